@@ -17,16 +17,18 @@
 
 #include <Vorb/ecs/Entity.h>
 
+#include "VoxelBroadPhase.h"
+
 class GameSystem;
 class SpaceSystem;
-struct AabbCollidableComponent;
 
 class AABBCollidableComponentUpdater {
 public:
     void update(GameSystem* gameSystem, SpaceSystem* spaceSystem);
 
+    const VoxelBroadPhase& getBroadPhase() const { return m_broadPhase; }
 private:
-    void collideWithVoxels(AabbCollidableComponent& cmp, GameSystem* gameSystem, SpaceSystem* spaceSystem);
+    VoxelBroadPhase m_broadPhase; ///< Finds the voxel collisions of all AABBs
 };
 
 #endif // AABBCollidableComponentUpdater_h__
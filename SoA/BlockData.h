@@ -76,7 +76,7 @@ class Block
     nString sinkID;
     ui16 explosionRays;
     ui16 floraHeight = 0;
-    ui16 liquidStartID = 0;
+    ui16 liquidStartID = 0; ///< Level l of this liquid is block liquidStartID + l
     ui16 liquidLevels = 0;
 
     BlockOcclusion occlude;
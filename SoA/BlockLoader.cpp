@@ -222,6 +222,7 @@ void GameBlockPostProcess::invoke(Sender s, ui16 id) {
 
     // Ca Physics
     if (block.caFilePath.length()) {
+        const CaPhysicsType* caType = nullptr;
         // Check if this physics type was already loaded
         auto it = m_caCache->find(block.caFilePath);
         if (it == m_caCache->end()) {
@@ -230,16 +231,50 @@ void GameBlockPostProcess::invoke(Sender s, ui16 id) {
             CaPhysicsType* newType = new CaPhysicsType();
             // Load in the data
             if (newType->loadFromYml(block.caFilePath, m_iom)) {
-                block.caIndex = newType->getCaIndex();
-                block.caAlg = newType->getCaAlg();
+                caType = newType;
             } else {
                 delete newType;
             }
         } else {
-            block.caIndex = it->second->getCaIndex();
-            block.caAlg = it->second->getCaAlg();
+            caType = it->second;
+        }
+        if (caType) {
+            block.caIndex = caType->getCaIndex();
+            block.caAlg = caType->getCaAlg();
+            // The levels come through here too, they already know theirs
+            if (block.caAlg == CAAlgorithm::LIQUID && !block.liquidLevels && caType->getLiquidLevels()) {
+                // Invalidates block
+                BlockLoader::addLiquidLevels((BlockPack*)s, id, caType->getLiquidLevels());
+            }
+        }
+    }
+}
+
+bool BlockLoader::addLiquidLevels(BlockPack* pack, BlockID id, ui32 levels) {
+    BlockPack& blocks = *pack;
+    blocks[id].liquidStartID = id - 1;
+    blocks[id].liquidLevels = (ui16)levels;
+
+    std::vector<BlockID> ids(1, id);
+    bool isContiguous = true;
+    for (ui32 l = 2; l <= levels; l++) {
+        // Copy, append moves the blocks
+        Block level = blocks[id];
+        level.sID = blocks[id].sID + "_" + std::to_string(l);
+        BlockID levelID = pack->append(level);
+        ids.push_back(levelID);
+        if (levelID != id + l - 1) isContiguous = false;
+    }
+
+    if (!isContiguous) {
+        // An old block mapping can put the levels elsewhere
+        printf("Liquid %s has no room for its %u levels, it won't flow. Delete %s to fix it.\n",
+               blocks[id].sID.c_str(), levels, BLOCK_MAPPING_PATH);
+        for (auto& levelID : ids) {
+            blocks[levelID].liquidLevels = 0;
         }
     }
+    return isContiguous;
 }
 
 bool BlockLoader::saveMapping(const vio::IOManager& iom, const cString filePath, BlockPack* pack) {    
@@ -42,6 +42,14 @@ class BlockLoader
     /// @param pack: Source of block data
     /// @return true on success, false on failure
     static bool saveBlocks(const nString& filePath, BlockPack* pack);
+
+    /// Makes block id level 1 of a liquid and appends its other levels as
+    /// <sID>_2 to <sID>_<levels>, which need the IDs right after it
+    /// @param pack: Pack holding the liquid block
+    /// @param id: ID of the liquid block
+    /// @param levels: Number of liquid levels
+    /// @return false if the levels didn't get contiguous IDs, the liquid won't flow then
+    static bool addLiquidLevels(BlockPack* pack, BlockID id, ui32 levels);
 private:
     /// Sets up the water blocks. This is temporary
     /// @param blocks: Output list for blocks
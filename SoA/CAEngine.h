@@ -3,14 +3,14 @@
 #include <Vorb/VorbPreDecl.inl>
 
 #include "CellularAutomataTask.h"
+#include "ChunkHandle.h"
 #include "Constants.h"
 #include "LiquidData.h"
 
 DECL_VIO(class IOManager)
 
-class ChunkManager;
+class BlockPack;
 class Chunk;
-class PhysicsEngine;
 
 /// Resolution of CA updates in frames
 #define CA_TICK_RES 4
@@ -30,11 +30,6 @@ typedef std::vector<CaPhysicsType*> CaPhysicsTypeList;
 
 class CaPhysicsType {
 public:
-
-    /// Updates the type.
-    /// @return true if it this physics type should simulate
-    bool update();
-
     /// Loads the data from a yml file
     /// @param filePath: path of the yml file
     /// @param ioManager: IOManager that will read the file
@@ -45,7 +40,7 @@ class CaPhysicsType {
     const int& getCaIndex() const { return _caIndex; }
     const ui32& getUpdateRate() const { return _data.updateRate; }
     const CAAlgorithm& getCaAlg() const { return _data.alg; }
-    const bool& getIsEven() const { return _isEven; }
+    const ui32& getLiquidLevels() const { return _data.liquidLevels; }
 
     // Static functions
     /// Gets the number of CA types currently cached
@@ -59,31 +54,55 @@ class CaPhysicsType {
 
     CaPhysicsData _data; ///< The algorithm specific data
     int _caIndex; ///< index into typesArray
-    bool _isEven = false;  ///< Used for optimization, only update odd or even chunks at any time
-
-    ui32 _ticks = 0; ///< Counts the ticks
 };
 
+/// Most cells a task simulates per tick, the rest wait for the next tick
+#define MAX_CA_UPDATES_PER_TASK 4096
+
+// Each worker thread gets one of these
 class CAEngine {
 public:
-    CAEngine(ChunkManager* chunkManager, PhysicsEngine* physicsEngine);
-    void setChunk(Chunk* chunk) { _chunk = chunk; }
-    void updateSpawnerBlocks(bool powders);
-    void updateLiquidBlocks(int caIndex);
-    void updatePowderBlocks(int caIndex);
+    /// Simulates the queued cells of chunk whose CA type is in typeMask.
+    /// Cells may move into the neighbors, they must not be simulating at the same
+    /// time. Changed chunks are flagged for one re-mesh at the end.
+    /// @param neighbors: Handles in Chunk::neighbors order, may be unacquired
+    /// @param typeMask: Bit caIndex is set for CA types that tick
+    void update(ChunkHandle& chunk, ChunkHandle neighbors[6], const BlockPack* blocks, ui64 typeMask);
 private:
-    
-    void liquidPhysics(i32 startBlockIndex, i32 b);
-    void powderPhysics(i32 c);
-
-//    i32 _dirIndex;
-    i32 _lowIndex;
-    i32 _range;
-    i32 _highIndex;
-    std::vector<ui16> _usedUpdateFlagList;
-    bool _blockUpdateFlagList[CHUNK_SIZE];
-    Chunk* _chunk;
-//    Chunk* _lockedChunk
-//    ChunkManager* m_chunkManager;
-//    PhysicsEngine* m_physicsEngine;
-};
\ No newline at end of file
+    /// A voxel in the chunk or one of its neighbors
+    struct CACell {
+        i32 chunk; ///< -1 for the chunk, else the neighbor direction
+        i32 index;
+    };
+
+    void liquidPhysics(const CACell& cell, ui16 blockID);
+    void powderPhysics(const CACell& cell, ui16 blockID);
+
+    bool getNeighborCell(const CACell& cell, int dir, OUT CACell& next) const;
+    ui16 readCell(const CACell& cell);
+    /// Sets the cell if it still holds expected. Neighbor cells are compared and set
+    /// under their lock, since other tasks may touch the same neighbor. Own cells
+    /// that were edited since the copy take the edit and fail.
+    bool swapCell(const CACell& cell, ui16 expected, ui16 desired);
+    void setOwnCell(int index, ui16 blockID);
+    /// Queues the cell and the voxels next to it for the next tick
+    void wakeCell(const CACell& cell);
+    void flushChanges(ChunkHandle& chunk);
+
+    const BlockPack* m_blockPack = nullptr;
+    Chunk* m_chunk = nullptr;
+    ChunkHandle* m_neighborHandles = nullptr;
+    Chunk* m_neighbors[6]; ///< Null if not generated
+    ui64 m_typeMask;
+    int m_dirIndex = 0; ///< Rotates powder slide directions without rand()
+
+    ui16 m_blocks[CHUNK_SIZE]; ///< Flat copy of the chunk
+    ui16 m_snapshot[CHUNK_SIZE]; ///< The chunk as it was copied, to spot edits made meanwhile
+    std::vector<ui16> m_cells; ///< Sorted unique cells to simulate
+    std::vector<ui16> m_changed; ///< Own cells to write back
+    std::vector<ui16> m_nextCells; ///< Own cells for the next tick
+
+    // Per neighbor
+    std::vector<ui16> m_neighborCells[6]; ///< Cells for the next tick of the neighbor
+    std::vector<ui16> m_neighborChanged[6];
+};
@@ -16,15 +16,14 @@
 #define CellularAutomataTask_h__
 
 #include <Vorb/IThreadPoolTask.h>
+#include <atomic>
 
+#include "ChunkHandle.h"
+#include "ConcurrentRecycler.h"
 #include "VoxPool.h"
 
+class BlockPack;
 class CaPhysicsType;
-class Chunk;
-class ChunkManager;
-class ChunkMeshManager;
-class PhysicsEngine;
-class ChunkMeshTask;
 
 #define CA_TASK_ID 3
 
@@ -36,30 +35,19 @@ enum class CAAlgorithm {
 
 class CellularAutomataTask : public vcore::IThreadPoolTask<WorkerData> {
 public:
-    friend class ChunkManager;
-    friend class SphericalVoxelComponentUpdater;
-    /// Constructs the task
-    CellularAutomataTask(ChunkManager* chunkManager,
-                         PhysicsEngine* physicsEngine,
-                         Chunk* chunk,
-                         OPT ChunkMeshManager* meshManager);
-
-    /// Adds a caPhysicsType for update
-    void addCaTypeToUpdate(CaPhysicsType* caType) {
-        typesToUpdate.push_back(caType);
-    }
+    CellularAutomataTask() : vcore::IThreadPoolTask<WorkerData>(CA_TASK_ID) {}
 
     /// Executes the task
     void execute(WorkerData* workerData) override;
 
-    ChunkMeshTask* renderTask = nullptr; ///< A nested to force re-mesh
+    void cleanup() override;
 
-private:
-    std::vector<CaPhysicsType*> typesToUpdate; ///< All the CA types that will be updated by this task
-    Chunk* _chunk = nullptr; ///< The chunk we are updating
-    ChunkManager* m_chunkManager = nullptr;
-    PhysicsEngine* m_physicsEngine = nullptr;
-    ChunkMeshManager* meshManager = nullptr;
+    ChunkHandle chunk;
+    ChunkHandle neighborHandles[6]; ///< In Chunk::neighbors order
+    const BlockPack* blockPack = nullptr;
+    ui64 typeMask = 0; ///< Bit caIndex is set for CA types that tick
+    std::atomic<ui32>* runningTasks = nullptr; ///< Decremented when the task is done
+    ConcurrentRecycler<CellularAutomataTask>* recycler = nullptr; ///< Where the task came from
 };
 
-#endif // CellularAutomataTask_h__
\ No newline at end of file
+#endif // CellularAutomataTask_h__
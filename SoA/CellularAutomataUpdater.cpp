@@ -0,0 +1,37 @@
+#include "stdafx.h"
+#include "CellularAutomataUpdater.h"
+
+#include "CAEngine.h"
+#include "ChunkGrid.h"
+
+void CellularAutomataUpdater::init(ChunkGrid* grid, OPT vcore::ThreadPool<WorkerData>* threadPool) {
+    m_grid = grid;
+    m_checkerboard.init(threadPool);
+    m_dueTypes = 0;
+}
+
+void CellularAutomataUpdater::update() {
+    // Tick the types even while a batch runs, so slow batches don't slow the CA
+    const CaPhysicsTypeList& types = CaPhysicsType::typesArray;
+    m_ticks.resize(types.size(), 0);
+    for (size_t i = 0; i < types.size() && i < 64; i++) {
+        if (++m_ticks[i] >= types[i]->getUpdateRate() * HALF_CA_TICK_RES) {
+            m_ticks[i] = 0;
+            m_dueTypes |= (ui64)1 << i;
+        }
+    }
+
+    if (m_checkerboard.isBusy() || !m_dueTypes) return;
+
+    const BlockPack* blockPack = m_grid->blockPack;
+    ui64 typeMask = m_dueTypes;
+    m_checkerboard.sendBatch(m_grid->acquireActiveChunks(),
+                             [](const Chunk& chunk) { return (bool)chunk.hasCaUpdates; },
+                             [&](CellularAutomataTask& task) {
+                                 task.blockPack = blockPack;
+                                 task.typeMask = typeMask;
+                             });
+    m_grid->releaseActiveChunks();
+    m_checkerboard.runInlineTasks();
+    m_dueTypes = 0;
+}
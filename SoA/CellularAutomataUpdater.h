@@ -0,0 +1,38 @@
+///
+/// CellularAutomataUpdater.h
+/// Seed of Andromeda
+///
+/// Copyright 2014 Regrowth Studios
+/// MIT License
+///
+/// Summary:
+/// Ticks the CA physics types and schedules CA tasks in a checkerboard
+/// pattern, so that neighboring chunks never simulate at the same time.
+///
+
+#pragma once
+
+#ifndef CellularAutomataUpdater_h__
+#define CellularAutomataUpdater_h__
+
+#include "CellularAutomataTask.h"
+#include "ChunkCheckerboard.h"
+
+class ChunkGrid;
+
+class CellularAutomataUpdater {
+public:
+    void init(ChunkGrid* grid, OPT vcore::ThreadPool<WorkerData>* threadPool);
+
+    /// Sends CA tasks for chunks of one color when a CA type ticks and the last
+    /// batch has finished. Each tick alternates the color. Without a thread pool
+    /// the batch runs on the calling thread.
+    void update();
+private:
+    ChunkGrid* m_grid = nullptr;
+    ChunkCheckerboard<CellularAutomataTask> m_checkerboard;
+    std::vector<ui32> m_ticks; ///< Per CA type
+    ui64 m_dueTypes = 0; ///< Bit caIndex is set for CA types that ticked
+};
+
+#endif // CellularAutomataUpdater_h__
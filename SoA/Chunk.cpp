@@ -10,6 +10,20 @@ void Chunk::init(WorldCubeFace face) {
     m_chunkPosition.pos = i32v3(m_id.x, m_id.y, m_id.z);
     m_chunkPosition.face = face;
     m_voxelPosition = VoxelSpaceConversions::chunkToVoxel(m_chunkPosition);
+
+    // Flora owners of the last chunk here don't apply
+    std::vector<ui64>().swap(floraOwners);
+    numFloraOwners = 0;
+    // Dropped by ChunkGrid when the last chunk here was freed
+    assert(!pendingNodes);
+
+    // Dark until the light task seeds it
+    IntervalTree<ui16>::LNode lightNode;
+    lightNode.set(0, CHUNK_SIZE, 0);
+    sunlight.clear();
+    lampLight.clear();
+    sunlight.initFromSortedArray(vvox::VoxelStorageState::INTERVAL_TREE, &lightNode, 1);
+    lampLight.initFromSortedArray(vvox::VoxelStorageState::INTERVAL_TREE, &lightNode, 1);
 }
 
 void Chunk::initAndFillEmpty(WorldCubeFace face, vvox::VoxelStorageState /*= vvox::VoxelStorageState::INTERVAL_TREE*/) {
@@ -22,12 +36,20 @@ void Chunk::initAndFillEmpty(WorldCubeFace face, vvox::VoxelStorageState /*= vvo
     tertiary.initFromSortedArray(vvox::VoxelStorageState::INTERVAL_TREE, &tertiaryNode, 1);
 }
 
-void Chunk::setRecyclers(vcore::FixedSizeArrayRecycler<CHUNK_SIZE, ui16>* shortRecycler) {
+void Chunk::setRecyclers(vcore::FixedSizeArrayRecycler<CHUNK_SIZE, ui16>* shortRecycler, std::atomic<size_t>* arrayBytes /*= nullptr*/) {
     blocks.setArrayRecycler(shortRecycler);
     tertiary.setArrayRecycler(shortRecycler);
+    sunlight.setArrayRecycler(shortRecycler);
+    lampLight.setArrayRecycler(shortRecycler);
+    blocks.setArrayByteCounter(arrayBytes);
+    tertiary.setArrayByteCounter(arrayBytes);
+    sunlight.setArrayByteCounter(arrayBytes);
+    lampLight.setArrayByteCounter(arrayBytes);
 }
 
 void Chunk::updateContainers() {
     blocks.update(dataMutex);
     tertiary.update(dataMutex);
+    sunlight.update(dataMutex);
+    lampLight.update(dataMutex);
 }
\ No newline at end of file
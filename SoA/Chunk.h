@@ -22,7 +22,10 @@
 #include "MetaSection.h"
 #include "ChunkGenerator.h"
 #include "ChunkID.h"
+#include "VoxelLightEngine.h"
 #include <Vorb/FixedSizeArrayRecycler.hpp>
+#include <atomic>
+#include <shared_mutex>
 
 #if defined(_MSC_VER)
 #define ALIGNED_(x) __declspec(align(x))
@@ -32,6 +35,7 @@
 
 class Chunk;
 typedef Chunk* ChunkPtr;
+struct VoxelNodeBatch;
 
 // TODO(Ben): Move to file
 typedef ui16 BlockIndex;
@@ -64,13 +68,13 @@ class Chunk {
     friend class SphericalVoxelComponentUpdater;
 public:
     
-    Chunk() : neighbor(), genLevel(ChunkGenLevel::GEN_NONE), pendingGenLevel(ChunkGenLevel::GEN_NONE), isAccessible(false), accessor(nullptr), m_inLoadRange(false),  m_handleState(0), m_handleRefCount(0) {}
+    Chunk() : neighbor(), genLevel(ChunkGenLevel::GEN_NONE), pendingGenLevel(ChunkGenLevel::GEN_NONE), isAccessible(false), pendingNodes(nullptr), numFloraOwners(0), meshSlabs(0), hasLightUpdates(false), isLit(false), hasCaUpdates(false), occupancy(0), isOccupancyStale(true), accessor(nullptr), m_inLoadRange(false), m_handleRefCount(0) {}
     // Initializes the chunk but does not set voxel data
     // Should be called after ChunkAccessor sets m_id
     void init(WorldCubeFace face);
     // Initializes the chunk and sets all voxel data to 0
     void initAndFillEmpty(WorldCubeFace face, vvox::VoxelStorageState = vvox::VoxelStorageState::INTERVAL_TREE);
-    void setRecyclers(vcore::FixedSizeArrayRecycler<CHUNK_SIZE, ui16>* shortRecycler);
+    void setRecyclers(vcore::FixedSizeArrayRecycler<CHUNK_SIZE, ui16>* shortRecycler, std::atomic<size_t>* arrayBytes = nullptr);
     void updateContainers();
 
     /************************************************************************/
@@ -92,6 +96,22 @@ class Chunk {
 
     // Marks the chunks as dirty and flags for a re-mesh
     void flagDirty() { isDirty = true; }
+    // Flags the mesh slabs an edit of voxel row y can change. Faces and ambient
+    // occlusion reach one row up and down, so borders flag the next slab too.
+    void flagMeshSlabs(int y) {
+        int slab = y / MESH_SLAB_HEIGHT;
+        ui8 bits = (ui8)(1 << slab);
+        if (y % MESH_SLAB_HEIGHT == 0 && slab > 0) bits |= (ui8)(1 << (slab - 1));
+        if (y % MESH_SLAB_HEIGHT == MESH_SLAB_HEIGHT - 1 && slab < MESH_SLAB_COUNT - 1) bits |= (ui8)(1 << (slab + 1));
+        meshSlabs |= bits;
+        isOccupancyStale = true;
+    }
+    // Queues a changed voxel for the light task of this chunk
+    void queueLightUpdate(ui16 blockIndex) {
+        std::lock_guard<std::mutex> l(lckLightQueues);
+        lightQueues.changedVoxels.push_back(blockIndex);
+        hasLightUpdates = true;
+    }
 
     /************************************************************************/
     /* Members                                                              */
@@ -115,17 +135,43 @@ class Chunk {
     bool isDirty;
     f32 distance2; //< Squared distance
     int numBlocks;
-    // TODO(Ben): reader/writer lock
-    std::mutex dataMutex;
+    /// Lock shared to read voxel data, exclusively to write it or change the
+    /// container state. Readers (meshing, rays, collision) don't block each other.
+    std::shared_timed_mutex dataMutex;
 
     volatile bool isAccessible;
 
     // TODO(Ben): Think about data locality.
     vvox::SmartVoxelContainer<ui16> blocks;
     vvox::SmartVoxelContainer<ui16> tertiary;
+    // Only written by the light task of this chunk, see VoxelLightEngine
+    vvox::SmartVoxelContainer<ui16> sunlight;
+    vvox::SmartVoxelContainer<ui16> lampLight;
     // Block indexes where flora must be generated.
     std::vector<ui16> floraToGenerate;
+    /// Flora from other chunks waiting for terrain, see VoxelNodeSetter
+    std::atomic<VoxelNodeBatch*> pendingNodes;
+    /// Which flora node set each flora voxel, so late nodes know if they win.
+    /// Open addressed, only touched by VoxelNodeSetter under the data lock.
+    std::vector<ui64> floraOwners;
+    ui32 numFloraOwners;
     volatile ui32 updateVersion;
+    /// Mesh slabs edited since the last mesh task took them
+    std::atomic<ui8> meshSlabs;
+    /// Light work for the next light task
+    std::mutex lckLightQueues;
+    ChunkLightQueues lightQueues;
+    std::atomic<bool> hasLightUpdates;
+    volatile bool isLit; ///< Light was seeded by a light task
+    /// Sparse set of voxels the CA simulates next tick, may have duplicates
+    std::mutex lckCaUpdates;
+    std::vector<ui16> caUpdates;
+    std::atomic<bool> hasCaUpdates;
+    /// Bit per 8x8x8 cell that has a non-air voxel, cell (x, y, z) is bit
+    /// x + z * 4 + y * 16. Rebuilt by VoxelRaycaster when stale, so writers
+    /// only have to set isOccupancyStale after changing blocks.
+    std::atomic<ui64> occupancy;
+    std::atomic<bool> isOccupancyStale;
 
     ChunkAccessor* accessor;
 
@@ -142,13 +188,12 @@ class Chunk {
     bool m_inLoadRange;
 
     ChunkID m_id;
+    ui32 m_pageIndex = 0; ///< Index of the PagedChunkAllocator page holding this chunk
 
     /************************************************************************/
     /* Chunk Handle Data                                                    */
     /************************************************************************/
-    std::mutex m_handleMutex;
-    ALIGNED_(4) volatile ui32 m_handleState;
-    ALIGNED_(4) volatile ui32 m_handleRefCount;
+    std::atomic<ui32> m_handleRefCount; ///< Only incremented while non-zero, see ChunkAccessor
 };
 
 #endif // NChunk_h__
@@ -3,13 +3,6 @@
 
 #include "ChunkAllocator.h"
 
-const ui32 HANDLE_STATE_ALIVE = 2;
-#ifdef FAST_CHUNK_ACCESS
-const ui32 HANDLE_STATE_DEAD = 0;
-const ui32 HANDLE_STATE_ACQUIRING = 1;
-const ui32 HANDLE_STATE_FREEING = 3;
-#endif
-
 ChunkHandle::ChunkHandle(const ChunkHandle& other) :
     m_accessor(other.m_acquired ? other.m_chunk->accessor : other.m_accessor),
     m_id(other.m_id),
@@ -45,154 +38,183 @@ void ChunkAccessor::init(PagedChunkAllocator* allocator) {
     m_allocator = allocator;
 }
 void ChunkAccessor::destroy() {
-    std::unordered_map<ChunkID, ChunkHandle>().swap(m_chunkLookup);
+    for (auto& shard : m_shards) {
+        std::lock_guard<std::mutex> l(shard.lock);
+        shard.clear();
+    }
+    m_countAlive = 0;
 }
 
-#ifdef FAST_CHUNK_ACCESS
-
 ChunkHandle ChunkAccessor::acquire(ChunkID id) {
-    std::unique_lock<std::mutex> lMap(m_lckLookup);
-    auto& it = m_chunkLookup.find(id);
-    if (it == m_chunkLookup.end()) {
-        ChunkHandle& h = m_chunkLookup[id];
-        h.m_chunk = m_allocator->alloc();
-        h->m_handleRefCount = 1;
-        h->m_id = id;
-        h->accessor = this;
-        h->m_handleState = HANDLE_STATE_ALIVE;
-        lMap.unlock();
-        onAdd(ChunkHandle(h));
-        return h;
-    } else {
-        InterlockedIncrement(&it->second->m_handleRefCount);
-        it->second->m_handleState = HANDLE_STATE_ALIVE;
-        return it->second;
-    }
-}
-ChunkHandle ChunkAccessor::acquire(ChunkHandle& chunk) {
-    switch (InterlockedCompareExchange(&chunk->m_handleState, HANDLE_STATE_ACQUIRING, HANDLE_STATE_ALIVE)) {
-    case HANDLE_STATE_FREEING:
-        return acquire(chunk->m_id);
-    case HANDLE_STATE_ACQUIRING:
-        InterlockedIncrement(&chunk->m_handleRefCount);
-        return chunk;
-    case HANDLE_STATE_ALIVE:
-        InterlockedIncrement(&chunk->m_handleRefCount);
-        InterlockedCompareExchange(&chunk->m_handleState, HANDLE_STATE_ALIVE, HANDLE_STATE_ACQUIRING);
-        return chunk;
-    default:
-        throw std::invalid_argument("INVALID CHUNK HANDLE STATE");
-    }
-}
-void ChunkAccessor::release(ChunkHandle& chunk) {
-    ui32 retries = 0;
-
-    // TODO(Cristian): Heavy thread-safety
-    ui32 currentCount = InterlockedDecrement(&chunk->m_handleRefCount);
-RETEST_CHUNK_LIVELINESS:
-    if (currentCount == 0) {
-        // If the chunk is alive, set it to zombie mode. Otherwise, it's being birthed or already dead.
-        switch (InterlockedCompareExchange(&chunk->m_handleState, HANDLE_STATE_FREEING, HANDLE_STATE_ALIVE)) {
-        case HANDLE_STATE_ALIVE:
-        { // Highlander... there can only be one... killer of chunks
-            std::lock_guard<std::mutex> chunkLock(chunk->m_handleMutex);
-            currentCount = InterlockedDecrement(&chunk->m_handleRefCount);
-            if (chunk->m_handleState == HANDLE_STATE_FREEING) {
-                // We are able to kill this chunk
-                safeRemove(chunk);
-            }
+    LookupShard& shard = getShard(id);
+    while (true) {
+        std::unique_lock<std::mutex> l(shard.lock);
+        Chunk* chunk = shard.find(id);
+        if (!chunk) {
+            // Nobody has it, add a new chunk
+            chunk = m_allocator->alloc();
+            chunk->m_id = id;
+            chunk->accessor = this;
+            chunk->m_handleRefCount = 1;
+            shard.insert(chunk);
+            l.unlock();
+            m_countAlive++;
+
+            ChunkHandle tmp;
+            tmp.m_chunk = chunk;
+            tmp.m_id = id;
+            onAdd(tmp);
+
+            tmp.m_acquired = true;
+            return tmp;
         }
-        case HANDLE_STATE_FREEING:
-            // Let the other thread do the work
-            break;
-        case HANDLE_STATE_ACQUIRING:
-            // Need to retry
-            std::this_thread::yield();
-            currentCount = chunk->m_handleRefCount;
-            retries++;
-            goto RETEST_CHUNK_LIVELINESS;
+
+        // Holding the shard lock keeps the chunk from being freed, but a chunk
+        // whose count already hit zero is on its way out and can't be revived.
+        ui32 count = chunk->m_handleRefCount;
+        while (count != 0) {
+            if (chunk->m_handleRefCount.compare_exchange_weak(count, count + 1)) {
+                ChunkHandle rv;
+                rv.m_chunk = chunk;
+                rv.m_id = id;
+                rv.m_acquired = true;
+                return rv;
+            }
         }
-    }
 
-    // Invalidate the handle
-    chunk.m_chunk = nullptr;
-    if (retries > 2) {
-        printf("A lot of release retries occurred: %d\n", retries);
-        fflush(stdout);
+        // Wait for the releasing thread to take it out of the lookup
+        l.unlock();
+        std::this_thread::yield();
     }
 }
-
-#else
-
-ChunkHandle ChunkAccessor::acquire(ChunkID id) {
-    bool wasOld;
-    ChunkHandle chunk = safeAdd(id, wasOld);
-
-    if (wasOld) return acquire(chunk);
-
-    chunk.m_acquired = true;
-    return chunk;
+ChunkHandle ChunkAccessor::tryAcquire(ChunkID id) {
+    LookupShard& shard = getShard(id);
+    std::lock_guard<std::mutex> l(shard.lock);
+    Chunk* chunk = shard.find(id);
+    if (chunk) {
+        // Same as acquire, a count of zero means it is being removed
+        ui32 count = chunk->m_handleRefCount;
+        while (count != 0) {
+            if (chunk->m_handleRefCount.compare_exchange_weak(count, count + 1)) {
+                ChunkHandle rv;
+                rv.m_chunk = chunk;
+                rv.m_id = id;
+                rv.m_acquired = true;
+                return rv;
+            }
+        }
+    }
+    return ChunkHandle();
 }
 ChunkHandle ChunkAccessor::acquire(ChunkHandle& chunk) {
-    std::lock_guard<std::mutex> lChunk(chunk->m_handleMutex);
-    if (chunk->m_handleRefCount == 0) {
-        // We need to re-add the chunk
-        bool wasOld = false;
-        chunk.m_acquired = true;
-        return safeAdd(chunk.m_id, wasOld);
-    } else {
-        ChunkHandle retValue = {};
-        memcpy(&retValue, &chunk, sizeof(ChunkHandle));
-        retValue->m_handleRefCount++;
-        retValue.m_acquired = true;
-        return retValue;
+    // The caller holds a reference, so the count can only be zero if the handle
+    // was released out from under us. No lookup needed in the common case.
+    ui32 count = chunk->m_handleRefCount;
+    while (count != 0) {
+        if (chunk->m_handleRefCount.compare_exchange_weak(count, count + 1)) {
+            ChunkHandle rv;
+            rv.m_chunk = chunk.m_chunk;
+            rv.m_id = chunk.m_id;
+            rv.m_acquired = true;
+            return rv;
+        }
     }
+    return acquire(chunk.m_id);
 }
 void ChunkAccessor::release(ChunkHandle& chunk) {
-    std::lock_guard<std::mutex> lChunk(chunk->m_handleMutex);
-    chunk->m_handleRefCount--;
-    if (chunk->m_handleRefCount == 0) {
-        // We need to remove the chunk
+    if (--chunk->m_handleRefCount == 0) {
+        // We were the last reference and nobody can acquire it anymore
         safeRemove(chunk);
     }
     chunk.m_acquired = false;
     chunk.m_accessor = this;
 }
 
-#endif
-
-ChunkHandle ChunkAccessor::safeAdd(ChunkID id, bool& wasOld) {
-    std::unique_lock<std::mutex> l(m_lckLookup);
-    auto it = m_chunkLookup.find(id);
-    if (it == m_chunkLookup.end()) {
-        wasOld = false;
-        ChunkHandle& h = m_chunkLookup[id];
-        h.m_chunk = m_allocator->alloc();
-        h.m_id = id;
-        h->m_id = id;
-        h->accessor = this;
-        h->m_handleState = HANDLE_STATE_ALIVE;
-        h->m_handleRefCount = 1;
-        ChunkHandle tmp(h);
-        l.unlock();
-        onAdd(tmp);
-        return h;
-    } else {
-        wasOld = true;
-        return it->second;
-    }
-}
 void ChunkAccessor::safeRemove(ChunkHandle& chunk) {
     { // TODO(Cristian): This needs to be added to a free-list?
-        std::lock_guard<std::mutex> l(m_lckLookup);
+        LookupShard& shard = getShard(chunk.m_id);
+        std::lock_guard<std::mutex> l(shard.lock);
 
         // Make sure it can't be accessed until acquired again
         chunk->accessor = nullptr;
 
         // TODO(Ben): Time based free?
-        m_chunkLookup.erase(chunk.m_id);
+        shard.erase(chunk.m_id);
     }
+    m_countAlive--;
     // Fire event before deallocating
     onRemove(chunk);
     m_allocator->free(chunk.m_chunk);
 }
+
+ui64 ChunkAccessor::hashID(ChunkID id) {
+    // Neighboring chunks only differ in a few low bits, so mix them all in
+    ui64 h = id.id;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+#define INITIAL_SHARD_SLOTS 64
+#define SHARD_SLOT_SHIFT 32 ///< Low bits of the hash pick the shard, so probe with high bits
+
+Chunk* ChunkAccessor::LookupShard::find(ChunkID id) const {
+    if (m_size == 0) return nullptr;
+    size_t mask = m_slots.size() - 1;
+    size_t i = (size_t)(hashID(id) >> SHARD_SLOT_SHIFT) & mask;
+    while (m_slots[i]) {
+        if (m_slots[i]->m_id == id) return m_slots[i];
+        i = (i + 1) & mask;
+    }
+    return nullptr;
+}
+
+void ChunkAccessor::LookupShard::insert(Chunk* chunk) {
+    // Keep load under 1/2 so probes stay short
+    if ((m_size + 1) * 2 > m_slots.size()) grow();
+    size_t mask = m_slots.size() - 1;
+    size_t i = (size_t)(hashID(chunk->m_id) >> SHARD_SLOT_SHIFT) & mask;
+    while (m_slots[i]) i = (i + 1) & mask;
+    m_slots[i] = chunk;
+    m_size++;
+}
+
+void ChunkAccessor::LookupShard::erase(ChunkID id) {
+    if (m_size == 0) return;
+    size_t mask = m_slots.size() - 1;
+    size_t i = (size_t)(hashID(id) >> SHARD_SLOT_SHIFT) & mask;
+    while (m_slots[i] && m_slots[i]->m_id != id) i = (i + 1) & mask;
+    if (!m_slots[i]) return;
+
+    // Backward shift deletion, so no tombstones are needed
+    size_t j = i;
+    while (true) {
+        j = (j + 1) & mask;
+        if (!m_slots[j]) break;
+        size_t home = (size_t)(hashID(m_slots[j]->m_id) >> SHARD_SLOT_SHIFT) & mask;
+        // Move j into the hole only if its home isn't cyclically in (i, j]
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            m_slots[i] = m_slots[j];
+            i = j;
+        }
+    }
+    m_slots[i] = nullptr;
+    m_size--;
+}
+
+void ChunkAccessor::LookupShard::clear() {
+    std::vector<Chunk*>().swap(m_slots);
+    m_size = 0;
+}
+
+void ChunkAccessor::LookupShard::grow() {
+    std::vector<Chunk*> old(m_slots.empty() ? INITIAL_SHARD_SLOTS : m_slots.size() * 2, nullptr);
+    old.swap(m_slots);
+    m_size = 0;
+    for (auto& chunk : old) {
+        if (chunk) insert(chunk);
+    }
+}
@@ -27,9 +27,11 @@ class ChunkAccessor {
     void destroy();
 
     ChunkHandle acquire(ChunkID id);
+    /// Like acquire, but returns an unacquired handle instead of adding missing chunks
+    ChunkHandle tryAcquire(ChunkID id);
 
     size_t getCountAlive() const {
-        return m_chunkLookup.size();
+        return m_countAlive;
     }
 
     Event<ChunkHandle&> onAdd; ///< Called when a handle is added
@@ -38,11 +40,33 @@ class ChunkAccessor {
     ChunkHandle acquire(ChunkHandle& chunk);
     void release(ChunkHandle& chunk);
 
-    ChunkHandle safeAdd(ChunkID id, bool& wasOld);
     void safeRemove(ChunkHandle& chunk);
 
-    std::mutex m_lckLookup;
-    std::unordered_map<ChunkID, ChunkHandle> m_chunkLookup;
+    /// One shard of the chunk lookup. Open addressed with linear probing, so a
+    /// lookup is a short scan of contiguous pointers under a lock that is only
+    /// contended by chunks hashing to the same shard.
+    class LookupShard {
+    public:
+        Chunk* find(ChunkID id) const;
+        void insert(Chunk* chunk);
+        void erase(ChunkID id);
+        void clear();
+
+        std::mutex lock;
+    private:
+        void grow();
+
+        std::vector<Chunk*> m_slots; ///< Keyed by Chunk::m_id, nullptr is empty
+        size_t m_size = 0;
+    };
+
+    static const size_t NUM_LOOKUP_SHARDS = 64; ///< Must be a power of 2
+
+    static ui64 hashID(ChunkID id);
+    LookupShard& getShard(ChunkID id) { return m_shards[hashID(id) & (NUM_LOOKUP_SHARDS - 1)]; }
+
+    LookupShard m_shards[NUM_LOOKUP_SHARDS];
+    std::atomic<size_t> m_countAlive = { 0 };
     PagedChunkAllocator* m_allocator = nullptr;
 };
 
@@ -3,7 +3,7 @@
 #include "Chunk.h"
 
 #define MAX_VOXEL_ARRAYS_TO_CACHE 200
-#define NUM_SHORT_VOXEL_ARRAYS 3
+#define NUM_SHORT_VOXEL_ARRAYS 5
 #define NUM_BYTE_VOXEL_ARRAYS 1
 
 #define INITIAL_UPDATE_VERSION 1
@@ -20,28 +20,35 @@ PagedChunkAllocator::~PagedChunkAllocator() {
 }
 
 Chunk* PagedChunkAllocator::alloc() {
-    // TODO(Ben): limit
     std::lock_guard<std::mutex> lock(m_lock);
 
-    // Allocate chunk pages if needed
-    if (m_freeChunks.empty()) {
-        ChunkPage* page = new ChunkPage();
-        m_chunkPages.push_back(page);
-        // Add chunks to free chunks lists
-        for (size_t i = 0; i < CHUNK_PAGE_SIZE; i++) {
-            Chunk* chunk = &page->chunks[CHUNK_PAGE_SIZE - i - 1];
-            chunk->setRecyclers(&m_shortFixedSizeArrayRecycler);
-            m_freeChunks.push_back(chunk);
-        }
+    // Fill the fullest page so the emptier ones can drain and be released.
+    // Only a few pages are open at a time since we fill them.
+    ChunkPage* page = nullptr;
+    for (auto& p : m_openPages) {
+        if (!page || p->freeChunks.size() < page->freeChunks.size()) page = p;
     }
+    // Allocate chunk pages if needed
+    if (!page) page = allocPage();
+
     // Grab a free chunk
-    Chunk* chunk = m_freeChunks.back();
-    m_freeChunks.pop_back();
+    Chunk* chunk = page->freeChunks.back();
+    page->freeChunks.pop_back();
+    page->lastUsed = ++m_useCounter;
+    if (page->freeChunks.empty()) removeOpenPage(page);
 
     // Set defaults
     chunk->gridData = nullptr;
     chunk->m_inLoadRange = false;
     chunk->numBlocks = 0;
+    chunk->isDirty = false;
+    chunk->meshSlabs = 0;
+    chunk->isLit = false;
+    chunk->hasLightUpdates = false;
+    chunk->lightQueues.clear();
+    chunk->hasCaUpdates = false;
+    chunk->caUpdates.clear();
+    chunk->isOccupancyStale = true;
     chunk->genLevel = ChunkGenLevel::GEN_NONE;
     chunk->pendingGenLevel = ChunkGenLevel::GEN_NONE;
     chunk->isAccessible = false;
@@ -53,12 +60,90 @@ Chunk* PagedChunkAllocator::alloc() {
 }
 
 void PagedChunkAllocator::free(Chunk* chunk) {
-    // TODO(Ben): Deletion if there is a lot?
-    std::lock_guard<std::mutex> lock(m_lock);
-    m_freeChunks.push_back(chunk);
-
     // Free data
     chunk->blocks.clear();
     chunk->tertiary.clear();
+    chunk->sunlight.clear();
+    chunk->lampLight.clear();
     std::vector<ChunkQuery*>().swap(chunk->m_genQueryData.pending);
+
+    std::lock_guard<std::mutex> lock(m_lock);
+    ChunkPage* page = m_chunkPages[chunk->m_pageIndex];
+    page->freeChunks.push_back(chunk);
+    page->lastUsed = ++m_useCounter;
+    if (page->freeChunks.size() == 1) addOpenPage(page);
+
+    if (isOverBudget()) {
+        trim(0);
+    } else if (page->freeChunks.size() == CHUNK_PAGE_SIZE) {
+        // Keep one spare page around so we don't thrash at a page boundary
+        trim(1);
+    }
+}
+
+void PagedChunkAllocator::setMemoryBudget(size_t bytes) {
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_memoryBudget = bytes;
+    if (isOverBudget()) trim(0);
+}
+
+PagedChunkAllocator::ChunkPage* PagedChunkAllocator::allocPage() {
+    ChunkPage* page = new ChunkPage();
+    m_pageBytes += sizeof(ChunkPage);
+
+    // Reuse the slot of a released page so chunk page indices stay valid
+    ui32 index = 0;
+    while (index < m_chunkPages.size() && m_chunkPages[index]) index++;
+    if (index == m_chunkPages.size()) {
+        m_chunkPages.push_back(page);
+    } else {
+        m_chunkPages[index] = page;
+    }
+
+    // Add chunks to free chunks lists
+    page->freeChunks.resize(CHUNK_PAGE_SIZE);
+    for (size_t i = 0; i < CHUNK_PAGE_SIZE; i++) {
+        Chunk* chunk = &page->chunks[CHUNK_PAGE_SIZE - i - 1];
+        chunk->setRecyclers(&m_shortFixedSizeArrayRecycler, &m_arrayBytes);
+        chunk->m_pageIndex = index;
+        page->freeChunks[i] = chunk;
+    }
+    addOpenPage(page);
+    return page;
+}
+
+void PagedChunkAllocator::addOpenPage(ChunkPage* page) {
+    page->openIndex = m_openPages.size();
+    m_openPages.push_back(page);
+}
+
+void PagedChunkAllocator::removeOpenPage(ChunkPage* page) {
+    m_openPages[page->openIndex] = m_openPages.back();
+    m_openPages[page->openIndex]->openIndex = page->openIndex;
+    m_openPages.pop_back();
+    page->openIndex = NOT_OPEN;
+}
+
+void PagedChunkAllocator::trim(size_t keep) {
+    // Cached arrays are only a speedup, they go before anything else
+    if (isOverBudget()) m_shortFixedSizeArrayRecycler.destroy();
+
+    // Empty pages are open
+    std::vector<ChunkPage*> empty;
+    for (auto& p : m_openPages) {
+        if (p->freeChunks.size() == CHUNK_PAGE_SIZE) empty.push_back(p);
+    }
+    if (empty.size() <= keep) return;
+
+    // Least recently used first
+    std::sort(empty.begin(), empty.end(), [](const ChunkPage* a, const ChunkPage* b) {
+        return a->lastUsed < b->lastUsed;
+    });
+    for (size_t i = 0; i < empty.size() - keep; i++) {
+        ChunkPage* page = empty[i];
+        removeOpenPage(page);
+        m_chunkPages[page->chunks[0].m_pageIndex] = nullptr;
+        delete page;
+        m_pageBytes -= sizeof(ChunkPage);
+    }
 }
@@ -21,6 +21,11 @@
 #include "Constants.h"
 
 /*! @brief The chunk allocator.
+ *
+ * Chunks live in pages. Allocation fills the fullest page first so that sparsely
+ * used pages drain, and pages that become empty are returned to the OS, least
+ * recently used first, whenever the allocator is over its memory budget. Voxel
+ * arrays cached for reuse count towards the budget and are dropped first.
  */
 class PagedChunkAllocator {
     friend class SphericalVoxelComponentUpdater;
@@ -36,16 +41,42 @@ class PagedChunkAllocator {
     Chunk* alloc();
     /// Frees a chunk
     void free(Chunk* chunk);
+
+    /// Sets the soft limit on getMemoryUsage(), 0 for no limit.
+    /// Cached voxel arrays and empty pages are released right away while over it.
+    void setMemoryBudget(size_t bytes);
+    size_t getMemoryBudget() const { return m_memoryBudget; }
+    /// Bytes held by chunk pages, live voxel arrays and voxel arrays cached for reuse
+    size_t getMemoryUsage() const { return m_pageBytes + m_arrayBytes + getCachedArrayBytes(); }
+    bool isOverBudget() const { return m_memoryBudget && getMemoryUsage() > m_memoryBudget; }
 protected:
-    static const size_t CHUNK_PAGE_SIZE = 2048;
+    static const size_t CHUNK_PAGE_SIZE = 256;
+    static const size_t NOT_OPEN = (size_t)-1;
     struct ChunkPage {
         Chunk chunks[CHUNK_PAGE_SIZE];
+        std::vector<Chunk*> freeChunks; ///< Inactive chunks in this page
+        ui64 lastUsed = 0; ///< m_useCounter at the last alloc or free
+        size_t openIndex = NOT_OPEN; ///< Index in m_openPages, NOT_OPEN when full
     };
 
-    std::vector<Chunk*> m_freeChunks; ///< List of inactive chunks
-    std::vector<ChunkPage*> m_chunkPages; ///< All pages
+    ChunkPage* allocPage();
+    void addOpenPage(ChunkPage* page);
+    void removeOpenPage(ChunkPage* page);
+    size_t getCachedArrayBytes() const {
+        return m_shortFixedSizeArrayRecycler.getSize() * CHUNK_SIZE * sizeof(ui16);
+    }
+    /// Drops cached voxel arrays, then releases empty pages, least recently used
+    /// first, keeping at most keep of them. m_lock must be held.
+    void trim(size_t keep);
+
+    std::vector<ChunkPage*> m_chunkPages; ///< All pages, nullptr where one was released
+    std::vector<ChunkPage*> m_openPages; ///< Pages with free chunks
+    size_t m_pageBytes = 0; ///< Bytes held by m_chunkPages
+    std::atomic<size_t> m_arrayBytes = { 0 }; ///< Bytes held by flat voxel arrays of live chunks
+    size_t m_memoryBudget = 0;
+    ui64 m_useCounter = 0;
     vcore::FixedSizeArrayRecycler<CHUNK_SIZE, ui16> m_shortFixedSizeArrayRecycler; ///< For recycling voxel data
-    std::mutex m_lock; ///< Lock access to free-list
+    std::mutex m_lock; ///< Lock access to pages
 };
 
 #endif // ChunkAllocator_h__
@@ -0,0 +1,95 @@
+///
+/// ChunkCheckerboard.h
+/// Seed of Andromeda
+///
+/// Copyright 2014 Regrowth Studios
+/// MIT License
+///
+/// Summary:
+/// Sends chunk tasks that touch their neighbors in a checkerboard pattern.
+/// Chunks of one color, the parity of x + y + z, share no faces, so a
+/// batch of one color runs fully in parallel.
+///
+
+#pragma once
+
+#ifndef ChunkCheckerboard_h__
+#define ChunkCheckerboard_h__
+
+#include <atomic>
+#include <vector>
+
+#include "Chunk.h"
+#include "ChunkHandle.h"
+#include "ConcurrentRecycler.h"
+#include "VoxPool.h"
+
+/// T needs chunk, neighborHandles[6], runningTasks and recycler, like VoxelLightTask.
+/// Tasks release their handles and then decrement runningTasks when they are done.
+template<typename T>
+class ChunkCheckerboard {
+public:
+    void init(OPT vcore::ThreadPool<WorkerData>* threadPool) {
+        m_threadPool = threadPool;
+        m_runningTasks = 0;
+        m_color = 0;
+    }
+
+    /// True until every task of the last batch is done
+    bool isBusy() const { return m_runningTasks != 0; }
+
+    /// Sends a task for each generated chunk of the next color that isDue accepts,
+    /// or of the other color if none does. setup fills in the rest of the task.
+    /// Without a thread pool the tasks wait for runInlineTasks().
+    /// @return The number of tasks sent
+    template<typename IsDue, typename Setup>
+    ui32 sendBatch(const std::vector<ChunkHandle>& chunks, IsDue isDue, Setup setup) {
+        ui32 numTasks = 0;
+        for (int pass = 0; pass < 2 && numTasks == 0; pass++) {
+            for (ChunkHandle h : chunks) {
+                Chunk* chunk = h;
+                const ChunkID& id = h.getID();
+                if (((id.x + id.y + id.z) & 1) != (i32)m_color) continue;
+                if (chunk->genLevel != GEN_DONE || !chunk->neighbor.left.isAquired()) continue;
+                if (!isDue(*chunk)) continue;
+
+                T* task = m_taskRecycler.create();
+                task->recycler = &m_taskRecycler;
+                task->chunk = h.acquire();
+                for (int i = 0; i < 6; i++) {
+                    task->neighborHandles[i] = chunk->neighbors[i].acquire();
+                }
+                task->runningTasks = &m_runningTasks;
+                setup(*task);
+                m_runningTasks++;
+                numTasks++;
+                if (m_threadPool) {
+                    m_threadPool->addTask(task);
+                } else {
+                    m_inlineTasks.push_back(task);
+                }
+            }
+            m_color ^= 1;
+        }
+        return numTasks;
+    }
+
+    /// Runs the batch on the calling thread if there is no thread pool. Call it
+    /// after releasing the active chunks, the tasks release chunk handles.
+    void runInlineTasks() {
+        for (T* task : m_inlineTasks) {
+            task->execute(&m_workerData);
+            task->cleanup();
+        }
+        m_inlineTasks.clear();
+    }
+private:
+    vcore::ThreadPool<WorkerData>* m_threadPool = nullptr;
+    std::atomic<ui32> m_runningTasks;
+    ui32 m_color = 0; ///< Parity of x + y + z of the chunks in the next batch
+    ConcurrentRecycler<T> m_taskRecycler;
+    std::vector<T*> m_inlineTasks; ///< Batch waiting for runInlineTasks()
+    WorkerData m_workerData; ///< Holds the engines when there is no thread pool
+};
+
+#endif // ChunkCheckerboard_h__
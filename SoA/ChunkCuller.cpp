@@ -0,0 +1,105 @@
+#include "stdafx.h"
+#include "ChunkCuller.h"
+
+#include <algorithm>
+
+#include "Camera.h"
+#include "ChunkMeshManager.h"
+#include "ChunkRenderer.h"
+#include "Frustum.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define CHUNK_CULL_SIMD
+#include <emmintrin.h>
+#endif
+
+// Frustum::sphereInFrustum ignores the near and far planes, so do we
+#define NUM_CULL_PLANES 4
+
+void ChunkCuller::cull(ChunkMeshManager* cmm, const Camera* camera) {
+    static const f64v3 boxDims_2(CHUNK_WIDTH / 2);
+    const f64v3& position = camera->getPosition();
+
+    { // Snapshot
+        std::lock_guard<std::mutex> l(cmm->lckActiveChunkMeshes);
+        const std::vector<ChunkMesh*>& chunkMeshes = cmm->getChunkMeshes();
+        m_meshes.assign(chunkMeshes.begin(), chunkMeshes.end());
+    }
+
+    size_t numMeshes = m_meshes.size();
+    size_t paddedSize = (numMeshes + 3) & ~(size_t)3;
+    m_centerX.resize(paddedSize);
+    m_centerY.resize(paddedSize);
+    m_centerZ.resize(paddedSize);
+    m_isVisible.resize(paddedSize);
+    for (size_t i = 0; i < numMeshes; i++) {
+        f64v3 center = m_meshes[i]->position + boxDims_2 - position;
+        m_centerX[i] = (f32)center.x;
+        m_centerY[i] = (f32)center.y;
+        m_centerZ[i] = (f32)center.z;
+    }
+    // Padding is tested but never read
+    for (size_t i = numMeshes; i < paddedSize; i++) {
+        m_centerX[i] = 0.0f;
+        m_centerY[i] = 0.0f;
+        m_centerZ[i] = 0.0f;
+    }
+
+    cullSpheres(camera);
+
+    // Build the draw list, front to back
+    m_sortKeys.clear();
+    for (size_t i = 0; i < numMeshes; i++) {
+        ChunkMesh* cm = m_meshes[i];
+        cm->inFrustum = m_isVisible[i] != 0;
+        if (!cm->inFrustum) continue;
+        f32 dist2 = m_centerX[i] * m_centerX[i] + m_centerY[i] * m_centerY[i] + m_centerZ[i] * m_centerZ[i];
+        // Non-negative floats sort the same as their bits
+        ui32 distBits;
+        memcpy(&distBits, &dist2, sizeof(f32));
+        m_sortKeys.push_back(((ui64)distBits << 32) | (ui64)i);
+    }
+    std::sort(m_sortKeys.begin(), m_sortKeys.end());
+
+    m_drawList.resize(m_sortKeys.size());
+    for (size_t i = 0; i < m_sortKeys.size(); i++) {
+        m_drawList[i] = m_meshes[m_sortKeys[i] & 0xFFFFFFFF];
+    }
+}
+
+void ChunkCuller::cullSpheres(const Camera* camera) {
+    const Frustum::Plane* planes = camera->getFrustum().getPlanes();
+    const size_t size = m_isVisible.size();
+
+#ifdef CHUNK_CULL_SIMD
+    __m128 nx[NUM_CULL_PLANES], ny[NUM_CULL_PLANES], nz[NUM_CULL_PLANES], nd[NUM_CULL_PLANES];
+    for (int p = 0; p < NUM_CULL_PLANES; p++) {
+        nx[p] = _mm_set1_ps(planes[p].normal.x);
+        ny[p] = _mm_set1_ps(planes[p].normal.y);
+        nz[p] = _mm_set1_ps(planes[p].normal.z);
+        // Visible when d + dot(n, c) > -radius
+        nd[p] = _mm_set1_ps(planes[p].d + CHUNK_DIAGONAL_LENGTH);
+    }
+    const __m128 zero = _mm_setzero_ps();
+    for (size_t i = 0; i < size; i += 4) {
+        __m128 x = _mm_loadu_ps(&m_centerX[i]);
+        __m128 y = _mm_loadu_ps(&m_centerY[i]);
+        __m128 z = _mm_loadu_ps(&m_centerZ[i]);
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int p = 0; p < NUM_CULL_PLANES; p++) {
+            __m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx[p], x), _mm_mul_ps(ny[p], y)),
+                                     _mm_add_ps(_mm_mul_ps(nz[p], z), nd[p]));
+            inside = _mm_and_ps(inside, _mm_cmpgt_ps(dist, zero));
+        }
+        int mask = _mm_movemask_ps(inside);
+        m_isVisible[i] = (ui8)(mask & 1);
+        m_isVisible[i + 1] = (ui8)((mask >> 1) & 1);
+        m_isVisible[i + 2] = (ui8)((mask >> 2) & 1);
+        m_isVisible[i + 3] = (ui8)((mask >> 3) & 1);
+    }
+#else
+    for (size_t i = 0; i < size; i++) {
+        m_isVisible[i] = camera->sphereInFrustum(f32v3(m_centerX[i], m_centerY[i], m_centerZ[i]), CHUNK_DIAGONAL_LENGTH) ? 1 : 0;
+    }
+#endif
+}
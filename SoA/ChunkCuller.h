@@ -0,0 +1,48 @@
+///
+/// ChunkCuller.h
+/// Seed of Andromeda
+///
+/// Copyright 2014 Regrowth Studios
+/// MIT License
+///
+/// Summary:
+/// Frustum culls the active chunk meshes once per frame and builds the draw
+/// list shared by the voxel render stages.
+///
+
+#pragma once
+
+#ifndef ChunkCuller_h__
+#define ChunkCuller_h__
+
+class Camera;
+class ChunkMesh;
+class ChunkMeshManager;
+
+class ChunkCuller {
+public:
+    /// Snapshots the active meshes and culls them against the camera frustum.
+    /// lckActiveChunkMeshes is only held while taking the snapshot.
+    void cull(ChunkMeshManager* cmm, const Camera* camera);
+
+    /// Meshes that passed the cull, sorted front to back
+    const std::vector<ChunkMesh*>& getDrawList() const { return m_drawList; }
+    /// All active meshes as of the last cull
+    const std::vector<ChunkMesh*>& getSnapshot() const { return m_meshes; }
+private:
+    /// Tests bounding spheres against the side planes, four at a time
+    void cullSpheres(const Camera* camera);
+
+    // Snapshot of mesh bounds in SoA layout, relative to the camera.
+    // Padded to a multiple of 4.
+    std::vector<ChunkMesh*> m_meshes;
+    std::vector<f32> m_centerX;
+    std::vector<f32> m_centerY;
+    std::vector<f32> m_centerZ;
+    std::vector<ui8> m_isVisible;
+
+    std::vector<ui64> m_sortKeys; ///< Squared distance bits in the high half, snapshot index in the low half
+    std::vector<ChunkMesh*> m_drawList;
+};
+
+#endif // ChunkCuller_h__
@@ -0,0 +1,46 @@
+#include "stdafx.h"
+#include "ChunkDrawCommandBuilder.h"
+
+#include "ChunkMesh.h"
+
+void ChunkDrawCommandBuilder::begin(ui32 numPages) {
+    if (m_pageCommands.size() < numPages) m_pageCommands.resize(numPages);
+    for (auto& commands : m_pageCommands) commands.clear();
+    m_pageFirstCommand.assign(m_pageCommands.size(), 0);
+    m_commands.clear();
+    m_drawOffsets.clear();
+}
+
+void ChunkDrawCommandBuilder::addMesh(ui32 page, i32 baseVertex, const f64v3& position,
+                                      const ChunkMeshRenderData& renderData, const f64v3& playerPos) {
+    std::vector<DrawElementsIndirectCommand>& commands = m_pageCommands[page];
+    size_t prevSize = commands.size();
+    ui32 drawIndex = (ui32)m_drawOffsets.size();
+
+#define ADD_FACE(off, size) commands.push_back({ (ui32)renderData.size, 1, (ui32)renderData.off, baseVertex, drawIndex })
+    //top
+    if (renderData.pyVboSize && playerPos.y > position.y + renderData.lowestY) ADD_FACE(pyVboOff, pyVboSize);
+    //front
+    if (renderData.pzVboSize && playerPos.z > position.z + renderData.lowestZ) ADD_FACE(pzVboOff, pzVboSize);
+    //back
+    if (renderData.nzVboSize && playerPos.z < position.z + renderData.highestZ) ADD_FACE(nzVboOff, nzVboSize);
+    //left
+    if (renderData.nxVboSize && playerPos.x < position.x + renderData.highestX) ADD_FACE(nxVboOff, nxVboSize);
+    //right
+    if (renderData.pxVboSize && playerPos.x > position.x + renderData.lowestX) ADD_FACE(pxVboOff, pxVboSize);
+    //bottom
+    if (renderData.nyVboSize && playerPos.y < position.y + renderData.highestY) ADD_FACE(nyVboOff, nyVboSize);
+#undef ADD_FACE
+
+    // Only meshes with visible faces use a draw offset
+    if (commands.size() != prevSize) {
+        m_drawOffsets.emplace_back(position - playerPos);
+    }
+}
+
+void ChunkDrawCommandBuilder::end() {
+    for (size_t i = 0; i < m_pageCommands.size(); i++) {
+        m_pageFirstCommand[i] = (ui32)m_commands.size();
+        m_commands.insert(m_commands.end(), m_pageCommands[i].begin(), m_pageCommands[i].end());
+    }
+}
@@ -0,0 +1,61 @@
+///
+/// ChunkDrawCommandBuilder.h
+/// Seed of Andromeda
+///
+/// Copyright 2014 Regrowth Studios
+/// MIT License
+///
+/// Summary:
+/// Builds indirect draw commands for opaque chunk meshes that live in a
+/// ChunkVertexArena. Does not touch GL so it can run without a context.
+///
+
+#pragma once
+
+#ifndef ChunkDrawCommandBuilder_h__
+#define ChunkDrawCommandBuilder_h__
+
+class ChunkMeshRenderData;
+
+/// Same layout as the command read by glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand {
+    ui32 count;
+    ui32 instanceCount;
+    ui32 firstIndex;
+    i32 baseVertex;
+    ui32 baseInstance;
+};
+
+class ChunkDrawCommandBuilder {
+public:
+    /// Clears the previous frame
+    /// @param numPages: Number of arena pages meshes can be in
+    void begin(ui32 numPages);
+
+    /// Adds a command for each face of a mesh that can face the player.
+    /// Uses the same backface skip as ChunkRenderer::drawOpaque.
+    /// @param page: Arena page holding the vertices
+    /// @param baseVertex: First vertex of the mesh in the page
+    /// @param position: Voxel position of the mesh
+    /// @param renderData: Index ranges and bounds of each face
+    /// @param playerPos: Voxel position of the camera
+    void addMesh(ui32 page, i32 baseVertex, const f64v3& position,
+                 const ChunkMeshRenderData& renderData, const f64v3& playerPos);
+
+    /// Joins the commands of all pages. Call before reading them.
+    void end();
+
+    /// Commands for every page, grouped by page
+    const std::vector<DrawElementsIndirectCommand>& getCommands() const { return m_commands; }
+    /// Mesh offset from the player, indexed by baseInstance
+    const std::vector<f32v3>& getDrawOffsets() const { return m_drawOffsets; }
+    ui32 getPageFirstCommand(ui32 page) const { return m_pageFirstCommand[page]; }
+    ui32 getPageNumCommands(ui32 page) const { return (ui32)m_pageCommands[page].size(); }
+private:
+    std::vector<std::vector<DrawElementsIndirectCommand> > m_pageCommands;
+    std::vector<ui32> m_pageFirstCommand;
+    std::vector<DrawElementsIndirectCommand> m_commands;
+    std::vector<f32v3> m_drawOffsets;
+};
+
+#endif // ChunkDrawCommandBuilder_h__
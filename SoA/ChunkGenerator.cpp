@@ -5,11 +5,12 @@
 #include "Chunk.h"
 #include "ChunkHandle.h"
 #include "ChunkGrid.h"
+#include "ChunkIOManager.h"
 
 void ChunkGenerator::init(vcore::ThreadPool<WorkerData>* threadPool,
                           PlanetGenData* genData,
                           ChunkGrid* grid) {
-    m_threadPool = threadPool;
+    m_scheduler.init(threadPool);
     m_proceduralGenerator.init(genData);
     m_grid = grid;
 }
@@ -34,7 +35,7 @@ void ChunkGenerator::submitQuery(ChunkQuery* query) {
         if (!chunk.gridData->isLoading) {
             // Send heightmap gen query
             chunk.gridData->isLoading = true;
-            m_threadPool->addTask(&query->genTask);
+            scheduleQuery(query);
         }
         // Store as a pending query
         m_pendingQueries[chunk.gridData].push_back(query);
@@ -43,20 +44,52 @@ void ChunkGenerator::submitQuery(ChunkQuery* query) {
             // Only one gen query should be active at a time so just store this one
             chunk.m_genQueryData.pending.push_back(query);
         } else {
-            // Submit for generation
             chunk.m_genQueryData.current = query;
-            m_threadPool->addTask(&query->genTask);
+            // Chunks that were saved are loaded instead of generated
+            if (chunk.genLevel == GEN_NONE && m_grid->chunkIo && m_grid->chunkIo->addToLoadList(query)) return;
+            // Submit for generation
+            scheduleQuery(query);
         }
     }
 }
 
+void ChunkGenerator::scheduleQuery(ChunkQuery* query) {
+    m_scheduler.addTask(query->chunk.getID(), query->chunk->getVoxelPosition().pos, &query->genTask);
+}
+
 void ChunkGenerator::finishQuery(ChunkQuery* query) {
     m_finishedQueries.enqueue(query);
 }
 
+void ChunkGenerator::finishLoad(ChunkQuery* query, bool isLoaded) {
+    if (!isLoaded) {
+        scheduleQuery(query);
+        return;
+    }
+    // Loaded chunks are finished, same as a completed GenerateTask
+    Chunk& chunk = query->chunk;
+    chunk.genLevel = ChunkGenLevel::GEN_DONE;
+    query->m_isFinished = true;
+    query->m_cond.notify_one();
+    chunk.isAccessible = true;
+    // Flora from neighbors that finished while it was loading
+    m_grid->nodeSetter.flushNodes(query->chunk);
+    finishQuery(query);
+}
+
 // Updates finished queries
 void ChunkGenerator::update() {
 #define MAX_QUERIES 100
+    if (m_grid->chunkIo) {
+        ChunkLoadResult loads[MAX_QUERIES];
+        size_t numLoads = m_grid->chunkIo->getFinishedLoads(loads, MAX_QUERIES);
+        for (size_t i = 0; i < numLoads; i++) {
+            // Every face shares the IO manager, so the load may be for another grid
+            ChunkQuery* q = loads[i].query;
+            q->genTask.chunkGenerator->finishLoad(q, loads[i].isLoaded);
+        }
+    }
+
     ChunkQuery* queries[MAX_QUERIES];
     size_t numQueries = m_finishedQueries.try_dequeue_bulk(queries, MAX_QUERIES);
     for (size_t i = 0; i < numQueries; i++) {
@@ -113,7 +146,7 @@ void ChunkGenerator::update() {
                 q = chunk.m_genQueryData.pending.back();
                 chunk.m_genQueryData.pending.pop_back();
                 chunk.m_genQueryData.current = q;
-                m_threadPool->addTask(&q->genTask);
+                scheduleQuery(q);
             }
             // Notify listeners that this chunk is finished
             onGenFinish(q->chunk, q->genLevel);
@@ -121,4 +154,7 @@ void ChunkGenerator::update() {
             if (q->shouldRelease) q->release();
         }
     }
+
+    // Closest chunks go to the thread pool first
+    m_scheduler.update();
 }
@@ -22,6 +22,7 @@
 #include "PlanetGenData.h"
 #include "GenerateTask.h"
 #include "ChunkQuery.h"
+#include "ChunkTaskScheduler.h"
 
 class PagedChunkAllocator;
 class ChunkGridData;
@@ -47,18 +48,27 @@ class ChunkGenerator {
     void finishQuery(ChunkQuery* query);
     // Updates finished queries
     void update();
+    /// Sets where the player is so closer chunks generate first
+    void setViewpoint(const f64v3& position, const f32v3& direction, f64 maxDistance) {
+        m_scheduler.setViewpoint(position, direction, maxDistance);
+    }
 
     Event<ChunkHandle&, ChunkGenLevel> onGenFinish;
 private:
     void tryFlagMeshableNeighbors(ChunkHandle& ch);
     void flagMeshbleNeighbor(ChunkHandle& n, ui32 bit);
+    /// Queues the generation task of a query
+    void scheduleQuery(ChunkQuery* query);
+    /// Finishes a query the chunk IO manager tried to load, generating it if it
+    /// wasn't saved. Must be the generator of the query.
+    void finishLoad(ChunkQuery* query, bool isLoaded);
 
     moodycamel::ConcurrentQueue<ChunkQuery*> m_finishedQueries;
     std::map < ChunkGridData*, std::vector<ChunkQuery*> >m_pendingQueries; ///< Queries waiting on height map
 
     ChunkGrid* m_grid = nullptr;
     ProceduralChunkGenerator m_proceduralGenerator;
-    vcore::ThreadPool<WorkerData>* m_threadPool = nullptr;
+    ChunkTaskScheduler m_scheduler; ///< Orders tasks for the thread pool
 };
 
 #endif // ChunkGenerator_h__
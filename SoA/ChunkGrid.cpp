@@ -2,6 +2,7 @@
 #include "ChunkGrid.h"
 #include "Chunk.h"
 #include "ChunkAllocator.h"
+#include "ChunkIOManager.h"
 #include "soaUtils.h"
 
 #include <Vorb/utils.h>
@@ -22,7 +23,8 @@ void ChunkGrid::init(WorldCubeFace face,
     accessor.onAdd += makeDelegate(this, &ChunkGrid::onAccessorAdd);
     accessor.onRemove += makeDelegate(this, &ChunkGrid::onAccessorRemove);
     nodeSetter.grid = this;
-    nodeSetter.threadPool = threadPool;
+    lightUpdater.init(this, threadPool);
+    caUpdater.init(this, threadPool);
 }
 
 void ChunkGrid::dispose() {
@@ -33,11 +35,8 @@ void ChunkGrid::dispose() {
 }
 
 ChunkQuery* ChunkGrid::submitQuery(const i32v3& chunkPos, ChunkGenLevel genLevel, bool shouldRelease) {
-    ChunkQuery* query;
-    {
-        std::lock_guard<std::mutex> l(m_lckQueryRecycler);
-        query = m_queryRecycler.create();
-    }
+    // Recycled queries also recycle their GenerateTask
+    ChunkQuery* query = m_queryRecycler.create();
     query->chunkPos = chunkPos;
     query->genLevel = genLevel;
     query->shouldRelease = shouldRelease;
@@ -56,9 +55,12 @@ ChunkQuery* ChunkGrid::submitQuery(const i32v3& chunkPos, ChunkGenLevel genLevel
 void ChunkGrid::releaseQuery(ChunkQuery* query) {
     assert(query->grid);
     query->grid = nullptr;
-    {
-        std::lock_guard<std::mutex> l(m_lckQueryRecycler);
-        m_queryRecycler.recycle(query);
+    m_queryRecycler.recycle(query);
+}
+
+void ChunkGrid::setViewpoint(const f64v3& position, const f32v3& direction, f64 maxDistance) {
+    for (ui32 i = 0; i < numGenerators; i++) {
+        generators[i].setViewpoint(position, direction, maxDistance);
     }
 }
 
@@ -85,8 +87,16 @@ void ChunkGrid::update() {
         generators[0].submitQuery(q);
     }
     
-    // Place any needed nodes
-    nodeSetter.update();
+    // Compress quiet voxel data and uncompress busy data
+    for (ChunkHandle h : acquireActiveChunks()) {
+        // Generators and loaders fill the containers until then
+        if (h->genLevel == GEN_DONE) h->updateContainers();
+    }
+    releaseActiveChunks();
+
+    // Simulate liquids and powders, then spread light through the results
+    caUpdater.update();
+    lightUpdater.update();
 }
 
 void ChunkGrid::onAccessorAdd(Sender s VORB_MAYBE_UNUSED, ChunkHandle& chunk) {
@@ -125,6 +135,14 @@ void ChunkGrid::onAccessorRemove(Sender s VORB_MAYBE_UNUSED, ChunkHandle& chunk)
         m_activeChunks.pop_back();
     }
 
+    // Save modified chunks before their data is freed
+    if (chunkIo && chunk->genLevel == GEN_DONE && chunk->isDirty) {
+        chunkIo->addToSaveList(chunk);
+    }
+
+    // Nobody will flush flora that is still waiting on it
+    nodeSetter.dropNodes(chunk);
+
     // TODO(Ben): Could be slightly faster with InterlockedDecrement and FSM?
     { // Remove and possibly free grid data
         std::unique_lock<std::mutex> l(m_lckGridData);
@@ -25,10 +25,14 @@
 #include "ChunkAllocator.h"
 #include "ChunkAccessor.h"
 #include "ChunkHandle.h"
+#include "ConcurrentRecycler.h"
 
+#include "CellularAutomataUpdater.h"
+#include "VoxelLightUpdater.h"
 #include "VoxelNodeSetter.h"
 
 class BlockPack;
+class ChunkIOManager;
 
 class ChunkGrid {
     friend class ChunkMeshManager;
@@ -54,6 +58,8 @@ class ChunkGrid {
 
     // Processes chunk queries and set active chunks
     void update();
+    /// Sets where the player is so closer chunks generate first
+    void setViewpoint(const f64v3& position, const f32v3& direction, f64 maxDistance);
 
     // Locks and gets active chunks. Must call releaseActiveChunks() later.
     const std::vector<ChunkHandle>& acquireActiveChunks() { 
@@ -68,8 +74,11 @@ class ChunkGrid {
 
     ChunkAccessor accessor;
     BlockPack* blockPack = nullptr; ///< Handle to the block pack for this grid
+    ChunkIOManager* chunkIo = nullptr; ///< Loads and saves chunks, may be null
 
     VoxelNodeSetter nodeSetter;
+    VoxelLightUpdater lightUpdater;
+    CellularAutomataUpdater caUpdater;
 
     Event<ChunkHandle&> onNeighborsAcquire;
     Event<ChunkHandle&> onNeighborsRelease;
@@ -91,8 +100,7 @@ class ChunkGrid {
     
     vcore::IDGenerator<ChunkID> m_idGenerator;
 
-    std::mutex m_lckQueryRecycler;
-    PtrRecycler<ChunkQuery> m_queryRecycler;
+    ConcurrentRecycler<ChunkQuery> m_queryRecycler;
 
 
     WorldCubeFace m_face = FACE_NONE;
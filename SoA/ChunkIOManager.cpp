@@ -2,175 +2,181 @@
 
 #include "ChunkIOManager.h"
 
-#ifdef VORB_OS_WINDOWS
-#include <direct.h> //for mkdir windows
-#include <io.h>
-#endif
+#include <algorithm>
 
-#include <fcntl.h>
-#include <sys/stat.h>
-#include <sys/types.h>
-#include <chrono>
-#include <thread>
-
-//#include <ZLIB/zlib.h>
-
-#include "BlockData.h"
 #include "Chunk.h"
+#include "ChunkHandle.h"
+#include "ChunkQuery.h"
 #include "Errors.h"
-#include "GameManager.h"
-#include "SoaOptions.h"
 
 ChunkIOManager::ChunkIOManager(const nString& saveDir) :
     _regionFileManager(saveDir)
 {
-    _isThreadFinished = 0;
+    _isDone = false;
+    _isThreadFinished = false;
     readWriteThread = NULL;
-    _shouldDisableLoading = 0;
+    _shouldDisableLoading = false;
 }
 
 ChunkIOManager::~ChunkIOManager()
 {
     onQuit();
+    for (auto& data : _freeSaveData) delete data;
 }
 
 void ChunkIOManager::clear() {
-    Chunk*  tmp;
-    _queueLock.lock();
-    //flush queues
-    while (chunksToLoad.try_dequeue(tmp));
-    _queueLock.unlock();
+    std::lock_guard<std::mutex> lock(_queueLock);
+    for (auto& q : _chunksToLoad) {
+        _finishedLoads.enqueue(ChunkLoadResult{ q, false });
+    }
+    _chunksToLoad.clear();
+}
 
-    while (chunksToSave.peek() != nullptr);
+void ChunkIOManager::addToSaveList(Chunk& chunk) {
+    std::unique_lock<std::mutex> lock(_queueLock);
+    _saveSpaceCond.wait(lock, [&] { return _chunksToSave.size() < MAX_QUEUED_CHUNK_SAVES || _isThreadFinished; });
+    if (_isThreadFinished) return;
+
+    ChunkSaveData* data;
+    if (_freeSaveData.size()) {
+        data = _freeSaveData.back();
+        _freeSaveData.pop_back();
+    } else {
+        data = new ChunkSaveData;
+    }
+    lock.unlock();
 
-    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    data->position = chunk.getChunkPosition();
+    {
+        std::shared_lock<std::shared_timed_mutex> l(chunk.dataMutex);
+        chunk.blocks.copyRegion(i32v3(0), i32v3(CHUNK_WIDTH), data->blocks, CHUNK_WIDTH, CHUNK_LAYER);
+        chunk.tertiary.copyRegion(i32v3(0), i32v3(CHUNK_WIDTH), data->tertiary, CHUNK_WIDTH, CHUNK_LAYER);
+    }
+    chunk.isDirty = false;
 
-    while (finishedLoadChunks.try_dequeue(tmp));
+    lock.lock();
+    _chunksToSave.push_back(data);
+    lock.unlock();
+    _cond.notify_one();
 }
 
-
-void ChunkIOManager::addToSaveList(Chunk* ch VORB_UNUSED)
-{
-    //if (ch->inSaveThread == 0 && ch->inLoadThread == 0){
-    //    ch->dirty = 0;
-    //    ch->inSaveThread = 1;
-    //    chunksToSave.enqueue(ch);
-    //    _cond.notify_one();
-    //}
+bool ChunkIOManager::addToLoadList(ChunkQuery* query) {
+    if (_shouldDisableLoading) return false;
+    {
+        std::lock_guard<std::mutex> lock(_queueLock);
+        if (_chunksToLoad.size() >= MAX_QUEUED_CHUNK_LOADS || _isThreadFinished) return false;
+        _chunksToLoad.push_back(query);
+    }
+    _cond.notify_one();
+    return true;
 }
 
-void ChunkIOManager::addToSaveList(std::vector <Chunk* > &chunks VORB_UNUSED)
+void ChunkIOManager::readWriteChunks()
 {
-  /*  NChunk* ch;
-    for (size_t i = 0; i < chunks.size(); i++){
-        ch = chunks[i];
-        if (ch->inSaveThread == 0 && ch->inLoadThread == 0){
-            ch->inSaveThread = 1;
-            ch->dirty = 0;
-            chunksToSave.enqueue(ch);
+    std::vector<ChunkSaveData*> saves;
+    std::vector<ChunkQuery*> loads;
+    ChunkSaveData* loadData = new ChunkSaveData;
+    _blockNodes.resize(CHUNK_SIZE);
+    _tertiaryNodes.resize(CHUNK_SIZE);
+
+    std::unique_lock<std::mutex> queueLock(_queueLock);
+    while (true) {
+        _cond.wait(queueLock, [&] { return _isDone || _chunksToSave.size() || _chunksToLoad.size(); });
+        if (_chunksToSave.empty() && _chunksToLoad.empty()) break; // Done and drained
+
+        // Take the whole batch
+        saves.swap(_chunksToSave);
+        loads.swap(_chunksToLoad);
+        queueLock.unlock();
+
+        // Saves go first so a chunk that was unloaded and requested again gets its latest data
+        _regionFileManager.saveChunks(saves.data(), saves.size());
+
+        // Load in region order so each region file is opened once
+        std::sort(loads.begin(), loads.end(), [](ChunkQuery* a, ChunkQuery* b) {
+            const ChunkPosition3D& pa = a->chunk->getChunkPosition();
+            const ChunkPosition3D& pb = b->chunk->getChunkPosition();
+            if (pa.face != pb.face) return pa.face < pb.face;
+            i32v3 ra(pa.pos.x >> RSHIFT, pa.pos.y >> RSHIFT, pa.pos.z >> RSHIFT);
+            i32v3 rb(pb.pos.x >> RSHIFT, pb.pos.y >> RSHIFT, pb.pos.z >> RSHIFT);
+            if (ra.x != rb.x) return ra.x < rb.x;
+            if (ra.y != rb.y) return ra.y < rb.y;
+            return ra.z < rb.z;
+        });
+        for (auto& q : loads) {
+            Chunk& chunk = q->chunk;
+            bool isLoaded = _regionFileManager.loadChunk(chunk.getChunkPosition(), *loadData);
+            if (isLoaded) fillChunk(chunk, *loadData);
+            _finishedLoads.enqueue(ChunkLoadResult{ q, isLoaded });
         }
+        loads.clear();
+
+        queueLock.lock();
+        _freeSaveData.insert(_freeSaveData.end(), saves.begin(), saves.end());
+        saves.clear();
+        _saveSpaceCond.notify_all();
     }
-    _cond.notify_one();*/
-}
+    _isThreadFinished = true;
+    _saveSpaceCond.notify_all();
+    queueLock.unlock();
 
-void ChunkIOManager::addToLoadList(Chunk* ch VORB_UNUSED)
-{
-  /*  if (ch->inSaveThread == 0 && ch->inLoadThread == 0){
-        ch->loadStatus = 0;
-        ch->inLoadThread = 1;
-        chunksToLoad.enqueue(ch);
-        _cond.notify_one();
-    }*/
+    _regionFileManager.clear();
+    delete loadData;
 }
 
-void ChunkIOManager::addToLoadList(std::vector <Chunk* > &chunks VORB_UNUSED)
-{
-   /* NChunk* ch;
-
-    if (_shouldDisableLoading) {
-        for (size_t i = 0; i < chunks.size(); i++){
-            chunks[i]->loadStatus = 2;
-            finishedLoadChunks.enqueue(chunks[i]);
+void ChunkIOManager::fillChunk(Chunk& chunk, const ChunkSaveData& data) {
+    size_t blockDataSize = 0;
+    size_t tertiaryDataSize = 0;
+    int numBlocks = 0;
+
+    _blockNodes[blockDataSize++].set(0, 1, data.blocks[0]);
+    _tertiaryNodes[tertiaryDataSize++].set(0, 1, data.tertiary[0]);
+    if (data.blocks[0] != 0) numBlocks++;
+    for (ui16 c = 1; c < CHUNK_SIZE; c++) {
+        if (data.blocks[c] == _blockNodes[blockDataSize - 1].data) {
+            ++_blockNodes[blockDataSize - 1].length;
+        } else {
+            _blockNodes[blockDataSize++].set(c, 1, data.blocks[c]);
         }
-        return;
-    }
-
-    for (size_t i = 0; i < chunks.size(); i++){
-        ch = chunks[i];
-       
-        if (ch->inSaveThread == 0 && ch->inLoadThread == 0){
-            ch->inLoadThread = true;
-            chunksToLoad.enqueue(ch);
-        }
-        else{
-            std::cout << "ERROR: Tried to add chunk to load list and its in a thread! : " << (int)ch->inSaveThread << " " << (int)ch->inLoadThread << " " << ch->voxelPosition.z << std::endl;
+        if (data.tertiary[c] == _tertiaryNodes[tertiaryDataSize - 1].data) {
+            ++_tertiaryNodes[tertiaryDataSize - 1].length;
+        } else {
+            _tertiaryNodes[tertiaryDataSize++].set(c, 1, data.tertiary[c]);
         }
+        if (data.blocks[c] != 0) numBlocks++;
     }
-    _cond.notify_one();*/
+
+    std::lock_guard<std::shared_timed_mutex> l(chunk.dataMutex);
+    chunk.blocks.initFromSortedArray(vvox::VoxelStorageState::INTERVAL_TREE, _blockNodes.data(), blockDataSize);
+    chunk.tertiary.initFromSortedArray(vvox::VoxelStorageState::INTERVAL_TREE, _tertiaryNodes.data(), tertiaryDataSize);
+    chunk.numBlocks = numBlocks;
+    chunk.isDirty = false;
 }
 
-void ChunkIOManager::readWriteChunks()
-{
-    //std::unique_lock<std::mutex> queueLock(_queueLock);
-    //NChunk* ch;
-
-    //nString reg;
-
-    //while (!_isDone){
-    //    if (_isDone){
-    //        _regionFileManager.clear();
-    //        queueLock.unlock();
-    //        _isThreadFinished = 1;
-    //        return;
-    //    }
-    //    _regionFileManager.flush();
-    //    _cond.wait(queueLock); //wait for a notification that queue is not empty
-
-    //    if (_isDone){
-    //        _regionFileManager.clear();
-    //        _isThreadFinished = 1;
-    //        queueLock.unlock();
-    //        return;
-    //    }
-    //    queueLock.unlock();
-
-    //    // All tasks
-    //    while (chunksToLoad.try_dequeue(ch) || chunksToSave.try_dequeue(ch)) {
-    //        if (ch->getState() == ChunkStates::LOAD) {
-    //            if (1 || _regionFileManager.tryLoadChunk(ch) == false) {
-    //                ch->loadStatus = 1;
-    //            }
-
-    //            finishedLoadChunks.enqueue(ch);
-    //        } else { //save
-    //           // _regionFileManager.saveChunk(ch);
-    //            ch->inSaveThread = 0; //race condition?
-    //        }
-    //       
-    //    }
-
-    //    queueLock.lock();
-    //}
+void ChunkIOManager::onDataChange(Sender s VORB_MAYBE_UNUSED, ChunkHandle& chunk) {
+    chunk->flagDirty();
 }
 
 void ChunkIOManager::beginThread()
 {
-    _isDone = 0;
-    _isThreadFinished = 0;
-    readWriteThread = NULL;
+    _isDone = false;
+    _isThreadFinished = false;
+    Chunk::DataChange += makeDelegate(this, &ChunkIOManager::onDataChange);
     readWriteThread = new std::thread(&ChunkIOManager::readWriteChunks, this);
 }
 
 void ChunkIOManager::onQuit()
 {
+    if (readWriteThread == NULL) return;
 
+    Chunk::DataChange -= makeDelegate(this, &ChunkIOManager::onDataChange);
     clear();
 
     _queueLock.lock();
-    _isDone = 1;
+    _isDone = true;
     _queueLock.unlock();
     _cond.notify_one();
-    if (readWriteThread != NULL && readWriteThread->joinable()) readWriteThread->join();
+    if (readWriteThread->joinable()) readWriteThread->join();
     delete readWriteThread;
     readWriteThread = NULL;
 }
@@ -181,4 +187,4 @@ bool ChunkIOManager::saveVersionFile() {
 
 bool ChunkIOManager::checkVersion() {
     return _regionFileManager.checkVersion();
-}
\ No newline at end of file
+}
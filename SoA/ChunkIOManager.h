@@ -1,27 +1,50 @@
 #pragma once
 #include <condition_variable>
 #include <mutex>
-#include <queue>
 #include <thread>
+#include <vector>
+
+#include <Vorb/concurrentqueue.h>
+#include <Vorb/Event.hpp>
+#include <Vorb/voxel/IntervalTree.h>
 
 #include "RegionFileManager.h"
-#include "readerwriterqueue.h"
 
 class Chunk;
+class ChunkHandle;
+class ChunkQuery;
+
+#define MAX_QUEUED_CHUNK_SAVES 64
+#define MAX_QUEUED_CHUNK_LOADS 256
+
+struct ChunkLoadResult {
+    ChunkQuery* query;
+    bool isLoaded; ///< When false the chunk was never saved and must be generated
+};
 
+/// Loads and saves chunks on a single IO thread. Requests are batched so each
+/// wakeup of the thread handles every queued save and load at once.
 class ChunkIOManager{
 public:
     ChunkIOManager(const nString& saveDir);
     ~ChunkIOManager();
+    /// Cancels pending loads, reporting them as not loaded. Saves are kept.
     void clear();
 
-    void addToSaveList(Chunk*  ch);
-    void addToSaveList(std::vector<Chunk* >& chunks);
-    void addToLoadList(Chunk*  ch);
-    void addToLoadList(std::vector<Chunk* >& chunks);
+    /// Copies the voxel data of a chunk and queues it for saving.
+    /// Blocks if too many saves are queued.
+    void addToSaveList(Chunk& chunk);
+    /// Queues a load for the chunk of a query. Returns false if the queue is full
+    /// or loading is disabled, in which case the chunk should be generated.
+    bool addToLoadList(ChunkQuery* query);
+    /// Gets finished loads. Loaded chunks already have their voxel data.
+    size_t getFinishedLoads(ChunkLoadResult* results, size_t maxResults) {
+        return _finishedLoads.try_dequeue_bulk(results, maxResults);
+    }
 
     void beginThread();
 
+    /// Finishes all queued saves and stops the thread
     void onQuit();
 
     void setDisableLoading(bool disableLoading) { _shouldDisableLoading = disableLoading; }
@@ -29,19 +52,29 @@ class ChunkIOManager{
     bool saveVersionFile();
     bool checkVersion();
 
-    moodycamel::ReaderWriterQueue<Chunk* > chunksToLoad;
-    moodycamel::ReaderWriterQueue<Chunk* > chunksToSave;
     std::thread* readWriteThread;
-    moodycamel::ReaderWriterQueue<Chunk* > finishedLoadChunks;
 private:
     RegionFileManager _regionFileManager;
 
     void readWriteChunks(); //used by the thread
+    void fillChunk(Chunk& chunk, const ChunkSaveData& data);
+
+    void onDataChange(Sender s, ChunkHandle& chunk);
+
+    std::vector<ChunkSaveData*> _chunksToSave;
+    std::vector<ChunkQuery*> _chunksToLoad;
+    std::vector<ChunkSaveData*> _freeSaveData; ///< Recycled save buffers
+    moodycamel::ConcurrentQueue<ChunkLoadResult> _finishedLoads;
+
+    // Only used by the thread
+    std::vector<IntervalTree<ui16>::LNode> _blockNodes;
+    std::vector<IntervalTree<ui16>::LNode> _tertiaryNodes;
 
     std::mutex _queueLock;
     std::condition_variable _cond;
+    std::condition_variable _saveSpaceCond; ///< Signaled when queued saves are written
 
     bool _isDone;
     bool _isThreadFinished;
     bool _shouldDisableLoading;
-};
\ No newline at end of file
+};
@@ -23,6 +23,10 @@ ChunkMeshData::ChunkMeshData(MeshTaskType type) : type(type) {
     // Empty
 }
 
+ChunkMeshData::~ChunkMeshData() {
+    delete slabs;
+}
+
 void ChunkMeshData::addTransQuad(const i8v3& pos) {
     transQuadPositions.push_back(pos);
 
@@ -37,3 +41,16 @@ void ChunkMeshData::addTransQuad(const i8v3& pos) {
 
     transVertIndex += 4;
 }
+
+ui32 ChunkMeshSlabs::getOffset(int face, int slab) const {
+    ui32 offset = 0;
+    for (int f = 0; f < face; f++) {
+        for (int s = 0; s < MESH_SLAB_COUNT; s++) offset += capacity[f][s];
+    }
+    for (int s = 0; s < slab; s++) offset += capacity[face][s];
+    return offset;
+}
+
+ui32 ChunkMeshSlabs::getTotalCapacity() const {
+    return getOffset(6, 0);
+}
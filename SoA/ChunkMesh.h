@@ -2,6 +2,9 @@
 #include "Vertex.h"
 #include "BlockTextureMethods.h"
 #include "ChunkHandle.h"
+#include "ChunkMeshStagingRing.h"
+#include "ChunkVertexArena.h"
+#include "Constants.h"
 #include <Vorb/io/Keg.h>
 #include <Vorb/graphics/gtypes.h>
 
@@ -16,6 +19,12 @@ enum class MeshType {
 };
 KEG_ENUM_DECL(MeshType);
 
+// Vertex layout of opaque block meshes
+enum class BlockVertexFormat {
+    DEFAULT, ///< BlockVertex
+    COMPACT ///< CompactBlockVertex with a BlockMaterial table
+};
+
 enum class MeshTaskType;
 
 class Block;
@@ -82,11 +91,32 @@ struct VoxelQuad {
     };
 };
 
+struct CompactBlockQuad {
+    CompactBlockVertex verts[4];
+};
+
+/// CPU copy of a slab meshed chunk. The vbo holds the ranges face major, slab
+/// minor, each range padded with degenerate quads up to its capacity.
+class ChunkMeshSlabs {
+public:
+    /// Quad offset of a range in the vbo
+    ui32 getOffset(int face, int slab) const;
+    /// Quads in the whole vbo
+    ui32 getTotalCapacity() const;
+
+    std::vector<VoxelQuad> quads[6][MESH_SLAB_COUNT]; ///< Active quads of each range
+    ui32 capacity[6][MESH_SLAB_COUNT]; ///< Quads reserved for each range
+    i32v3 lowest[MESH_SLAB_COUNT]; ///< Quad bounds of each slab
+    i32v3 highest[MESH_SLAB_COUNT];
+    ui32 layoutID = 0; ///< Changes whenever a capacity changes
+};
+
 class ChunkMeshData
 {
 public:
     ChunkMeshData();
     ChunkMeshData(MeshTaskType type);
+    ~ChunkMeshData();
 
     void addTransQuad(const i8v3& pos);
 
@@ -99,6 +129,14 @@ class ChunkMeshData
     std::vector <LiquidVertex> waterVertices;
     MeshTaskType type;
 
+    // Opaque quads when vertexFormat is COMPACT, opaqueQuads is empty then
+    BlockVertexFormat vertexFormat = BlockVertexFormat::DEFAULT;
+    std::vector <CompactBlockQuad> compactOpaqueQuads;
+    std::vector <BlockMaterial> opaqueMaterials;
+    MeshStagingAllocation staging; ///< Opaque quads already copied to the staging ring
+    ChunkMeshSlabs* slabs = nullptr; ///< Set when meshed in slabs, handed back to the mesh manager
+    ui8 slabPatch = 0; ///< Slabs to patch into a vbo with the same layout, 0 uploads everything
+
     //*** Transparency info for sorting ***
     ui32 transVertIndex = 0;
     std::vector <i8v3> transQuadPositions;
@@ -135,6 +173,12 @@ class ChunkMesh
         VGVertexArray vaos[4];
     };
 
+    BlockVertexFormat vertexFormat = BlockVertexFormat::DEFAULT; ///< Format of vboID
+    VGBuffer materialBufferID = 0; ///< BlockMaterial table for COMPACT
+    VGTexture materialTextureID = 0; ///< Texture buffer view of materialBufferID
+    ChunkArenaAllocation arenaAllocation; ///< Opaque quads when batched, vboID is unused then
+    ui32 slabLayoutID = 0; ///< ChunkMeshSlabs::layoutID of the opaque quads, 0 if not slab meshed
+
     f64 distance2 = 32.0;
     f64v3 position;
     ui32 activeMeshesIndex = ACTIVE_MESH_INDEX_NONE; ///< Index into active meshes array
@@ -145,6 +189,7 @@ class ChunkMesh
 
     //*** Transparency info for sorting ***
     VGIndexBuffer transIndexID = 0;
+    i32v3 transSortPos = i32v3(0); ///< Camera voxel of the last sort
     std::vector<i8v3> transQuadPositions;
     std::vector<ui32> transQuadIndices;
 };
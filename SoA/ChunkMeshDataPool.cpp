@@ -0,0 +1,91 @@
+#include "stdafx.h"
+#include "ChunkMeshDataPool.h"
+
+#include "ChunkMeshTask.h"
+
+// Enough for every mesh in flight, the rest are freed
+#define MAX_FREE_MESH_DATA 128
+// Halve the histogram after this many samples so it follows recent meshes
+#define HISTOGRAM_DECAY_SAMPLES 256
+// Fraction of samples the typical size must cover
+#define TYPICAL_SIZE_PERCENTILE 0.9f
+// Vectors over this multiple of the typical size are freed
+#define MAX_CAPACITY_SCALE 2
+
+void MeshSizeHistogram::addSample(size_t size) {
+    ui32 bucket = 0;
+    while (size > ((size_t)1 << bucket) && bucket < MESH_SIZE_HISTOGRAM_BUCKETS - 1) bucket++;
+    m_counts[bucket]++;
+    if (++m_numSamples >= HISTOGRAM_DECAY_SAMPLES) {
+        m_numSamples = 0;
+        for (int i = 0; i < MESH_SIZE_HISTOGRAM_BUCKETS; i++) m_counts[i] >>= 1;
+        updateTypicalSize();
+    }
+}
+
+void MeshSizeHistogram::updateTypicalSize() {
+    ui32 total = 0;
+    for (int i = 0; i < MESH_SIZE_HISTOGRAM_BUCKETS; i++) total += m_counts[i];
+    ui32 target = (ui32)(total * TYPICAL_SIZE_PERCENTILE);
+    ui32 sum = 0;
+    for (int i = 0; i < MESH_SIZE_HISTOGRAM_BUCKETS; i++) {
+        sum += m_counts[i];
+        if (sum >= target) {
+            m_typicalSize = (size_t)1 << i;
+            return;
+        }
+    }
+}
+
+ChunkMeshData* ChunkMeshDataPool::create(MeshTaskType type) {
+    ChunkMeshData* data = m_recycler.create();
+    // Only approximate, it just bounds how many we keep
+    if (m_numFree > 0) m_numFree--;
+    data->type = type;
+    return data;
+}
+
+void ChunkMeshDataPool::recycle(ChunkMeshData* data) {
+    if (m_numFree >= MAX_FREE_MESH_DATA) {
+        delete data;
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> l(m_lckHistograms);
+        trim(data->opaqueQuads, m_opaqueSizes);
+        trim(data->transQuads, m_transSizes);
+        trim(data->cutoutQuads, m_cutoutSizes);
+        trim(data->waterVertices, m_waterSizes);
+        trim(data->compactOpaqueQuads, m_compactSizes);
+        trim(data->opaqueMaterials, m_materialSizes);
+        trim(data->transQuadIndices, m_transIndexSizes);
+        trim(data->transQuadPositions, m_transPositionSizes);
+    }
+    data->chunkMeshRenderData = ChunkMeshRenderData();
+    data->vertexFormat = BlockVertexFormat::DEFAULT;
+    data->transVertIndex = 0;
+    data->staging = MeshStagingAllocation();
+    delete data->slabs;
+    data->slabs = nullptr;
+    data->slabPatch = 0;
+
+    m_numFree++;
+    m_recycler.recycle(data);
+}
+
+void ChunkMeshDataPool::destroy() {
+    m_recycler.destroy();
+    m_numFree = 0;
+}
+
+template<typename T>
+void ChunkMeshDataPool::trim(std::vector<T>& v, MeshSizeHistogram& histogram) {
+    histogram.addSample(v.size());
+    size_t typicalSize = histogram.getTypicalSize();
+    if (v.capacity() / MAX_CAPACITY_SCALE > typicalSize) {
+        std::vector<T>().swap(v);
+    } else {
+        v.clear();
+    }
+}
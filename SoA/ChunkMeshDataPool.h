@@ -0,0 +1,70 @@
+///
+/// ChunkMeshDataPool.h
+/// Seed of Andromeda
+///
+/// Copyright 2014 Regrowth Studios
+/// MIT License
+///
+/// Summary:
+/// Recycles ChunkMeshData between mesh tasks so their vertex vectors keep
+/// their capacity. Vectors much larger than recent meshes need are freed
+/// so a few huge meshes don't pin memory.
+///
+
+#pragma once
+
+#ifndef ChunkMeshDataPool_h__
+#define ChunkMeshDataPool_h__
+
+#include <atomic>
+#include <mutex>
+
+#include "ChunkMesh.h"
+#include "ConcurrentRecycler.h"
+
+#define MESH_SIZE_HISTOGRAM_BUCKETS 24
+
+/// Decaying log2 histogram of recent vector sizes
+class MeshSizeHistogram {
+public:
+    void addSample(size_t size);
+    /// @return Capacity that covers most recent samples, SIZE_MAX until there are enough
+    size_t getTypicalSize() const { return m_typicalSize; }
+private:
+    void updateTypicalSize();
+
+    ui32 m_counts[MESH_SIZE_HISTOGRAM_BUCKETS] = {};
+    ui32 m_numSamples = 0;
+    size_t m_typicalSize = SIZE_MAX;
+};
+
+class ChunkMeshDataPool {
+public:
+    ~ChunkMeshDataPool() { destroy(); }
+
+    /// Gets empty mesh data, reusing recycled buffers if there are any. Thread safe.
+    ChunkMeshData* create(MeshTaskType type);
+    /// Gives back data once uploadMeshData is done with it. Thread safe.
+    void recycle(ChunkMeshData* data);
+    /// Frees all recycled data
+    void destroy();
+private:
+    /// Clears a vector, freeing it if it is much bigger than usual
+    template<typename T>
+    void trim(std::vector<T>& v, MeshSizeHistogram& histogram);
+
+    ConcurrentRecycler<ChunkMeshData> m_recycler;
+    std::atomic<ui32> m_numFree{ 0 };
+
+    std::mutex m_lckHistograms;
+    MeshSizeHistogram m_opaqueSizes;
+    MeshSizeHistogram m_transSizes;
+    MeshSizeHistogram m_cutoutSizes;
+    MeshSizeHistogram m_waterSizes;
+    MeshSizeHistogram m_compactSizes;
+    MeshSizeHistogram m_materialSizes;
+    MeshSizeHistogram m_transIndexSizes;
+    MeshSizeHistogram m_transPositionSizes;
+};
+
+#endif // ChunkMeshDataPool_h__
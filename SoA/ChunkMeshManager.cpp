@@ -1,37 +1,41 @@
 #include "stdafx.h"
 #include "ChunkMeshManager.h"
 
+#include "Camera.h"
 #include "ChunkMesh.h"
 #include "ChunkMeshTask.h"
 #include "ChunkMesher.h"
 #include "ChunkRenderer.h"
+#include "SoaOptions.h"
 #include "SpaceSystemComponents.h"
 #include "soaUtils.h"
 
 #define MAX_UPDATES_PER_FRAME 300
+// Bounds the memory of CPU side slab meshes, chunks past it re-mesh fully
+#define MAX_MESH_SLABS 256
 
 ChunkMeshManager::ChunkMeshManager(vcore::ThreadPool<WorkerData>* threadPool, BlockPack* blockPack) {
     m_threadPool = threadPool;
     m_blockPack = blockPack;
+    m_meshScheduler.init(threadPool);
     SpaceSystemAssemblages::onAddSphericalVoxelComponent += makeDelegate(this, &ChunkMeshManager::onAddSphericalVoxelComponent);
     SpaceSystemAssemblages::onRemoveSphericalVoxelComponent += makeDelegate(this, &ChunkMeshManager::onRemoveSphericalVoxelComponent);
 }
 
 void ChunkMeshManager::update(const f64v3& cameraPosition, bool shouldSort) {
-    ChunkMeshUpdateMessage updateBuffer[MAX_UPDATES_PER_FRAME];
-    size_t numUpdates;
-    if ((numUpdates = m_messages.try_dequeue_bulk(updateBuffer, MAX_UPDATES_PER_FRAME))) {
-        for (size_t i = 0; i < numUpdates; i++) {
-            updateMesh(updateBuffer[i]);
-        }
-    }
+    // Upload until the frame's budget is spent, the rest waits for the next frame
+    bool hasBacklogRoom = m_uploadBacklog.fill(m_messages, m_uploadBudget, MAX_UPDATES_PER_FRAME);
+    m_uploadBacklog.upload(m_uploadBudget, [this](ChunkMeshUpdateMessage& message) { updateMesh(message); });
+    m_uploadBackend->endFrame();
 
     // Update pending meshes
     {
         std::lock_guard<std::mutex> l(m_lckPendingMesh);
         for (auto it = m_pendingMesh.begin(); it != m_pendingMesh.end();) {
-            ChunkMeshTask* task = createMeshTask(it->second);
-            if (task) {
+            // A task that hasn't run yet will already see the newest data
+            bool isQueued = m_meshScheduler.isQueued(it->first);
+            ChunkMeshTask* task = isQueued ? nullptr : createMeshTask(it->second);
+            if (isQueued || task) {
                 {
                     std::lock_guard<std::mutex> l(m_lckActiveChunks);
 
@@ -40,7 +44,7 @@ void ChunkMeshManager::update(const f64v3& cameraPosition, bool shouldSort) {
                     assert(iter!=m_activeChunks.end());
                     iter->second->updateVersion = it->second->updateVersion;
                 }
-                m_threadPool->addTask(task);
+                if (task) m_meshScheduler.addTask(it->first, it->second->getVoxelPosition().pos, task);
                 it->second.release();
                 m_pendingMesh.erase(it++);
             } else {
@@ -48,6 +52,9 @@ void ChunkMeshManager::update(const f64v3& cameraPosition, bool shouldSort) {
             }
         }
     }
+    // Closest visible chunks go to the thread pool first. While uploads are
+    // behind, meshing more would only pile up mesh data.
+    if (hasBacklogRoom) m_meshScheduler.update();
 
     // TODO(Ben): This is redundant with the chunk manager! Find a way to share! (Pointer?)
     updateMeshDistances(cameraPosition);
@@ -56,10 +63,39 @@ void ChunkMeshManager::update(const f64v3& cameraPosition, bool shouldSort) {
     }
 }
 
+void ChunkMeshManager::setViewpoint(const Camera* camera) {
+    f64 maxDistance = soaOptions.get(OPT_VOXEL_RENDER_DISTANCE).value.f + (f64)CHUNK_WIDTH;
+    m_meshScheduler.setViewpoint(camera->getPosition(), camera->getDirection(), maxDistance);
+    m_meshScheduler.setFrustum(camera->getFrustum());
+}
+
 void ChunkMeshManager::destroy() {
+    m_uploadBacklog.clear([this](ChunkMeshUpdateMessage& message) {
+        m_uploadBackend->discard(message.meshData);
+        meshDataPool.recycle(message.meshData);
+    });
+    std::vector<vcore::IThreadPoolTask<WorkerData>*> tasks;
+    m_meshScheduler.clear(&tasks);
+    for (auto& task : tasks) {
+        disposeMeshTask(static_cast<ChunkMeshTask*>(task));
+    }
     std::vector <ChunkMesh*>().swap(m_activeChunkMeshes);
     moodycamel::ConcurrentQueue<ChunkMeshUpdateMessage>().swap(m_messages);
     std::unordered_map<ChunkID, ChunkMesh*>().swap(m_activeChunks);
+    {
+        std::lock_guard<std::mutex> l(m_lckMeshSlabs);
+        for (auto& it : m_meshSlabs) delete it.second;
+        std::unordered_map<ChunkID, ChunkMeshSlabs*>().swap(m_meshSlabs);
+    }
+}
+
+ChunkMeshSlabs* ChunkMeshManager::takeMeshSlabs(const ChunkID& id) {
+    std::lock_guard<std::mutex> l(m_lckMeshSlabs);
+    auto it = m_meshSlabs.find(id);
+    if (it == m_meshSlabs.end()) return nullptr;
+    ChunkMeshSlabs* slabs = it->second;
+    m_meshSlabs.erase(it);
+    return slabs;
 }
 
 ChunkMesh* ChunkMeshManager::createMesh(ChunkHandle& h) {
@@ -78,6 +114,7 @@ ChunkMesh* ChunkMeshManager::createMesh(ChunkHandle& h) {
     memset(mesh->vaos, 0, sizeof(mesh->vaos));
     mesh->transIndexID = 0;
     mesh->activeMeshesIndex = ACTIVE_MESH_INDEX_NONE;
+    mesh->slabLayoutID = 0;
 
     { // Register chunk as active and give it a mesh
         std::lock_guard<std::mutex> l(m_lckActiveChunks);
@@ -104,8 +141,8 @@ ChunkMeshTask* ChunkMeshManager::createMeshTask(ChunkHandle& chunk) {
         back->genLevel != GEN_DONE || front->genLevel != GEN_DONE ||
         bottom->genLevel != GEN_DONE || top->genLevel != GEN_DONE) return nullptr;
 
-    // TODO(Ben): Recycler
-    ChunkMeshTask* meshTask = new ChunkMeshTask;
+    ChunkMeshTask* meshTask = m_meshTaskRecycler.create();
+    meshTask->recycler = &m_meshTaskRecycler;
     meshTask->init(chunk, MeshTaskType::DEFAULT, m_blockPack, this);
 
     // Set dependencies
@@ -118,11 +155,20 @@ ChunkMeshTask* ChunkMeshManager::createMeshTask(ChunkHandle& chunk) {
     return meshTask;
 }
 
+void ChunkMeshManager::disposeMeshTask(ChunkMeshTask* task) {
+    task->chunk.release();
+    for (int i = 0; i < NUM_NEIGHBOR_HANDLES; i++) {
+        task->neighborHandles[i].release();
+    }
+    m_meshTaskRecycler.recycle(task);
+}
+
 void ChunkMeshManager::disposeMesh(ChunkMesh* mesh) {
     // De-allocate buffer objects
     glDeleteBuffers(4, mesh->vbos);
     glDeleteVertexArrays(4, mesh->vaos);
     if (mesh->transIndexID) glDeleteBuffers(1, &mesh->transIndexID);
+    if (ChunkRenderer::vertexArena) ChunkRenderer::vertexArena->free(mesh->arenaAllocation);
 
     { // Remove from mesh list
         std::lock_guard<std::mutex> l(lckActiveChunkMeshes);
@@ -146,13 +192,14 @@ void ChunkMeshManager::updateMesh(ChunkMeshUpdateMessage& message) {
         std::lock_guard<std::mutex> l(m_lckActiveChunks);
         auto it = m_activeChunks.find(message.chunkID);
         if (it == m_activeChunks.end()) {
-            delete message.meshData;
+            m_uploadBackend->discard(message.meshData);
+            meshDataPool.recycle(message.meshData);
             return; /// The mesh was already released, so ignore!
         }
         mesh = it->second;
     }
     
-    if (ChunkMesher::uploadMeshData(*mesh, message.meshData)) {
+    if (m_uploadBackend->upload(*mesh, message.meshData)) {
         // Add to active list if its not there
         std::lock_guard<std::mutex> l(lckActiveChunkMeshes);
         if (mesh->activeMeshesIndex == ACTIVE_MESH_INDEX_NONE) {
@@ -171,8 +218,13 @@ void ChunkMeshManager::updateMesh(ChunkMeshUpdateMessage& message) {
         }
     }
 
-    // TODO(Ben): come on...
-    delete message.meshData;
+    // The slabs describe what is in the vbo now
+    if (message.meshData->slabs) {
+        storeMeshSlabs(message.chunkID, message.meshData->slabs);
+        message.meshData->slabs = nullptr;
+    }
+
+    meshDataPool.recycle(message.meshData);
 }
 
 void ChunkMeshManager::updateMeshDistances(const f64v3& cameraPosition) {
@@ -187,6 +239,29 @@ void ChunkMeshManager::updateMeshDistances(const f64v3& cameraPosition) {
     }
 }
 
+void ChunkMeshManager::storeMeshSlabs(const ChunkID& id, ChunkMeshSlabs* slabs) {
+    std::lock_guard<std::mutex> l(m_lckMeshSlabs);
+    auto it = m_meshSlabs.find(id);
+    if (it != m_meshSlabs.end()) {
+        // An older task finished late
+        delete it->second;
+        it->second = slabs;
+    } else if (m_meshSlabs.size() < MAX_MESH_SLABS) {
+        m_meshSlabs[id] = slabs;
+    } else {
+        delete slabs;
+    }
+}
+
+void ChunkMeshManager::freeMeshSlabs(const ChunkID& id) {
+    std::lock_guard<std::mutex> l(m_lckMeshSlabs);
+    auto it = m_meshSlabs.find(id);
+    if (it != m_meshSlabs.end()) {
+        delete it->second;
+        m_meshSlabs.erase(it);
+    }
+}
+
 void ChunkMeshManager::onAddSphericalVoxelComponent(Sender s VORB_MAYBE_UNUSED, SphericalVoxelComponent& cmp, vecs::EntityID e VORB_MAYBE_UNUSED) {
     for (ui32 i = 0; i < 6; i++) {
         for (ui32 j = 0; j < cmp.chunkGrids[i].numGenerators; j++) {
@@ -247,6 +322,10 @@ void ChunkMeshManager::onNeighborsRelease(Sender s VORB_MAYBE_UNUSED, ChunkHandl
             m_pendingMesh.erase(it);
         }
     }
+    // Out of range, so the mesh would just be thrown away
+    ChunkMeshTask* task = static_cast<ChunkMeshTask*>(m_meshScheduler.cancel(chunk.getID()));
+    if (task) disposeMeshTask(task);
+    freeMeshSlabs(chunk.getID());
 
     disposeMesh(mesh);
 }
@@ -19,33 +19,47 @@
 #include "Vorb/concurrentqueue.h"
 #include "Chunk.h"
 #include "ChunkMesh.h"
+#include "ChunkMeshDataPool.h"
+#include "ChunkMeshTask.h"
+#include "ChunkMeshUploader.h"
+#include "ChunkTaskScheduler.h"
 #include "SpaceSystemAssemblages.h"
 #include <mutex>
 
-struct ChunkMeshUpdateMessage {
-    ChunkID chunkID;
-    ChunkMeshData* meshData = nullptr;
-};
+class Camera;
 
 class ChunkMeshManager {
 public:
     ChunkMeshManager(vcore::ThreadPool<WorkerData>* threadPool, BlockPack* blockPack);
     /// Updates the meshManager, uploading any needed meshes
     void update(const f64v3& cameraPosition, bool shouldSort);
+    /// Sets the camera used to prioritize mesh tasks
+    void setViewpoint(const Camera* camera);
     /// Adds a mesh for updating
     void sendMessage(const ChunkMeshUpdateMessage& message) { m_messages.enqueue(message); }
     /// Destroys all meshes
     void destroy();
+    /// Replaces the GL upload backend, e.g. with a fake for headless runs. Not owned.
+    void setUploadBackend(IMeshUploadBackend* backend) { m_uploadBackend = backend; }
+    /// Ring mesh tasks should write their vertices into, may be null. Thread safe.
+    ChunkMeshStagingRing* getStagingRing() { return m_uploadBackend->getStagingRing(); }
+    MeshUploadBudget& getUploadBudget() { return m_uploadBudget; }
+    /// Takes the slab mesh of a chunk for its mesh task, null if it has none. Thread safe.
+    ChunkMeshSlabs* takeMeshSlabs(const ChunkID& id);
 
     // Be sure to lock lckActiveChunkMeshes
     const std::vector <ChunkMesh*>& getChunkMeshes() { return m_activeChunkMeshes; }
     std::mutex lckActiveChunkMeshes;
+
+    ChunkMeshDataPool meshDataPool; ///< Mesh tasks write into these, recycled after upload
 private:
     VORB_NON_COPYABLE(ChunkMeshManager);
 
     ChunkMesh* createMesh(ChunkHandle& h);
 
     ChunkMeshTask* createMeshTask(ChunkHandle& chunk);
+    /// Releases and frees a task that never ran
+    void disposeMeshTask(ChunkMeshTask* task);
 
     void disposeMesh(ChunkMesh* mesh);
 
@@ -54,6 +68,11 @@ class ChunkMeshManager {
 
     void updateMeshDistances(const f64v3& cameraPosition);
 
+    /// Keeps the slab mesh of a chunk for its next mesh task
+    void storeMeshSlabs(const ChunkID& id, ChunkMeshSlabs* slabs);
+    /// Frees the slab mesh of a chunk
+    void freeMeshSlabs(const ChunkID& id);
+
     /************************************************************************/
     /* Event Handlers                                                       */
     /************************************************************************/
@@ -69,17 +88,26 @@ class ChunkMeshManager {
     /************************************************************************/
     std::vector<ChunkMesh*> m_activeChunkMeshes; ///< Meshes that should be drawn
     moodycamel::ConcurrentQueue<ChunkMeshUpdateMessage> m_messages; ///< Lock-free queue of messages
+    MeshUploadBacklog m_uploadBacklog; ///< Finished meshes over the frame's budget
+
+    MeshUploadBudget m_uploadBudget;
+    GLMeshUploadBackend m_glUploadBackend;
+    IMeshUploadBackend* m_uploadBackend = &m_glUploadBackend;
    
     BlockPack* m_blockPack = nullptr;
     vcore::ThreadPool<WorkerData>* m_threadPool = nullptr;
 
     std::mutex m_lckPendingMesh;
     std::map<ChunkID, ChunkHandle> m_pendingMesh;
+    ChunkTaskScheduler m_meshScheduler; ///< Mesh tasks waiting for the thread pool
+    ConcurrentRecycler<ChunkMeshTask> m_meshTaskRecycler;
 
     std::mutex m_lckMeshRecycler;
     PtrRecycler<ChunkMesh> m_meshRecycler;
     std::mutex m_lckActiveChunks;
     std::unordered_map<ChunkID, ChunkMesh*> m_activeChunks; ///< Stores chunk IDs that have meshes
+    std::mutex m_lckMeshSlabs;
+    std::unordered_map<ChunkID, ChunkMeshSlabs*> m_meshSlabs; ///< CPU copies of edited chunk meshes
 };
 
 #endif // ChunkMeshManager_h__
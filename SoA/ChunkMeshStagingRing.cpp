@@ -0,0 +1,171 @@
+#include "stdafx.h"
+#include "ChunkMeshStagingRing.h"
+
+#include "ChunkMesh.h"
+#include "ChunkRenderer.h"
+
+// Keeps every block aligned for memcpy
+#define STAGING_ALIGNMENT 16
+
+void StagingRingAllocator::init(ui32 capacity) {
+    std::lock_guard<std::mutex> l(m_lock);
+    m_capacity = capacity;
+    m_blocks.clear();
+    m_completedFrame = 0;
+}
+
+bool StagingRingAllocator::allocate(ui32 size, OUT MeshStagingAllocation& allocation) {
+    size = (size + STAGING_ALIGNMENT - 1) & ~(ui32)(STAGING_ALIGNMENT - 1);
+    if (size == 0 || size > m_capacity) return false;
+
+    std::lock_guard<std::mutex> l(m_lock);
+    ui32 offset;
+    if (m_blocks.empty()) {
+        offset = 0;
+    } else {
+        const Block& front = m_blocks.front();
+        const Block& back = m_blocks.back();
+        ui32 headEnd = back.offset + back.size;
+        if (back.offset >= front.offset) {
+            // Not wrapped, room is after the head or before the tail
+            if (headEnd + size <= m_capacity) {
+                offset = headEnd;
+            } else if (size <= front.offset) {
+                offset = 0;
+            } else {
+                return false;
+            }
+        } else {
+            // Wrapped, room is between the head and the tail
+            if (headEnd + size <= front.offset) {
+                offset = headEnd;
+            } else {
+                return false;
+            }
+        }
+    }
+
+    m_blocks.push_back({ offset, size, 0, false });
+    allocation.offset = offset;
+    allocation.size = size;
+    return true;
+}
+
+void StagingRingAllocator::release(const MeshStagingAllocation& allocation, ui64 frame) {
+    std::lock_guard<std::mutex> l(m_lock);
+    for (auto& b : m_blocks) {
+        if (b.offset == allocation.offset && !b.isReleased) {
+            b.isReleased = true;
+            b.releaseFrame = frame;
+            break;
+        }
+    }
+    // Blocks the GPU never read can go right away
+    while (m_blocks.size() && m_blocks.front().isReleased && m_blocks.front().releaseFrame <= m_completedFrame) {
+        m_blocks.pop_front();
+    }
+}
+
+void StagingRingAllocator::retireFrame(ui64 completedFrame) {
+    std::lock_guard<std::mutex> l(m_lock);
+    if (completedFrame > m_completedFrame) m_completedFrame = completedFrame;
+    // Only the oldest blocks can be freed, so the ring stays contiguous
+    while (m_blocks.size() && m_blocks.front().isReleased && m_blocks.front().releaseFrame <= m_completedFrame) {
+        m_blocks.pop_front();
+    }
+}
+
+ui32 StagingRingAllocator::getBytesInUse() {
+    std::lock_guard<std::mutex> l(m_lock);
+    ui32 bytes = 0;
+    for (auto& b : m_blocks) bytes += b.size;
+    return bytes;
+}
+
+bool ChunkMeshStagingRing::init(ui32 capacity) {
+    if (!GLEW_ARB_buffer_storage) return false;
+
+    const GLbitfield FLAGS = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glGenBuffers(1, &m_buffer);
+    glBindBuffer(GL_COPY_READ_BUFFER, m_buffer);
+    glBufferStorage(GL_COPY_READ_BUFFER, capacity, nullptr, FLAGS);
+    m_mappedData = (ui8*)glMapBufferRange(GL_COPY_READ_BUFFER, 0, capacity, FLAGS);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    if (!m_mappedData) {
+        glDeleteBuffers(1, &m_buffer);
+        m_buffer = 0;
+        return false;
+    }
+    m_allocator.init(capacity);
+    return true;
+}
+
+void ChunkMeshStagingRing::dispose() {
+    for (auto& f : m_fences) glDeleteSync(f.fence);
+    std::deque<FrameFence>().swap(m_fences);
+    if (m_buffer) {
+        glBindBuffer(GL_COPY_READ_BUFFER, m_buffer);
+        glUnmapBuffer(GL_COPY_READ_BUFFER);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glDeleteBuffers(1, &m_buffer);
+        m_buffer = 0;
+    }
+    m_mappedData = nullptr;
+}
+
+bool ChunkMeshStagingRing::stage(ChunkMeshData& data) {
+    const void* src;
+    ui32 size;
+    if (data.vertexFormat == BlockVertexFormat::COMPACT) {
+        src = data.compactOpaqueQuads.data();
+        size = (ui32)(data.compactOpaqueQuads.size() * sizeof(CompactBlockQuad));
+    } else if (!ChunkRenderer::vertexArena) {
+        // Batched meshes are written straight into the arena
+        src = data.opaqueQuads.data();
+        size = (ui32)(data.opaqueQuads.size() * sizeof(VoxelQuad));
+    } else {
+        return false;
+    }
+    if (size == 0 || !m_allocator.allocate(size, data.staging)) return false;
+
+    memcpy(m_mappedData + data.staging.offset, src, size);
+    // Copy the real size, the allocation is padded
+    data.staging.size = size;
+    return true;
+}
+
+void ChunkMeshStagingRing::copyToBuffer(VGBuffer& buffer, MeshStagingAllocation& allocation) {
+    if (buffer == 0) glGenBuffers(1, &buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, allocation.size, nullptr, GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_READ_BUFFER, m_buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, allocation.offset, 0, allocation.size);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    // Reusable once this frame's fence passes
+    m_allocator.release(allocation, m_frame);
+    allocation.size = 0;
+}
+
+void ChunkMeshStagingRing::discard(MeshStagingAllocation& allocation) {
+    if (allocation.size == 0) return;
+    m_allocator.release(allocation, 0);
+    allocation.size = 0;
+}
+
+void ChunkMeshStagingRing::endFrame() {
+    m_fences.push_back({ m_frame, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0) });
+    m_frame++;
+
+    // Don't wait, just check what has finished
+    ui64 completedFrame = 0;
+    while (m_fences.size()) {
+        GLenum result = glClientWaitSync(m_fences.front().fence, 0, 0);
+        if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED) break;
+        completedFrame = m_fences.front().frame;
+        glDeleteSync(m_fences.front().fence);
+        m_fences.pop_front();
+    }
+    if (completedFrame) m_allocator.retireFrame(completedFrame);
+}
@@ -0,0 +1,95 @@
+///
+/// ChunkMeshStagingRing.h
+/// Seed of Andromeda
+///
+/// Copyright 2014 Regrowth Studios
+/// MIT License
+///
+/// Summary:
+/// Persistently mapped ring buffer that mesh workers write vertex data
+/// into, so the render thread only has to issue buffer copies.
+///
+
+#pragma once
+
+#ifndef ChunkMeshStagingRing_h__
+#define ChunkMeshStagingRing_h__
+
+#include <deque>
+#include <mutex>
+
+#include <Vorb/graphics/gtypes.h>
+
+class ChunkMeshData;
+
+/// Part of the staging ring holding one mesh's data
+struct MeshStagingAllocation {
+    ui32 offset = 0;
+    ui32 size = 0; ///< 0 when nothing is staged
+};
+
+/// Ring allocation bookkeeping without any GL, so it can run headless.
+/// Blocks are freed in allocation order once their frame has finished on the GPU.
+class StagingRingAllocator {
+public:
+    void init(ui32 capacity);
+
+    /// Thread safe.
+    /// @return false if there is no room right now
+    bool allocate(ui32 size, OUT MeshStagingAllocation& allocation);
+    /// Marks a block as no longer needed once frame is done with it. Use
+    /// frame 0 for blocks the GPU never read. Thread safe.
+    void release(const MeshStagingAllocation& allocation, ui64 frame);
+    /// Frees released blocks whose frame is <= completedFrame. Thread safe.
+    void retireFrame(ui64 completedFrame);
+
+    ui32 getCapacity() const { return m_capacity; }
+    /// Bytes in blocks that are not yet free. Thread safe.
+    ui32 getBytesInUse();
+private:
+    struct Block {
+        ui32 offset;
+        ui32 size;
+        ui64 releaseFrame;
+        bool isReleased;
+    };
+
+    std::deque<Block> m_blocks; ///< Oldest first
+    ui64 m_completedFrame = 0;
+    ui32 m_capacity = 0;
+    std::mutex m_lock;
+};
+
+class ChunkMeshStagingRing {
+public:
+    /// Needs ARB_buffer_storage. Call on the GL thread.
+    /// @return false if persistent mapping isn't supported
+    bool init(ui32 capacity);
+    void dispose();
+
+    /// Copies the opaque vertices of data into the ring and records where in
+    /// data.staging. Thread safe, called by mesh workers.
+    /// @return false if the data wasn't staged and must be uploaded normally
+    bool stage(ChunkMeshData& data);
+
+    /// Copies staged data into the start of a buffer, resizing it to fit. Render thread only.
+    void copyToBuffer(VGBuffer& buffer, MeshStagingAllocation& allocation);
+    /// Gives back staged data that won't be copied. Thread safe.
+    void discard(MeshStagingAllocation& allocation);
+
+    /// Fences this frame's copies and frees space from finished frames. Render thread only.
+    void endFrame();
+private:
+    struct FrameFence {
+        ui64 frame;
+        GLsync fence;
+    };
+
+    StagingRingAllocator m_allocator;
+    std::deque<FrameFence> m_fences;
+    VGBuffer m_buffer = 0;
+    ui8* m_mappedData = nullptr;
+    ui64 m_frame = 1; ///< 0 is used for blocks the GPU never read
+};
+
+#endif // ChunkMeshStagingRing_h__
@@ -9,18 +9,9 @@
 #include "ChunkMesher.h"
 #include "GameManager.h"
 #include "Chunk.h"
-#include "VoxelLightEngine.h"
 #include "VoxelUtils.h"
 
 void ChunkMeshTask::execute(WorkerData* workerData) {
-    // Mesh updates are accompanied by light updates // TODO(Ben): Seems wasteful.
-    if (workerData->voxelLightEngine == nullptr) {
-        workerData->voxelLightEngine = new VoxelLightEngine();
-    }
-    
-    // TODO(Ben): Lighting
-    // updateLight(workerData->voxelLightEngine);
-    
     // Lazily allocate chunkMesher // TODO(Ben): Seems wasteful.
     if (workerData->chunkMesher == nullptr) {
         workerData->chunkMesher = new ChunkMesher;
@@ -30,30 +21,32 @@ void ChunkMeshTask::execute(WorkerData* workerData) {
     ChunkMeshUpdateMessage msg;
     msg.chunkID = chunk.getID();
 
+    // Take the edits before copying the data, later ones get another task
+    ui8 editedSlabs = chunk->meshSlabs.exchange(0);
+    ChunkMeshSlabs* slabs = meshManager->takeMeshSlabs(chunk.getID());
+
     // Pre-processing
     workerData->chunkMesher->prepareDataAsync(chunk, neighborHandles);
 
-    // Create the actual mesh
-    msg.meshData = workerData->chunkMesher->createChunkMeshData(type);
+    // Create the actual mesh, only re-meshing the edited slabs if we have the rest
+    msg.meshData = workerData->chunkMesher->createChunkMeshData(type, &meshManager->meshDataPool, editedSlabs, slabs);
+
+    // Write the vertices to the GPU visible ring here so the render thread only has to copy
+    // Patches only write a few ranges of the existing buffer
+    ChunkMeshStagingRing* stagingRing = meshManager->getStagingRing();
+    if (stagingRing && !msg.meshData->slabPatch) stagingRing->stage(*msg.meshData);
 
     // Send it for update
     meshManager->sendMessage(msg);
 }
 
+void ChunkMeshTask::cleanup() {
+    recycler->recycle(this);
+}
+
 void ChunkMeshTask::init(ChunkHandle& ch, MeshTaskType cType, const BlockPack* blockPack, ChunkMeshManager* meshManager) {
     type = cType;
     chunk = ch.acquire();
     this->blockPack = blockPack;
     this->meshManager = meshManager;
 }
-
-// TODO(Ben): uhh
-void ChunkMeshTask::updateLight(VoxelLightEngine* voxelLightEngine VORB_UNUSED) {
-    /* if (chunk->sunRemovalList.size()) {
-         voxelLightEngine->calculateSunlightRemoval(chunk);
-         }
-         if (chunk->sunExtendList.size()) {
-         voxelLightEngine->calculateSunlightExtend(chunk);
-         }
-         voxelLightEngine->calculateLight(chunk);*/
-}
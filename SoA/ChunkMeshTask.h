@@ -18,6 +18,7 @@
 #include <Vorb/IThreadPoolTask.h>
 
 #include "ChunkHandle.h"
+#include "ConcurrentRecycler.h"
 #include "Constants.h"
 #include "VoxPool.h"
 
@@ -26,7 +27,6 @@ class ChunkGridData;
 class ChunkMesh;
 class ChunkMeshData;
 class ChunkMeshManager;
-class VoxelLightEngine;
 class BlockPack;
 
 enum class MeshTaskType { DEFAULT, LIQUID };
@@ -50,6 +50,8 @@ class ChunkMeshTask : public vcore::IThreadPoolTask<WorkerData> {
 
     // Executes the task
     void execute(WorkerData* workerData) override;
+    // Gives the task back to its recycler
+    void cleanup() override;
 
     // Initializes the task
     void init(ChunkHandle& ch, MeshTaskType cType, const BlockPack* blockPack, ChunkMeshManager* meshManager);
@@ -59,8 +61,7 @@ class ChunkMeshTask : public vcore::IThreadPoolTask<WorkerData> {
     ChunkMeshManager* meshManager = nullptr;
     const BlockPack* blockPack = nullptr;
     ChunkHandle neighborHandles[NUM_NEIGHBOR_HANDLES];
-private:
-    void updateLight(VoxelLightEngine* voxelLightEngine);
+    ConcurrentRecycler<ChunkMeshTask>* recycler = nullptr; ///< Where the task came from
 };
 
 #endif // RenderTask_h__
@@ -0,0 +1,109 @@
+#include "stdafx.h"
+#include "ChunkMeshUploader.h"
+
+#include "ChunkMesh.h"
+#include "ChunkMesher.h"
+
+#include <Vorb/Timing.h>
+
+size_t getMeshDataUploadSize(const ChunkMeshData& data) {
+    size_t opaqueQuads = data.opaqueQuads.size();
+    if (data.slabPatch) {
+        // Only the patched ranges are written
+        opaqueQuads = 0;
+        for (int face = 0; face < 6; face++) {
+            for (int s = 0; s < MESH_SLAB_COUNT; s++) {
+                if (data.slabPatch & (1 << s)) opaqueQuads += data.slabs->capacity[face][s];
+            }
+        }
+    }
+    return opaqueQuads * sizeof(VoxelQuad) +
+        data.transQuads.size() * sizeof(VoxelQuad) +
+        data.cutoutQuads.size() * sizeof(VoxelQuad) +
+        data.waterVertices.size() * sizeof(LiquidVertex) +
+        data.compactOpaqueQuads.size() * sizeof(CompactBlockQuad) +
+        data.opaqueMaterials.size() * sizeof(BlockMaterial) +
+        data.transQuadIndices.size() * sizeof(ui32);
+}
+
+void MeshUploadBudget::init(size_t maxBytesPerFrame, f64 maxMsPerFrame) {
+    m_maxBytes = maxBytesPerFrame;
+    m_maxMs = maxMsPerFrame;
+}
+
+void MeshUploadBudget::beginFrame() {
+    m_frameBytes = 0;
+    m_frameMs = 0.0;
+    m_frameUploads = 0;
+}
+
+bool MeshUploadBudget::canUpload(size_t bytes) const {
+    if (m_frameUploads == 0) return true;
+    return m_frameBytes + bytes <= m_maxBytes && m_frameMs < m_maxMs;
+}
+
+void MeshUploadBudget::addUpload(size_t bytes, f64 ms) {
+    m_frameBytes += bytes;
+    m_frameMs += ms;
+    m_frameUploads++;
+}
+
+bool MeshUploadBacklog::fill(moodycamel::ConcurrentQueue<ChunkMeshUpdateMessage>& queue, const MeshUploadBudget& budget, size_t maxMessages) {
+    if (!hasRoom(budget)) return false;
+    m_buffer.resize(maxMessages);
+    size_t numMessages = queue.try_dequeue_bulk(m_buffer.data(), maxMessages);
+    for (size_t i = 0; i < numMessages; i++) {
+        m_bytes += getMeshDataUploadSize(*m_buffer[i].meshData);
+        m_messages.push_back(m_buffer[i]);
+    }
+    return hasRoom(budget);
+}
+
+void MeshUploadBacklog::upload(MeshUploadBudget& budget, const UploadFunc& uploadFunc) {
+    budget.beginFrame();
+    PreciseTimer timer;
+    while (m_messages.size()) {
+        ChunkMeshUpdateMessage& message = m_messages.front();
+        size_t bytes = getMeshDataUploadSize(*message.meshData);
+        if (!budget.canUpload(bytes)) break;
+        timer.start();
+        uploadFunc(message);
+        budget.addUpload(bytes, timer.stop());
+        m_bytes -= bytes;
+        m_messages.pop_front();
+    }
+}
+
+void MeshUploadBacklog::clear(const UploadFunc& discardFunc) {
+    for (auto& message : m_messages) discardFunc(message);
+    std::deque<ChunkMeshUpdateMessage>().swap(m_messages);
+    m_bytes = 0;
+}
+
+GLMeshUploadBackend::~GLMeshUploadBackend() {
+    if (m_stagingRing) m_ring.dispose();
+}
+
+bool GLMeshUploadBackend::upload(ChunkMesh& mesh, ChunkMeshData* data) {
+    if (!m_isInit) initRing();
+    bool canRender = ChunkMesher::uploadMeshData(mesh, data, m_stagingRing);
+    // Staged data can go unused, e.g. when the mesh went into the vertex arena
+    discard(data);
+    return canRender;
+}
+
+void GLMeshUploadBackend::discard(ChunkMeshData* data) {
+    if (data->staging.size) m_ring.discard(data->staging);
+}
+
+void GLMeshUploadBackend::endFrame() {
+    if (!m_isInit) initRing();
+    if (m_stagingRing) m_ring.endFrame();
+}
+
+void GLMeshUploadBackend::initRing() {
+    m_isInit = true;
+    if (m_ring.init(MESH_STAGING_RING_SIZE)) {
+        m_stagingRing = &m_ring;
+    }
+}
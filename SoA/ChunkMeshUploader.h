@@ -0,0 +1,128 @@
+///
+/// ChunkMeshUploader.h
+/// Seed of Andromeda
+///
+/// Copyright 2014 Regrowth Studios
+/// MIT License
+///
+/// Summary:
+/// Spreads chunk mesh uploads over frames with a byte and time budget.
+/// Uploads go through a backend so the budget can run without GL.
+///
+
+#pragma once
+
+#ifndef ChunkMeshUploader_h__
+#define ChunkMeshUploader_h__
+
+#include <atomic>
+#include <deque>
+#include <functional>
+
+#include <Vorb/concurrentqueue.h>
+
+#include "ChunkID.h"
+#include "ChunkMeshStagingRing.h"
+
+class ChunkMesh;
+class ChunkMeshData;
+
+#define MESH_UPLOAD_BYTES_PER_FRAME (8 * 1024 * 1024)
+#define MESH_UPLOAD_MS_PER_FRAME 2.0
+#define MESH_STAGING_RING_SIZE (32 * 1024 * 1024)
+#define MESH_UPLOAD_BACKLOG_FRAMES 4 ///< Frames of budget the backlog may hold
+
+struct ChunkMeshUpdateMessage {
+    ChunkID chunkID;
+    ChunkMeshData* meshData = nullptr;
+};
+
+/// Bytes that uploading data will send to the GPU
+size_t getMeshDataUploadSize(const ChunkMeshData& data);
+
+/// Tracks the uploads of one frame against a limit
+class MeshUploadBudget {
+public:
+    void init(size_t maxBytesPerFrame, f64 maxMsPerFrame);
+
+    void beginFrame();
+    /// The first upload of a frame is always allowed so huge meshes still get through
+    /// @param bytes: Size of the upload
+    /// @return true if the upload fits in what is left of the frame
+    bool canUpload(size_t bytes) const;
+    /// Records an upload
+    /// @param bytes: Size of the upload
+    /// @param ms: Time the upload took
+    void addUpload(size_t bytes, f64 ms);
+
+    size_t getMaxBytes() const { return m_maxBytes; }
+    size_t getFrameBytes() const { return m_frameBytes; }
+    f64 getFrameMs() const { return m_frameMs; }
+    ui32 getFrameUploads() const { return m_frameUploads; }
+private:
+    size_t m_maxBytes = MESH_UPLOAD_BYTES_PER_FRAME;
+    f64 m_maxMs = MESH_UPLOAD_MS_PER_FRAME;
+    size_t m_frameBytes = 0;
+    f64 m_frameMs = 0.0;
+    ui32 m_frameUploads = 0;
+};
+
+/// Finished meshes waiting for their upload, oldest first. Only takes new meshes
+/// while it holds less than MESH_UPLOAD_BACKLOG_FRAMES of budget, so meshing
+/// faster than the budget allows can't grow it without bound.
+class MeshUploadBacklog {
+public:
+    typedef std::function<void(ChunkMeshUpdateMessage&)> UploadFunc;
+
+    /// Moves up to maxMessages meshes out of queue if there is room
+    /// @return false if the backlog is full, new mesh work should wait
+    bool fill(moodycamel::ConcurrentQueue<ChunkMeshUpdateMessage>& queue, const MeshUploadBudget& budget, size_t maxMessages);
+    /// Uploads the oldest meshes until the budget of the frame is spent
+    void upload(MeshUploadBudget& budget, const UploadFunc& uploadFunc);
+    /// Hands every waiting mesh to discardFunc and empties the backlog
+    void clear(const UploadFunc& discardFunc);
+
+    bool hasRoom(const MeshUploadBudget& budget) const {
+        return m_bytes < budget.getMaxBytes() * MESH_UPLOAD_BACKLOG_FRAMES;
+    }
+    size_t size() const { return m_messages.size(); }
+    size_t getBytes() const { return m_bytes; }
+private:
+    std::deque<ChunkMeshUpdateMessage> m_messages;
+    std::vector<ChunkMeshUpdateMessage> m_buffer; ///< For bulk dequeues
+    size_t m_bytes = 0; ///< Upload size of everything in m_messages
+};
+
+/// Does the actual mesh uploads for ChunkMeshManager.
+/// Replace with a fake to exercise the upload budget without GL.
+class IMeshUploadBackend {
+public:
+    virtual ~IMeshUploadBackend() {}
+    /// @return true if the mesh is renderable
+    virtual bool upload(ChunkMesh& mesh, ChunkMeshData* data) = 0;
+    /// Called with data that will never be uploaded, before it is recycled
+    virtual void discard(ChunkMeshData* data) = 0;
+    /// Called once per frame after the uploads
+    virtual void endFrame() = 0;
+    /// Ring that workers may write mesh data into, null if there isn't one. Thread safe.
+    virtual ChunkMeshStagingRing* getStagingRing() { return nullptr; }
+};
+
+class GLMeshUploadBackend : public IMeshUploadBackend {
+public:
+    virtual ~GLMeshUploadBackend();
+
+    virtual bool upload(ChunkMesh& mesh, ChunkMeshData* data) override;
+    virtual void discard(ChunkMeshData* data) override;
+    virtual void endFrame() override;
+    virtual ChunkMeshStagingRing* getStagingRing() override { return m_stagingRing; }
+private:
+    /// Creates the staging ring on first use, since it needs the GL thread
+    void initRing();
+
+    ChunkMeshStagingRing m_ring;
+    std::atomic<ChunkMeshStagingRing*> m_stagingRing{ nullptr }; ///< &m_ring once it works
+    bool m_isInit = false;
+};
+
+#endif // ChunkMeshUploader_h__
@@ -12,6 +12,7 @@
 
 #include "BlockPack.h"
 #include "Chunk.h"
+#include "ChunkMeshDataPool.h"
 #include "ChunkMeshTask.h"
 #include "ChunkRenderer.h"
 #include "Errors.h"
@@ -21,6 +22,10 @@
 #include "VoxelMesher.h"
 #include "VoxelUtils.h"
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 #define GETBLOCK(a) blocks->operator[](a)
 
 // const float LIGHT_MULT = 0.95f, LIGHT_OFFSET = -0.2f;
@@ -33,7 +38,19 @@
 #define PADDED_SIZE PADDED_CHUNK_SIZE
 const int PADDED_WIDTH_M1 = PADDED_WIDTH - 1;
 
-#define NO_QUAD_INDEX 0xFFFF
+// Extra quads reserved in edited slabs so small edits can be patched in place
+#define MESH_SLAB_SLACK 4
+
+// Index of the lowest set bit, bits must not be 0
+inline int lowestBit(ui32 bits) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, bits);
+    return (int)index;
+#else
+    return __builtin_ctz(bits);
+#endif
+}
 
 #define QUAD_SIZE 7
 
@@ -64,6 +81,7 @@ PlanetHeightData ChunkMesher::defaultChunkHeightData[CHUNK_LAYER] = {};
 
 void ChunkMesher::init(const BlockPack* blocks) {
     this->blocks = blocks;
+    vertexFormat = soaOptions.get(OPT_COMPACT_BLOCK_VERTICES).value.b ? BlockVertexFormat::COMPACT : BlockVertexFormat::DEFAULT;
 
     // Set up the texture params
     m_textureMethodParams[X_NEG][B_INDEX].init(this, PADDED_CHUNK_WIDTH, PADDED_CHUNK_LAYER, -1, X_NEG, B_INDEX);
@@ -83,6 +101,26 @@ void ChunkMesher::init(const BlockPack* blocks) {
 
     m_textureMethodParams[Z_POS][B_INDEX].init(this, 1, PADDED_CHUNK_LAYER, PADDED_CHUNK_WIDTH, Z_POS, B_INDEX);
     m_textureMethodParams[Z_POS][O_INDEX].init(this, 1, PADDED_CHUNK_LAYER, PADDED_CHUNK_WIDTH, Z_POS, O_INDEX);
+
+    // Set up the greedy meshing params
+    m_faceInfo[X_NEG].init(i32v3(-1, 0, 0), (int)vvox::Axis::Z, (int)vvox::Axis::Y, 2, ui8v2(1, 1), -PADDED_CHUNK_LAYER, PADDED_CHUNK_WIDTH);
+    m_faceInfo[X_POS].init(i32v3(1, 0, 0), (int)vvox::Axis::Z, (int)vvox::Axis::Y, 0, ui8v2(-1, 1), -PADDED_CHUNK_LAYER, -PADDED_CHUNK_WIDTH);
+    m_faceInfo[Y_NEG].init(i32v3(0, -1, 0), (int)vvox::Axis::X, (int)vvox::Axis::Z, 2, ui8v2(1, 1), PADDED_CHUNK_WIDTH, 1);
+    m_faceInfo[Y_POS].init(i32v3(0, 1, 0), (int)vvox::Axis::X, (int)vvox::Axis::Z, 0, ui8v2(-1, 1), -PADDED_CHUNK_WIDTH, -1);
+    m_faceInfo[Z_NEG].init(i32v3(0, 0, -1), (int)vvox::Axis::X, (int)vvox::Axis::Y, 0, ui8v2(-1, 1), -PADDED_CHUNK_LAYER, -1);
+    m_faceInfo[Z_POS].init(i32v3(0, 0, 1), (int)vvox::Axis::X, (int)vvox::Axis::Y, 2, ui8v2(1, 1), -PADDED_CHUNK_LAYER, 1);
+}
+
+void ChunkMesher::FaceMeshInfo::init(const i32v3& normal, int rightAxis, int frontAxis, int rightStretchIndex, const ui8v2& texOffset, int aoFrontOffset, int aoRightOffset) {
+    this->normal = normal;
+    this->offset = normal.x + normal.y * PADDED_CHUNK_LAYER + normal.z * PADDED_CHUNK_WIDTH;
+    this->sliceAxis = 3 - rightAxis - frontAxis;
+    this->rightAxis = rightAxis;
+    this->frontAxis = frontAxis;
+    this->rightStretchIndex = rightStretchIndex;
+    this->texOffset = texOffset;
+    this->aoFrontOffset = aoFrontOffset;
+    this->aoRightOffset = aoRightOffset;
 }
 
 void ChunkMesher::prepareData(const Chunk* chunk) {
@@ -250,7 +288,7 @@ void ChunkMesher::prepareData(const Chunk* chunk) {
 
 #define GET_EDGE_X(ch, sy, sz, dy, dz) \
     { \
-      std::lock_guard<std::mutex> l(ch->dataMutex); \
+      std::shared_lock<std::shared_timed_mutex> l(ch->dataMutex); \
       for (int x = 0; x < CHUNK_WIDTH; x++) { \
           srcIndex = (sy) * CHUNK_LAYER + (sz) * CHUNK_WIDTH + x; \
           destIndex = (dy) * PADDED_LAYER + (dz) * PADDED_WIDTH + (x + 1); \
@@ -262,7 +300,7 @@ void ChunkMesher::prepareData(const Chunk* chunk) {
 
 #define GET_EDGE_Y(ch, sx, sz, dx, dz) \
     { \
-      std::lock_guard<std::mutex> l(ch->dataMutex); \
+      std::shared_lock<std::shared_timed_mutex> l(ch->dataMutex); \
       for (int y = 0; y < CHUNK_WIDTH; y++) { \
         srcIndex = y * CHUNK_LAYER + (sz) * CHUNK_WIDTH + (sx); \
         destIndex = (y + 1) * PADDED_LAYER + (dz) * PADDED_WIDTH + (dx); \
@@ -274,7 +312,7 @@ void ChunkMesher::prepareData(const Chunk* chunk) {
 
 #define GET_EDGE_Z(ch, sx, sy, dx, dy) \
     { \
-      std::lock_guard<std::mutex> l(ch->dataMutex); \
+      std::shared_lock<std::shared_timed_mutex> l(ch->dataMutex); \
       for (int z = 0; z < CHUNK_WIDTH; z++) { \
         srcIndex = z * CHUNK_WIDTH + (sy) * CHUNK_LAYER + (sx); \
         destIndex = (z + 1) * PADDED_WIDTH + (dy) * PADDED_LAYER + (dx); \
@@ -288,7 +326,7 @@ void ChunkMesher::prepareData(const Chunk* chunk) {
     srcIndex = (sy) * CHUNK_LAYER + (sz) * CHUNK_WIDTH + (sx); \
     destIndex = (dy) * PADDED_LAYER + (dz) * PADDED_WIDTH + (dx); \
     { \
-      std::lock_guard<std::mutex> l(ch->dataMutex); \
+      std::shared_lock<std::shared_timed_mutex> l(ch->dataMutex); \
       blockData[destIndex] = ch->getBlockData(srcIndex); \
       tertiaryData[destIndex] = ch->getTertiaryData(srcIndex); \
     } \
@@ -298,9 +336,6 @@ void ChunkMesher::prepareDataAsync(ChunkHandle& chunk, ChunkHandle neighbors[NUM
     int x, y, z, srcIndex, destIndex;
 
     int wc;
-    int c = 0;
-
-    i32v3 pos;
 
     wSize = 0;
     chunkVoxelPos = chunk->getVoxelPosition();
@@ -313,161 +348,56 @@ void ChunkMesher::prepareDataAsync(ChunkHandle& chunk, ChunkHandle neighbors[NUM
     }
 
     // TODO(Ben): Do this last so we can be queued for mesh longer?
-    // TODO(Ben): Dude macro this or something.
     { // Main chunk
-        std::lock_guard<std::mutex> l(chunk->dataMutex);
-        if (chunk->blocks.getState() == vvox::VoxelStorageState::INTERVAL_TREE) {
-
-            int s = 0;
-            //block data
-            auto& dataTree = chunk->blocks.getTree();
-            for (size_t i = 0; i < dataTree.size(); i++) {
-                for (size_t j = 0; j < dataTree[i].length; j++) {
-                    c = dataTree[i].getStart() + j;
-
-                    getPosFromBlockIndex(c, pos);
-
-                    wc = (pos.y + 1)*PADDED_LAYER + (pos.z + 1)*PADDED_WIDTH + (pos.x + 1);
-                    blockData[wc] = dataTree[i].data;
-                    if (GETBLOCK(blockData[wc]).meshType == MeshType::LIQUID) {
-                        m_wvec[s++] = wc;
-                    }
-                }
-            }
-            wSize = s;
-        } else {
-            int s = 0;
-            for (y = 0; y < CHUNK_WIDTH; y++) {
-                for (z = 0; z < CHUNK_WIDTH; z++) {
-                    for (x = 0; x < CHUNK_WIDTH; x++, c++) {
-                        wc = (y + 1)*PADDED_LAYER + (z + 1)*PADDED_WIDTH + (x + 1);
-                        blockData[wc] = chunk->blocks[c];
-                        if (GETBLOCK(blockData[wc]).meshType == MeshType::LIQUID) {
-                            m_wvec[s++] = wc;
-                        }
-                    }
-                }
-            }
-            wSize = s;
-        }
-        if (chunk->tertiary.getState() == vvox::VoxelStorageState::INTERVAL_TREE) {
-            //tertiary data
-            c = 0;
-            auto& dataTree = chunk->tertiary.getTree();
-            for (size_t i = 0; i < dataTree.size(); i++) {
-                for (size_t j = 0; j < dataTree[i].length; j++) {
-                    c = dataTree[i].getStart() + j;
-
-                    getPosFromBlockIndex(c, pos);
-                    wc = (pos.y + 1)*PADDED_LAYER + (pos.z + 1)*PADDED_WIDTH + (pos.x + 1);
-
-                    tertiaryData[wc] = dataTree[i].data;
-                }
-            }
-
-        } else {
-            c = 0;
-            for (y = 0; y < CHUNK_WIDTH; y++) {
-                for (z = 0; z < CHUNK_WIDTH; z++) {
-                    for (x = 0; x < CHUNK_WIDTH; x++, c++) {
-                        wc = (y + 1)*PADDED_LAYER + (z + 1)*PADDED_WIDTH + (x + 1);
-                        tertiaryData[wc] = chunk->tertiary.get(c);
-                    }
-                }
-            }
-        }
+        std::shared_lock<std::shared_timed_mutex> l(chunk->dataMutex);
+        chunk->blocks.copyRegion(i32v3(0), i32v3(CHUNK_WIDTH), blockData + PADDED_LAYER + PADDED_WIDTH + 1, PADDED_WIDTH, PADDED_LAYER);
+        chunk->tertiary.copyRegion(i32v3(0), i32v3(CHUNK_WIDTH), tertiaryData + PADDED_LAYER + PADDED_WIDTH + 1, PADDED_WIDTH, PADDED_LAYER);
     }
     chunk.release();
 
-    ChunkHandle& left = neighbors[NEIGHBOR_HANDLE_LEFT];
-    { // Left
-        std::lock_guard<std::mutex> l(left->dataMutex);
-        for (y = 1; y < PADDED_WIDTH - 1; y++) {
-            for (z = 1; z < PADDED_WIDTH - 1; z++) {
-                srcIndex = (z - 1)*CHUNK_WIDTH + (y - 1)*CHUNK_LAYER;
-                destIndex = z*PADDED_WIDTH + y*PADDED_LAYER;
-
-                blockData[destIndex] = left->getBlockData(srcIndex + CHUNK_WIDTH - 1);
-                tertiaryData[destIndex] = left->getTertiaryData(srcIndex + CHUNK_WIDTH - 1);
+    // Find liquids after the copy so the lock isn't held for it
+    int s = 0;
+    for (y = 1; y < PADDED_WIDTH - 1; y++) {
+        for (z = 1; z < PADDED_WIDTH - 1; z++) {
+            wc = y * PADDED_LAYER + z * PADDED_WIDTH + 1;
+            for (x = 1; x < PADDED_WIDTH - 1; x++, wc++) {
+                if (GETBLOCK(blockData[wc]).meshType == MeshType::LIQUID) {
+                    m_wvec[s++] = wc;
+                }
             }
         }
     }
-    left.release();
-
-    ChunkHandle& right = neighbors[NEIGHBOR_HANDLE_RIGHT];
-    { // Right
-        std::lock_guard<std::mutex> l(right->dataMutex);
-        for (y = 1; y < PADDED_WIDTH - 1; y++) {
-            for (z = 1; z < PADDED_WIDTH - 1; z++) {
-                srcIndex = (z - 1)*CHUNK_WIDTH + (y - 1)*CHUNK_LAYER;
-                destIndex = z*PADDED_WIDTH + y*PADDED_LAYER + PADDED_WIDTH - 1;
+    wSize = s;
 
-                blockData[destIndex] = (right->getBlockData(srcIndex));
-                tertiaryData[destIndex] = right->getTertiaryData(srcIndex);
-            }
-        }
-    }
-    right.release();
+    // Copies a single voxel thick slab of a neighbor into the padding
+#define COPY_NEIGHBOR_SLAB(ch, minX, minY, minZ, maxX, maxY, maxZ, destOffset) \
+    { \
+        std::shared_lock<std::shared_timed_mutex> l(ch->dataMutex); \
+        ch->blocks.copyRegion(i32v3(minX, minY, minZ), i32v3(maxX, maxY, maxZ), blockData + (destOffset), PADDED_WIDTH, PADDED_LAYER); \
+        ch->tertiary.copyRegion(i32v3(minX, minY, minZ), i32v3(maxX, maxY, maxZ), tertiaryData + (destOffset), PADDED_WIDTH, PADDED_LAYER); \
+    } \
+    ch.release();
 
+    ChunkHandle& left = neighbors[NEIGHBOR_HANDLE_LEFT];
+    COPY_NEIGHBOR_SLAB(left, CHUNK_WIDTH - 1, 0, 0, CHUNK_WIDTH, CHUNK_WIDTH, CHUNK_WIDTH,
+                       PADDED_LAYER + PADDED_WIDTH);
+    ChunkHandle& right = neighbors[NEIGHBOR_HANDLE_RIGHT];
+    COPY_NEIGHBOR_SLAB(right, 0, 0, 0, 1, CHUNK_WIDTH, CHUNK_WIDTH,
+                       PADDED_LAYER + PADDED_WIDTH + PADDED_WIDTH - 1);
     ChunkHandle& bottom = neighbors[NEIGHBOR_HANDLE_BOT];
-    { // Bottom
-        std::lock_guard<std::mutex> l(bottom->dataMutex);
-        for (z = 1; z < PADDED_WIDTH - 1; z++) {
-            for (x = 1; x < PADDED_WIDTH - 1; x++) {
-                srcIndex = (z - 1)*CHUNK_WIDTH + x - 1 + CHUNK_SIZE - CHUNK_LAYER;
-                destIndex = z*PADDED_WIDTH + x;
-                //data
-                blockData[destIndex] = (bottom->getBlockData(srcIndex)); //bottom
-                tertiaryData[destIndex] = bottom->getTertiaryData(srcIndex);
-            }
-        }
-    }
-    bottom.release();
-
+    COPY_NEIGHBOR_SLAB(bottom, 0, CHUNK_WIDTH - 1, 0, CHUNK_WIDTH, CHUNK_WIDTH, CHUNK_WIDTH,
+                       PADDED_WIDTH + 1);
     ChunkHandle& top = neighbors[NEIGHBOR_HANDLE_TOP];
-    { // Top
-        std::lock_guard<std::mutex> l(top->dataMutex);
-        for (z = 1; z < PADDED_WIDTH - 1; z++) {
-            for (x = 1; x < PADDED_WIDTH - 1; x++) {
-                srcIndex = (z - 1)*CHUNK_WIDTH + x - 1;
-                destIndex = z*PADDED_WIDTH + x + PADDED_SIZE - PADDED_LAYER;
-
-                blockData[destIndex] = (top->getBlockData(srcIndex)); //top
-                tertiaryData[destIndex] = top->getTertiaryData(srcIndex);
-            }
-        }
-    }
-    top.release();
-
+    COPY_NEIGHBOR_SLAB(top, 0, 0, 0, CHUNK_WIDTH, 1, CHUNK_WIDTH,
+                       PADDED_SIZE - PADDED_LAYER + PADDED_WIDTH + 1);
     ChunkHandle& back = neighbors[NEIGHBOR_HANDLE_BACK];
-    { // Back
-        std::lock_guard<std::mutex> l(back->dataMutex);
-        for (y = 1; y < PADDED_WIDTH - 1; y++) {
-            for (x = 1; x < PADDED_WIDTH - 1; x++) {
-                srcIndex = (x - 1) + (y - 1)*CHUNK_LAYER + CHUNK_LAYER - CHUNK_WIDTH;
-                destIndex = x + y*PADDED_LAYER;
-
-                blockData[destIndex] = back->getBlockData(srcIndex);
-                tertiaryData[destIndex] = back->getTertiaryData(srcIndex);
-            }
-        }
-    }
-    back.release();
-
+    COPY_NEIGHBOR_SLAB(back, 0, 0, CHUNK_WIDTH - 1, CHUNK_WIDTH, CHUNK_WIDTH, CHUNK_WIDTH,
+                       PADDED_LAYER + 1);
     ChunkHandle& front = neighbors[NEIGHBOR_HANDLE_FRONT];
-    { // Front
-        std::lock_guard<std::mutex> l(front->dataMutex);
-        for (y = 1; y < PADDED_WIDTH - 1; y++) {
-            for (x = 1; x < PADDED_WIDTH - 1; x++) {
-                srcIndex = (x - 1) + (y - 1)*CHUNK_LAYER;
-                destIndex = x + y*PADDED_LAYER + PADDED_LAYER - PADDED_WIDTH;
+    COPY_NEIGHBOR_SLAB(front, 0, 0, 0, CHUNK_WIDTH, CHUNK_WIDTH, 1,
+                       PADDED_LAYER + PADDED_LAYER - PADDED_WIDTH + 1);
+#undef COPY_NEIGHBOR_SLAB
 
-                blockData[destIndex] = front->getBlockData(srcIndex);
-                tertiaryData[destIndex] = front->getTertiaryData(srcIndex);
-            }
-        }
-    }
-    front.release();
     // Clone edge data
     // TODO(Ben): Light gradient calc
     // X horizontal rows
@@ -543,7 +473,8 @@ void ChunkMesher::prepareDataAsync(ChunkHandle& chunk, ChunkHandle neighbors[NUM
     }
 }
 
-CALLER_DELETE ChunkMeshData* ChunkMesher::createChunkMeshData(MeshTaskType type VORB_UNUSED) {
+CALLER_DELETE ChunkMeshData* ChunkMesher::createChunkMeshData(MeshTaskType type VORB_UNUSED, OPT ChunkMeshDataPool* dataPool,
+                                                             ui8 editedSlabs, OPT CALLEE_DELETE ChunkMeshSlabs* slabs) {
     m_numQuads = 0;
     m_highestY = 0;
     m_lowestY = 256;
@@ -552,9 +483,6 @@ CALLER_DELETE ChunkMeshData* ChunkMesher::createChunkMeshData(MeshTaskType type
     m_highestZ = 0;
     m_lowestZ = 256;
 
-    // Clear quad indices
-    memset(m_quadIndices, 0xFF, sizeof(m_quadIndices));
-
     for (int i = 0; i < 6; i++) {
         m_quads[i].clear();
     }
@@ -563,10 +491,37 @@ CALLER_DELETE ChunkMeshData* ChunkMesher::createChunkMeshData(MeshTaskType type
     _waterVboVerts.clear();
 
     // Stores the data for a chunk mesh
-    // TODO(Ben): new is bad mkay
-    m_chunkMeshData = new ChunkMeshData(MeshTaskType::DEFAULT);
+    // Pooled data still has the capacity of earlier meshes
+    if (dataPool) {
+        m_chunkMeshData = dataPool->create(MeshTaskType::DEFAULT);
+    } else {
+        m_chunkMeshData = new ChunkMeshData(MeshTaskType::DEFAULT);
+    }
 
-    // Loop through blocks
+    // Edited chunks are meshed in slabs so the next edit can reuse the rest
+    // Changes all over the chunk, like flora nodes, don't start it
+    bool useSlabs = (slabs || (editedSlabs && editedSlabs != ALL_MESH_SLABS)) &&
+        vertexFormat == BlockVertexFormat::DEFAULT;
+    if (!useSlabs) {
+        delete slabs;
+        slabs = nullptr;
+    } else if (slabs && !editedSlabs) {
+        // No edit info, only the layout can be reused
+        editedSlabs = ALL_MESH_SLABS;
+    }
+
+    // Cull faces and greedy mesh the blocks
+    i32 sizes[6];
+    buildFaceMasks();
+    if (useSlabs) {
+        buildSlabQuads(editedSlabs, slabs, sizes);
+    } else {
+        for (int face = 0; face < 6; face++) {
+            greedyMeshFace(face);
+        }
+    }
+
+    // Loop through blocks for the remaining mesh types
     for (by = 0; by < CHUNK_WIDTH; by++) {
         for (bz = 0; bz < CHUNK_WIDTH; bz++) {
             for (bx = 0; bx < CHUNK_WIDTH; bx++) {
@@ -581,9 +536,6 @@ CALLER_DELETE ChunkMeshData* ChunkMesher::createChunkMeshData(MeshTaskType type
                 voxelPosOffset = ui8v3(bx * QUAD_SIZE, by * QUAD_SIZE, bz * QUAD_SIZE);
 
                 switch (block->meshType) {
-                    case MeshType::BLOCK:
-                        addBlock();
-                        break;
                     case MeshType::LEAVES:
                     case MeshType::CROSSFLORA:
                     case MeshType::TRIANGLE:
@@ -602,24 +554,26 @@ CALLER_DELETE ChunkMeshData* ChunkMesher::createChunkMeshData(MeshTaskType type
     // Get quad buffer to fill
     std::vector<VoxelQuad>& finalQuads = m_chunkMeshData->opaqueQuads;
 
-    finalQuads.resize(m_numQuads);
-    // Copy the data
-    // TODO(Ben): Could construct in place and not need ANY copying with 6 iterations?
-    i32 index = 0;
-    i32 sizes[6];
-    for (int i = 0; i < 6; i++) {
-        std::vector<VoxelQuad>& quads = m_quads[i];
-        int tmp = index;
-        for (size_t j = 0; j < quads.size(); j++) {
-            VoxelQuad& q = quads[j];
-            if (q.v.v0.mesherFlags & MESH_FLAG_ACTIVE) {
-                finalQuads[index++] = q;
+    // Slab meshes are already laid out
+    if (!useSlabs) {
+        finalQuads.resize(m_numQuads);
+        // Copy the data
+        // TODO(Ben): Could construct in place and not need ANY copying with 6 iterations?
+        i32 index = 0;
+        for (int i = 0; i < 6; i++) {
+            std::vector<VoxelQuad>& quads = m_quads[i];
+            int tmp = index;
+            for (size_t j = 0; j < quads.size(); j++) {
+                VoxelQuad& q = quads[j];
+                if (q.v.v0.mesherFlags & MESH_FLAG_ACTIVE) {
+                    finalQuads[index++] = q;
+                }
             }
+            sizes[i] = index - tmp;
         }
-        sizes[i] = index - tmp;
     }
 
-    // Swap flora quads
+    // Swap flora quads. Pooled data gives us back an empty vector with capacity.
     renderData.cutoutVboSize = m_floraQuads.size() * INDICES_PER_QUAD;
     m_chunkMeshData->cutoutQuads.swap(m_floraQuads);
 
@@ -654,11 +608,139 @@ CALLER_DELETE ChunkMeshData* ChunkMesher::createChunkMeshData(MeshTaskType type
         renderData.lowestY = m_lowestY;
         renderData.highestZ = m_highestZ;
         renderData.lowestZ = m_lowestZ;
+
+        if (vertexFormat == BlockVertexFormat::COMPACT) buildCompactQuads();
     }
 
     return m_chunkMeshData;
 }
 
+void ChunkMesher::buildSlabQuads(ui8 editedSlabs, OPT ChunkMeshSlabs* slabs, OUT i32 sizes[6]) {
+    static std::atomic<ui32> nextLayoutID(1);
+
+    // Without the previous mesh every slab is meshed into a new layout
+    bool canPatch = slabs != nullptr;
+    if (!slabs) {
+        slabs = new ChunkMeshSlabs;
+        memset(slabs->capacity, 0, sizeof(slabs->capacity));
+    }
+    ui8 meshedSlabs = canPatch ? editedSlabs : (ui8)ALL_MESH_SLABS;
+
+    for (int s = 0; s < MESH_SLAB_COUNT; s++) {
+        if (!(meshedSlabs & (1 << s))) continue;
+        m_highestX = m_highestY = m_highestZ = 0;
+        m_lowestX = m_lowestY = m_lowestZ = 256;
+        for (int face = 0; face < 6; face++) {
+            m_quads[face].clear();
+            greedyMeshFace(face, s * MESH_SLAB_HEIGHT, (s + 1) * MESH_SLAB_HEIGHT);
+
+            std::vector<VoxelQuad>& slabQuads = slabs->quads[face][s];
+            slabQuads.clear();
+            for (auto& q : m_quads[face]) {
+                if (q.v.v0.mesherFlags & MESH_FLAG_ACTIVE) slabQuads.push_back(q);
+            }
+            ui32 count = (ui32)slabQuads.size();
+            ui32& capacity = slabs->capacity[face][s];
+            if (count > capacity || !canPatch) {
+                // Leave room to grow where the player is editing
+                capacity = (editedSlabs & (1 << s)) ? count + count / 4 + MESH_SLAB_SLACK : count;
+                canPatch = false;
+            }
+        }
+        slabs->lowest[s] = i32v3(m_lowestX, m_lowestY, m_lowestZ);
+        slabs->highest[s] = i32v3(m_highestX, m_highestY, m_highestZ);
+    }
+
+    if (canPatch) {
+        m_chunkMeshData->slabPatch = meshedSlabs;
+    } else {
+        slabs->layoutID = nextLayoutID++;
+        if (slabs->layoutID == 0) slabs->layoutID = nextLayoutID++;
+        m_chunkMeshData->slabPatch = 0;
+    }
+
+    // Lay out all ranges so a mismatched vbo can still be fully replaced
+    VoxelQuad emptyQuad;
+    memset(&emptyQuad, 0, sizeof(emptyQuad)); // All corners at the origin, rasterizes nothing
+    std::vector<VoxelQuad>& finalQuads = m_chunkMeshData->opaqueQuads;
+    finalQuads.resize(slabs->getTotalCapacity(), emptyQuad); // Pooled data is empty, so this pads everything
+    size_t index = 0;
+    for (int face = 0; face < 6; face++) {
+        sizes[face] = 0;
+        for (int s = 0; s < MESH_SLAB_COUNT; s++) {
+            const std::vector<VoxelQuad>& slabQuads = slabs->quads[face][s];
+            std::copy(slabQuads.begin(), slabQuads.end(), finalQuads.begin() + index);
+            index += slabs->capacity[face][s];
+            sizes[face] += slabs->capacity[face][s];
+        }
+    }
+
+    // Bounds of every slab, not just the ones we meshed
+    m_highestX = m_highestY = m_highestZ = 0;
+    m_lowestX = m_lowestY = m_lowestZ = 256;
+    for (int s = 0; s < MESH_SLAB_COUNT; s++) {
+        m_lowestX = glm::min(m_lowestX, slabs->lowest[s].x);
+        m_lowestY = glm::min(m_lowestY, slabs->lowest[s].y);
+        m_lowestZ = glm::min(m_lowestZ, slabs->lowest[s].z);
+        m_highestX = glm::max(m_highestX, slabs->highest[s].x);
+        m_highestY = glm::max(m_highestY, slabs->highest[s].y);
+        m_highestZ = glm::max(m_highestZ, slabs->highest[s].z);
+    }
+
+    m_chunkMeshData->slabs = slabs;
+}
+
+void ChunkMesher::buildCompactQuads() {
+    std::vector<VoxelQuad>& quads = m_chunkMeshData->opaqueQuads;
+    std::vector<CompactBlockQuad>& compactQuads = m_chunkMeshData->compactOpaqueQuads;
+    std::vector<BlockMaterial>& materials = m_chunkMeshData->opaqueMaterials;
+
+    m_materialIndices.clear();
+    compactQuads.resize(quads.size());
+    BlockMaterial material;
+    BlockMaterial prevMaterial;
+    ui16 index = 0;
+    for (size_t i = 0; i < quads.size(); i++) {
+        for (int j = 0; j < 4; j++) {
+            const BlockVertex& src = quads[i].verts[j];
+            material.texturePosition = src.texturePosition;
+            material.normTexturePosition = src.normTexturePosition;
+            material.dispTexturePosition = src.dispTexturePosition;
+            material.textureDims = src.textureDims;
+            material.overlayTextureDims = src.overlayTextureDims;
+            material.color = src.color;
+            material.blendMode = src.blendMode;
+            material.overlayColor = src.overlayColor;
+            material.animationLength = src.animationLength;
+            // Neighboring vertices usually share a material, skip the lookup
+            if (materials.empty() || !(material == prevMaterial)) {
+                auto it = m_materialIndices.find(material);
+                if (it != m_materialIndices.end()) {
+                    index = it->second;
+                } else {
+                    if (materials.size() > UINT16_MAX) {
+                        // Too many materials to index, keep the default format
+                        compactQuads.clear();
+                        materials.clear();
+                        return;
+                    }
+                    index = (ui16)materials.size();
+                    materials.push_back(material);
+                    m_materialIndices[material] = index;
+                }
+                prevMaterial = material;
+            }
+            CompactBlockVertex& dst = compactQuads[i].verts[j];
+            dst.position = src.position;
+            dst.face = src.face;
+            dst.tex = src.tex;
+            dst.material = index;
+        }
+    }
+    m_chunkMeshData->vertexFormat = BlockVertexFormat::COMPACT;
+    std::vector<VoxelQuad>().swap(quads);
+}
+
 inline bool mapBufferData(GLuint& vboID, GLsizeiptr size, void* src, GLenum usage) {
     // Block Vertices
     if (vboID == 0) {
@@ -677,7 +759,66 @@ inline bool mapBufferData(GLuint& vboID, GLsizeiptr size, void* src, GLenum usag
     return true;
 }
 
-bool ChunkMesher::uploadMeshData(ChunkMesh& mesh, ChunkMeshData* meshData) {
+// Uploads the BlockMaterial table of a COMPACT mesh to a texture buffer
+inline void uploadMaterials(ChunkMesh& mesh, const std::vector<BlockMaterial>& materials) {
+    if (mesh.materialBufferID == 0) {
+        glGenBuffers(1, &(mesh.materialBufferID));
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, mesh.materialBufferID);
+    glBufferData(GL_TEXTURE_BUFFER, materials.size() * sizeof(BlockMaterial), materials.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    if (mesh.materialTextureID == 0) {
+        glGenTextures(1, &(mesh.materialTextureID));
+        glBindTexture(GL_TEXTURE_BUFFER, mesh.materialTextureID);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA8UI, mesh.materialBufferID);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+    }
+}
+
+inline void freeMaterials(ChunkMesh& mesh) {
+    if (mesh.materialTextureID != 0) {
+        glDeleteTextures(1, &(mesh.materialTextureID));
+        mesh.materialTextureID = 0;
+    }
+    if (mesh.materialBufferID != 0) {
+        glDeleteBuffers(1, &(mesh.materialBufferID));
+        mesh.materialBufferID = 0;
+    }
+}
+
+inline void freeOpaque(ChunkMesh& mesh) {
+    freeMaterials(mesh);
+    if (mesh.vboID != 0) {
+        glDeleteBuffers(1, &(mesh.vboID));
+        mesh.vboID = 0;
+    }
+    if (mesh.vaoID != 0) {
+        glDeleteVertexArrays(1, &(mesh.vaoID));
+        mesh.vaoID = 0;
+    }
+}
+
+void ChunkMesher::patchSlabs(ChunkMesh& mesh, const ChunkMeshData& meshData) {
+    const ChunkMeshSlabs& slabs = *meshData.slabs;
+    bool isBatched = mesh.arenaAllocation.numQuads != 0;
+    if (!isBatched) glBindBuffer(GL_ARRAY_BUFFER, mesh.vboID);
+    for (int face = 0; face < 6; face++) {
+        for (int s = 0; s < MESH_SLAB_COUNT; s++) {
+            ui32 capacity = slabs.capacity[face][s];
+            if (!(meshData.slabPatch & (1 << s)) || capacity == 0) continue;
+            ui32 offset = slabs.getOffset(face, s);
+            if (isBatched) {
+                ChunkRenderer::vertexArena->write(mesh.arenaAllocation, offset, &meshData.opaqueQuads[offset], capacity);
+            } else {
+                glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)offset * sizeof(VoxelQuad), (GLsizeiptr)capacity * sizeof(VoxelQuad), &meshData.opaqueQuads[offset]);
+            }
+        }
+    }
+    if (!isBatched) glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+bool ChunkMesher::uploadMeshData(ChunkMesh& mesh, ChunkMeshData* meshData, OPT ChunkMeshStagingRing* stagingRing) {
     bool canRender = false;
 
     //store the index data for sorting in the chunk mesh
@@ -686,21 +827,57 @@ bool ChunkMesher::uploadMeshData(ChunkMesh& mesh, ChunkMeshData* meshData) {
 
     switch (meshData->type) {
         case MeshTaskType::DEFAULT:
-            if (meshData->opaqueQuads.size()) {
+            // The vao has to be rebuilt when the format changes
+            if (mesh.vaoID != 0 && mesh.vertexFormat != meshData->vertexFormat) {
+                glDeleteVertexArrays(1, &(mesh.vaoID));
+                mesh.vaoID = 0;
+            }
+            mesh.vertexFormat = meshData->vertexFormat;
+            if (meshData->vertexFormat != BlockVertexFormat::DEFAULT || meshData->opaqueQuads.empty()) {
+                if (ChunkRenderer::vertexArena) ChunkRenderer::vertexArena->free(mesh.arenaAllocation);
+            }
+            if (meshData->vertexFormat == BlockVertexFormat::COMPACT && meshData->compactOpaqueQuads.size()) {
+                if (stagingRing && meshData->staging.size) {
+                    stagingRing->copyToBuffer(mesh.vboID, meshData->staging);
+                } else {
+                    mapBufferData(mesh.vboID, meshData->compactOpaqueQuads.size() * sizeof(CompactBlockQuad), &(meshData->compactOpaqueQuads[0]), GL_STATIC_DRAW);
+                }
+                uploadMaterials(mesh, meshData->opaqueMaterials);
+                canRender = true;
 
-                mapBufferData(mesh.vboID, meshData->opaqueQuads.size() * sizeof(VoxelQuad), &(meshData->opaqueQuads[0]), GL_STATIC_DRAW);
+                if (!mesh.vaoID) buildCompactVao(mesh);
+            } else if (meshData->vertexFormat == BlockVertexFormat::COMPACT) {
+                // Nothing to draw
+                freeOpaque(mesh);
+            } else if (meshData->slabPatch && mesh.slabLayoutID == meshData->slabs->layoutID) {
+                // The vbo has the same layout, only write the slabs that were meshed again
+                patchSlabs(mesh, *meshData);
+                canRender = meshData->opaqueQuads.size() != 0;
+            } else if (meshData->opaqueQuads.size()) {
+                freeMaterials(mesh);
                 canRender = true;
 
-                if (!mesh.vaoID) buildVao(mesh);
-            } else {
-                if (mesh.vboID != 0) {
-                    glDeleteBuffers(1, &(mesh.vboID));
-                    mesh.vboID = 0;
-                }
-                if (mesh.vaoID != 0) {
-                    glDeleteVertexArrays(1, &(mesh.vaoID));
-                    mesh.vaoID = 0;
+                // Batched meshes live in the shared arena instead of their own buffer
+                if (ChunkRenderer::vertexArena &&
+                    ChunkRenderer::vertexArena->upload(mesh.arenaAllocation, &(meshData->opaqueQuads[0]), (ui32)meshData->opaqueQuads.size())) {
+                    if (mesh.vboID != 0) {
+                        glDeleteBuffers(1, &(mesh.vboID));
+                        mesh.vboID = 0;
+                    }
+                    if (mesh.vaoID != 0) {
+                        glDeleteVertexArrays(1, &(mesh.vaoID));
+                        mesh.vaoID = 0;
+                    }
+                } else {
+                    if (stagingRing && meshData->staging.size) {
+                        stagingRing->copyToBuffer(mesh.vboID, meshData->staging);
+                    } else {
+                        mapBufferData(mesh.vboID, meshData->opaqueQuads.size() * sizeof(VoxelQuad), &(meshData->opaqueQuads[0]), GL_STATIC_DRAW);
+                    }
+                    if (!mesh.vaoID) buildVao(mesh);
                 }
+            } else {
+                freeOpaque(mesh);
             }
 
             if (meshData->transQuads.size()) {
@@ -744,6 +921,7 @@ bool ChunkMesher::uploadMeshData(ChunkMesh& mesh, ChunkMeshData* meshData) {
                     mesh.cutoutVboID = 0;
                 }
             }
+            mesh.slabLayoutID = meshData->slabs ? meshData->slabs->layoutID : 0;
             mesh.renderData = meshData->chunkMeshRenderData;
             //The missing break is deliberate!
             VORB_FALLTHROUGH;
@@ -777,6 +955,8 @@ void ChunkMesher::freeChunkMesh(CALLEE_DELETE ChunkMesh* mesh) {
     if (mesh->vaoID != 0) {
         glDeleteVertexArrays(1, &mesh->vaoID);
     }
+    if (ChunkRenderer::vertexArena) ChunkRenderer::vertexArena->free(mesh->arenaAllocation);
+    freeMaterials(*mesh);
     // Transparent
     if (mesh->transVaoID != 0) {
         glDeleteVertexArrays(1, &mesh->transVaoID);
@@ -855,44 +1035,184 @@ void ChunkMesher::freeBuffers() {
 
 #define CompareVerticesLight(v1, v2) (v1.sunlight == v2.sunlight && !memcmp(&v1.lampColor, &v2.lampColor, 3) && !memcmp(&v1.color, &v2.color, 3))
 
-void ChunkMesher::addBlock()
-{
+void ChunkMesher::buildFaceMasks() {
+    memset(m_faceMasks, 0, sizeof(m_faceMasks));
+
+    // Build occlusion rows for the whole padded data
+    for (int y = 0; y < PADDED_CHUNK_WIDTH; y++) {
+        for (int z = 0; z < PADDED_CHUNK_WIDTH; z++) {
+            const ui16* row = &blockData[y * PADDED_CHUNK_LAYER + z * PADDED_CHUNK_WIDTH];
+            ui64 occludeRow = 0;
+            ui64 selfOccludeRow = 0;
+            ui32 blockRow = 0;
+            for (int x = 0; x < PADDED_CHUNK_WIDTH; x++) {
+                const Block& b = blocks->operator[](row[x]);
+                if (b.occlude == BlockOcclusion::ALL) {
+                    occludeRow |= 1ull << x;
+                } else if (b.occlude == BlockOcclusion::SELF) {
+                    selfOccludeRow |= 1ull << x;
+                }
+                if (b.meshType == MeshType::BLOCK && x > 0 && x < PADDED_WIDTH_M1) {
+                    blockRow |= 1u << (x - 1);
+                }
+            }
+            m_occludeRows[y][z] = occludeRow;
+            m_selfOccludeRows[y][z] = selfOccludeRow;
+            if (y > 0 && y < PADDED_WIDTH_M1 && z > 0 && z < PADDED_WIDTH_M1) {
+                m_blockRows[y - 1][z - 1] = blockRow;
+            }
+        }
+    }
+
+    // Cull faces a row at a time
+    for (int y = 0; y < CHUNK_WIDTH; y++) {
+        for (int z = 0; z < CHUNK_WIDTH; z++) {
+            ui32 blockRow = m_blockRows[y][z];
+            if (blockRow == 0) continue;
+            for (int face = 0; face < 6; face++) {
+                const FaceMeshInfo& info = m_faceInfo[face];
+                // Neighbor row, shifted so bit x is the neighbor of x
+                int ny = y + 1 + info.normal.y;
+                int nz = z + 1 + info.normal.z;
+                int shift = 1 + info.normal.x;
+                ui32 visible = blockRow & ~(ui32)(m_occludeRows[ny][nz] >> shift);
+                // Self occluding neighbors only occlude the same block
+                ui32 selfOcclude = visible & (ui32)(m_selfOccludeRows[ny][nz] >> shift);
+                while (selfOcclude) {
+                    int x = lowestBit(selfOcclude);
+                    selfOcclude &= selfOcclude - 1;
+                    int index = (y + 1) * PADDED_CHUNK_LAYER + (z + 1) * PADDED_CHUNK_WIDTH + (x + 1);
+                    if (blockData[index] == blockData[index + info.offset]) visible &= ~(1u << x);
+                }
+                if (visible == 0) continue;
+                if (info.rightAxis == (int)vvox::Axis::X) {
+                    // Rows already run along the right axis
+                    i32v3 pos(0, y, z);
+                    m_faceMasks[face][pos[info.sliceAxis]][pos[info.frontAxis]] |= visible;
+                } else {
+                    // X faces run along z, scatter the bits
+                    while (visible) {
+                        int x = lowestBit(visible);
+                        visible &= visible - 1;
+                        m_faceMasks[face][x][y] |= 1u << z;
+                    }
+                }
+            }
+        }
+    }
+}
+
+void ChunkMesher::greedyMeshFace(int face, int yBegin, int yEnd) {
+    const FaceMeshInfo& info = m_faceInfo[face];
+    std::vector<VoxelQuad>& quads = m_quads[face];
     // Ambient occlusion buffer for vertices
     f32 ao[4];
 
-    // Check the faces
-    // Left
-    if (shouldRenderFace(-1)) {
-        computeAmbientOcclusion(-1, -PADDED_CHUNK_LAYER, PADDED_CHUNK_WIDTH, ao);
-        addQuad(X_NEG, (int)vvox::Axis::Z, (int)vvox::Axis::Y, -PADDED_CHUNK_WIDTH, -PADDED_CHUNK_LAYER, 2, ui8v2(1, 1), ao);
-    }
-    // Right
-    if (shouldRenderFace(1)) {
-        computeAmbientOcclusion(1, -PADDED_CHUNK_LAYER, -PADDED_CHUNK_WIDTH, ao);
-        addQuad(X_POS, (int)vvox::Axis::Z, (int)vvox::Axis::Y, -PADDED_CHUNK_WIDTH, -PADDED_CHUNK_LAYER, 0, ui8v2(-1, 1), ao);
-    }
-    // Bottom
-    if (shouldRenderFace(-PADDED_CHUNK_LAYER)) { 
-        computeAmbientOcclusion(-PADDED_CHUNK_LAYER, PADDED_CHUNK_WIDTH, 1, ao);
-        addQuad(Y_NEG, (int)vvox::Axis::X, (int)vvox::Axis::Z, -1, -PADDED_CHUNK_WIDTH, 2, ui8v2(1, 1), ao);
-    }
-    // Top
-    if (shouldRenderFace(PADDED_CHUNK_LAYER)) {
-        computeAmbientOcclusion(PADDED_CHUNK_LAYER, -PADDED_CHUNK_WIDTH, -1, ao);
-        addQuad(Y_POS, (int)vvox::Axis::X, (int)vvox::Axis::Z, -1, -PADDED_CHUNK_WIDTH, 0, ui8v2(-1, 1), ao);
-    }
-    // Back
-    if (shouldRenderFace(-PADDED_CHUNK_WIDTH)) {
-        computeAmbientOcclusion(-PADDED_CHUNK_WIDTH, -PADDED_CHUNK_LAYER, -1, ao);
-        addQuad(Z_NEG, (int)vvox::Axis::X, (int)vvox::Axis::Y, -1, -PADDED_CHUNK_LAYER, 0, ui8v2(-1, 1), ao);
-    }
-    // Front
-    if (shouldRenderFace(PADDED_CHUNK_WIDTH)) {
-        computeAmbientOcclusion(PADDED_CHUNK_WIDTH, -PADDED_CHUNK_LAYER, 1, ao);
-        addQuad(Z_POS, (int)vvox::Axis::X, (int)vvox::Axis::Y, -1, -PADDED_CHUNK_LAYER, 2, ui8v2(1, 1), ao);
+    // Y faces are sliced along y, the others merge along it
+    bool isYFace = info.sliceAxis == (int)vvox::Axis::Y;
+    int sBegin = isYFace ? yBegin : 0;
+    int sEnd = isYFace ? yEnd : CHUNK_WIDTH;
+    int fBegin = isYFace ? 0 : yBegin;
+    int fEnd = isYFace ? CHUNK_WIDTH : yEnd;
+
+    for (int s = sBegin; s < sEnd; s++) {
+        ui32 rows[CHUNK_WIDTH];
+        memcpy(rows, m_faceMasks[face][s], sizeof(rows));
+
+        // Build the unmerged quads of the slice
+        for (int f = fBegin; f < fEnd; f++) {
+            ui32 bits = rows[f];
+            while (bits) {
+                int r = lowestBit(bits);
+                bits &= bits - 1;
+                i32v3 pos;
+                pos[info.sliceAxis] = s;
+                pos[info.frontAxis] = f;
+                pos[info.rightAxis] = r;
+                bx = pos.x;
+                by = pos.y;
+                bz = pos.z;
+                blockIndex = (by + 1) * PADDED_CHUNK_LAYER + (bz + 1) * PADDED_CHUNK_WIDTH + (bx + 1);
+                blockID = blockData[blockIndex];
+                heightData = &m_chunkHeightData[bz * CHUNK_WIDTH + bx];
+                block = &blocks->operator[](blockID);
+                voxelPosOffset = ui8v3(bx * QUAD_SIZE, by * QUAD_SIZE, bz * QUAD_SIZE);
+                computeAmbientOcclusion(info.offset, info.aoFrontOffset, info.aoRightOffset, ao);
+                computeQuad(face, ao, m_sliceQuads[f * CHUNK_WIDTH + r]);
+            }
+        }
+
+        // Merge them into maximal rectangles, first to the right then to the front
+        for (int f = fBegin; f < fEnd; f++) {
+            while (rows[f]) {
+                int r = lowestBit(rows[f]);
+                const VoxelQuad& base = m_sliceQuads[f * CHUNK_WIDTH + r];
+                int w = 1;
+                while (r + w < CHUNK_WIDTH && (rows[f] & (1u << (r + w))) &&
+                       canMergeQuads(base, m_sliceQuads[f * CHUNK_WIDTH + r + w])) {
+                    w++;
+                }
+                ui32 runMask = ((w == 32) ? 0xFFFFFFFFu : ((1u << w) - 1)) << r;
+                int h = 1;
+                while (f + h < fEnd && (rows[f + h] & runMask) == runMask) {
+                    const VoxelQuad* row = &m_sliceQuads[(f + h) * CHUNK_WIDTH + r];
+                    int i = 0;
+                    while (i < w && canMergeQuads(base, row[i])) i++;
+                    if (i != w) break;
+                    h++;
+                }
+                for (int i = 0; i < h; i++) {
+                    rows[f + i] &= ~runMask;
+                }
+
+                // Stretch a copy of the first quad over the rectangle
+                quads.push_back(base);
+                m_numQuads++;
+                VoxelQuad& quad = quads.back();
+                if (w > 1) {
+                    ui8 stretch = (ui8)((w - 1) * QUAD_SIZE);
+                    ui8 texStretch = (ui8)((w - 1) * info.texOffset.x);
+                    quad.verts[info.rightStretchIndex].position[info.rightAxis] += stretch;
+                    quad.verts[info.rightStretchIndex].tex.x += texStretch;
+                    quad.verts[info.rightStretchIndex + 1].position[info.rightAxis] += stretch;
+                    quad.verts[info.rightStretchIndex + 1].tex.x += texStretch;
+                }
+                if (h > 1) {
+                    ui8 stretch = (ui8)((h - 1) * QUAD_SIZE);
+                    ui8 texStretch = (ui8)((h - 1) * info.texOffset.y);
+                    quad.v.v0.position[info.frontAxis] += stretch;
+                    quad.v.v0.tex.y += texStretch;
+                    quad.v.v3.position[info.frontAxis] += stretch;
+                    quad.v.v3.tex.y += texStretch;
+                }
+
+                // Check against lowest and highest for culling in render
+                // TODO(Ben): Think about this more
+                i32v3 corners[2];
+                corners[0] = i32v3(base.v.v0.position);
+                corners[1] = corners[0];
+                corners[1][info.rightAxis] += (w - 1) * QUAD_SIZE;
+                corners[1][info.frontAxis] += (h - 1) * QUAD_SIZE;
+                for (int i = 0; i < 2; i++) {
+                    if (corners[i].x < m_lowestX) m_lowestX = corners[i].x;
+                    if (corners[i].x > m_highestX) m_highestX = corners[i].x;
+                    if (corners[i].y < m_lowestY) m_lowestY = corners[i].y;
+                    if (corners[i].y > m_highestY) m_highestY = corners[i].y;
+                    if (corners[i].z < m_lowestZ) m_lowestZ = corners[i].z;
+                    if (corners[i].z > m_highestZ) m_highestZ = corners[i].z;
+                }
+            }
+        }
     }
 }
 
+bool ChunkMesher::canMergeQuads(const VoxelQuad& quad, const VoxelQuad& other) const {
+    // Only uniform quads can be stretched
+    return (other.v.v0 == quad.v.v0 &&
+            other.v.v0 == other.v.v1 && other.v.v0 == other.v.v2 && other.v.v0 == other.v.v3 &&
+            quad.v.v0 == quad.v.v1 && quad.v.v0 == quad.v.v2 && quad.v.v0 == quad.v.v3);
+}
+
 void ChunkMesher::computeAmbientOcclusion(int upOffset VORB_UNUSED, int frontOffset VORB_UNUSED, int rightOffset VORB_UNUSED, f32 ambientOcclusion VORB_UNUSED[]) {
 #ifdef USE_AO
     // Ambient occlusion factor
@@ -926,7 +1246,7 @@ void ChunkMesher::computeAmbientOcclusion(int upOffset VORB_UNUSED, int frontOff
 #endif
 }
 
-void ChunkMesher::addQuad(int face, int rightAxis, int frontAxis, int leftOffset, int backOffset, int rightStretchIndex, const ui8v2& texOffset, f32 ambientOcclusion VORB_UNUSED[]) {
+void ChunkMesher::computeQuad(int face, f32 ambientOcclusion VORB_UNUSED[], OUT VoxelQuad& quad) {
     // Get texture TODO(Ben): Null check?
     const BlockTexture* texture = block->textures[face];
 
@@ -940,8 +1260,6 @@ void ChunkMesher::addQuad(int face, int rightAxis, int frontAxis, int leftOffset
                                 heightData->temperature,
                                 heightData->humidity, 0);
 
-    std::vector<VoxelQuad>& quads = m_quads[face];
-
     // Get texturing parameters
     ui8 blendMode = getBlendMode(texture->blendMode);
     // TODO(Ben): Make this better
@@ -964,14 +1282,8 @@ void ChunkMesher::addQuad(int face, int rightAxis, int frontAxis, int leftOffset
     ui8 vOffset = (ui8)(pos[FACE_AXIS[face][1]] * FACE_AXIS_SIGN[face][1]);
 
     // Construct the quad
-    // i16 quadIndex = quads.size();
-    quads.emplace_back();
-    m_numQuads++;
-    VoxelQuad* quad = &quads.back();
-    quad->v.v0.mesherFlags = MESH_FLAG_ACTIVE;
-
     for (int i = 0; i < 4; i++) {
-        BlockVertex& v = quad->verts[i];
+        BlockVertex& v = quad.verts[i];
         v.position = VoxelMesher::VOXEL_POSITIONS[face][i] + voxelPosOffset;
 #ifdef USE_AO
         f32& ao = ambientOcclusion[i];
@@ -1002,28 +1314,19 @@ void ChunkMesher::addQuad(int face, int rightAxis, int frontAxis, int leftOffset
         v.textureDims = methodDatas[0].size;
         v.overlayTextureDims = methodDatas[3].size;
         v.blendMode = blendMode;
+        v.animationLength = 0;
         v.face = (ui8)face;
     }
+    quad.v.v0.mesherFlags = MESH_FLAG_ACTIVE;
     // Set texture coordinates
-    quad->verts[0].tex.x = (ui8)(UV_0 + uOffset);
-    quad->verts[0].tex.y = (ui8)(UV_1 + vOffset);
-    quad->verts[1].tex.x = (ui8)(UV_0 + uOffset);
-    quad->verts[1].tex.y = (ui8)(UV_0 + vOffset);
-    quad->verts[2].tex.x = (ui8)(UV_1 + uOffset);
-    quad->verts[2].tex.y = (ui8)(UV_0 + vOffset);
-    quad->verts[3].tex.x = (ui8)(UV_1 + uOffset);
-    quad->verts[3].tex.y = (ui8)(UV_1 + vOffset);
-
-    // Check against lowest and highest for culling in render
-    // TODO(Ben): Think about this more
-    if (quad->v.v0.position.x < m_lowestX) m_lowestX = quad->v.v0.position.x;
-    if (quad->v.v0.position.x > m_highestX) m_highestX = quad->v.v0.position.x;
-    if (quad->v.v0.position.y < m_lowestY) m_lowestY = quad->v.v0.position.y;
-    if (quad->v.v0.position.y > m_highestY) m_highestY = quad->v.v0.position.y;
-    if (quad->v.v0.position.z < m_lowestZ) m_lowestZ = quad->v.v0.position.z;
-    if (quad->v.v0.position.z > m_highestZ) m_highestZ = quad->v.v0.position.z;
-
-    m_numQuads -= tryMergeQuad(quad, quads, face, rightAxis, frontAxis, leftOffset, backOffset, rightStretchIndex, texOffset);
+    quad.verts[0].tex.x = (ui8)(UV_0 + uOffset);
+    quad.verts[0].tex.y = (ui8)(UV_1 + vOffset);
+    quad.verts[1].tex.x = (ui8)(UV_0 + uOffset);
+    quad.verts[1].tex.y = (ui8)(UV_0 + vOffset);
+    quad.verts[2].tex.x = (ui8)(UV_1 + uOffset);
+    quad.verts[2].tex.y = (ui8)(UV_0 + vOffset);
+    quad.verts[3].tex.x = (ui8)(UV_1 + uOffset);
+    quad.verts[3].tex.y = (ui8)(UV_1 + vOffset);
 }
 
 struct FloraQuadData {
@@ -1143,64 +1446,6 @@ void ChunkMesher::addFloraQuad(const ui8v3* positions, FloraQuadData& data) {
 }
 
 
-int ChunkMesher::tryMergeQuad(VoxelQuad* quad, std::vector<VoxelQuad>& quads, int face, int rightAxis, int frontAxis, int leftOffset, int backOffset, int rightStretchIndex, const ui8v2& texOffset) {
-    int rv = 0;
-    i16 quadIndex = quads.size() - 1;
-    if (quad->v.v0 == quad->v.v3 && quad->v.v1 == quad->v.v2) {
-        quad->v.v0.mesherFlags |= MESH_FLAG_MERGE_RIGHT;
-        ui16 leftIndex = m_quadIndices[blockIndex + leftOffset][face];
-        // Check left merge
-        if (leftIndex != NO_QUAD_INDEX) {
-            VoxelQuad& lQuad = quads[leftIndex];
-            if (((lQuad.v.v0.mesherFlags & MESH_FLAG_MERGE_RIGHT) != 0) &&
-                lQuad.v.v0.position[frontAxis] == quad->v.v0.position[frontAxis] &&
-                lQuad.v.v1.position[frontAxis] == quad->v.v1.position[frontAxis] &&
-                lQuad.v.v0 == quad->v.v0 && lQuad.v.v1 == quad->v.v1) {
-                // Stretch the previous quad
-                lQuad.verts[rightStretchIndex].position[rightAxis] += QUAD_SIZE;
-                lQuad.verts[rightStretchIndex].tex.x += texOffset.x;
-                lQuad.verts[rightStretchIndex + 1].position[rightAxis] += QUAD_SIZE;
-                lQuad.verts[rightStretchIndex + 1].tex.x += texOffset.x;
-                // Remove the current quad
-                quads.pop_back();
-                ++rv;
-                quadIndex = leftIndex;
-                quad = &lQuad;
-            }
-        }
-    }
-    // Check back merge
-    if (quad->v.v0 == quad->v.v1 && quad->v.v2 == quad->v.v3) {
-        quad->v.v0.mesherFlags |= MESH_FLAG_MERGE_FRONT;
-        int backIndex = m_quadIndices[blockIndex + backOffset][face];
-        if (backIndex != NO_QUAD_INDEX) {
-            VoxelQuad* bQuad = &quads[backIndex];
-            while (!(bQuad->v.v0.mesherFlags & MESH_FLAG_ACTIVE)) {
-                backIndex = bQuad->v.replaceQuad;
-                bQuad = &quads[backIndex];
-            }
-            if (((bQuad->v.v0.mesherFlags & MESH_FLAG_MERGE_FRONT) != 0) &&
-                bQuad->v.v0.position[rightAxis] == quad->v.v0.position[rightAxis] &&
-                bQuad->v.v2.position[rightAxis] == quad->v.v2.position[rightAxis] &&
-                bQuad->v.v0 == quad->v.v0 && bQuad->v.v1 == quad->v.v1) {
-                bQuad->v.v0.position[frontAxis] += QUAD_SIZE;
-                bQuad->v.v0.tex.y += texOffset.y;
-                bQuad->v.v3.position[frontAxis] += QUAD_SIZE;
-                bQuad->v.v3.tex.y += texOffset.y;
-                quadIndex = backIndex;
-                // Mark as not in use
-                quad->v.v0.mesherFlags = 0;
-                quad->v.replaceQuad = backIndex;
-                ++rv;
-            }
-        }
-    }
-    // Mark quadIndices so we can merge this quad later
-    m_quadIndices[blockIndex][face] = quadIndex;
-    // Return number of merges
-    return rv;
-}
-
 //Gets the liquid level from a block index
 #define LEVEL(i) ((_blockIDData[i] == 0) ? 0 : (((nextBlock = &GETBLOCK(_blockIDData[i]))->caIndex == block.caIndex) ? nextBlock->waterMeshLevel : 0))
 
@@ -1508,13 +1753,6 @@ int ChunkMesher::getLiquidLevel(int blockIndex, const Block& block) {
     return val;
 }
 
-bool ChunkMesher::shouldRenderFace(int offset) {
-    const Block& neighbor = blocks->operator[](blockData[blockIndex + offset]);
-    if (neighbor.occlude == BlockOcclusion::ALL) return false;
-    if ((neighbor.occlude == BlockOcclusion::SELF) && (blockID == neighbor.ID)) return false;
-    return true;
-}
-
 int ChunkMesher::getOcclusion(const Block& block) {
     if (block.occlude == BlockOcclusion::ALL) return 1;
     if ((block.occlude == BlockOcclusion::SELF) && (blockID == block.ID)) return 1;
@@ -1610,6 +1848,12 @@ void ChunkMesher::buildVao(ChunkMesh& cm) {
     glBindBuffer(GL_ARRAY_BUFFER, cm.vboID);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ChunkRenderer::sharedIBO);
 
+    setBlockVertexAttributes();
+
+    glBindVertexArray(0);
+}
+
+void ChunkMesher::setBlockVertexAttributes() {
     for (int i = 0; i < 8; i++) {
         glEnableVertexAttribArray(i);
     }
@@ -1630,6 +1874,24 @@ void ChunkMesher::buildVao(ChunkMesh& cm) {
     glVertexAttribPointer(6, 3, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(BlockVertex), offsetptr(BlockVertex, color));
     // vOverlayColor
     glVertexAttribPointer(7, 3, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(BlockVertex), offsetptr(BlockVertex, overlayColor));
+}
+
+void ChunkMesher::buildCompactVao(ChunkMesh& cm) {
+    glGenVertexArrays(1, &(cm.vaoID));
+    glBindVertexArray(cm.vaoID);
+    glBindBuffer(GL_ARRAY_BUFFER, cm.vboID);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ChunkRenderer::sharedIBO);
+
+    for (int i = 0; i < 3; i++) {
+        glEnableVertexAttribArray(i);
+    }
+
+    // vPosition_Face
+    glVertexAttribPointer(0, 4, GL_UNSIGNED_BYTE, GL_FALSE, sizeof(CompactBlockVertex), offsetptr(CompactBlockVertex, position));
+    // vTex
+    glVertexAttribPointer(1, 2, GL_UNSIGNED_BYTE, GL_FALSE, sizeof(CompactBlockVertex), offsetptr(CompactBlockVertex, tex));
+    // vMaterial, index into the unMaterials texture buffer
+    glVertexAttribIPointer(2, 1, GL_UNSIGNED_SHORT, sizeof(CompactBlockVertex), offsetptr(CompactBlockVertex, material));
 
     glBindVertexArray(0);
 }
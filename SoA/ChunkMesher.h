@@ -8,6 +8,9 @@
 class BlockPack;
 class BlockTextureLayer;
 class ChunkMeshData;
+class ChunkMeshDataPool;
+class ChunkMeshSlabs;
+class ChunkMeshStagingRing;
 struct BlockTexture;
 struct PlanetHeightData;
 struct FloraQuadData;
@@ -48,14 +51,23 @@ class ChunkMesher {
 
     // TODO(Ben): Unique ptr?
     // Must call prepareData or prepareDataAsync first
-    CALLER_DELETE ChunkMeshData* createChunkMeshData(MeshTaskType type);
+    // If dataPool is set the data comes from it and must be recycled there instead of deleted
+    // Opaque quads are meshed in slabs when only some editedSlabs are set, or when slabs is set.
+    // slabs is the previous mesh of the chunk, only its editedSlabs are meshed again and it
+    // moves to the result.
+    CALLER_DELETE ChunkMeshData* createChunkMeshData(MeshTaskType type, OPT ChunkMeshDataPool* dataPool = nullptr,
+                                                     ui8 editedSlabs = 0, OPT CALLEE_DELETE ChunkMeshSlabs* slabs = nullptr);
 
     // Returns true if the mesh is renderable
-    static bool uploadMeshData(ChunkMesh& mesh, ChunkMeshData* meshData);
+    // Opaque data in meshData->staging is copied from stagingRing instead of uploaded
+    static bool uploadMeshData(ChunkMesh& mesh, ChunkMeshData* meshData, OPT ChunkMeshStagingRing* stagingRing = nullptr);
 
     // Frees buffers AND deletes memory. mesh Pointer is invalid after calling.
     static void freeChunkMesh(CALLEE_DELETE ChunkMesh* mesh);
 
+    // Sets up BlockVertex attributes for the bound VAO and GL_ARRAY_BUFFER
+    static void setBlockVertexAttributes();
+
     void freeBuffers();
 
     int bx, by, bz; // Block iterators
@@ -74,32 +86,69 @@ class ChunkMesher {
     const BlockPack* blocks;
 
     VoxelPosition3D chunkVoxelPos;
+
+    // Layout of the opaque quads created by createChunkMeshData
+    BlockVertexFormat vertexFormat = BlockVertexFormat::DEFAULT;
 private:
-    void addBlock();
-    void addQuad(int face, int rightAxis, int frontAxis, int leftOffset, int backOffset, int rightStretchIndex, const ui8v2& texOffset, f32 ambientOcclusion[]);
+    // Per face parameters for greedy meshing
+    struct FaceMeshInfo {
+        void init(const i32v3& normal, int rightAxis, int frontAxis, int rightStretchIndex, const ui8v2& texOffset, int aoFrontOffset, int aoRightOffset);
+
+        i32v3 normal;
+        int offset; ///< Padded index offset to the neighbor we face
+        int sliceAxis;
+        int rightAxis;
+        int frontAxis;
+        int rightStretchIndex; ///< First of the two verts moved when stretching right
+        ui8v2 texOffset;
+        int aoFrontOffset;
+        int aoRightOffset;
+    };
+
+    void buildFaceMasks();
+    // Only meshes voxels in rows [yBegin, yEnd)
+    void greedyMeshFace(int face, int yBegin = 0, int yEnd = CHUNK_WIDTH);
+    void buildSlabQuads(ui8 editedSlabs, OPT ChunkMeshSlabs* slabs, OUT i32 sizes[6]);
+    void computeQuad(int face, f32 ambientOcclusion[], OUT VoxelQuad& quad);
+    bool canMergeQuads(const VoxelQuad& quad, const VoxelQuad& other) const;
     void computeAmbientOcclusion(int upOffset, int frontOffset, int rightOffset, f32 ambientOcclusion[]);
     void addFlora();
     void addFloraQuad(const ui8v3* positions, FloraQuadData& data);
-    int tryMergeQuad(VoxelQuad* quad, std::vector<VoxelQuad>& quads, int face, int rightAxis, int frontAxis, int leftOffset, int backOffset, int rightStretchIndex, const ui8v2& texOffset);
     void addLiquid();
+    void buildCompactQuads();
 
     int getLiquidLevel(int blockIndex, const Block& block);
 
-    bool shouldRenderFace(int offset);
     int getOcclusion(const Block& block);
 
     ui8 getBlendMode(const BlendType& blendType);
 
+    // Writes the ranges of meshData.slabPatch into the vbo of mesh
+    static void patchSlabs(ChunkMesh& mesh, const ChunkMeshData& meshData);
+
     static void buildTransparentVao(ChunkMesh& cm);
     static void buildCutoutVao(ChunkMesh& cm);
     static void buildVao(ChunkMesh& cm);
+    static void buildCompactVao(ChunkMesh& cm);
     static void buildWaterVao(ChunkMesh& cm);
 
-    ui16 m_quadIndices[PADDED_CHUNK_SIZE][6];
+    FaceMeshInfo m_faceInfo[6];
+    // Visible faces of each slice along the face normal, one row per front axis
+    // coordinate with a bit per right axis coordinate.
+    ui32 m_faceMasks[6][CHUNK_WIDTH][CHUNK_WIDTH];
+    // Rows along x of the padded data, bit x is set if that voxel occludes
+    ui64 m_occludeRows[PADDED_CHUNK_WIDTH][PADDED_CHUNK_WIDTH];
+    ui64 m_selfOccludeRows[PADDED_CHUNK_WIDTH][PADDED_CHUNK_WIDTH];
+    // Rows along x of the unpadded data, bit x is set for MeshType::BLOCK
+    ui32 m_blockRows[CHUNK_WIDTH][CHUNK_WIDTH];
+    // Unmerged quads of the slice being meshed
+    VoxelQuad m_sliceQuads[CHUNK_LAYER];
     ui16 m_wvec[CHUNK_SIZE];
 
     std::vector<BlockVertex> m_finalVerts[6];
 
+    std::unordered_map<BlockMaterial, ui16, BlockMaterial::Hash> m_materialIndices;
+
     std::vector<VoxelQuad> m_floraQuads;
     std::vector<VoxelQuad> m_quads[6];
     ui32 m_numQuads;
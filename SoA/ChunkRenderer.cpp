@@ -13,10 +13,13 @@
 #include "SoaOptions.h"
 #include "soaUtils.h"
 
+#include <Vorb/graphics/ShaderManager.h>
+
 volatile f32 ChunkRenderer::fadeDist = 1.0f;
 f32m4 ChunkRenderer::worldMatrix = f32m4(1.0f);
 
 VGIndexBuffer ChunkRenderer::sharedIBO = 0;
+ChunkVertexArena* ChunkRenderer::vertexArena = nullptr;
 
 void ChunkRenderer::init() {
     // Not thread safe
@@ -48,6 +51,41 @@ void ChunkRenderer::init() {
         m_opaqueProgram.use();
         glUniform1i(m_opaqueProgram.getUniform("unTextures"), 0);
     }
+    if (soaOptions.get(OPT_COMPACT_BLOCK_VERTICES).value.b) { // Compact opaque
+        m_compactOpaqueProgram = vg::ShaderManager::createProgramFromFile("Shaders/BlockShading/compactShading.vert",
+                                                                          "Shaders/BlockShading/standardShading.frag",
+                                                                          nullptr, nullptr);
+        if (m_compactOpaqueProgram.isLinked()) {
+            m_compactOpaqueProgram.use();
+            glUniform1i(m_compactOpaqueProgram.getUniform("unTextures"), 0);
+            glUniform1i(m_compactOpaqueProgram.getUniform("unMaterials"), 1);
+        } else {
+            if (m_compactOpaqueProgram.isCreated()) m_compactOpaqueProgram.dispose();
+            // Meshers read the option when they start, so chunks get DEFAULT vertices
+            soaOptions.get(OPT_COMPACT_BLOCK_VERTICES).value.b = false;
+            printf("Compact block shader failed, using the default block vertices\n");
+        }
+    }
+    // Needs baseInstance for the per draw offsets
+    if (soaOptions.get(OPT_BATCHED_CHUNK_RENDERING).value.b && GLEW_ARB_multi_draw_indirect && GLEW_ARB_base_instance) {
+        // Optional, so a missing shader falls back to drawOpaque instead of asking to recompile
+        m_batchedOpaqueProgram = vg::ShaderManager::createProgramFromFile("Shaders/BlockShading/batchedShading.vert",
+                                                                          "Shaders/BlockShading/standardShading.frag",
+                                                                          nullptr, nullptr);
+        if (m_batchedOpaqueProgram.isLinked()) {
+            m_batchedOpaqueProgram.use();
+            glUniform1i(m_batchedOpaqueProgram.getUniform("unTextures"), 0);
+            glGenBuffers(1, &m_indirectBuffer);
+            // Not thread safe
+            if (!vertexArena) {
+                vertexArena = new ChunkVertexArena;
+                vertexArena->init();
+            }
+        } else {
+            if (m_batchedOpaqueProgram.isCreated()) m_batchedOpaqueProgram.dispose();
+            printf("Batched chunk shader failed, drawing chunks one at a time\n");
+        }
+    }
     // TODO(Ben): Fix the shaders
     { // Transparent
    //     m_transparentProgram = ShaderLoader::createProgramFromFile("Shaders/BlockShading/standardShading.vert",
@@ -68,6 +106,17 @@ void ChunkRenderer::init() {
 
 void ChunkRenderer::dispose() {
     if (m_opaqueProgram.isCreated()) m_opaqueProgram.dispose();
+    if (m_compactOpaqueProgram.isCreated()) m_compactOpaqueProgram.dispose();
+    if (m_batchedOpaqueProgram.isCreated()) m_batchedOpaqueProgram.dispose();
+    if (m_indirectBuffer) {
+        glDeleteBuffers(1, &m_indirectBuffer);
+        m_indirectBuffer = 0;
+    }
+    if (vertexArena) {
+        vertexArena->dispose();
+        delete vertexArena;
+        vertexArena = nullptr;
+    }
     if (m_transparentProgram.isCreated()) m_transparentProgram.dispose();
     if (m_cutoutProgram.isCreated()) m_cutoutProgram.dispose();
     if (m_waterProgram.isCreated()) m_waterProgram.dispose();
@@ -76,32 +125,59 @@ void ChunkRenderer::dispose() {
 // TODO: blockAmbient variables were going unused, what are they for?
 
 void ChunkRenderer::beginOpaque(VGTexture textureAtlas, const f32v3& sunDir, const f32v3& lightColor VORB_MAYBE_UNUSED /*= f32v3(1.0f)*/, const f32v3& ambient /*= f32v3(0.0f)*/) {
-    m_opaqueProgram.use();
-    glUniform3fv(m_opaqueProgram.getUniform("unLightDirWorld"), 1, &(sunDir[0]));
-    glUniform1f(m_opaqueProgram.getUniform("unSpecularExponent"), soaOptions.get(OPT_SPECULAR_EXPONENT).value.f);
-    glUniform1f(m_opaqueProgram.getUniform("unSpecularIntensity"), soaOptions.get(OPT_SPECULAR_INTENSITY).value.f * 0.3f);
+    if (m_compactOpaqueProgram.isCreated()) {
+        setOpaqueUniforms(m_compactOpaqueProgram, sunDir, ambient);
+    }
+    if (m_batchedOpaqueProgram.isCreated()) {
+        setOpaqueUniforms(m_batchedOpaqueProgram, sunDir, ambient);
+    }
+    setOpaqueUniforms(m_opaqueProgram, sunDir, ambient);
+    m_activeOpaqueProgram = &m_opaqueProgram;
 
     // Bind the block textures
     glActiveTexture(GL_TEXTURE0);
-    glUniform1i(m_opaqueProgram.getUniform("unTextures"), 0); // TODO(Ben): Temporary
     glBindTexture(GL_TEXTURE_2D_ARRAY, textureAtlas);
 
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sharedIBO);
+}
+
+void ChunkRenderer::setOpaqueUniforms(vg::GLProgram& program, const f32v3& sunDir, const f32v3& ambient) {
+    program.use();
+    glUniform3fv(program.getUniform("unLightDirWorld"), 1, &(sunDir[0]));
+    glUniform1f(program.getUniform("unSpecularExponent"), soaOptions.get(OPT_SPECULAR_EXPONENT).value.f);
+    glUniform1f(program.getUniform("unSpecularIntensity"), soaOptions.get(OPT_SPECULAR_INTENSITY).value.f * 0.3f);
+
+    glUniform1i(program.getUniform("unTextures"), 0); // TODO(Ben): Temporary
+
     // f32 blockAmbient = 0.000f;
-    glUniform3fv(m_opaqueProgram.getUniform("unAmbientLight"), 1, &ambient[0]);
-    glUniform3fv(m_opaqueProgram.getUniform("unSunColor"), 1, &sunDir[0]);
+    glUniform3fv(program.getUniform("unAmbientLight"), 1, &ambient[0]);
+    glUniform3fv(program.getUniform("unSunColor"), 1, &sunDir[0]);
 
-    glUniform1f(m_opaqueProgram.getUniform("unFadeDist"), 100000.0f/*ChunkRenderer::fadeDist*/);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sharedIBO);
+    glUniform1f(program.getUniform("unFadeDist"), 100000.0f/*ChunkRenderer::fadeDist*/);
 }
 
-void ChunkRenderer::drawOpaque(const ChunkMesh *cm, const f64v3 &PlayerPos, const f32m4 &VP) const {
+void ChunkRenderer::drawOpaque(const ChunkMesh *cm, const f64v3 &PlayerPos, const f32m4 &VP) {
     if (cm->vaoID == 0) return;
+
+    // Switch programs when the format changes
+    vg::GLProgram* program = &m_opaqueProgram;
+    if (cm->vertexFormat == BlockVertexFormat::COMPACT) {
+        if (!m_compactOpaqueProgram.isCreated()) return;
+        program = &m_compactOpaqueProgram;
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_BUFFER, cm->materialTextureID);
+        glActiveTexture(GL_TEXTURE0);
+    }
+    if (program != m_activeOpaqueProgram) {
+        program->use();
+        m_activeOpaqueProgram = program;
+    }
     
     setMatrixTranslation(worldMatrix, f64v3(cm->position), PlayerPos);
 
     f32m4 MVP = VP * worldMatrix;
-    glUniformMatrix4fv(m_opaqueProgram.getUniform("unWVP"), 1, GL_FALSE, &MVP[0][0]);
-    glUniformMatrix4fv(m_opaqueProgram.getUniform("unW"), 1, GL_FALSE, &worldMatrix[0][0]);
+    glUniformMatrix4fv(program->getUniform("unWVP"), 1, GL_FALSE, &MVP[0][0]);
+    glUniformMatrix4fv(program->getUniform("unW"), 1, GL_FALSE, &worldMatrix[0][0]);
 
     glBindVertexArray(cm->vaoID);
 
@@ -134,8 +210,51 @@ void ChunkRenderer::drawOpaque(const ChunkMesh *cm, const f64v3 &PlayerPos, cons
     glBindVertexArray(0);
 }
 
+void ChunkRenderer::drawOpaqueBatched(const std::vector<ChunkMesh*>& meshes, const f64v3& PlayerPos, const f32m4& VP) {
+    ui32 numPages = vertexArena->getNumPages();
+    m_commandBuilder.begin(numPages);
+    for (const ChunkMesh* cm : meshes) {
+        const ChunkArenaAllocation& alloc = cm->arenaAllocation;
+        if (alloc.numQuads) {
+            m_commandBuilder.addMesh(alloc.page, (i32)alloc.firstQuad * 4, cm->position, cm->renderData, PlayerPos);
+        } else {
+            drawOpaque(cm, PlayerPos, VP);
+        }
+    }
+    m_commandBuilder.end();
+
+    const std::vector<DrawElementsIndirectCommand>& commands = m_commandBuilder.getCommands();
+    if (commands.empty()) return;
+
+    // Upload this frame's offsets and commands
+    const std::vector<f32v3>& drawOffsets = m_commandBuilder.getDrawOffsets();
+    glBindBuffer(GL_ARRAY_BUFFER, vertexArena->getDrawOffsetBuffer());
+    glBufferData(GL_ARRAY_BUFFER, drawOffsets.size() * sizeof(f32v3), drawOffsets.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirectBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data(), GL_STREAM_DRAW);
+
+    m_batchedOpaqueProgram.use();
+    m_activeOpaqueProgram = &m_batchedOpaqueProgram;
+    glUniformMatrix4fv(m_batchedOpaqueProgram.getUniform("unVP"), 1, GL_FALSE, &VP[0][0]);
+
+    for (ui32 page = 0; page < numPages; page++) {
+        ui32 numCommands = m_commandBuilder.getPageNumCommands(page);
+        if (numCommands == 0) continue;
+        glBindVertexArray(vertexArena->getVao(page));
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+                                    (void*)((size_t)m_commandBuilder.getPageFirstCommand(page) * sizeof(DrawElementsIndirectCommand)),
+                                    numCommands, 0);
+    }
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
 void ChunkRenderer::drawOpaqueCustom(const ChunkMesh* cm, vg::GLProgram& m_program, const f64v3& PlayerPos, const f32m4& VP) {
     if (cm->vaoID == 0) return;
+    // Custom programs only understand BlockVertex
+    if (cm->vertexFormat != BlockVertexFormat::DEFAULT) return;
     
     setMatrixTranslation(worldMatrix, f64v3(cm->position), PlayerPos);
 
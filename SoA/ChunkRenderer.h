@@ -5,6 +5,7 @@
 
 #include <Vorb/graphics/GLProgram.h>
 
+#include "ChunkDrawCommandBuilder.h"
 #include "ChunkMesh.h"
 
 class GameRenderParams;
@@ -19,8 +20,13 @@ class ChunkRenderer {
     void dispose();
 
     void beginOpaque(VGTexture textureAtlas, const f32v3& sunDir, const f32v3& lightColor = f32v3(1.0f), const f32v3& ambient = f32v3(0.0f));
-    void drawOpaque(const ChunkMesh* cm, const f64v3& PlayerPos, const f32m4& VP) const;
+    void drawOpaque(const ChunkMesh* cm, const f64v3& PlayerPos, const f32m4& VP);
     static void drawOpaqueCustom(const ChunkMesh* cm, vg::GLProgram& m_program, const f64v3& PlayerPos, const f32m4& VP);
+    /// True if meshes can be drawn with drawOpaqueBatched
+    bool hasBatchedOpaque() const { return m_batchedOpaqueProgram.isCreated(); }
+    /// Draws all meshes in the vertex arena with one glMultiDrawElementsIndirect per page.
+    /// Meshes outside the arena are drawn with drawOpaque.
+    void drawOpaqueBatched(const std::vector<ChunkMesh*>& meshes, const f64v3& PlayerPos, const f32m4& VP);
 
     void beginTransparent(VGTexture textureAtlas, const f32v3& sunDir, const f32v3& lightColor = f32v3(1.0f), const f32v3& ambient = f32v3(0.0f));
     void drawTransparent(const ChunkMesh* cm, const f64v3& playerPos, const f32m4& VP) const;
@@ -36,12 +42,21 @@ class ChunkRenderer {
 
     static volatile f32 fadeDist;
     static VGIndexBuffer sharedIBO;
+    static ChunkVertexArena* vertexArena; ///< Shared opaque vertex storage, null unless batching
 private:
+    void setOpaqueUniforms(vg::GLProgram& program, const f32v3& sunDir, const f32v3& ambient);
+
     static f32m4 worldMatrix; ///< Reusable world matrix for chunks
     vg::GLProgram m_opaqueProgram;
+    vg::GLProgram m_compactOpaqueProgram; ///< For BlockVertexFormat::COMPACT meshes
+    vg::GLProgram m_batchedOpaqueProgram; ///< For meshes in vertexArena
+    vg::GLProgram* m_activeOpaqueProgram = nullptr;
     vg::GLProgram m_transparentProgram;
     vg::GLProgram m_cutoutProgram;
     vg::GLProgram m_waterProgram;
+
+    ChunkDrawCommandBuilder m_commandBuilder;
+    VGBuffer m_indirectBuffer = 0;
 };
 
 #endif // ChunkRenderer_h__
@@ -2,6 +2,7 @@
 #include "ChunkSphereComponentUpdater.h"
 
 #include "ChunkAccessor.h"
+#include "ChunkGrid.h"
 #include "ChunkID.h"
 #include "GameSystem.h"
 #include "SpaceSystem.h"
@@ -93,6 +94,10 @@ void ChunkSphereComponentUpdater::update(GameSystem* gameSystem, SpaceSystem* sp
                 }
             }
         }
+
+        // Generate what the player is looking at first
+        f32v3 direction(voxelPos.orientation * f64v3(0.0, 0.0, 1.0));
+        cmp.chunkGrid->setViewpoint(voxelPos.gridPosition.pos, direction, (f64)((cmp.radius + 1) * CHUNK_WIDTH));
     }
 }
 
@@ -0,0 +1,115 @@
+#include "stdafx.h"
+#include "ChunkTaskScheduler.h"
+
+#include <algorithm>
+
+#include "soaUtils.h"
+
+// Multipliers on distance squared
+#define OUTSIDE_FRUSTUM_PENALTY 4.0
+#define BEHIND_PENALTY 16.0
+// Out of range tasks go behind everything else
+#define OUT_OF_RANGE_PRIORITY 1.0e30
+
+// Chunk bounding sphere
+#define CHUNK_RADIUS (CHUNK_WIDTH * 0.8660254f)
+
+void ChunkTaskScheduler::init(VoxPool* threadPool, size_t maxQueued) {
+    m_threadPool = threadPool;
+    m_maxQueued = maxQueued;
+}
+
+void ChunkTaskScheduler::setViewpoint(const f64v3& position, const f32v3& direction, f64 maxDistance) {
+    std::lock_guard<std::mutex> l(m_lock);
+    // Only reprioritize when it changes enough to matter
+    if (selfDot(position - m_viewPosition) >= 1.0 || glm::dot(direction, m_viewDirection) < 0.99f) {
+        m_viewPosition = position;
+        m_viewDirection = direction;
+        m_needsSort = true;
+    }
+    m_maxDistance2 = maxDistance * maxDistance;
+}
+
+void ChunkTaskScheduler::setFrustum(const Frustum& frustum) {
+    std::lock_guard<std::mutex> l(m_lock);
+    m_frustum = frustum;
+    m_hasFrustum = true;
+}
+
+void ChunkTaskScheduler::addTask(ChunkID id, const f64v3& voxelPosition, vcore::IThreadPoolTask<WorkerData>* task) {
+    static const f64v3 CHUNK_HALF_DIMS(CHUNK_WIDTH / 2);
+    std::lock_guard<std::mutex> l(m_lock);
+    m_entries.emplace_back();
+    Entry& e = m_entries.back();
+    e.center = voxelPosition + CHUNK_HALF_DIMS;
+    e.task = task;
+    e.id = id;
+    m_queuedIds.insert(id);
+    m_needsSort = true;
+}
+
+vcore::IThreadPoolTask<WorkerData>* ChunkTaskScheduler::cancel(ChunkID id) {
+    std::lock_guard<std::mutex> l(m_lock);
+    auto it = m_queuedIds.find(id);
+    if (it == m_queuedIds.end()) return nullptr;
+    m_queuedIds.erase(it);
+    for (size_t i = 0; i < m_entries.size(); i++) {
+        if (m_entries[i].id == id) {
+            vcore::IThreadPoolTask<WorkerData>* task = m_entries[i].task;
+            // Erase keeps the order
+            m_entries.erase(m_entries.begin() + i);
+            return task;
+        }
+    }
+    return nullptr;
+}
+
+bool ChunkTaskScheduler::isQueued(ChunkID id) {
+    std::lock_guard<std::mutex> l(m_lock);
+    return m_queuedIds.find(id) != m_queuedIds.end();
+}
+
+void ChunkTaskScheduler::clear(OPT std::vector<vcore::IThreadPoolTask<WorkerData>*>* tasks) {
+    std::lock_guard<std::mutex> l(m_lock);
+    if (tasks) {
+        for (auto& e : m_entries) tasks->push_back(e.task);
+    }
+    std::vector<Entry>().swap(m_entries);
+    m_queuedIds.clear();
+}
+
+void ChunkTaskScheduler::update() {
+    std::lock_guard<std::mutex> l(m_lock);
+    if (m_entries.empty()) return;
+
+    if (m_needsSort) {
+        m_needsSort = false;
+        for (auto& e : m_entries) {
+            e.priority = getPriority(e.center);
+        }
+        // Best at the back so we can pop it
+        std::sort(m_entries.begin(), m_entries.end(), [](const Entry& a, const Entry& b) {
+            return a.priority > b.priority;
+        });
+    }
+
+    // Keep the pool queue short so new high priority tasks don't wait behind old ones
+    size_t queued = m_threadPool->getTasksSizeApprox();
+    while (queued < m_maxQueued && m_entries.size()) {
+        m_threadPool->addTask(m_entries.back().task);
+        m_queuedIds.erase(m_queuedIds.find(m_entries.back().id));
+        m_entries.pop_back();
+        queued++;
+    }
+}
+
+f64 ChunkTaskScheduler::getPriority(const f64v3& center) const {
+    f64v3 offset = center - m_viewPosition;
+    f64 dist2 = selfDot(offset);
+    if (dist2 > m_maxDistance2) return OUT_OF_RANGE_PRIORITY + dist2;
+
+    f32v3 relPos(offset);
+    if (glm::dot(relPos, m_viewDirection) < -CHUNK_RADIUS) return dist2 * BEHIND_PENALTY;
+    if (m_hasFrustum && !m_frustum.sphereInFrustum(relPos, CHUNK_RADIUS)) return dist2 * OUTSIDE_FRUSTUM_PENALTY;
+    return dist2;
+}
@@ -0,0 +1,90 @@
+///
+/// ChunkTaskScheduler.h
+/// Seed of Andromeda
+///
+/// Copyright 2014 Regrowth Studios
+/// MIT License
+///
+/// Summary:
+/// Holds chunk tasks back from the thread pool and submits them
+/// closest and most visible first, so the chunks in front of the
+/// player are meshed and generated before the rest.
+///
+
+#pragma once
+
+#ifndef ChunkTaskScheduler_h__
+#define ChunkTaskScheduler_h__
+
+#include <mutex>
+#include <unordered_set>
+
+#include "ChunkID.h"
+#include "Constants.h"
+#include "Frustum.h"
+#include "VoxPool.h"
+
+// Short enough that new close tasks don't wait long behind old ones.
+// Shared by all schedulers on a pool so none of them starve the others.
+#define MAX_QUEUED_CHUNK_TASKS 32
+
+class ChunkTaskScheduler {
+public:
+    /// @param threadPool: Pool that runs the tasks
+    /// @param maxQueued: Tasks are only submitted while the pool has fewer than this waiting
+    void init(VoxPool* threadPool, size_t maxQueued = MAX_QUEUED_CHUNK_TASKS);
+
+    /// Sets where the player is and where they are looking. Thread safe.
+    /// @param position: Voxel position of the camera
+    /// @param direction: Normalized view direction
+    /// @param maxDistance: Tasks farther than this only run once nothing closer is left
+    void setViewpoint(const f64v3& position, const f32v3& direction, f64 maxDistance);
+    /// Also deprioritizes tasks outside of the frustum. Thread safe.
+    /// @param frustum: Frustum relative to the viewpoint position
+    void setFrustum(const Frustum& frustum);
+
+    /// Queues a task for a chunk. Thread safe.
+    /// @param id: Chunk the task is for
+    /// @param voxelPosition: Voxel position of the chunk's minimum corner
+    void addTask(ChunkID id, const f64v3& voxelPosition, vcore::IThreadPoolTask<WorkerData>* task);
+    /// Removes the queued task for a chunk. Tasks already sent to the pool can't be cancelled.
+    /// Thread safe.
+    /// @return The removed task or nullptr
+    vcore::IThreadPoolTask<WorkerData>* cancel(ChunkID id);
+    /// @return true if a task for the chunk is waiting. Thread safe.
+    bool isQueued(ChunkID id);
+    /// Removes all queued tasks. Thread safe.
+    /// @param tasks: Gets the removed tasks, may be null
+    void clear(OPT std::vector<vcore::IThreadPoolTask<WorkerData>*>* tasks);
+
+    /// Reprioritizes if the viewpoint moved and tops up the thread pool.
+    void update();
+
+    size_t getNumQueued() const { return m_entries.size(); }
+private:
+    struct Entry {
+        f64v3 center;
+        vcore::IThreadPoolTask<WorkerData>* task;
+        ChunkID id;
+        f64 priority;
+    };
+
+    /// Lower runs sooner
+    f64 getPriority(const f64v3& center) const;
+
+    std::vector<Entry> m_entries; ///< Sorted by descending priority when !m_needsSort
+    std::unordered_multiset<ChunkID> m_queuedIds; ///< IDs of m_entries
+    bool m_needsSort = false;
+
+    f64v3 m_viewPosition = f64v3(0.0);
+    f32v3 m_viewDirection = f32v3(0.0f, 0.0f, 1.0f);
+    f64 m_maxDistance2 = DOUBLE_SENTINEL;
+    Frustum m_frustum;
+    bool m_hasFrustum = false;
+
+    VoxPool* m_threadPool = nullptr;
+    size_t m_maxQueued = 0;
+    std::mutex m_lock;
+};
+
+#endif // ChunkTaskScheduler_h__
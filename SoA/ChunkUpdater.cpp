@@ -123,10 +123,42 @@ void ChunkUpdater::placeBlockSafe(Chunk* chunk VORB_UNUSED, Chunk*& lockedChunk
     placeBlock(chunk, lockedChunk, blockIndex, blockData);*/
 }
 
+void ChunkUpdater::queueCaUpdates(Chunk* chunk, BlockIndex blockIndex) {
+    const i32v3 pos = getPosFromBlockIndex(blockIndex);
+
+    // Voxels over the border go to the neighbor
+    auto queueNeighbor = [](ChunkHandle& neighbor, BlockIndex index) {
+        if (!neighbor.isAquired()) return;
+        std::lock_guard<std::mutex> l(neighbor->lckCaUpdates);
+        neighbor->caUpdates.push_back(index);
+        neighbor->hasCaUpdates = true;
+    };
+    if (pos.x == 0) queueNeighbor(chunk->neighbor.left, blockIndex + CHUNK_WIDTH_M1);
+    if (pos.x == CHUNK_WIDTH_M1) queueNeighbor(chunk->neighbor.right, blockIndex - CHUNK_WIDTH_M1);
+    if (pos.y == 0) queueNeighbor(chunk->neighbor.bottom, blockIndex + CHUNK_SIZE - CHUNK_LAYER);
+    if (pos.y == CHUNK_WIDTH_M1) queueNeighbor(chunk->neighbor.top, blockIndex - CHUNK_SIZE + CHUNK_LAYER);
+    if (pos.z == 0) queueNeighbor(chunk->neighbor.back, blockIndex + CHUNK_LAYER - CHUNK_WIDTH);
+    if (pos.z == CHUNK_WIDTH_M1) queueNeighbor(chunk->neighbor.front, blockIndex - CHUNK_LAYER + CHUNK_WIDTH);
+
+    std::lock_guard<std::mutex> l(chunk->lckCaUpdates);
+    std::vector<ui16>& cells = chunk->caUpdates;
+    cells.push_back(blockIndex);
+    if (pos.x > 0) cells.push_back(blockIndex - 1);
+    if (pos.x < CHUNK_WIDTH_M1) cells.push_back(blockIndex + 1);
+    if (pos.y > 0) cells.push_back(blockIndex - CHUNK_LAYER);
+    if (pos.y < CHUNK_WIDTH_M1) cells.push_back(blockIndex + CHUNK_LAYER);
+    if (pos.z > 0) cells.push_back(blockIndex - CHUNK_WIDTH);
+    if (pos.z < CHUNK_WIDTH_M1) cells.push_back(blockIndex + CHUNK_WIDTH);
+    chunk->hasCaUpdates = true;
+}
+
 void ChunkUpdater::placeBlockNoUpdate(Chunk* chunk, BlockIndex blockIndex, BlockID blockType) {
  
     chunk->blocks.set(blockIndex, blockType);
     chunk->flagDirty();
+    chunk->flagMeshSlabs(blockIndex / CHUNK_LAYER);
+    chunk->queueLightUpdate(blockIndex);
+    queueCaUpdates(chunk, blockIndex);
 
     //Block &block = GETBLOCK(blockType);
 
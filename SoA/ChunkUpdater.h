@@ -22,6 +22,8 @@ class ChunkUpdater {
     }
     static void placeBlockSafe(Chunk* chunk, Chunk*& lockedChunk, BlockIndex blockIndex, BlockID blockData);
     static void placeBlockNoUpdate(Chunk* chunk, BlockIndex blockIndex, BlockID blockType);
+    /// Wakes the cellular automata at a voxel and the voxels next to it
+    static void queueCaUpdates(Chunk* chunk, BlockIndex blockIndex);
     static void placeBlockFromLiquidPhysics(Chunk* chunk, Chunk*& lockedChunk, int blockIndex, int blockType);
     static void placeBlockFromLiquidPhysicsSafe(Chunk* chunk, Chunk*& lockedChunk, int blockIndex, int blockType);
   
@@ -0,0 +1,111 @@
+#include "stdafx.h"
+#include "ChunkVertexArena.h"
+
+#include <algorithm>
+
+#include "ChunkMesh.h"
+#include "ChunkMesher.h"
+#include "ChunkRenderer.h"
+
+void ChunkVertexArena::init() {
+    glGenBuffers(1, &m_drawOffsetBuffer);
+}
+
+void ChunkVertexArena::dispose() {
+    for (auto& page : m_pages) {
+        glDeleteVertexArrays(1, &page.vao);
+        glDeleteBuffers(1, &page.vbo);
+    }
+    std::vector<Page>().swap(m_pages);
+    if (m_drawOffsetBuffer) {
+        glDeleteBuffers(1, &m_drawOffsetBuffer);
+        m_drawOffsetBuffer = 0;
+    }
+}
+
+bool ChunkVertexArena::upload(ChunkArenaAllocation& alloc, const VoxelQuad* quads, ui32 numQuads) {
+    free(alloc);
+    if (!allocate(numQuads, alloc)) return false;
+
+    glBindBuffer(GL_ARRAY_BUFFER, m_pages[alloc.page].vbo);
+    glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)alloc.firstQuad * sizeof(VoxelQuad),
+                    (GLsizeiptr)numQuads * sizeof(VoxelQuad), quads);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return true;
+}
+
+void ChunkVertexArena::write(const ChunkArenaAllocation& alloc, ui32 offset, const VoxelQuad* quads, ui32 numQuads) {
+    assert(offset + numQuads <= alloc.numQuads);
+
+    glBindBuffer(GL_ARRAY_BUFFER, m_pages[alloc.page].vbo);
+    glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)(alloc.firstQuad + offset) * sizeof(VoxelQuad),
+                    (GLsizeiptr)numQuads * sizeof(VoxelQuad), quads);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void ChunkVertexArena::free(ChunkArenaAllocation& alloc) {
+    if (alloc.numQuads == 0) return;
+
+    std::vector<FreeRange>& ranges = m_pages[alloc.page].freeRanges;
+    // Find the first range after alloc
+    auto it = std::lower_bound(ranges.begin(), ranges.end(), alloc.firstQuad,
+                               [](const FreeRange& r, ui32 firstQuad) { return r.firstQuad < firstQuad; });
+    bool joinsPrev = it != ranges.begin() && (it - 1)->firstQuad + (it - 1)->numQuads == alloc.firstQuad;
+    bool joinsNext = it != ranges.end() && alloc.firstQuad + alloc.numQuads == it->firstQuad;
+    if (joinsPrev && joinsNext) {
+        (it - 1)->numQuads += alloc.numQuads + it->numQuads;
+        ranges.erase(it);
+    } else if (joinsPrev) {
+        (it - 1)->numQuads += alloc.numQuads;
+    } else if (joinsNext) {
+        it->firstQuad = alloc.firstQuad;
+        it->numQuads += alloc.numQuads;
+    } else {
+        ranges.insert(it, FreeRange{ alloc.firstQuad, alloc.numQuads });
+    }
+    alloc.numQuads = 0;
+}
+
+bool ChunkVertexArena::allocate(ui32 numQuads, OUT ChunkArenaAllocation& alloc) {
+    if (numQuads == 0 || numQuads > CHUNK_ARENA_PAGE_QUADS) return false;
+
+    for (ui32 p = 0; p <= m_pages.size(); p++) {
+        if (p == m_pages.size()) createPage();
+        std::vector<FreeRange>& ranges = m_pages[p].freeRanges;
+        for (size_t i = 0; i < ranges.size(); i++) {
+            if (ranges[i].numQuads < numQuads) continue;
+            alloc.page = p;
+            alloc.firstQuad = ranges[i].firstQuad;
+            alloc.numQuads = numQuads;
+            ranges[i].firstQuad += numQuads;
+            ranges[i].numQuads -= numQuads;
+            if (ranges[i].numQuads == 0) ranges.erase(ranges.begin() + i);
+            return true;
+        }
+    }
+    return false;
+}
+
+void ChunkVertexArena::createPage() {
+    m_pages.emplace_back();
+    Page& page = m_pages.back();
+    page.freeRanges.push_back(FreeRange{ 0, CHUNK_ARENA_PAGE_QUADS });
+
+    glGenBuffers(1, &page.vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, page.vbo);
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)CHUNK_ARENA_PAGE_QUADS * sizeof(VoxelQuad), nullptr, GL_STATIC_DRAW);
+
+    glGenVertexArrays(1, &page.vao);
+    glBindVertexArray(page.vao);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ChunkRenderer::sharedIBO);
+    ChunkMesher::setBlockVertexAttributes();
+
+    // Per draw offset, indexed by baseInstance
+    glBindBuffer(GL_ARRAY_BUFFER, m_drawOffsetBuffer);
+    glEnableVertexAttribArray(CHUNK_ARENA_DRAW_OFFSET_ATTRIB);
+    glVertexAttribPointer(CHUNK_ARENA_DRAW_OFFSET_ATTRIB, 3, GL_FLOAT, GL_FALSE, sizeof(f32v3), nullptr);
+    glVertexAttribDivisor(CHUNK_ARENA_DRAW_OFFSET_ATTRIB, 1);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
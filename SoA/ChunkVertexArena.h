@@ -0,0 +1,70 @@
+///
+/// ChunkVertexArena.h
+/// Seed of Andromeda
+///
+/// Copyright 2014 Regrowth Studios
+/// MIT License
+///
+/// Summary:
+/// Suballocates opaque chunk mesh quads from a few large vertex buffers so
+/// they can be drawn with glMultiDrawElementsIndirect.
+///
+
+#pragma once
+
+#ifndef ChunkVertexArena_h__
+#define ChunkVertexArena_h__
+
+#include <Vorb/graphics/gtypes.h>
+
+struct VoxelQuad;
+
+// 32 MB of VoxelQuad per page
+#define CHUNK_ARENA_PAGE_QUADS 262144
+// Vertex attribute of the per draw offset
+#define CHUNK_ARENA_DRAW_OFFSET_ATTRIB 8
+
+/// A range of quads in one page. numQuads is 0 if nothing is allocated.
+struct ChunkArenaAllocation {
+    ui32 page = 0;
+    ui32 firstQuad = 0;
+    ui32 numQuads = 0;
+};
+
+class ChunkVertexArena {
+public:
+    void init();
+    void dispose();
+
+    /// Uploads quads, replacing the previous contents of alloc.
+    /// Returns false if the quads can't fit in a page.
+    bool upload(ChunkArenaAllocation& alloc, const VoxelQuad* quads, ui32 numQuads);
+    /// Overwrites numQuads quads of alloc starting at quad offset, in place
+    void write(const ChunkArenaAllocation& alloc, ui32 offset, const VoxelQuad* quads, ui32 numQuads);
+    /// Returns the quads of alloc to the arena
+    void free(ChunkArenaAllocation& alloc);
+
+    ui32 getNumPages() const { return (ui32)m_pages.size(); }
+    VGVertexArray getVao(ui32 page) const { return m_pages[page].vao; }
+    /// Per draw f32v3 offsets, read by every page as an instanced attribute
+    VGBuffer getDrawOffsetBuffer() const { return m_drawOffsetBuffer; }
+private:
+    struct FreeRange {
+        ui32 firstQuad;
+        ui32 numQuads;
+    };
+    struct Page {
+        VGVertexBuffer vbo = 0;
+        VGVertexArray vao = 0;
+        std::vector<FreeRange> freeRanges; ///< Sorted by firstQuad, never adjacent
+    };
+
+    /// First fit over all pages, adding a page if needed
+    bool allocate(ui32 numQuads, OUT ChunkArenaAllocation& alloc);
+    void createPage();
+
+    std::vector<Page> m_pages;
+    VGBuffer m_drawOffsetBuffer = 0;
+};
+
+#endif // ChunkVertexArena_h__
@@ -0,0 +1,51 @@
+///
+/// ConcurrentRecycler.h
+/// Seed of Andromeda
+///
+/// Copyright 2014 Regrowth Studios
+/// MIT License
+///
+/// Summary:
+/// Lock-free object recycler for objects that are made on one thread
+/// and given back on others, such as thread pool tasks.
+///
+
+#pragma once
+
+#ifndef ConcurrentRecycler_h__
+#define ConcurrentRecycler_h__
+
+#include <Vorb/concurrentqueue.h>
+
+/// Unlike PtrRecycler this needs no lock. Each thread that recycles
+/// gets its own sub-queue in the ConcurrentQueue, so workers giving back
+/// objects don't contend with each other.
+/// Objects are not reconstructed, so users must reset any state they need.
+template<typename T>
+class ConcurrentRecycler {
+public:
+    ConcurrentRecycler() {}
+    ~ConcurrentRecycler() { destroy(); }
+
+    /// Gets a free object, only allocating if there are none. Thread safe.
+    T* create() {
+        T* obj;
+        if (m_free.try_dequeue(obj)) return obj;
+        return new T;
+    }
+    /// Gives back an object from create(). Thread safe.
+    void recycle(T* obj) {
+        m_free.enqueue(obj);
+    }
+    /// Frees all recycled objects. Objects still in use are not freed.
+    void destroy() {
+        T* obj;
+        while (m_free.try_dequeue(obj)) delete obj;
+    }
+private:
+    VORB_NON_COPYABLE(ConcurrentRecycler);
+
+    moodycamel::ConcurrentQueue<T*> m_free;
+};
+
+#endif // ConcurrentRecycler_h__
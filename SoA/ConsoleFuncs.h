@@ -128,6 +128,15 @@ void registerFuncs(vscript::IEnvironment<ScriptImpl>* env) {
     env->setNamespaces("CHS");
     env->addCDelegate("run", makeDelegate(runCHS));
 
+    env->setNamespaces("MUB");
+    env->addCDelegate("run", makeDelegate(runMUB));
+
+    env->setNamespaces("CDB");
+    env->addCDelegate("run", makeDelegate(runCDB));
+
+    env->setNamespaces("CAL");
+    env->addCDelegate("run", makeDelegate(runCAL));
+
     env->setNamespaces();
 }
 
@@ -1,8 +1,14 @@
 #include "stdafx.h"
 #include "ConsoleTests.h"
 
+#include "BlockLoader.h"
+#include "BlockPack.h"
+#include "CAEngine.h"
 #include "ChunkAllocator.h"
 #include "ChunkAccessor.h"
+#include "ChunkDrawCommandBuilder.h"
+#include "ChunkMesh.h"
+#include "ChunkMeshUploader.h"
 
 #include <random>
 #include <Vorb/Timing.h>
@@ -102,3 +108,233 @@ void runCHS() {
     h2.release();
     h1.release();
 }
+
+namespace {
+    /// Uploads nothing, but keeps the staging ring books like GLMeshUploadBackend
+    class FakeMeshUploadBackend : public IMeshUploadBackend {
+    public:
+        FakeMeshUploadBackend(ui32 ringSize, ui64 gpuLatency) : m_gpuLatency(gpuLatency) {
+            ring.init(ringSize);
+        }
+
+        /// What a mesh task does with the ring, leaves data unstaged if it is full
+        void stage(ChunkMeshData& data) {
+            ring.allocate((ui32)(data.opaqueQuads.size() * sizeof(VoxelQuad)), data.staging);
+        }
+
+        virtual bool upload(ChunkMesh& mesh VORB_MAYBE_UNUSED, ChunkMeshData* data) override {
+            numUploads++;
+            if (data->staging.size) {
+                // Free once the GPU is done with this frame's copies
+                ring.release(data->staging, m_frame);
+                data->staging.size = 0;
+            }
+            return true;
+        }
+        virtual void discard(ChunkMeshData* data) override {
+            if (data->staging.size) {
+                ring.release(data->staging, 0);
+                data->staging.size = 0;
+            }
+        }
+        virtual void endFrame() override {
+            // The GPU finishes frames a few frames late
+            if (m_frame > m_gpuLatency) ring.retireFrame(m_frame - m_gpuLatency);
+            m_frame++;
+        }
+
+        StagingRingAllocator ring;
+        ui32 numUploads = 0;
+    private:
+        ui64 m_gpuLatency;
+        ui64 m_frame = 1;
+    };
+}
+
+void runMUB() {
+    const size_t MAX_BYTES = 64 * 1024;
+    const size_t MESH_QUADS = 4096 / sizeof(VoxelQuad) + 1;
+    const size_t MESH_BYTES = MESH_QUADS * sizeof(VoxelQuad);
+    const size_t MESHES_PER_FRAME = 40; ///< Meshing over twice as fast as the budget
+    const ui32 RING_SIZE = 256 * 1024;
+    const ui64 GPU_LATENCY = 2;
+
+    FakeMeshUploadBackend backend(RING_SIZE, GPU_LATENCY);
+    MeshUploadBudget budget;
+    budget.init(MAX_BYTES, 1000.0);
+    MeshUploadBacklog backlog;
+    moodycamel::ConcurrentQueue<ChunkMeshUpdateMessage> messages;
+    ChunkMesh mesh;
+    MeshUploadBacklog::UploadFunc uploadFunc = [&](ChunkMeshUpdateMessage& message) {
+        backend.upload(mesh, message.meshData);
+        delete message.meshData;
+    };
+
+    ui32 numMeshes = 0;
+    size_t maxBacklogBytes = 0;
+    bool isBudgetKept = true;
+    bool isRingKept = true;
+    bool hasRoom = true;
+    for (int frame = 0; frame < 300; frame++) {
+        // Mesh tasks only get scheduled while the backlog has room, like ChunkMeshManager
+        if (hasRoom && frame < 200) {
+            for (size_t i = 0; i < MESHES_PER_FRAME; i++) {
+                ChunkMeshData* data = new ChunkMeshData(MeshTaskType::DEFAULT);
+                data->opaqueQuads.resize(MESH_QUADS);
+                backend.stage(*data);
+                messages.enqueue(ChunkMeshUpdateMessage{ ChunkID(numMeshes++), data });
+            }
+        }
+
+        hasRoom = backlog.fill(messages, budget, 300);
+        if (backlog.getBytes() > maxBacklogBytes) maxBacklogBytes = backlog.getBytes();
+        backlog.upload(budget, uploadFunc);
+        backend.endFrame();
+
+        if (budget.getFrameBytes() > MAX_BYTES && budget.getFrameUploads() > 1) isBudgetKept = false;
+        if (backend.ring.getBytesInUse() > RING_SIZE) isRingKept = false;
+    }
+    backlog.clear(uploadFunc);
+
+    // The backlog may pass its limit by at most one frame of meshing
+    bool isBacklogKept = maxBacklogBytes <= MAX_BYTES * MESH_UPLOAD_BACKLOG_FRAMES + MESHES_PER_FRAME * MESH_BYTES;
+    bool isAllUploaded = backend.numUploads == numMeshes;
+    bool isRingFreed = backend.ring.getBytesInUse() == 0;
+    printf("MUB: %u meshes, %u uploaded, max backlog %zu bytes\n", numMeshes, backend.numUploads, maxBacklogBytes);
+    printf("MUB: budget %s, backlog %s, ring %s, ring freed %s\n",
+           isBudgetKept ? "ok" : "FAILED", isBacklogKept ? "ok" : "FAILED",
+           isRingKept ? "ok" : "FAILED", isRingFreed ? "ok" : "FAILED");
+    printf("MUB: %s\n", (isBudgetKept && isBacklogKept && isRingKept && isRingFreed && isAllUploaded) ? "passed" : "FAILED");
+    fflush(stdout);
+}
+
+void runCDB() {
+    // Each face has its own index range, so the commands tell which faces were kept
+    ChunkMeshRenderData renderData;
+    renderData.nxVboOff = 0;   renderData.nxVboSize = 6;
+    renderData.pxVboOff = 6;   renderData.pxVboSize = 12;
+    renderData.nyVboOff = 18;  renderData.nyVboSize = 18;
+    renderData.pyVboOff = 36;  renderData.pyVboSize = 24;
+    renderData.nzVboOff = 60;  renderData.nzVboSize = 30;
+    renderData.pzVboOff = 90;  renderData.pzVboSize = 36;
+    renderData.lowestX = renderData.lowestY = renderData.lowestZ = 0;
+    renderData.highestX = renderData.highestY = renderData.highestZ = CHUNK_WIDTH;
+    ChunkMeshRenderData emptyData;
+
+    const f64v3 playerPos(16.0, 100.0, 16.0);
+    const f64v3 posA(0.0);              // Below the player, hides its bottom
+    const f64v3 posB(64.0, 0.0, 0.0);   // Also right of the player, hides its right
+    const i32 BASE_VERTEX_A = 100;
+    const i32 BASE_VERTEX_B = 7;
+
+    ChunkDrawCommandBuilder builder;
+    builder.begin(2);
+    builder.addMesh(1, BASE_VERTEX_A, posA, renderData, playerPos);
+    // Has no faces, so it must not take a draw offset
+    builder.addMesh(0, 0, posA, emptyData, playerPos);
+    builder.addMesh(0, BASE_VERTEX_B, posB, renderData, playerPos);
+    builder.end();
+
+    const std::vector<DrawElementsIndirectCommand>& commands = builder.getCommands();
+    const std::vector<f32v3>& offsets = builder.getDrawOffsets();
+    // Checks the commands of one mesh and that the hidden face is left out
+    auto checkMesh = [&](ui32 first, ui32 count, i32 baseVertex, ui32 baseInstance, i32 hiddenOff) {
+        if (first + count > commands.size()) return false;
+        for (ui32 i = first; i < first + count; i++) {
+            const DrawElementsIndirectCommand& c = commands[i];
+            if (c.baseVertex != baseVertex || c.baseInstance != baseInstance || c.instanceCount != 1) return false;
+            if ((i32)c.firstIndex == hiddenOff) return false;
+        }
+        return true;
+    };
+
+    bool isGrouped = builder.getPageFirstCommand(0) == 0 && builder.getPageNumCommands(0) == 4 &&
+        builder.getPageFirstCommand(1) == 4 && builder.getPageNumCommands(1) == 5 && commands.size() == 9;
+    bool isSkipped = isGrouped && checkMesh(0, 4, BASE_VERTEX_B, 1, renderData.pxVboOff) &&
+        checkMesh(4, 5, BASE_VERTEX_A, 0, renderData.nyVboOff);
+    bool isRangeKept = true;
+    for (auto& c : commands) {
+        if ((c.firstIndex == (ui32)renderData.pyVboOff && c.count != (ui32)renderData.pyVboSize) ||
+            (c.firstIndex == (ui32)renderData.nxVboOff && c.count != (ui32)renderData.nxVboSize)) {
+            isRangeKept = false;
+        }
+    }
+    bool isOffsetKept = offsets.size() == 2 && offsets[0] == f32v3(posA - playerPos) && offsets[1] == f32v3(posB - playerPos);
+
+    size_t numCommands = commands.size();
+    size_t numOffsets = offsets.size();
+
+    // The next frame starts empty
+    builder.begin(2);
+    builder.end();
+    bool isCleared = builder.getCommands().empty() && builder.getDrawOffsets().empty() && builder.getPageNumCommands(1) == 0;
+
+    printf("CDB: %zu commands, %zu draw offsets\n", numCommands, numOffsets);
+    printf("CDB: pages %s, backfaces %s, ranges %s, offsets %s, cleared %s\n",
+           isGrouped ? "ok" : "FAILED", isSkipped ? "ok" : "FAILED", isRangeKept ? "ok" : "FAILED",
+           isOffsetKept ? "ok" : "FAILED", isCleared ? "ok" : "FAILED");
+    printf("CDB: %s\n", (isGrouped && isSkipped && isRangeKept && isOffsetKept && isCleared) ? "passed" : "FAILED");
+    fflush(stdout);
+}
+
+void runCAL() {
+    const ui32 LEVELS = 8;
+    const int MAX_TICKS = 100;
+
+    BlockPack blocks;
+    Block stone;
+    stone.sID = "stone";
+    BlockID stoneID = blocks.append(stone);
+    Block water;
+    water.sID = "water";
+    water.caIndex = 0;
+    water.caAlg = CAAlgorithm::LIQUID;
+    BlockID waterID = blocks.append(water);
+    bool hasLevels = BlockLoader::addLiquidLevels(&blocks, waterID, LEVELS);
+    hasLevels = hasLevels && blocks.getBlockIndex("water_" + std::to_string(LEVELS)) == waterID + LEVELS - 1;
+    const Block& liquid = blocks[waterID];
+    ui16 fullID = liquid.liquidStartID + liquid.liquidLevels;
+
+    PagedChunkAllocator allocator = {};
+    ChunkAccessor accessor = {};
+    accessor.init(&allocator);
+    ChunkHandle chunk = accessor.acquire(0);
+    chunk->initAndFillEmpty(WorldCubeFace::FACE_TOP);
+    for (int i = 0; i < CHUNK_LAYER; i++) {
+        chunk->blocks.set(i, stoneID);
+    }
+    // Drop a full block from up high, no neighbors so it stays in the chunk
+    int start = CHUNK_WIDTH / 2 + (CHUNK_WIDTH / 2) * CHUNK_WIDTH + 8 * CHUNK_LAYER;
+    chunk->blocks.set(start, fullID);
+    chunk->caUpdates.push_back((ui16)start);
+    chunk->hasCaUpdates = true;
+
+    CAEngine engine;
+    ChunkHandle neighbors[6];
+    int ticks = 0;
+    while (chunk->hasCaUpdates && ticks < MAX_TICKS) {
+        engine.update(chunk, neighbors, &blocks, ~(ui64)0);
+        ticks++;
+    }
+
+    ui32 volume = 0;
+    int wetCells = 0;
+    bool isOnFloor = true;
+    for (int i = 0; i < CHUNK_SIZE; i++) {
+        ui16 id = chunk->blocks.get(i);
+        if (id < waterID || id >= waterID + LEVELS) continue;
+        volume += id - liquid.liquidStartID;
+        wetCells++;
+        if (i / CHUNK_LAYER != 1) isOnFloor = false;
+    }
+    chunk.release();
+
+    bool isVolumeKept = volume == LEVELS;
+    bool hasSpread = wetCells > 1;
+    printf("CAL: %d ticks, %d wet cells, volume %u of %u\n", ticks, wetCells, volume, LEVELS);
+    printf("CAL: levels %s, fell %s, spread %s, volume %s\n",
+           hasLevels ? "ok" : "FAILED", isOnFloor ? "ok" : "FAILED",
+           hasSpread ? "ok" : "FAILED", isVolumeKept ? "ok" : "FAILED");
+    printf("CAL: %s\n", (hasLevels && isOnFloor && hasSpread && isVolumeKept) ? "passed" : "FAILED");
+    fflush(stdout);
+}
@@ -27,4 +27,25 @@ void freeCAS(ChunkAccessSpeedData* data);
 
 void runCHS();
 
+/************************************************************************/
+/* Mesh Upload Budget                                                   */
+/************************************************************************/
+/// Runs the mesh upload backlog, budget and staging ring against a fake
+/// backend, without GL. Prints whether the limits held.
+void runMUB();
+
+/************************************************************************/
+/* Chunk Draw Commands                                                  */
+/************************************************************************/
+/// Builds indirect draw commands for a few meshes without GL and checks the
+/// backface skip, the offsets and the grouping by arena page.
+void runCDB();
+
+/************************************************************************/
+/* CA Liquid                                                            */
+/************************************************************************/
+/// Adds the levels of a liquid like BlockLoader does and lets a full block of
+/// it flow on a stone floor. Prints whether it fell, spread and kept its volume.
+void runCAL();
+
 #endif // !ConsoleTests_h__
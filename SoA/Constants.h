@@ -37,6 +37,11 @@ const i32 CHUNK_WIDTH_M1 = 31;
 const i32 HALF_CHUNK_WIDTH = CHUNK_WIDTH / 2;
 const i32 CHUNK_LAYER = CHUNK_WIDTH*CHUNK_WIDTH;
 const i32 CHUNK_SIZE = CHUNK_LAYER*CHUNK_WIDTH;
+// Opaque meshes of edited chunks are split into horizontal slabs so an edit
+// only re-meshes and re-uploads the slabs it touched.
+const i32 MESH_SLAB_COUNT = 8;
+const i32 MESH_SLAB_HEIGHT = CHUNK_WIDTH / MESH_SLAB_COUNT;
+#define ALL_MESH_SLABS 0xFF
 const i32 SURFACE_DEPTH = 256;
 const i32 OBJECT_LIST_SIZE = 24096;
 
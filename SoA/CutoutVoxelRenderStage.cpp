@@ -6,6 +6,7 @@
 #include "Chunk.h"
 #include "BlockPack.h"
 #include "BlockTexturePack.h"
+#include "ChunkCuller.h"
 #include "ChunkMeshManager.h"
 #include "ChunkRenderer.h"
 #include "GameRenderParams.h"
@@ -19,8 +20,8 @@ void CutoutVoxelRenderStage::hook(ChunkRenderer* renderer, const GameRenderParam
 }
 
 void CutoutVoxelRenderStage::render(const Camera* camera VORB_MAYBE_UNUSED) {
-    ChunkMeshManager* cmm = m_gameRenderParams->chunkMeshmanager;
-    
+    const std::vector<ChunkMesh*>& drawList = m_gameRenderParams->chunkCuller->getDrawList();
+    if (drawList.empty()) return;
 
     const f64v3& position = m_gameRenderParams->chunkCamera->getPosition();
 
@@ -39,20 +40,9 @@ void CutoutVoxelRenderStage::render(const Camera* camera VORB_MAYBE_UNUSED) {
     //     saveTicks = SDL_GetTicks();
     // }
 
-    ChunkMesh *cm;
-
-    const std::vector <ChunkMesh *>& chunkMeshes = cmm->getChunkMeshes();
-    {
-        std::lock_guard<std::mutex> l(cmm->lckActiveChunkMeshes);
-        if (chunkMeshes.empty()) return;
-        for (int i = chunkMeshes.size() - 1; i >= 0; i--) {
-            cm = chunkMeshes[i];
-
-            if (cm->inFrustum) {
-                m_renderer->drawCutout(cm, position,
-                                       m_gameRenderParams->chunkCamera->getViewProjectionMatrix());
-            }
-        }
+    const f32m4& VP = m_gameRenderParams->chunkCamera->getViewProjectionMatrix();
+    for (ChunkMesh* cm : drawList) {
+        m_renderer->drawCutout(cm, position, VP);
     }
     glEnable(GL_CULL_FACE);
     
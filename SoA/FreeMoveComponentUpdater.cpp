@@ -6,11 +6,16 @@
 #include "Constants.h"
 
 void FreeMoveComponentUpdater::update(GameSystem* gameSystem, SpaceSystem* spaceSystem) {
+    update(gameSystem, spaceSystem, 0, (vecs::ComponentID)gameSystem->freeMoveInput.getComponentListSize());
+}
+
+void FreeMoveComponentUpdater::update(GameSystem* gameSystem, SpaceSystem* spaceSystem, vecs::ComponentID begin, vecs::ComponentID end) {
     //TODO(Ben): A lot of temporary code here
     f64v3 forward, right, up;
 
-    for (auto& it : gameSystem->freeMoveInput) {
-        auto& fmcmp = it.second;
+    // Skip the null component
+    for (vecs::ComponentID id = begin ? begin : 1; id < end; id++) {
+        auto& fmcmp = gameSystem->freeMoveInput.get(id);
         auto& physcmp = gameSystem->physics.get(fmcmp.physicsComponent);
 
         f64q* orientation;
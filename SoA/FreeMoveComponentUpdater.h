@@ -15,6 +15,8 @@
 #ifndef FreeMoveComponentUpdater_h__
 #define FreeMoveComponentUpdater_h__
 
+#include <Vorb/ecs/Entity.h>
+
 class GameSystem;
 class SpaceSystem;
 struct FreeMoveInputComponent;
@@ -22,6 +24,8 @@ struct FreeMoveInputComponent;
 class FreeMoveComponentUpdater {
 public:
     void update(GameSystem* gameSystem, SpaceSystem* spaceSystem);
+    /// Updates the free move components with IDs in [begin, end)
+    void update(GameSystem* gameSystem, SpaceSystem* spaceSystem, vecs::ComponentID begin, vecs::ComponentID end);
     static void rotateFromMouse(GameSystem* gameSystem, FreeMoveInputComponent& cmp, float dx, float dy, float speed);
 };
 
@@ -55,6 +55,9 @@ class Frustum {
     /// @param radius: Radius of the sphere
     /// @return true if it is in the frustum
     bool sphereInFrustum(const f32v3& pos, float radius) const;
+
+    /// Gets the six planes, indexed by Planes
+    const Plane* getPlanes() const { return m_planes; }
 private:
     float m_fov = 0.0f; ///< Vertical field of view in degrees
     float m_aspectRatio = 0.0f; ///< Screen aspect ratio
@@ -4,12 +4,17 @@
 #include "GameSystem.h"
 
 void FrustumComponentUpdater::update(OUT GameSystem* gameSystem) {
+    update(gameSystem, 0, (vecs::ComponentID)gameSystem->frustum.getComponentListSize());
+}
+
+void FrustumComponentUpdater::update(OUT GameSystem* gameSystem, vecs::ComponentID begin, vecs::ComponentID end) {
     f64q orientation;
     f32v3 up;
     f32v3 dir;
     const f32v3 pos(0.0f); ///< Always treat as origin for precision
-    for (auto& it : gameSystem->frustum) {
-        auto& cmp = it.second;
+    // Skip the null component
+    for (vecs::ComponentID id = begin ? begin : 1; id < end; id++) {
+        auto& cmp = gameSystem->frustum.get(id);
         
         // Get orientation based on position and head
         if (cmp.voxelPosition) {
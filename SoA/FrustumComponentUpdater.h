@@ -16,6 +16,7 @@
 #define FrustumComponentUpdater_h__
 
 #include "Vorb/decorators.h"
+#include <Vorb/ecs/Entity.h>
 
 class GameSystem;
 
@@ -24,6 +25,8 @@ class FrustumComponentUpdater {
     /// Updates frustum components
     /// @param gameSystem: Game ECS
     void update(OUT GameSystem* gameSystem);
+    /// Updates the frustum components with IDs in [begin, end)
+    void update(OUT GameSystem* gameSystem, vecs::ComponentID begin, vecs::ComponentID end);
 };
 
 #endif // FrustumComponentUpdater_h__
@@ -8,6 +8,7 @@
 
 class ChunkMesh;
 class Camera;
+class ChunkCuller;
 class ChunkMeshManager;
 class BlockPack;
 class BlockTexturePack;
@@ -32,6 +33,7 @@ class GameRenderParams {
     float lightActive;
     const Camera* chunkCamera;
     ChunkMeshManager* chunkMeshmanager;
+    const ChunkCuller* chunkCuller = nullptr; ///< Draw list shared by the voxel stages
     BlockPack* blocks;
     BlockTexturePack* blockTexturePack;
     bool isUnderwater;
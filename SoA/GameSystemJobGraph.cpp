@@ -0,0 +1,85 @@
+#include "stdafx.h"
+#include "GameSystemJobGraph.h"
+
+#include "GameWorkerPool.h"
+
+namespace {
+    // Ranges smaller than this aren't worth a thread
+    const size_t MIN_ITEMS_PER_TASK = 64;
+
+    inline bool isConflicting(ui32 readsA, ui32 writesA, ui32 readsB, ui32 writesB) {
+        return (writesA & (readsB | writesB)) || (writesB & readsA);
+    }
+}
+
+void GameSystemJobGraph::init(OPT GameWorkerPool* workerPool) {
+    m_workerPool = workerPool;
+}
+
+void GameSystemJobGraph::addJob(ui32 reads, ui32 writes, std::function<void()> func) {
+    Job job;
+    job.reads = reads;
+    job.writes = writes;
+    job.func = [func](size_t, size_t) { func(); };
+    addJob(std::move(job));
+}
+
+void GameSystemJobGraph::addRangeJob(ui32 reads, ui32 writes, std::function<size_t()> getCount, RangeFunc func) {
+    Job job;
+    job.reads = reads;
+    job.writes = writes;
+    job.getCount = getCount;
+    job.func = func;
+    addJob(std::move(job));
+}
+
+void GameSystemJobGraph::addJob(Job&& job) {
+    // Goes in the stage after the last job it has to wait for
+    job.stage = 0;
+    for (auto& other : m_jobs) {
+        if (other.stage >= job.stage && isConflicting(other.reads, other.writes, job.reads, job.writes)) {
+            job.stage = other.stage + 1;
+        }
+    }
+    if (job.stage == m_stages.size()) m_stages.emplace_back();
+    m_stages[job.stage].push_back(m_jobs.size());
+    m_jobs.push_back(std::move(job));
+}
+
+void GameSystemJobGraph::run() {
+    for (size_t stage = 0; stage < m_stages.size(); stage++) {
+        runStage(stage);
+    }
+}
+
+void GameSystemJobGraph::runStage(size_t stage) {
+    size_t maxTasksPerJob = m_workerPool ? m_workerPool->getNumThreads() : 1;
+
+    // Split the jobs into tasks
+    m_tasks.clear();
+    for (auto& j : m_stages[stage]) {
+        Job& job = m_jobs[j];
+        if (!job.getCount) {
+            m_tasks.push_back({ j, 0, 0 });
+            continue;
+        }
+        size_t count = job.getCount();
+        if (count == 0) continue;
+        size_t numTasks = count / MIN_ITEMS_PER_TASK;
+        if (numTasks > maxTasksPerJob) numTasks = maxTasksPerJob;
+        if (numTasks == 0) numTasks = 1;
+        size_t taskSize = (count + numTasks - 1) / numTasks;
+        for (size_t begin = 0; begin < count; begin += taskSize) {
+            m_tasks.push_back({ j, begin, begin + taskSize < count ? begin + taskSize : count });
+        }
+    }
+
+    if (m_tasks.size() <= 1 || !m_workerPool) {
+        for (auto& task : m_tasks) m_jobs[task.job].func(task.begin, task.end);
+        return;
+    }
+    m_workerPool->run(m_tasks.size(), [this](size_t t) {
+        const Task& task = m_tasks[t];
+        m_jobs[task.job].func(task.begin, task.end);
+    });
+}
@@ -0,0 +1,86 @@
+///
+/// GameSystemJobGraph.h
+/// Seed of Andromeda
+///
+/// Copyright 2014 Regrowth Studios
+/// MIT License
+///
+/// Summary:
+/// Runs the GameSystem updaters as jobs with declared read and write sets,
+/// in parallel wherever the sets allow it.
+///
+
+#pragma once
+
+#ifndef GameSystemJobGraph_h__
+#define GameSystemJobGraph_h__
+
+#include <Vorb/types.h>
+
+#include <functional>
+#include <vector>
+
+class GameWorkerPool;
+
+/// State a job can read or write, mostly GameSystem component tables
+enum GameSystemResource : ui32 {
+    GS_PHYSICS = 1 << 0,
+    GS_SPACE_POSITION = 1 << 1,
+    GS_VOXEL_POSITION = 1 << 2,
+    GS_FREE_MOVE_INPUT = 1 << 3,
+    GS_PARKOUR_INPUT = 1 << 4,
+    GS_HEAD = 1 << 5,
+    GS_FRUSTUM = 1 << 6,
+    GS_CHUNK_SPHERE = 1 << 7,
+    GS_AABB_COLLIDABLE = 1 << 8,
+    GS_ATTRIBUTES = 1 << 9,
+    GS_SPACE_SYSTEM = 1 << 10, ///< Space ECS components
+    GS_CHUNKS = 1 << 11, ///< Chunk grids of voxel planets
+    /// Jobs that add or remove components must write this
+    GS_ALL = 0xffffffff
+};
+
+class GameSystemJobGraph {
+public:
+    /// Runs over [begin, end) of the items of a job
+    typedef std::function<void(size_t begin, size_t end)> RangeFunc;
+
+    /// @param workerPool: Runs the jobs of a stage together, null runs them serially
+    void init(OPT GameWorkerPool* workerPool);
+
+    /// Adds a job that runs after every job added before it that it conflicts with.
+    /// The result is the same as running all jobs in the order they were added.
+    /// @param reads: GameSystemResource bits the job reads
+    /// @param writes: GameSystemResource bits the job writes
+    void addJob(ui32 reads, ui32 writes, std::function<void()> func);
+    /// Adds a job over getCount() items that can be split into ranges on several
+    /// threads. The work for one item may only write state of that item.
+    void addRangeJob(ui32 reads, ui32 writes, std::function<size_t()> getCount, RangeFunc func);
+
+    /// Runs all jobs once and returns when they are done
+    void run();
+private:
+    struct Job {
+        ui32 reads;
+        ui32 writes;
+        std::function<size_t()> getCount; ///< Empty if the job can't be split
+        RangeFunc func;
+        size_t stage;
+    };
+    struct Task {
+        size_t job;
+        size_t begin;
+        size_t end;
+    };
+
+    void addJob(Job&& job);
+    /// Runs the tasks of a stage, on the workers when there is more than one
+    void runStage(size_t stage);
+
+    GameWorkerPool* m_workerPool = nullptr;
+    std::vector<Job> m_jobs;
+    std::vector<std::vector<size_t>> m_stages; ///< Jobs that can run together, in order
+    std::vector<Task> m_tasks; ///< Tasks of the stage that is running
+};
+
+#endif // GameSystemJobGraph_h__
@@ -14,9 +14,16 @@
 
 #include <Vorb/utils.h>
 
+// The updaters assume this many updates per second
+const f64 GAME_TIMESTEP = 1.0 / 60.0;
+// When further behind than this, the time is dropped so we don't spiral
+const int MAX_STEPS_PER_UPDATE = 4;
+
 GameSystemUpdater::GameSystemUpdater(OUT SoaState* soaState, InputMapper* inputMapper) :
     m_soaState(soaState),
     m_inputMapper(inputMapper) {
+    m_jobGraph.init(&soaState->gameWorkerPool);
+    addJobs();
 }
 
 GameSystemUpdater::~GameSystemUpdater() {
@@ -24,13 +31,61 @@ GameSystemUpdater::~GameSystemUpdater() {
 }
 
 void GameSystemUpdater::update(OUT GameSystem* gameSystem, OUT SpaceSystem* spaceSystem, const SoaState* soaState VORB_MAYBE_UNUSED) {
-    // Update component tables
-    m_freeMoveUpdater.update(gameSystem, spaceSystem);
-    m_headUpdater.update(gameSystem);
-    m_aabbCollidableUpdater.update(gameSystem, spaceSystem);
-    m_parkourUpdater.update(gameSystem, spaceSystem);
-    m_physicsUpdater.update(gameSystem, spaceSystem);
-    m_collisionUpdater.update(gameSystem);
-    m_chunkSphereUpdater.update(gameSystem, spaceSystem);
-    m_frustumUpdater.update(gameSystem);
+    auto now = std::chrono::steady_clock::now();
+    if (m_hasUpdated) {
+        m_accumulator += std::chrono::duration<f64>(now - m_lastUpdate).count();
+    } else {
+        // First update always steps
+        m_accumulator = GAME_TIMESTEP;
+        m_hasUpdated = true;
+    }
+    m_lastUpdate = now;
+
+    m_gameSystem = gameSystem;
+    m_spaceSystem = spaceSystem;
+    int steps = 0;
+    while (m_accumulator >= GAME_TIMESTEP) {
+        if (steps++ == MAX_STEPS_PER_UPDATE) {
+            m_accumulator = 0.0;
+            break;
+        }
+        m_jobGraph.run();
+        m_accumulator -= GAME_TIMESTEP;
+    }
+    m_gameSystem = nullptr;
+    m_spaceSystem = nullptr;
+}
+
+void GameSystemUpdater::addJobs() {
+    // Added in the order they used to run serially, the graph keeps that order
+    // between updaters that share state. Physics adds and removes components, so
+    // it runs alone.
+    m_jobGraph.addRangeJob(GS_FREE_MOVE_INPUT | GS_SPACE_SYSTEM, GS_PHYSICS | GS_VOXEL_POSITION | GS_SPACE_POSITION,
+                           [this]() { return m_gameSystem->freeMoveInput.getComponentListSize(); },
+                           [this](size_t begin, size_t end) {
+        m_freeMoveUpdater.update(m_gameSystem, m_spaceSystem, (vecs::ComponentID)begin, (vecs::ComponentID)end);
+    });
+    m_jobGraph.addJob(GS_HEAD, 0, [this]() {
+        m_headUpdater.update(m_gameSystem);
+    });
+    m_jobGraph.addJob(GS_PHYSICS | GS_VOXEL_POSITION | GS_SPACE_SYSTEM | GS_CHUNKS, GS_AABB_COLLIDABLE, [this]() {
+        m_aabbCollidableUpdater.update(m_gameSystem, m_spaceSystem);
+    });
+    m_jobGraph.addJob(GS_PARKOUR_INPUT | GS_ATTRIBUTES | GS_HEAD | GS_AABB_COLLIDABLE, GS_PHYSICS | GS_VOXEL_POSITION, [this]() {
+        m_parkourUpdater.update(m_gameSystem, m_spaceSystem);
+    });
+    m_jobGraph.addJob(GS_ALL, GS_ALL, [this]() {
+        m_physicsUpdater.update(m_gameSystem, m_spaceSystem, m_aabbCollidableUpdater.getBroadPhase());
+    });
+    m_jobGraph.addJob(GS_AABB_COLLIDABLE, 0, [this]() {
+        m_collisionUpdater.update(m_gameSystem);
+    });
+    m_jobGraph.addJob(GS_VOXEL_POSITION | GS_SPACE_SYSTEM, GS_CHUNK_SPHERE | GS_CHUNKS, [this]() {
+        m_chunkSphereUpdater.update(m_gameSystem, m_spaceSystem);
+    });
+    m_jobGraph.addRangeJob(GS_VOXEL_POSITION | GS_SPACE_POSITION | GS_HEAD, GS_FRUSTUM,
+                           [this]() { return m_gameSystem->frustum.getComponentListSize(); },
+                           [this](size_t begin, size_t end) {
+        m_frustumUpdater.update(m_gameSystem, (vecs::ComponentID)begin, (vecs::ComponentID)end);
+    });
 }
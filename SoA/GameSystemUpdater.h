@@ -19,6 +19,7 @@
 #include "CollisionComponentUpdater.h"
 #include "FreeMoveComponentUpdater.h"
 #include "FrustumComponentUpdater.h"
+#include "GameSystemJobGraph.h"
 #include "InputMapper.h"
 #include "PhysicsComponentUpdater.h"
 #include "ParkourComponentUpdater.h"
@@ -28,6 +29,8 @@
 #include <Vorb/Event.hpp>
 #include <Vorb/VorbPreDecl.inl>
 
+#include <chrono>
+
 struct SoaState;
 class SpaceSystem;
 struct VoxelPositionComponent;
@@ -40,11 +43,14 @@ class GameSystemUpdater {
     GameSystemUpdater(OUT SoaState* soaState, InputMapper* inputMapper);
     ~GameSystemUpdater();
     /// Updates the game system, and also updates voxel components for space system
-    /// planet transitions.
+    /// planet transitions. Runs as many fixed steps as the time since the last
+    /// call covers, so the simulation speed doesn't depend on the frame rate.
     /// @param gameSystem: Game ECS
     /// @param spaceSystem: Space ECS. Only SphericalVoxelComponents are modified.
     void update(OUT GameSystem* gameSystem, OUT SpaceSystem* spaceSystem, const SoaState* soaState);
 private:
+    /// Declares the updaters to the job graph
+    void addJobs();
 
     int m_frameCounter = 0; ///< Counts frames for updateVoxelPlanetTransitions updates
 
@@ -58,6 +64,16 @@ class GameSystemUpdater {
     ChunkSphereComponentUpdater m_chunkSphereUpdater;
     FrustumComponentUpdater m_frustumUpdater;
 
+    GameSystemJobGraph m_jobGraph; ///< Runs the updaters
+    // Only valid during update, for the jobs
+    GameSystem* m_gameSystem = nullptr;
+    SpaceSystem* m_spaceSystem = nullptr;
+
+    // Fixed timestep
+    std::chrono::steady_clock::time_point m_lastUpdate;
+    f64 m_accumulator = 0.0; ///< Seconds not simulated yet
+    bool m_hasUpdated = false;
+
     const SoaState* m_soaState = nullptr;
     InputMapper* m_inputMapper = nullptr;
 };
@@ -0,0 +1,77 @@
+#include "stdafx.h"
+#include "GameWorkerPool.h"
+
+namespace {
+    const size_t MAX_GAME_WORKERS = 3;
+}
+
+GameWorkerPool::~GameWorkerPool() {
+    {
+        std::lock_guard<std::mutex> l(m_lckWork);
+        m_quit = true;
+    }
+    m_condWork.notify_all();
+    for (auto& t : m_workers) t.join();
+}
+
+size_t GameWorkerPool::getNumThreads() {
+    if (m_workers.empty() && !m_isSingleCore) {
+        size_t numWorkers = std::thread::hardware_concurrency();
+        // The calling thread takes a share too
+        numWorkers = numWorkers > 0 ? numWorkers - 1 : 0;
+        if (numWorkers > MAX_GAME_WORKERS) numWorkers = MAX_GAME_WORKERS;
+        m_isSingleCore = numWorkers == 0;
+        for (size_t n = 0; n < numWorkers; n++) {
+            m_workers.emplace_back(&GameWorkerPool::workerThreadFunc, this);
+        }
+    }
+    return m_workers.size() + 1;
+}
+
+void GameWorkerPool::run(size_t numTasks, const TaskFunc& func) {
+    if (numTasks <= 1 || getNumThreads() == 1) {
+        for (size_t t = 0; t < numTasks; t++) func(t);
+        return;
+    }
+
+    {
+        std::unique_lock<std::mutex> l(m_lckWork);
+        // A worker that woke up late could still be looking at the last batch
+        m_condDone.wait(l, [&] { return m_activeWorkers == 0; });
+        m_func = &func;
+        m_numTasks = numTasks;
+        m_nextTask = 0;
+        m_generation++;
+    }
+    m_condWork.notify_all();
+
+    // Help out, then wait for the tasks that were claimed by workers
+    runTasks();
+    std::unique_lock<std::mutex> l(m_lckWork);
+    m_condDone.wait(l, [&] { return m_activeWorkers == 0; });
+}
+
+void GameWorkerPool::runTasks() {
+    size_t t;
+    while ((t = m_nextTask++) < m_numTasks) {
+        (*m_func)(t);
+    }
+}
+
+void GameWorkerPool::workerThreadFunc() {
+    ui32 generation = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> l(m_lckWork);
+            m_condWork.wait(l, [&] { return m_quit || m_generation != generation; });
+            if (m_quit) return;
+            generation = m_generation;
+            m_activeWorkers++;
+        }
+        runTasks();
+        {
+            std::lock_guard<std::mutex> l(m_lckWork);
+            if (--m_activeWorkers == 0) m_condDone.notify_all();
+        }
+    }
+}
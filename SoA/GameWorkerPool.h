@@ -0,0 +1,61 @@
+///
+/// GameWorkerPool.h
+/// Seed of Andromeda
+///
+/// Copyright 2014 Regrowth Studios
+/// MIT License
+///
+/// Summary:
+/// A few worker threads that help the update thread with fork-join work,
+/// shared by the game and space system updaters.
+///
+
+#pragma once
+
+#ifndef GameWorkerPool_h__
+#define GameWorkerPool_h__
+
+#include <Vorb/types.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// The chunk thread pool isn't used for this, the update would queue behind
+/// generation and meshing tasks. Only one thread may use a pool at a time.
+class GameWorkerPool {
+public:
+    /// Runs one task of a batch
+    typedef std::function<void(size_t task)> TaskFunc;
+
+    ~GameWorkerPool();
+
+    /// Gets how many threads run() uses, counting the calling thread. Starts the
+    /// workers on first use, none on single-core machines.
+    size_t getNumThreads();
+
+    /// Calls func for each task in [0, numTasks) on the workers and the calling
+    /// thread, and returns when all of them are done.
+    void run(size_t numTasks, const TaskFunc& func);
+private:
+    /// Claims and runs tasks of the current batch until there are none left
+    void runTasks();
+    void workerThreadFunc();
+
+    std::vector<std::thread> m_workers;
+    bool m_isSingleCore = false; ///< No point in starting workers
+    std::mutex m_lckWork;
+    std::condition_variable m_condWork;
+    std::condition_variable m_condDone;
+    ui32 m_generation = 0; ///< Bumped for each batch handed to the workers
+    size_t m_activeWorkers = 0;
+    bool m_quit = false;
+    const TaskFunc* m_func = nullptr; ///< Of the current batch
+    std::atomic<size_t> m_nextTask = { 0 };
+    std::atomic<size_t> m_numTasks = { 0 };
+};
+
+#endif // GameWorkerPool_h__
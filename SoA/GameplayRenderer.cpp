@@ -223,6 +223,10 @@ void GameplayRenderer::render() {
         glClear(GL_DEPTH_BUFFER_BIT);
         glEnable(GL_BLEND);
         glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        // Cull once for all voxel stages
+        m_chunkCuller.cull(m_meshManager, &m_voxelCamera);
+        m_meshManager->setViewpoint(&m_voxelCamera);
+        m_gameRenderParams.chunkCuller = &m_chunkCuller;
         stages.opaqueVoxel.render(&m_voxelCamera);
         // _physicsBlockRenderStage->draw();
         //  m_cutoutVoxelRenderStage->render();
@@ -21,6 +21,7 @@
 
 #include "Camera.h"
 #include "ChunkGridRenderStage.h"
+#include "ChunkCuller.h"
 #include "ChunkRenderer.h"
 #include "ColoredFullQuadRenderer.h"
 #include "CutoutVoxelRenderStage.h"
@@ -131,6 +132,7 @@ class GameplayRenderer {
 
     Camera m_voxelCamera;
     ChunkRenderer m_chunkRenderer;
+    ChunkCuller m_chunkCuller; ///< Builds the voxel draw list each frame
 
     ColoredFullQuadRenderer m_coloredQuadRenderer; ///< For rendering full screen colored quads
 
@@ -19,6 +19,8 @@ void GenerateTask::execute(WorkerData* workerData) {
             case ChunkGenLevel::GEN_TERRAIN:
                 chunkGenerator->m_proceduralGenerator.generateChunk(&chunk, heightData);
                 chunk.genLevel = GEN_TERRAIN;
+                // Flora from neighbors that finished first
+                query->grid->nodeSetter.flushNodes(query->chunk);
                 // TODO(Ben): Not lazy load.
                 if (!workerData->floraGenerator) {
                     workerData->floraGenerator = new FloraGenerator;
@@ -43,60 +45,97 @@ void GenerateTask::execute(WorkerData* workerData) {
     chunkGenerator->finishQuery(query);
 }
 
-struct ChunkFloraArrays {
-    std::vector<VoxelToPlace> fNodes;
-    std::vector<VoxelToPlace> wNodes;
-};
+namespace {
+    const ui32 EMPTY_BUCKET = 0xFFFFFFFFu; ///< Chunk offsets only use 30 bits
+    const size_t MIN_BUCKETS = 32;
+
+    /// Flat table of the node batch for each chunk the flora of a chunk reaches
+    class FloraBuckets {
+    public:
+        struct Bucket {
+            ui32 chunkOffset = EMPTY_BUCKET;
+            ui32 numNodes = 0;
+            VoxelNodeBatch* batch = nullptr;
+        };
+
+        Bucket& get(ui32 chunkOffset) {
+            // Keep the table at most half full
+            if ((m_size + 1) * 2 > m_buckets.size()) grow();
+            Bucket& b = find(chunkOffset);
+            if (b.chunkOffset == EMPTY_BUCKET) {
+                b.chunkOffset = chunkOffset;
+                m_size++;
+            }
+            return b;
+        }
+
+        std::vector<Bucket>::iterator begin() { return m_buckets.begin(); }
+        std::vector<Bucket>::iterator end() { return m_buckets.end(); }
+    private:
+        Bucket& find(ui32 chunkOffset) {
+            size_t mask = m_buckets.size() - 1;
+            size_t i = (chunkOffset * 2654435761u) & mask;
+            while (m_buckets[i].chunkOffset != EMPTY_BUCKET && m_buckets[i].chunkOffset != chunkOffset) {
+                i = (i + 1) & mask;
+            }
+            return m_buckets[i];
+        }
+
+        void grow() {
+            std::vector<Bucket> old;
+            old.swap(m_buckets);
+            m_buckets.resize(old.empty() ? MIN_BUCKETS : old.size() * 2);
+            for (auto& b : old) {
+                if (b.chunkOffset != EMPTY_BUCKET) find(b.chunkOffset) = b;
+            }
+        }
+
+        std::vector<Bucket> m_buckets;
+        size_t m_size = 0;
+    };
+}
 
 void GenerateTask::generateFlora(WorkerData* workerData, Chunk& chunk) {
     std::vector<FloraNode> fNodes, wNodes;
     workerData->floraGenerator->generateChunkFlora(&chunk, heightData, fNodes, wNodes);
 
+    // Count the nodes for each chunk first, so every batch is allocated once
+    FloraBuckets buckets;
+    for (auto& it : fNodes) buckets.get(it.chunkOffset).numNodes++;
+    for (auto& it : wNodes) buckets.get(it.chunkOffset).numNodes++;
 
-    // Sort based on chunk to minimize locking
-    std::map<ChunkID, ChunkFloraArrays> chunkMap;
-
-    // Add all nodes
-    // TODO(Ben): There should be a way to approximate size needs or use map on generator side.
-    for (auto& it : fNodes) {
-        ChunkID id(chunk.getID());
-        id.x += FloraGenerator::getChunkXOffset(it.chunkOffset);
-        id.y += FloraGenerator::getChunkYOffset(it.chunkOffset);
-        id.z += FloraGenerator::getChunkZOffset(it.chunkOffset);
-        chunkMap[id].fNodes.emplace_back(it.blockID, it.blockIndex);
+    VoxelNodeSetter& nodeSetter = query->grid->nodeSetter;
+    for (auto& b : buckets) {
+        if (b.chunkOffset == EMPTY_BUCKET) continue;
+        b.batch = nodeSetter.createBatch();
+        b.batch->nodes.reserve(b.numNodes);
     }
-    for (auto& it : wNodes) {
-        ChunkID id(chunk.getID());
-        id.x += FloraGenerator::getChunkXOffset(it.chunkOffset);
-        id.y += FloraGenerator::getChunkYOffset(it.chunkOffset);
-        id.z += FloraGenerator::getChunkZOffset(it.chunkOffset);
 
-        chunkMap[id].wNodes.emplace_back(it.blockID, it.blockIndex);
+    // Priorities only depend on this chunk, so the result doesn't depend on which
+    // neighbor finishes first
+    const ChunkID& source = chunk.getID();
+    for (size_t i = 0; i < fNodes.size(); i++) {
+        const FloraNode& node = fNodes[i];
+        buckets.get(node.chunkOffset).batch->nodes.emplace_back(node.blockID, node.blockIndex,
+                                                                VoxelNodeSetter::getPriority(source, i, false));
+    }
+    for (size_t i = 0; i < wNodes.size(); i++) {
+        const FloraNode& node = wNodes[i];
+        buckets.get(node.chunkOffset).batch->nodes.emplace_back(node.blockID, node.blockIndex,
+                                                                VoxelNodeSetter::getPriority(source, i, true));
     }
 
-    // Traverse chunks
-    for (auto& it : chunkMap) {
-        ChunkHandle h = query->grid->accessor.acquire(it.first);
-        // TODO(Ben): Handle other case
-        if (h->genLevel >= GEN_TERRAIN) {
-            {
-                std::lock_guard<std::mutex> l(h->dataMutex);
-                for (auto& node : it.second.wNodes) {
-                    h->blocks.set(node.blockIndex, node.blockID);
-                }
-                for (auto& node : it.second.fNodes) {
-                    if (h->blocks.get(node.blockIndex) == 0) {
-                        h->blocks.set(node.blockIndex, node.blockID);
-                    }
-                }
-            }
-
-            if (h->genLevel == GEN_DONE) h->DataChange(h);
-        } else {
-            query->grid->nodeSetter.setNodes(h, GEN_TERRAIN, it.second.wNodes, it.second.fNodes);
-        }
+    // Hand the batches to their chunks, this one included
+    for (auto& b : buckets) {
+        if (b.chunkOffset == EMPTY_BUCKET) continue;
+        ChunkID id(source);
+        id.x += FloraGenerator::getChunkXOffset(b.chunkOffset);
+        id.y += FloraGenerator::getChunkYOffset(b.chunkOffset);
+        id.z += FloraGenerator::getChunkZOffset(b.chunkOffset);
+        ChunkHandle h = query->grid->accessor.acquire(id);
+        nodeSetter.setNodes(h, b.batch);
         h.release();
     }
 
     std::vector<ui16>().swap(chunk.floraToGenerate);
-}
\ No newline at end of file
+}
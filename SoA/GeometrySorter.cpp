@@ -6,34 +6,46 @@
 
 #include "ChunkRenderer.h"
 
-std::vector <Distanceclass> GeometrySorter::_distBuffer;
+#define RADIX_BITS 8
+#define RADIX_SIZE (1 << RADIX_BITS)
+#define RADIX_MASK (RADIX_SIZE - 1)
 
-i32 convertData(Distanceclass* data) {
-    return data->distance;
+// Flipped so that an ascending sort puts the farthest quads first.
+// Distances are squared lengths, so they are never negative.
+inline ui32 sortKey(const Distanceclass& d) {
+    return ~(ui32)d.distance;
 }
 
-bool comparator(const Distanceclass& i, const Distanceclass& j) { 
-    return (i.distance > j.distance); 
-}
+bool GeometrySorter::sortTransparentBlocks(ChunkMesh* cm, const i32v3& cameraPos) {
+    // Order can only change when the camera changes voxels
+    if (!cm->needsSort && cm->transSortPos == cameraPos) return false;
+    bool quadsChanged = cm->needsSort;
+    cm->needsSort = false;
+    cm->transSortPos = cameraPos;
 
-void GeometrySorter::sortTransparentBlocks(ChunkMesh* cm, const i32v3& cameraPos) {
+    size_t numQuads = cm->transQuadPositions.size();
+    m_distBuffer.resize(numQuads);
 
-    _distBuffer.resize(cm->transQuadPositions.size());
+    //We multiply by 2 because we need twice the precision of integers per block
+    //we subtract by 1 in order to ensure that the camera position is centered on a block
+    i32v3 relPos = ((i32v3(cm->position) - cameraPos) << 1) - 1;
 
-    for (size_t i = 0; i < cm->transQuadPositions.size(); i++) {
-        _distBuffer[i].quadIndex = i; 
-        //We multiply by 2 because we need twice the precision of integers per block
-        //we subtract by 1 in order to ensure that the camera position is centered on a block
-        _distBuffer[i].distance = selfDot(((i32v3(cm->position) - cameraPos) << 1) - 1 + i32v3(cm->transQuadPositions[i]));
+    // Fill in the current draw order so we can tell if it is still sorted
+    bool isSorted = true;
+    for (size_t i = 0; i < numQuads; i++) {
+        Distanceclass& d = m_distBuffer[i];
+        d.quadIndex = cm->transQuadIndices[i * 6] >> 2;
+        d.distance = selfDot(relPos + i32v3(cm->transQuadPositions[d.quadIndex]));
+        if (i && d.distance > m_distBuffer[i - 1].distance) isSorted = false;
     }
+    if (isSorted && !quadsChanged) return false;
 
-   // radixSort<Distanceclass, 8>(&(_distBuffer[0]), _distBuffer.size(), convertData, 31);
-    std::sort(_distBuffer.begin(), _distBuffer.end(), comparator);
+    if (!isSorted) radixSort();
 
     int startIndex;
     int j = 0;
-    for (size_t i = 0; i < _distBuffer.size(); i++) {
-        startIndex = _distBuffer[i].quadIndex * 4;
+    for (size_t i = 0; i < m_distBuffer.size(); i++) {
+        startIndex = m_distBuffer[i].quadIndex * 4;
         cm->transQuadIndices[j] = startIndex;
         cm->transQuadIndices[j + 1] = startIndex + 1;
         cm->transQuadIndices[j + 2] = startIndex + 2;
@@ -42,4 +54,44 @@ void GeometrySorter::sortTransparentBlocks(ChunkMesh* cm, const i32v3& cameraPos
         cm->transQuadIndices[j + 5] = startIndex;
         j += 6;
     }
-}
\ No newline at end of file
+    return true;
+}
+
+void GeometrySorter::radixSort() {
+    size_t size = m_distBuffer.size();
+    if (size < 2) return;
+    m_swapBuffer.resize(size);
+
+    // Count every digit in one pass
+    ui32 counts[4][RADIX_SIZE] = {};
+    for (size_t i = 0; i < size; i++) {
+        ui32 key = sortKey(m_distBuffer[i]);
+        counts[0][key & RADIX_MASK]++;
+        counts[1][(key >> 8) & RADIX_MASK]++;
+        counts[2][(key >> 16) & RADIX_MASK]++;
+        counts[3][key >> 24]++;
+    }
+
+    Distanceclass* src = m_distBuffer.data();
+    Distanceclass* dst = m_swapBuffer.data();
+    for (ui32 pass = 0; pass < 4; pass++) {
+        ui32* count = counts[pass];
+        ui32 shift = pass * RADIX_BITS;
+        // Every key has the same digit, this pass would not move anything.
+        // Nearby quads share the high bytes, so this skips most passes.
+        if (count[(sortKey(src[0]) >> shift) & RADIX_MASK] == size) continue;
+
+        // Exclusive prefix sum into bucket offsets
+        ui32 offset = 0;
+        for (ui32 b = 0; b < RADIX_SIZE; b++) {
+            ui32 c = count[b];
+            count[b] = offset;
+            offset += c;
+        }
+        for (size_t i = 0; i < size; i++) {
+            dst[count[(sortKey(src[i]) >> shift) & RADIX_MASK]++] = src[i];
+        }
+        std::swap(src, dst);
+    }
+    if (src != m_distBuffer.data()) m_distBuffer.swap(m_swapBuffer);
+}
@@ -11,12 +11,22 @@ class Distanceclass {
     i32 distance;
 };
 
+/// Orders transparent quads back to front. Each instance owns its
+/// scratch buffers, so use one sorter per thread.
 class GeometrySorter {
 public:
-    static void sortTransparentBlocks(ChunkMesh* cm, const i32v3& cameraPos);
+    /// Sorts the transparent quads of a mesh back to front for cameraPos.
+    /// Skips the sort if the mesh was already sorted from the same voxel
+    /// and its quads did not change (cm->needsSort).
+    /// @param cm: The mesh to sort
+    /// @param cameraPos: Voxel position of the camera
+    /// @return true if cm->transQuadIndices changed and must be uploaded
+    bool sortTransparentBlocks(ChunkMesh* cm, const i32v3& cameraPos);
 
 private:
+    /// Stable LSD radix sort of m_distBuffer by descending distance
+    void radixSort();
 
-
-    static std::vector <Distanceclass> _distBuffer;
-};
\ No newline at end of file
+    std::vector<Distanceclass> m_distBuffer;
+    std::vector<Distanceclass> m_swapBuffer; ///< Radix sort scatter target
+};
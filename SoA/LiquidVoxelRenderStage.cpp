@@ -5,6 +5,7 @@
 #include "BlockTexturePack.h"
 #include "Camera.h"
 #include "Chunk.h"
+#include "ChunkCuller.h"
 #include "ChunkMeshManager.h"
 #include "ChunkRenderer.h"
 #include "GameRenderParams.h"
@@ -18,24 +19,20 @@ void LiquidVoxelRenderStage::hook(ChunkRenderer* renderer, const GameRenderParam
 }
 
 void LiquidVoxelRenderStage::render(const Camera* camera VORB_MAYBE_UNUSED) {
-    ChunkMeshManager* cmm = m_gameRenderParams->chunkMeshmanager;
-    
+    const std::vector<ChunkMesh*>& drawList = m_gameRenderParams->chunkCuller->getDrawList();
+    if (drawList.empty()) return;
+
     m_renderer->beginLiquid(m_gameRenderParams->blockTexturePack->getAtlasTexture(), m_gameRenderParams->sunlightDirection,
                             m_gameRenderParams->sunlightColor);
 
     if (m_gameRenderParams->isUnderwater) glDisable(GL_CULL_FACE);
     glDepthMask(GL_FALSE);
 
-    const std::vector <ChunkMesh *>& chunkMeshes = cmm->getChunkMeshes();
-    {
-        std::lock_guard<std::mutex> l(cmm->lckActiveChunkMeshes);
-        if (chunkMeshes.empty()) return;
-        for (unsigned int i = 0; i < chunkMeshes.size(); i++) //they are sorted backwards??
-        {
-            m_renderer->drawLiquid(chunkMeshes[i],
-                                   m_gameRenderParams->chunkCamera->getPosition(),
-                                   m_gameRenderParams->chunkCamera->getViewProjectionMatrix());
-        }
+    const f64v3& position = m_gameRenderParams->chunkCamera->getPosition();
+    const f32m4& VP = m_gameRenderParams->chunkCamera->getViewProjectionMatrix();
+    // Back to front for blending
+    for (auto it = drawList.rbegin(); it != drawList.rend(); ++it) {
+        m_renderer->drawLiquid(*it, position, VP);
     }
 
     glDepthMask(GL_TRUE);
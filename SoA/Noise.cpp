@@ -590,3 +590,234 @@ f64 Noise::raw(const f64 x, const f64 y, const f64 z, const f64 w) {
     // Sum up and scale the result to cover the range [-1,1]
     return 27.0 * (n0 + n1 + n2 + n3 + n4);
 }
+
+/************************************************************************/
+/* Batched noise                                                        */
+/************************************************************************/
+// The batched kernels in NoiseBatch.inl are compiled once per instruction set.
+// FMA is deliberately left out so the results stay bit-identical to the scalar
+// functions above.
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define NOISE_BATCH_SIMD
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#ifdef NOISE_BATCH_SIMD
+
+#if defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("sse4.1")
+#endif
+namespace NoiseSSE41 {
+    struct NoisePack {
+        static const size_t WIDTH = 2;
+        NoisePack() {}
+        NoisePack(__m128d v) : v(v) {}
+        NoisePack(f64 s) : v(_mm_set1_pd(s)) {}
+        static NoisePack load(const f64* p) { return _mm_loadu_pd(p); }
+        void store(f64* p) const { _mm_storeu_pd(p, v); }
+        __m128d v;
+    };
+    inline NoisePack operator+(const NoisePack& a, const NoisePack& b) { return _mm_add_pd(a.v, b.v); }
+    inline NoisePack operator-(const NoisePack& a, const NoisePack& b) { return _mm_sub_pd(a.v, b.v); }
+    inline NoisePack operator*(const NoisePack& a, const NoisePack& b) { return _mm_mul_pd(a.v, b.v); }
+    inline NoisePack operator/(const NoisePack& a, const NoisePack& b) { return _mm_div_pd(a.v, b.v); }
+    inline NoisePack vfloor(const NoisePack& a) { return _mm_floor_pd(a.v); }
+    inline NoisePack vsqrt(const NoisePack& a) { return _mm_sqrt_pd(a.v); }
+    // (y < x) ? y : x, same as glm::min
+    inline NoisePack vmin(const NoisePack& x, const NoisePack& y) { return _mm_min_pd(y.v, x.v); }
+    // (x < y) ? y : x, same as glm::max
+    inline NoisePack vmax(const NoisePack& x, const NoisePack& y) { return _mm_max_pd(y.v, x.v); }
+    inline NoisePack vlt(const NoisePack& a, const NoisePack& b) { return _mm_cmplt_pd(a.v, b.v); }
+    inline NoisePack vge(const NoisePack& a, const NoisePack& b) { return _mm_cmpge_pd(a.v, b.v); }
+    inline NoisePack vand(const NoisePack& a, const NoisePack& b) { return _mm_and_pd(a.v, b.v); }
+    inline NoisePack vor(const NoisePack& a, const NoisePack& b) { return _mm_or_pd(a.v, b.v); }
+    // ~a & b
+    inline NoisePack vandnot(const NoisePack& a, const NoisePack& b) { return _mm_andnot_pd(a.v, b.v); }
+    // mask ? a : b
+    inline NoisePack vselect(const NoisePack& mask, const NoisePack& a, const NoisePack& b) { return _mm_blendv_pd(b.v, a.v, mask.v); }
+
+    // Per lane permutation lookups, see Noise::raw
+    inline void simplexGradients(const NoisePack& i, const NoisePack& j, const NoisePack& k,
+                                 const NoisePack& i1, const NoisePack& j1, const NoisePack& k1,
+                                 const NoisePack& i2, const NoisePack& j2, const NoisePack& k2,
+                                 OUT NoisePack (&g)[4][3]) {
+        f64 lanes[9][NoisePack::WIDTH];
+        i.store(lanes[0]); j.store(lanes[1]); k.store(lanes[2]);
+        i1.store(lanes[3]); j1.store(lanes[4]); k1.store(lanes[5]);
+        i2.store(lanes[6]); j2.store(lanes[7]); k2.store(lanes[8]);
+        f64 grads[4][3][NoisePack::WIDTH];
+        for (size_t l = 0; l < NoisePack::WIDTH; l++) {
+            int ii = (int)lanes[0][l] & 255;
+            int jj = (int)lanes[1][l] & 255;
+            int kk = (int)lanes[2][l] & 255;
+            int gi[4];
+            gi[0] = Noise::perm[ii + Noise::perm[jj + Noise::perm[kk]]] % 12;
+            gi[1] = Noise::perm[ii + (int)lanes[3][l] + Noise::perm[jj + (int)lanes[4][l] + Noise::perm[kk + (int)lanes[5][l]]]] % 12;
+            gi[2] = Noise::perm[ii + (int)lanes[6][l] + Noise::perm[jj + (int)lanes[7][l] + Noise::perm[kk + (int)lanes[8][l]]]] % 12;
+            gi[3] = Noise::perm[ii + 1 + Noise::perm[jj + 1 + Noise::perm[kk + 1]]] % 12;
+            for (int c = 0; c < 4; c++) {
+                grads[c][0][l] = Noise::grad3[gi[c]][0];
+                grads[c][1][l] = Noise::grad3[gi[c]][1];
+                grads[c][2][l] = Noise::grad3[gi[c]][2];
+            }
+        }
+        for (int c = 0; c < 4; c++) {
+            g[c][0] = NoisePack::load(grads[c][0]);
+            g[c][1] = NoisePack::load(grads[c][1]);
+            g[c][2] = NoisePack::load(grads[c][2]);
+        }
+    }
+
+#include "NoiseBatch.inl"
+}
+#if defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+#if defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#endif
+namespace NoiseAVX2 {
+    struct NoisePack {
+        static const size_t WIDTH = 4;
+        NoisePack() {}
+        NoisePack(__m256d v) : v(v) {}
+        NoisePack(f64 s) : v(_mm256_set1_pd(s)) {}
+        static NoisePack load(const f64* p) { return _mm256_loadu_pd(p); }
+        void store(f64* p) const { _mm256_storeu_pd(p, v); }
+        __m256d v;
+    };
+    inline NoisePack operator+(const NoisePack& a, const NoisePack& b) { return _mm256_add_pd(a.v, b.v); }
+    inline NoisePack operator-(const NoisePack& a, const NoisePack& b) { return _mm256_sub_pd(a.v, b.v); }
+    inline NoisePack operator*(const NoisePack& a, const NoisePack& b) { return _mm256_mul_pd(a.v, b.v); }
+    inline NoisePack operator/(const NoisePack& a, const NoisePack& b) { return _mm256_div_pd(a.v, b.v); }
+    inline NoisePack vfloor(const NoisePack& a) { return _mm256_floor_pd(a.v); }
+    inline NoisePack vsqrt(const NoisePack& a) { return _mm256_sqrt_pd(a.v); }
+    // (y < x) ? y : x, same as glm::min
+    inline NoisePack vmin(const NoisePack& x, const NoisePack& y) { return _mm256_min_pd(y.v, x.v); }
+    // (x < y) ? y : x, same as glm::max
+    inline NoisePack vmax(const NoisePack& x, const NoisePack& y) { return _mm256_max_pd(y.v, x.v); }
+    inline NoisePack vlt(const NoisePack& a, const NoisePack& b) { return _mm256_cmp_pd(a.v, b.v, _CMP_LT_OQ); }
+    inline NoisePack vge(const NoisePack& a, const NoisePack& b) { return _mm256_cmp_pd(a.v, b.v, _CMP_GE_OQ); }
+    inline NoisePack vand(const NoisePack& a, const NoisePack& b) { return _mm256_and_pd(a.v, b.v); }
+    inline NoisePack vor(const NoisePack& a, const NoisePack& b) { return _mm256_or_pd(a.v, b.v); }
+    // ~a & b
+    inline NoisePack vandnot(const NoisePack& a, const NoisePack& b) { return _mm256_andnot_pd(a.v, b.v); }
+    // mask ? a : b
+    inline NoisePack vselect(const NoisePack& mask, const NoisePack& a, const NoisePack& b) { return _mm256_blendv_pd(b.v, a.v, mask.v); }
+
+    inline __m128i permGather(const __m128i& index) {
+        return _mm_i32gather_epi32(Noise::perm, index, 4);
+    }
+    // x % 12 for 0 <= x < 512
+    inline __m128i mod12(const __m128i& x) {
+        __m128i q = _mm_srli_epi32(_mm_mullo_epi32(x, _mm_set1_epi32(2731)), 15);
+        return _mm_sub_epi32(x, _mm_mullo_epi32(q, _mm_set1_epi32(12)));
+    }
+    // Gathered permutation lookups, see Noise::raw
+    inline void simplexGradients(const NoisePack& i, const NoisePack& j, const NoisePack& k,
+                                 const NoisePack& i1, const NoisePack& j1, const NoisePack& k1,
+                                 const NoisePack& i2, const NoisePack& j2, const NoisePack& k2,
+                                 OUT NoisePack (&g)[4][3]) {
+        const __m128i byteMask = _mm_set1_epi32(255);
+        const __m128i one = _mm_set1_epi32(1);
+        __m128i ii = _mm_and_si128(_mm256_cvttpd_epi32(i.v), byteMask);
+        __m128i jj = _mm_and_si128(_mm256_cvttpd_epi32(j.v), byteMask);
+        __m128i kk = _mm_and_si128(_mm256_cvttpd_epi32(k.v), byteMask);
+        __m128i gi[4];
+        gi[0] = permGather(_mm_add_epi32(ii, permGather(_mm_add_epi32(jj, permGather(kk)))));
+        gi[1] = permGather(_mm_add_epi32(_mm_add_epi32(ii, _mm256_cvttpd_epi32(i1.v)),
+                           permGather(_mm_add_epi32(_mm_add_epi32(jj, _mm256_cvttpd_epi32(j1.v)),
+                           permGather(_mm_add_epi32(kk, _mm256_cvttpd_epi32(k1.v)))))));
+        gi[2] = permGather(_mm_add_epi32(_mm_add_epi32(ii, _mm256_cvttpd_epi32(i2.v)),
+                           permGather(_mm_add_epi32(_mm_add_epi32(jj, _mm256_cvttpd_epi32(j2.v)),
+                           permGather(_mm_add_epi32(kk, _mm256_cvttpd_epi32(k2.v)))))));
+        gi[3] = permGather(_mm_add_epi32(_mm_add_epi32(ii, one),
+                           permGather(_mm_add_epi32(_mm_add_epi32(jj, one),
+                           permGather(_mm_add_epi32(kk, one))))));
+        for (int c = 0; c < 4; c++) {
+            __m128i index = _mm_mullo_epi32(mod12(gi[c]), _mm_set1_epi32(3));
+            g[c][0] = _mm256_i32gather_pd(&Noise::grad3[0][0], index, 8);
+            g[c][1] = _mm256_i32gather_pd(&Noise::grad3[0][0], _mm_add_epi32(index, one), 8);
+            g[c][2] = _mm256_i32gather_pd(&Noise::grad3[0][0], _mm_add_epi32(index, _mm_set1_epi32(2)), 8);
+        }
+    }
+
+#include "NoiseBatch.inl"
+}
+#if defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+enum class NoiseBatchPath {
+    SCALAR,
+    SSE41,
+    AVX2
+};
+
+static NoiseBatchPath detectBatchPath() {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    bool hasSSE41 = (info[2] & (1 << 19)) != 0;
+    bool hasOSXSAVE = (info[2] & (1 << 27)) != 0;
+    bool hasAVX = (info[2] & (1 << 28)) != 0;
+    __cpuidex(info, 7, 0);
+    bool hasAVX2 = (info[1] & (1 << 5)) != 0;
+    // Make sure the OS saves the YMM registers
+    if (hasOSXSAVE && hasAVX && hasAVX2 && (_xgetbv(0) & 6) == 6) return NoiseBatchPath::AVX2;
+    if (hasSSE41) return NoiseBatchPath::SSE41;
+#else
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return NoiseBatchPath::AVX2;
+    if (__builtin_cpu_supports("sse4.1")) return NoiseBatchPath::SSE41;
+#endif
+    return NoiseBatchPath::SCALAR;
+}
+
+static const NoiseBatchPath BATCH_PATH = detectBatchPath();
+
+#endif // NOISE_BATCH_SIMD
+
+void Noise::rawBatch(const f64* x, const f64* y, const f64* z, f64 freq, OUT f64* rv, size_t n) {
+#ifdef NOISE_BATCH_SIMD
+    switch (BATCH_PATH) {
+        case NoiseBatchPath::AVX2:
+            NoiseAVX2::simplexBatch(x, y, z, freq, rv, n);
+            return;
+        case NoiseBatchPath::SSE41:
+            NoiseSSE41::simplexBatch(x, y, z, freq, rv, n);
+            return;
+        default:
+            break;
+    }
+#endif
+    for (size_t i = 0; i < n; i++) {
+        rv[i] = raw(x[i] * freq, y[i] * freq, z[i] * freq);
+    }
+}
+
+void Noise::cellularBatch(const f64* x, const f64* y, const f64* z, f64 freq, OUT f64* f1, OUT f64* f2, size_t n) {
+#ifdef NOISE_BATCH_SIMD
+    switch (BATCH_PATH) {
+        case NoiseBatchPath::AVX2:
+            NoiseAVX2::cellularBatch(x, y, z, freq, f1, f2, n);
+            return;
+        case NoiseBatchPath::SSE41:
+            NoiseSSE41::cellularBatch(x, y, z, freq, f1, f2, n);
+            return;
+        default:
+            break;
+    }
+#endif
+    for (size_t i = 0; i < n; i++) {
+        f64v2 ff = cellular(f64v3(x[i], y[i], z[i]) * freq);
+        f1[i] = ff.x;
+        f2[i] = ff.y;
+    }
+}
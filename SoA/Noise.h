@@ -17,6 +17,8 @@
 
 #include <Vorb/io/Keg.h>
 
+#include "NoiseProgram.h"
+
 enum class TerrainStage {
     NOISE,
     SQUARED,
@@ -57,6 +59,7 @@ KEG_TYPE_DECL(TerrainFuncProperties);
 struct NoiseBase {
     f64 base = 0.0f;
     Array<TerrainFuncProperties> funcs;
+    NoiseProgram program; ///< Compiled funcs, see NoiseProgram::compile()
 };
 KEG_TYPE_DECL(NoiseBase);
 
@@ -88,6 +91,11 @@ namespace Noise {
     f64 raw(const f64 x, const f64 y, const f64 z);
     f64 raw(const f64 x, const f64 y, const f64, const f64 w);
 
+    // Batched noise. Evaluates n samples at (x[i], y[i], z[i]) * freq at once using
+    // AVX or SSE4.1 when the CPU supports it. Results are bit-identical to raw() and cellular().
+    void rawBatch(const f64* x, const f64* y, const f64* z, f64 freq, OUT f64* rv, size_t n);
+    void cellularBatch(const f64* x, const f64* y, const f64* z, f64 freq, OUT f64* f1, OUT f64* f2, size_t n);
+
     // Scaled Multi-octave Simplex noise
     // The result will be between the two parameters passed.
     inline f64 scaledFractal(const int octaves, const f64 persistence, const f64 freq, const f64 loBound, const f64 hiBound, const f64 x, const f64 y) {
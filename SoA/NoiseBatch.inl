@@ -0,0 +1,192 @@
+///
+/// NoiseBatch.inl
+/// Seed of Andromeda
+///
+/// Summary:
+/// Batched simplex and cellular noise kernels. This file is included by Noise.cpp
+/// once per instruction set, inside a namespace that defines NoisePack and
+/// simplexGradients() for that instruction set. Every operation here must stay
+/// op-for-op identical to the scalar Noise::raw(x, y, z) and Noise::cellular()
+/// so the results are bit-identical.
+///
+
+// Set of three packs, mirrors the f64v3 math in Noise::cellular()
+struct NoisePack3 {
+    NoisePack3() {}
+    NoisePack3(const NoisePack& x, const NoisePack& y, const NoisePack& z) : x(x), y(y), z(z) {}
+    NoisePack x, y, z;
+};
+inline NoisePack3 operator+(const NoisePack3& a, const NoisePack3& b) { return NoisePack3(a.x + b.x, a.y + b.y, a.z + b.z); }
+inline NoisePack3 operator+(const NoisePack3& a, const NoisePack& b) { return NoisePack3(a.x + b, a.y + b, a.z + b); }
+inline NoisePack3 operator+(const NoisePack& a, const NoisePack3& b) { return NoisePack3(a + b.x, a + b.y, a + b.z); }
+inline NoisePack3 operator-(const NoisePack3& a, const NoisePack& b) { return NoisePack3(a.x - b, a.y - b, a.z - b); }
+inline NoisePack3 operator*(const NoisePack3& a, const NoisePack3& b) { return NoisePack3(a.x * b.x, a.y * b.y, a.z * b.z); }
+inline NoisePack3 operator*(const NoisePack3& a, const NoisePack& b) { return NoisePack3(a.x * b, a.y * b, a.z * b); }
+inline NoisePack3 operator*(const NoisePack& a, const NoisePack3& b) { return NoisePack3(a * b.x, a * b.y, a * b.z); }
+
+inline NoisePack3 vfloor(const NoisePack3& a) { return NoisePack3(vfloor(a.x), vfloor(a.y), vfloor(a.z)); }
+// Same as glm::fract
+inline NoisePack3 vfract(const NoisePack3& a) { return NoisePack3(a.x - vfloor(a.x), a.y - vfloor(a.y), a.z - vfloor(a.z)); }
+// Same as glm::mod
+inline NoisePack vmod(const NoisePack& a, const NoisePack& b) { return a - b * vfloor(a / b); }
+inline NoisePack3 vmod(const NoisePack3& a, const NoisePack& b) { return NoisePack3(vmod(a.x, b), vmod(a.y, b), vmod(a.z, b)); }
+inline NoisePack3 vmin(const NoisePack3& a, const NoisePack3& b) { return NoisePack3(vmin(a.x, b.x), vmin(a.y, b.y), vmin(a.z, b.z)); }
+inline NoisePack3 vmax(const NoisePack3& a, const NoisePack3& b) { return NoisePack3(vmax(a.x, b.x), vmax(a.y, b.y), vmax(a.z, b.z)); }
+
+inline NoisePack3 vpermute(const NoisePack3& x) {
+    return vmod((NoisePack(34.0) * x + NoisePack(1.0)) * x, 289.0);
+}
+
+// Contribution from a single simplex corner
+inline NoisePack simplexCorner(const NoisePack& x, const NoisePack& y, const NoisePack& z, const NoisePack (&g)[3]) {
+    NoisePack t = NoisePack(0.6) - x * x - y * y - z * z;
+    NoisePack t2 = t * t;
+    NoisePack d = g[0] * x + g[1] * y + g[2] * z;
+    return vselect(vlt(t, 0.0), 0.0, t2 * t2 * d);
+}
+
+void simplexBatch(const f64* xs, const f64* ys, const f64* zs, f64 freq, OUT f64* rv, size_t n) {
+    const size_t W = NoisePack::WIDTH;
+    const f64 F3 = 1.0 / 3.0;
+    const f64 G3 = 1.0 / 6.0;
+
+    size_t b = 0;
+    for (; b + W <= n; b += W) {
+        NoisePack x = NoisePack::load(xs + b) * freq;
+        NoisePack y = NoisePack::load(ys + b) * freq;
+        NoisePack z = NoisePack::load(zs + b) * freq;
+
+        // Skew the input space to determine which simplex cell we're in
+        NoisePack s = (x + y + z) * F3;
+        NoisePack i = vfloor(x + s);
+        NoisePack j = vfloor(y + s);
+        NoisePack k = vfloor(z + s);
+
+        NoisePack t = (i + j + k) * G3;
+        NoisePack x0 = x - (i - t);
+        NoisePack y0 = y - (j - t);
+        NoisePack z0 = z - (k - t);
+
+        // Branchless version of the simplex order selection in Noise::raw
+        NoisePack xgey = vge(x0, y0);
+        NoisePack ygez = vge(y0, z0);
+        NoisePack xgez = vge(x0, z0);
+        NoisePack i1 = vselect(vand(xgey, xgez), 1.0, 0.0);
+        NoisePack j1 = vselect(vandnot(xgey, ygez), 1.0, 0.0);
+        NoisePack k1 = vselect(vor(ygez, xgez), 0.0, 1.0);
+        NoisePack i2 = vselect(vor(xgey, xgez), 1.0, 0.0);
+        NoisePack j2 = vselect(vandnot(ygez, xgey), 0.0, 1.0);
+        NoisePack k2 = vselect(vand(ygez, xgez), 0.0, 1.0);
+
+        // Hashed gradients of the four simplex corners
+        NoisePack g[4][3];
+        simplexGradients(i, j, k, i1, j1, k1, i2, j2, k2, g);
+
+        NoisePack x1 = x0 - i1 + G3;
+        NoisePack y1 = y0 - j1 + G3;
+        NoisePack z1 = z0 - k1 + G3;
+        NoisePack x2 = x0 - i2 + 2.0 * G3;
+        NoisePack y2 = y0 - j2 + 2.0 * G3;
+        NoisePack z2 = z0 - k2 + 2.0 * G3;
+        NoisePack x3 = x0 - 1.0 + 3.0 * G3;
+        NoisePack y3 = y0 - 1.0 + 3.0 * G3;
+        NoisePack z3 = z0 - 1.0 + 3.0 * G3;
+
+        NoisePack n0 = simplexCorner(x0, y0, z0, g[0]);
+        NoisePack n1 = simplexCorner(x1, y1, z1, g[1]);
+        NoisePack n2 = simplexCorner(x2, y2, z2, g[2]);
+        NoisePack n3 = simplexCorner(x3, y3, z3, g[3]);
+        (NoisePack(32.0) * (n0 + n1 + n2 + n3)).store(rv + b);
+    }
+    // Remainder
+    for (; b < n; b++) {
+        rv[b] = Noise::raw(xs[b] * freq, ys[b] * freq, zs[b] * freq);
+    }
+}
+
+// Computes the offsets of a single feature point row, see Noise::cellular
+inline NoisePack3 cellularDistance(const NoisePack3& p, const NoisePack3& Pfx, const NoisePack& Pfy, const NoisePack& Pfz) {
+    NoisePack3 ox = vfract(p * K) - NoisePack(Ko);
+    NoisePack3 oy = vmod(vfloor(p * K), 7.0) * K - NoisePack(Ko);
+    NoisePack3 oz = vfloor(p * K2) * Kz - NoisePack(Kzo);
+
+    NoisePack3 dx = Pfx + NoisePack(jitter) * ox;
+    NoisePack3 dy = Pfy + NoisePack(jitter) * oy;
+    NoisePack3 dz = Pfz + NoisePack(jitter) * oz;
+
+    return dx * dx + dy * dy + dz * dz;
+}
+
+void cellularBatch(const f64* xs, const f64* ys, const f64* zs, f64 freq, OUT f64* f1, OUT f64* f2, size_t n) {
+    const size_t W = NoisePack::WIDTH;
+
+    size_t b = 0;
+    for (; b + W <= n; b += W) {
+        NoisePack3 P(NoisePack::load(xs + b) * freq,
+                     NoisePack::load(ys + b) * freq,
+                     NoisePack::load(zs + b) * freq);
+
+        NoisePack3 Pi = vmod(vfloor(P), 289.0);
+        NoisePack3 Pf = vfract(P) - NoisePack(0.5);
+
+        NoisePack3 Pfx = Pf.x + NoisePack3(1.0, 0.0, -1.0);
+        NoisePack3 Pfy = Pf.y + NoisePack3(1.0, 0.0, -1.0);
+        NoisePack3 Pfz = Pf.z + NoisePack3(1.0, 0.0, -1.0);
+
+        NoisePack3 p = vpermute(Pi.x + NoisePack3(-1.0, 0.0, 1.0));
+        NoisePack3 p1 = vpermute(p + Pi.y - 1.0);
+        NoisePack3 p2 = vpermute(p + Pi.y);
+        NoisePack3 p3 = vpermute(p + Pi.y + 1.0);
+
+        NoisePack3 d11 = cellularDistance(vpermute(p1 + Pi.z - 1.0), Pfx, Pfy.x, Pfz.x);
+        NoisePack3 d12 = cellularDistance(vpermute(p1 + Pi.z), Pfx, Pfy.x, Pfz.y);
+        NoisePack3 d13 = cellularDistance(vpermute(p1 + Pi.z + 1.0), Pfx, Pfy.x, Pfz.z);
+        NoisePack3 d21 = cellularDistance(vpermute(p2 + Pi.z - 1.0), Pfx, Pfy.y, Pfz.x);
+        NoisePack3 d22 = cellularDistance(vpermute(p2 + Pi.z), Pfx, Pfy.y, Pfz.y);
+        NoisePack3 d23 = cellularDistance(vpermute(p2 + Pi.z + 1.0), Pfx, Pfy.y, Pfz.z);
+        NoisePack3 d31 = cellularDistance(vpermute(p3 + Pi.z - 1.0), Pfx, Pfy.z, Pfz.x);
+        NoisePack3 d32 = cellularDistance(vpermute(p3 + Pi.z), Pfx, Pfy.z, Pfz.y);
+        NoisePack3 d33 = cellularDistance(vpermute(p3 + Pi.z + 1.0), Pfx, Pfy.z, Pfz.z);
+
+        // Sort out the two smallest distances (F1, F2)
+        NoisePack3 d1a = vmin(d11, d12);
+        d12 = vmax(d11, d12);
+        d11 = vmin(d1a, d13);
+        d13 = vmax(d1a, d13);
+        d12 = vmin(d12, d13);
+        NoisePack3 d2a = vmin(d21, d22);
+        d22 = vmax(d21, d22);
+        d21 = vmin(d2a, d23);
+        d23 = vmax(d2a, d23);
+        d22 = vmin(d22, d23);
+        NoisePack3 d3a = vmin(d31, d32);
+        d32 = vmax(d31, d32);
+        d31 = vmin(d3a, d33);
+        d33 = vmax(d3a, d33);
+        d32 = vmin(d32, d33);
+        NoisePack3 da = vmin(d11, d21);
+        d21 = vmax(d11, d21);
+        d11 = vmin(da, d31);
+        d31 = vmax(da, d31);
+        NoisePack m = vlt(d11.x, d11.y);
+        d11 = NoisePack3(vselect(m, d11.x, d11.y), vselect(m, d11.y, d11.x), d11.z);
+        m = vlt(d11.x, d11.z);
+        d11 = NoisePack3(vselect(m, d11.x, d11.z), d11.y, vselect(m, d11.z, d11.x));
+        d12 = vmin(d12, d21);
+        d12 = vmin(d12, d22);
+        d12 = vmin(d12, d31);
+        d12 = vmin(d12, d32);
+        d11.y = vmin(d11.y, d12.x);
+        d11.z = vmin(d11.z, d12.y);
+        d11.y = vmin(d11.y, d12.z);
+        d11.y = vmin(d11.y, d11.z);
+        vsqrt(d11.x).store(f1 + b);
+        vsqrt(d11.y).store(f2 + b);
+    }
+    // Remainder
+    for (; b < n; b++) {
+        f64v2 ff = Noise::cellular(f64v3(xs[b], ys[b], zs[b]) * freq);
+        f1[b] = ff.x;
+        f2[b] = ff.y;
+    }
+}
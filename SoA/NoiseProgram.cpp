@@ -0,0 +1,417 @@
+#include "stdafx.h"
+#include "NoiseProgram.h"
+
+#include "Noise.h"
+
+const ui8 NoiseProgram::NO_REGISTER;
+
+inline f64 applyOp(TerrainOp op, f64 a, f64 b) {
+    switch (op) {
+        case TerrainOp::ADD: return a + b;
+        case TerrainOp::SUB: return a - b;
+        case TerrainOp::MUL: return a * b;
+        case TerrainOp::DIV: return a / b;
+    }
+    return 0.0;
+}
+
+void NoiseProgram::compile(const Array<TerrainFuncProperties>& funcs) {
+    dispose();
+    compileFuncs(funcs, NO_REGISTER, TerrainOp::ADD, 0);
+    m_isCompiled = true;
+}
+
+void NoiseProgram::dispose() {
+    std::vector<Instruction>().swap(m_instructions);
+    std::vector<f64>().swap(m_frequencies);
+    std::vector<f64>().swap(m_amplitudes);
+    m_numRegisters = 0;
+    m_isCompiled = false;
+}
+
+// NOTE: Make sure this matches SphericalHeightmapGenerator::getNoiseValue()
+void NoiseProgram::compileFuncs(const Array<TerrainFuncProperties>& funcs, ui8 mod, TerrainOp op, ui8 depth) {
+    assert(depth < NO_REGISTER);
+    m_numRegisters = glm::max(m_numRegisters, (ui32)depth + 1);
+
+    for (size_t f = 0; f < funcs.size(); ++f) {
+        auto& fn = funcs[f];
+        bool hasClamp = (fn.clamp[0] != 0.0 || fn.clamp[1] != 0.0);
+        bool hasChildren = (fn.children.size() != 0);
+        size_t skipIndex;
+
+        Instruction in;
+        in.dst = depth;
+        in.mod = mod;
+        in.op = op;
+        in.hasClamp = hasClamp;
+        in.clamp = fn.clamp;
+        in.value = fn.low;
+
+        switch (fn.func) {
+            case TerrainStage::CONSTANT:
+                if (mod == NO_REGISTER) {
+                    // Fold the constant
+                    f64 h = fn.low;
+                    if (hasClamp) h = glm::clamp(h, fn.clamp[0], fn.clamp[1]);
+                    if (!hasChildren) {
+                        emitApplyConstant(fn.op, h);
+                    } else if (!(fn.op == TerrainOp::MUL && h == 0.0)) {
+                        in.code = OpCode::CONSTANT;
+                        in.value = h;
+                        in.hasClamp = false;
+                        m_instructions.push_back(in);
+                        compileFuncs(fn.children, depth, fn.op, depth + 1);
+                    }
+                } else {
+                    in.code = OpCode::CONSTANT;
+                    m_instructions.push_back(in);
+                    if (!hasChildren) {
+                        in.code = OpCode::APPLY;
+                        in.op = fn.op;
+                        m_instructions.push_back(in);
+                    } else {
+                        emitSkip(depth, fn.op, skipIndex);
+                        compileFuncs(fn.children, depth, fn.op, depth + 1);
+                        patchSkip(skipIndex);
+                    }
+                }
+                break;
+            case TerrainStage::PASS_THROUGH:
+                if (hasChildren) {
+                    // Value is never used, children see our parent directly
+                    emitSkip(mod, op, skipIndex);
+                    compileFuncs(fn.children, mod, op, depth + 1);
+                    patchSkip(skipIndex);
+                } else if (mod == NO_REGISTER) {
+                    emitApplyConstant(fn.op, 0.0);
+                } else {
+                    in.code = OpCode::PASS_THROUGH;
+                    m_instructions.push_back(in);
+                    in.code = OpCode::APPLY;
+                    in.op = fn.op;
+                    m_instructions.push_back(in);
+                }
+                break;
+            case TerrainStage::SQUARED:
+            case TerrainStage::CUBED:
+                if (mod != NO_REGISTER) {
+                    in.code = OpCode::POWER;
+                    in.power = (fn.func == TerrainStage::SQUARED) ? 2 : 3;
+                    m_instructions.push_back(in);
+                }
+                if (hasChildren) {
+                    emitSkip(mod, op, skipIndex);
+                    compileFuncs(fn.children, mod, op, depth + 1);
+                    patchSkip(skipIndex);
+                } else {
+                    // Value is 0 unless the parent made it clamp
+                    f64 h = 0.0;
+                    if (mod != NO_REGISTER && hasClamp) h = glm::clamp(h, fn.clamp[0], fn.clamp[1]);
+                    emitApplyConstant(fn.op, h);
+                }
+                break;
+            default: // It's a noise function
+                switch (fn.func) {
+                    case TerrainStage::RIDGED_NOISE:
+                        in.code = OpCode::NOISE_RIDGED;
+                        break;
+                    case TerrainStage::ABS_NOISE:
+                        in.code = OpCode::NOISE_ABS;
+                        break;
+                    case TerrainStage::CELLULAR_NOISE:
+                    case TerrainStage::CELLULAR_SQUARED_NOISE:
+                    case TerrainStage::CELLULAR_CUBED_NOISE:
+                        in.code = OpCode::NOISE_CELLULAR;
+                        if (fn.func == TerrainStage::CELLULAR_SQUARED_NOISE) in.octavePower = 2;
+                        if (fn.func == TerrainStage::CELLULAR_CUBED_NOISE) in.octavePower = 3;
+                        break;
+                    default:
+                        in.code = OpCode::NOISE;
+                        if (fn.func == TerrainStage::SQUARED_NOISE) in.power = 2;
+                        if (fn.func == TerrainStage::CUBED_NOISE) in.power = 3;
+                        break;
+                }
+                // Precompute the octaves
+                in.firstOctave = (ui16)m_frequencies.size();
+                in.numOctaves = (ui16)glm::max(fn.octaves, 0);
+                {
+                    f64 frequency = fn.frequency;
+                    f64 amplitude = 1.0;
+                    for (int i = 0; i < fn.octaves; i++) {
+                        m_frequencies.push_back(frequency);
+                        m_amplitudes.push_back(amplitude);
+                        frequency *= 2.0;
+                        in.maxAmplitude += amplitude;
+                        amplitude *= fn.persistence;
+                    }
+                }
+                in.hasScale = (fn.low != -1.0 || fn.high != 1.0);
+                in.scaleRange = fn.high - fn.low;
+                in.scaleOffset = (fn.high + fn.low) * 0.5;
+                m_instructions.push_back(in);
+
+                if (hasChildren) {
+                    emitSkip(depth, fn.op, skipIndex);
+                    compileFuncs(fn.children, depth, fn.op, depth + 1);
+                    patchSkip(skipIndex);
+                } else {
+                    in.code = OpCode::APPLY;
+                    in.op = fn.op;
+                    m_instructions.push_back(in);
+                }
+                break;
+        }
+    }
+}
+
+void NoiseProgram::emitApplyConstant(TerrainOp op, f64 value) {
+    // Adding or subtracting 0 does nothing
+    if ((op == TerrainOp::ADD || op == TerrainOp::SUB) && value == 0.0) return;
+    Instruction in;
+    in.code = OpCode::APPLY_CONSTANT;
+    in.op = op;
+    in.value = value;
+    m_instructions.push_back(in);
+}
+
+void NoiseProgram::emitSkip(ui8 reg, TerrainOp op, OUT size_t& skipIndex) {
+    // Children of a MUL are skipped when the modifier is 0
+    if (op == TerrainOp::MUL && reg != NO_REGISTER) {
+        skipIndex = m_instructions.size();
+        Instruction in;
+        in.code = OpCode::SKIP_IF_ZERO;
+        in.op = op;
+        in.dst = reg;
+        m_instructions.push_back(in);
+    } else {
+        skipIndex = SIZE_MAX;
+    }
+}
+
+void NoiseProgram::patchSkip(size_t skipIndex) {
+    if (skipIndex == SIZE_MAX) return;
+    if (skipIndex == m_instructions.size() - 1) {
+        // Nothing to skip
+        m_instructions.pop_back();
+    } else {
+        m_instructions[skipIndex].jump = (ui32)m_instructions.size();
+    }
+}
+
+f64 NoiseProgram::finishNoise(const Instruction& in, f64 total, f64 mod) {
+    f64 h = total / in.maxAmplitude;
+    // Handle any post processes per noise
+    if (in.power == 2) {
+        h = h * h;
+    } else if (in.power == 3) {
+        h = h * h * h;
+    }
+    // Conditional scaling.
+    if (in.hasScale) {
+        h = h * in.scaleRange * 0.5 + in.scaleOffset;
+    }
+    // Optional clamp if both fields are not 0.0
+    if (in.hasClamp) {
+        h = glm::clamp(h, in.clamp[0], in.clamp[1]);
+    }
+    // Apply modifier from parent if needed
+    if (in.mod != NO_REGISTER) {
+        h = applyOp(in.op, h, mod);
+    }
+    return h;
+}
+
+void NoiseProgram::execute(const f64v3& pos, f64& height) const {
+    f64 regs[NO_REGISTER];
+
+    const size_t numInstructions = m_instructions.size();
+    for (size_t pc = 0; pc < numInstructions; pc++) {
+        const Instruction& in = m_instructions[pc];
+        f64 mod = (in.mod != NO_REGISTER) ? regs[in.mod] : 0.0;
+        f64 total = 0.0;
+        switch (in.code) {
+            case OpCode::NOISE:
+                for (ui16 o = in.firstOctave; o < in.firstOctave + in.numOctaves; o++) {
+                    const f64& frequency = m_frequencies[o];
+                    total += Noise::raw(pos.x * frequency, pos.y * frequency, pos.z * frequency) * m_amplitudes[o];
+                }
+                regs[in.dst] = finishNoise(in, total, mod);
+                break;
+            case OpCode::NOISE_RIDGED:
+                for (ui16 o = in.firstOctave; o < in.firstOctave + in.numOctaves; o++) {
+                    const f64& frequency = m_frequencies[o];
+                    total += ((1.0 - glm::abs(Noise::raw(pos.x * frequency, pos.y * frequency, pos.z * frequency))) * 2.0 - 1.0) * m_amplitudes[o];
+                }
+                regs[in.dst] = finishNoise(in, total, mod);
+                break;
+            case OpCode::NOISE_ABS:
+                for (ui16 o = in.firstOctave; o < in.firstOctave + in.numOctaves; o++) {
+                    const f64& frequency = m_frequencies[o];
+                    total += glm::abs(Noise::raw(pos.x * frequency, pos.y * frequency, pos.z * frequency)) * m_amplitudes[o];
+                }
+                regs[in.dst] = finishNoise(in, total, mod);
+                break;
+            case OpCode::NOISE_CELLULAR:
+                for (ui16 o = in.firstOctave; o < in.firstOctave + in.numOctaves; o++) {
+                    f64v2 ff = Noise::cellular(pos * m_frequencies[o]);
+                    f64 tmp = ff.y - ff.x;
+                    if (in.octavePower == 1) {
+                        total += tmp * m_amplitudes[o];
+                    } else if (in.octavePower == 2) {
+                        total += tmp * tmp * m_amplitudes[o];
+                    } else {
+                        total += tmp * tmp * tmp * m_amplitudes[o];
+                    }
+                }
+                regs[in.dst] = finishNoise(in, total, mod);
+                break;
+            case OpCode::CONSTANT: {
+                f64 h = in.value;
+                if (in.mod != NO_REGISTER) h = applyOp(in.op, h, mod);
+                if (in.hasClamp) h = glm::clamp(in.mod != NO_REGISTER ? mod : h, in.clamp[0], in.clamp[1]);
+                regs[in.dst] = h;
+                break;
+            }
+            case OpCode::PASS_THROUGH: {
+                f64 h = applyOp(in.op, mod, in.value);
+                if (in.hasClamp) h = glm::clamp(h, in.clamp[0], in.clamp[1]);
+                regs[in.dst] = h;
+                break;
+            }
+            case OpCode::POWER:
+                regs[in.mod] = (in.power == 2) ? mod * mod : mod * mod * mod;
+                break;
+            case OpCode::APPLY:
+                height = applyOp(in.op, height, regs[in.dst]);
+                break;
+            case OpCode::APPLY_CONSTANT:
+                height = applyOp(in.op, height, in.value);
+                break;
+            case OpCode::SKIP_IF_ZERO:
+                if (regs[in.dst] == 0.0) pc = in.jump - 1;
+                break;
+        }
+    }
+}
+
+void NoiseProgram::executeBatch(const f64* x, const f64* y, const f64* z, size_t count, f64* height) const {
+    std::vector<f64> regs(m_numRegisters * count);
+    std::vector<f64> total(count);
+    std::vector<f64> n1(count), n2(count);
+    // Active samples inside nested SKIP_IF_ZERO ranges
+    std::vector<ui8> masks;
+    std::vector<ui32> maskEnds;
+    const ui8* active = nullptr;
+
+    const size_t numInstructions = m_instructions.size();
+    for (size_t pc = 0; pc < numInstructions; pc++) {
+        // Leave finished skip ranges
+        if (maskEnds.size() && maskEnds.back() == pc) {
+            while (maskEnds.size() && maskEnds.back() == pc) maskEnds.pop_back();
+            active = maskEnds.size() ? &masks[(maskEnds.size() - 1) * count] : nullptr;
+        }
+
+        const Instruction& in = m_instructions[pc];
+        f64* dst = (in.dst != NO_REGISTER) ? &regs[in.dst * count] : nullptr;
+        f64* mod = (in.mod != NO_REGISTER) ? &regs[in.mod * count] : nullptr;
+        switch (in.code) {
+            case OpCode::NOISE:
+            case OpCode::NOISE_RIDGED:
+            case OpCode::NOISE_ABS:
+                total.assign(count, 0.0);
+                for (ui16 o = in.firstOctave; o < in.firstOctave + in.numOctaves; o++) {
+                    const f64& amplitude = m_amplitudes[o];
+                    Noise::rawBatch(x, y, z, m_frequencies[o], n1.data(), count);
+                    if (in.code == OpCode::NOISE) {
+                        for (size_t i = 0; i < count; i++) total[i] += n1[i] * amplitude;
+                    } else if (in.code == OpCode::NOISE_RIDGED) {
+                        for (size_t i = 0; i < count; i++) total[i] += ((1.0 - glm::abs(n1[i])) * 2.0 - 1.0) * amplitude;
+                    } else {
+                        for (size_t i = 0; i < count; i++) total[i] += glm::abs(n1[i]) * amplitude;
+                    }
+                }
+                for (size_t i = 0; i < count; i++) {
+                    if (active && !active[i]) continue;
+                    dst[i] = finishNoise(in, total[i], mod ? mod[i] : 0.0);
+                }
+                break;
+            case OpCode::NOISE_CELLULAR:
+                total.assign(count, 0.0);
+                for (ui16 o = in.firstOctave; o < in.firstOctave + in.numOctaves; o++) {
+                    const f64& amplitude = m_amplitudes[o];
+                    Noise::cellularBatch(x, y, z, m_frequencies[o], n1.data(), n2.data(), count);
+                    for (size_t i = 0; i < count; i++) {
+                        f64 tmp = n2[i] - n1[i];
+                        if (in.octavePower == 1) {
+                            total[i] += tmp * amplitude;
+                        } else if (in.octavePower == 2) {
+                            total[i] += tmp * tmp * amplitude;
+                        } else {
+                            total[i] += tmp * tmp * tmp * amplitude;
+                        }
+                    }
+                }
+                for (size_t i = 0; i < count; i++) {
+                    if (active && !active[i]) continue;
+                    dst[i] = finishNoise(in, total[i], mod ? mod[i] : 0.0);
+                }
+                break;
+            case OpCode::CONSTANT:
+                for (size_t i = 0; i < count; i++) {
+                    if (active && !active[i]) continue;
+                    f64 h = in.value;
+                    if (mod) h = applyOp(in.op, h, mod[i]);
+                    if (in.hasClamp) h = glm::clamp(mod ? mod[i] : h, in.clamp[0], in.clamp[1]);
+                    dst[i] = h;
+                }
+                break;
+            case OpCode::PASS_THROUGH:
+                for (size_t i = 0; i < count; i++) {
+                    if (active && !active[i]) continue;
+                    f64 h = applyOp(in.op, mod[i], in.value);
+                    if (in.hasClamp) h = glm::clamp(h, in.clamp[0], in.clamp[1]);
+                    dst[i] = h;
+                }
+                break;
+            case OpCode::POWER:
+                for (size_t i = 0; i < count; i++) {
+                    if (active && !active[i]) continue;
+                    mod[i] = (in.power == 2) ? mod[i] * mod[i] : mod[i] * mod[i] * mod[i];
+                }
+                break;
+            case OpCode::APPLY:
+                for (size_t i = 0; i < count; i++) {
+                    if (active && !active[i]) continue;
+                    height[i] = applyOp(in.op, height[i], dst[i]);
+                }
+                break;
+            case OpCode::APPLY_CONSTANT:
+                for (size_t i = 0; i < count; i++) {
+                    if (active && !active[i]) continue;
+                    height[i] = applyOp(in.op, height[i], in.value);
+                }
+                break;
+            case OpCode::SKIP_IF_ZERO: {
+                size_t level = maskEnds.size();
+                if (masks.size() < (level + 1) * count) {
+                    masks.resize((level + 1) * count);
+                    if (active) active = &masks[(level - 1) * count];
+                }
+                ui8* next = &masks[level * count];
+                bool anyActive = false;
+                for (size_t i = 0; i < count; i++) {
+                    next[i] = (!active || active[i]) && dst[i] != 0.0;
+                    anyActive |= (next[i] != 0);
+                }
+                if (anyActive) {
+                    maskEnds.push_back(in.jump);
+                    active = next;
+                } else {
+                    pc = in.jump - 1;
+                }
+                break;
+            }
+        }
+    }
+}
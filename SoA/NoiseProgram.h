@@ -0,0 +1,85 @@
+///
+/// NoiseProgram.h
+/// Seed of Andromeda
+///
+/// Copyright 2014 Regrowth Studios
+/// MIT License
+///
+/// Summary:
+/// Flattened, pre-folded form of a TerrainFuncProperties tree that the CPU
+/// terrain generator can execute without walking the tree.
+///
+
+#pragma once
+
+#ifndef NoiseProgram_h__
+#define NoiseProgram_h__
+
+struct TerrainFuncProperties;
+enum class TerrainOp;
+
+class NoiseProgram {
+public:
+    /// Compiles a function tree into a flat program. Constants are folded and
+    /// stages that can't affect the result are dropped.
+    void compile(const Array<TerrainFuncProperties>& funcs);
+    void dispose();
+
+    bool isCompiled() const { return m_isCompiled; }
+    size_t getNumInstructions() const { return m_instructions.size(); }
+
+    /// Runs the program at pos, applying the result to height.
+    /// Same result as SphericalHeightmapGenerator::getNoiseValue() without a modifier.
+    void execute(const f64v3& pos, f64& height) const;
+    /// Runs the program for count positions in SoA layout.
+    void executeBatch(const f64* x, const f64* y, const f64* z, size_t count, f64* height) const;
+private:
+    enum class OpCode : ui8 {
+        NOISE, ///< Simplex noise
+        NOISE_RIDGED,
+        NOISE_ABS,
+        NOISE_CELLULAR,
+        CONSTANT, ///< dst = op(value, mod), optionally clamping mod
+        PASS_THROUGH, ///< dst = op(mod, value)
+        POWER, ///< mod = mod ^ power
+        APPLY, ///< height = op(height, dst)
+        APPLY_CONSTANT, ///< height = op(height, value)
+        SKIP_IF_ZERO ///< Skips to jump if dst == 0, for MUL children
+    };
+
+    static const ui8 NO_REGISTER = 0xFF;
+
+    struct Instruction {
+        OpCode code;
+        TerrainOp op;
+        ui8 dst = NO_REGISTER;
+        ui8 mod = NO_REGISTER;
+        ui8 octavePower = 1; ///< Per octave power for cellular noise
+        ui8 power = 1; ///< Power applied to the summed noise
+        bool hasClamp = false;
+        bool hasScale = false;
+        ui16 firstOctave = 0;
+        ui16 numOctaves = 0;
+        ui32 jump = 0;
+        f64 value = 0.0;
+        f64 scaleRange = 0.0; ///< high - low
+        f64 scaleOffset = 0.0; ///< (high + low) * 0.5
+        f64 maxAmplitude = 0.0;
+        f64v2 clamp = f64v2(0.0);
+    };
+
+    void compileFuncs(const Array<TerrainFuncProperties>& funcs, ui8 mod, TerrainOp op, ui8 depth);
+    void emitApplyConstant(TerrainOp op, f64 value);
+    void emitSkip(ui8 reg, TerrainOp op, OUT size_t& skipIndex);
+    void patchSkip(size_t skipIndex);
+    /// Normalizes, scales, clamps and applies the modifier to summed octaves
+    static f64 finishNoise(const Instruction& in, f64 total, f64 mod);
+
+    std::vector<Instruction> m_instructions;
+    std::vector<f64> m_frequencies; ///< Per octave frequencies
+    std::vector<f64> m_amplitudes; ///< Per octave amplitudes
+    ui32 m_numRegisters = 0;
+    bool m_isCompiled = false;
+};
+
+#endif // NoiseProgram_h__
@@ -7,6 +7,7 @@
 #include "Chunk.h"
 #include "BlockPack.h"
 #include "BlockTexturePack.h"
+#include "ChunkCuller.h"
 #include "ChunkMeshManager.h"
 #include "ChunkRenderer.h"
 #include "GameRenderParams.h"
@@ -21,33 +22,24 @@ void OpaqueVoxelRenderStage::hook(ChunkRenderer* renderer, const GameRenderParam
 }
 
 void OpaqueVoxelRenderStage::render(const Camera* camera VORB_MAYBE_UNUSED) {
-    ChunkMeshManager* cmm = m_gameRenderParams->chunkMeshmanager;
+    // Culled and sorted front to back by the ChunkCuller
+    const std::vector<ChunkMesh*>& drawList = m_gameRenderParams->chunkCuller->getDrawList();
+    if (drawList.empty()) return;
 
     const f64v3& position = m_gameRenderParams->chunkCamera->getPosition();
+    const f32m4& VP = m_gameRenderParams->chunkCamera->getViewProjectionMatrix();
 
     m_renderer->beginOpaque(m_gameRenderParams->blockTexturePack->getAtlasTexture(), m_gameRenderParams->sunlightDirection,
                             m_gameRenderParams->sunlightColor);
-    
-    // f64v3 closestPoint;
-    // static const f64v3 boxDims(CHUNK_WIDTH);
-    static const f64v3 boxDims_2(CHUNK_WIDTH / 2);
-    const std::vector <ChunkMesh *>& chunkMeshes = cmm->getChunkMeshes();
-    {
-        std::lock_guard<std::mutex> l(cmm->lckActiveChunkMeshes);
-        if (chunkMeshes.empty()) return;
-        for (int i = chunkMeshes.size() - 1; i >= 0; i--) {
-            ChunkMesh* cm = chunkMeshes[i];
 
-            if (m_gameRenderParams->chunkCamera->sphereInFrustum(f32v3(cm->position + boxDims_2 - position), CHUNK_DIAGONAL_LENGTH)) {
-                // TODO(Ben): Implement perfect fade
-                cm->inFrustum = 1;
-                m_renderer->drawOpaque(cm, position,
-                                       m_gameRenderParams->chunkCamera->getViewProjectionMatrix());
-            } else {
-                cm->inFrustum = 0;
-            }
+    // TODO(Ben): Implement perfect fade
+    if (m_renderer->hasBatchedOpaque()) {
+        m_renderer->drawOpaqueBatched(drawList, position, VP);
+    } else {
+        for (ChunkMesh* cm : drawList) {
+            m_renderer->drawOpaque(cm, position, VP);
         }
     }
-    
+
     m_renderer->end();
 }
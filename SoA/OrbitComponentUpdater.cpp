@@ -3,19 +3,161 @@
 #include "SpaceSystem.h"
 
 #include "Constants.h"
+#include "GameWorkerPool.h"
 #include "soaUtils.h"
 
-void OrbitComponentUpdater::update(SpaceSystem* spaceSystem, f64 time) {
-    for (auto& it : spaceSystem->orbit) {
-        auto& cmp = it.second;
-        if (cmp.parentOrbId) {
-            OrbitComponent* pOrbC = &spaceSystem->orbit.get(cmp.parentOrbId);
-            updatePosition(cmp, time, &spaceSystem->namePosition.get(cmp.npID),
-                              pOrbC,
-                              &spaceSystem->namePosition.get(pOrbC->npID));
-        } else {
-            updatePosition(cmp, time, &spaceSystem->namePosition.get(cmp.npID));
+namespace {
+    const ui32 NO_PARENT = UINT32_MAX;
+    const ui32 UNKNOWN_DEPTH = UINT32_MAX;
+    const ui32 VISITING_DEPTH = UINT32_MAX - 1;
+
+    const int KEPLER_ITERATIONS = 3;
+    // Orbits are solved in blocks, so the anomalies of a block stay on the stack
+    const size_t SOLVE_BLOCK_SIZE = 64;
+    // Levels smaller than two jobs are solved on the calling thread
+    const size_t MIN_ORBITS_PER_JOB = 512;
+
+    const f64 INV_PI = 0.3183098861837907;
+    // pi in two parts, k * PI_HI is exact for any k we'll see
+    const f64 PI_HI = 3.1415926534682512;
+    const f64 PI_LO = 1.2154201013012384e-10;
+    // Adding and subtracting 1.5 * 2^52 rounds to the nearest integer without a call
+    const f64 ROUND_MAGIC = 6755399441055744.0;
+
+    /// sin and cos without calls, branches or compares, so loops over them vectorize.
+    /// Within a few ulp of sin and cos for |x| below about 1e6.
+    inline void sinCos(f64 x, OUT f64& s, OUT f64& c) {
+        // x = k * pi + r with r in [-pi / 2, pi / 2], odd k flips the signs
+        f64 k = (x * INV_PI + ROUND_MAGIC) - ROUND_MAGIC;
+        f64 r = (x - k * PI_HI) - k * PI_LO;
+        f64 halfK = (k * 0.5 + ROUND_MAGIC) - ROUND_MAGIC;
+        f64 sign = 1.0 - 2.0 * fabs(k - 2.0 * halfK);
+
+        // Taylor series, the next terms are below 1e-17 on [-pi / 2, pi / 2]
+        f64 r2 = r * r;
+        f64 ps = 1.9572941063391263e-20;
+        ps = ps * r2 - 8.22063524662433e-18;
+        ps = ps * r2 + 2.8114572543455206e-15;
+        ps = ps * r2 - 7.647163731819816e-13;
+        ps = ps * r2 + 1.6059043836821613e-10;
+        ps = ps * r2 - 2.505210838544172e-08;
+        ps = ps * r2 + 2.7557319223985893e-06;
+        ps = ps * r2 - 0.0001984126984126984;
+        ps = ps * r2 + 0.008333333333333333;
+        ps = ps * r2 - 0.16666666666666666;
+        f64 pc = 4.110317623312165e-19;
+        pc = pc * r2 - 1.5619206968586225e-16;
+        pc = pc * r2 + 4.779477332387385e-14;
+        pc = pc * r2 - 1.1470745597729725e-11;
+        pc = pc * r2 + 2.08767569878681e-09;
+        pc = pc * r2 - 2.755731922398589e-07;
+        pc = pc * r2 + 2.48015873015873e-05;
+        pc = pc * r2 - 0.001388888888888889;
+        pc = pc * r2 + 0.041666666666666664;
+        pc = pc * r2 - 0.5;
+        s = sign * (r + r * r2 * ps);
+        c = sign * (1.0 + r2 * pc);
+    }
+
+    /// Solves Kepler's equation for the eccentric anomaly with Newton's method
+    /// http://www.jgiesen.de/kepler/kepler.html
+    inline f64 solveEccentricAnomaly(f64 meanAnomaly, f64 e) {
+        f64 E = meanAnomaly;
+        for (int n = 0; n < KEPLER_ITERATIONS; n++) {
+            E -= (E - e * sin(E) - meanAnomaly) / (1.0 - e * cos(E));
         }
+        return E;
+    }
+
+    /// Parent relative position and velocity from the eccentric anomaly
+    inline void toCartesian(f64 a, f64 e, f64 o, f64 p, f64 i, f64 parentMass, f64 E,
+                            OUT f64v3& position, OUT f64v3& velocity) {
+        // Calculate true anomaly
+        f64 v = atan2(sqrt(1.0 - e * e) * sin(E), cos(E) - e);
+
+        // Calculate radius
+        // http://www.stargazing.net/kepler/ellipse.html
+        f64 r = a * (1.0 - e * e) / (1.0 + e * cos(v));
+
+        f64 w = p - o; ///< Argument of periapsis
+
+        // Calculate position
+        f64 cosv = cos(v + w);
+        f64 sinv = sin(v + w);
+        f64 coso = cos(o);
+        f64 sino = sin(o);
+        f64 cosi = cos(i);
+        f64 sini = sin(i);
+        position.x = r * (coso * cosv - sino * sinv * cosi);
+        position.y = r * (sinv * sini);
+        position.z = r * (sino * cosv + coso * sinv * cosi);
+
+        // Calculate velocity
+        f64 g = sqrt(M_G * KM_PER_M * parentMass * (2.0 / r - 1.0 / a)) * KM_PER_M;
+        velocity.x = -g * sinv * cosi;
+        velocity.y = g * sinv * sini;
+        velocity.z = g * cosv;
+    }
+}
+
+void OrbitElements::resize(size_t size) {
+    a.resize(size);
+    e.resize(size);
+    o.resize(size);
+    p.resize(size);
+    i.resize(size);
+    parentMass.resize(size);
+    meanMotion.resize(size);
+    startMeanAnomaly.resize(size);
+}
+
+void OrbitComponentUpdater::update(SpaceSystem* spaceSystem, f64 time, OPT GameWorkerPool* workerPool /* = nullptr */) {
+    solve(spaceSystem, time, workerPool);
+
+    // Write back
+    for (size_t s = 0; s < m_ids.size(); s++) {
+        // Fixed bodies keep their position
+        if (m_elements.a[s] == 0.0) continue;
+        OrbitComponent& cmp = spaceSystem->orbit.get(m_ids[s]);
+        cmp.currentMeanAnomaly = (f32)m_meanAnomalies[s];
+        cmp.relativeVelocity = m_relativeVelocities[s];
+        cmp.velocity = m_velocities[s];
+        spaceSystem->namePosition.get(m_npIDs[s]).position = m_positions[s];
+    }
+}
+
+void OrbitComponentUpdater::getPositionsAt(SpaceSystem* spaceSystem, f64 time, OUT std::vector<f64v3>& positions,
+                                           OPT GameWorkerPool* workerPool /* = nullptr */) {
+    solve(spaceSystem, time, workerPool);
+
+    positions.assign(m_slots.size(), f64v3(0.0));
+    for (size_t s = 0; s < m_ids.size(); s++) {
+        positions[m_ids[s]] = m_positions[s];
+    }
+}
+
+void OrbitComponentUpdater::getTrajectory(vecs::ComponentID orbitID, f64 startTime, f64 timeStep, size_t count, OUT f64v3* positions) const {
+    if (orbitID >= m_slots.size()) {
+        for (size_t n = 0; n < count; n++) positions[n] = f64v3(0.0);
+        return;
+    }
+    const OrbitElements& el = m_elements;
+    for (size_t n = 0; n < count; n++) {
+        f64 time = startTime + (f64)n * timeStep;
+        f64v3 position(0.0);
+        // Sum up the chain of parents
+        for (ui32 s = m_slots[orbitID]; s != NO_PARENT; s = m_parents[s]) {
+            if (el.a[s] == 0.0) {
+                position += m_positions[s];
+                break;
+            }
+            f64 E = solveEccentricAnomaly(el.meanMotion[s] * time + el.startMeanAnomaly[s], el.e[s]);
+            f64v3 relPos;
+            f64v3 relVel;
+            toCartesian(el.a[s], el.e[s], el.o[s], el.p[s], el.i[s], el.parentMass[s], E, relPos, relVel);
+            position += relPos;
+        }
+        positions[n] = position;
     }
 }
 
@@ -30,32 +172,12 @@ void OrbitComponentUpdater::updatePosition(OrbitComponent& cmp, f64 time, NamePo
     f64 meanAnomaly = (M_2_PI / cmp.t) * time + cmp.startMeanAnomaly;
     cmp.currentMeanAnomaly = (f32)meanAnomaly;
 
-    f64 v = calculateTrueAnomaly(meanAnomaly, cmp.e);
-  
-    // Calculate radius
-    // http://www.stargazing.net/kepler/ellipse.html
-    f64 r = cmp.a * (1.0 - cmp.e * cmp.e) / (1.0 + cmp.e * cos(v));
-    
-    f64 w = cmp.p - cmp.o; ///< Argument of periapsis
+    // 2. Solve Kepler's equation
+    f64 E = solveEccentricAnomaly(meanAnomaly, cmp.e);
 
-    // Calculate position
+    // 3. Calculate position and velocity
     f64v3 position;
-    f64 cosv = cos(v + cmp.p - cmp.o);
-    f64 sinv = sin(v + cmp.p - cmp.o);
-    f64 coso = cos(cmp.o);
-    f64 sino = sin(cmp.o);
-    f64 cosi = cos(cmp.i);
-    f64 sini = sin(cmp.i);
-    position.x = r * (coso * cosv - sino * sinv * cosi);
-    position.y = r * (sinv * sini);
-    position.z = r * (sino * cosv + coso * sinv * cosi);
-
-    // Calculate velocity
-    f64 g = sqrt(M_G * KM_PER_M * cmp.parentMass * (2.0 / r - 1.0 / cmp.a)) * KM_PER_M;
-    f64 sinwv = sin(w + v);
-    cmp.relativeVelocity.x = -g * sinwv * cosi;
-    cmp.relativeVelocity.y = g * sinwv * sini;
-    cmp.relativeVelocity.z = g * cos(w + v);
+    toCartesian(cmp.a, cmp.e, cmp.o, cmp.p, cmp.i, cmp.parentMass, E, position, cmp.relativeVelocity);
 
     // If this planet has a parent, make it parent relative
     if (parentOrbComponent) {
@@ -68,20 +190,171 @@ void OrbitComponentUpdater::updatePosition(OrbitComponent& cmp, f64 time, NamePo
 }
 
 f64 OrbitComponentUpdater::calculateTrueAnomaly(f64 meanAnomaly, f64 e) {
-    // 2. Solve Kepler's equation to compute eccentric anomaly 
-    // using Newton's method
-    // http://www.jgiesen.de/kepler/kepler.html
-#define ITERATIONS 3
-    f64 E; ///< Eccentric Anomaly
-    f64 F;
-    E = meanAnomaly;
-    F = E - e * sin(meanAnomaly) - meanAnomaly;
-    for (int n = 0; n < ITERATIONS; n++) {
-        E = E -
-            F / (1.0 - e * cos(E));
-        F = E -
-            e * sin(E) - meanAnomaly;
-    }
-    // 3. Calculate true anomaly
+    f64 E = solveEccentricAnomaly(meanAnomaly, e);
     return atan2(sqrt(1.0 - e * e) * sin(E), cos(E) - e);
 }
+
+void OrbitComponentUpdater::buildHierarchy(SpaceSystem* spaceSystem) {
+    auto& orbits = spaceSystem->orbit;
+    // ID 0 is the null component
+    size_t listSize = orbits.getComponentListSize();
+    size_t numOrbits = listSize > 0 ? listSize - 1 : 0;
+
+    // Find the depth of each orbit, walking up to the first known ancestor
+    std::vector<ui32> depths(listSize, UNKNOWN_DEPTH);
+    std::vector<vecs::ComponentID> chain;
+    ui32 maxDepth = 0;
+    for (vecs::ComponentID id = 1; id < listSize; id++) {
+        vecs::ComponentID cur = id;
+        while (cur && cur < listSize && depths[cur] == UNKNOWN_DEPTH) {
+            depths[cur] = VISITING_DEPTH;
+            chain.push_back(cur);
+            cur = orbits.get(cur).parentOrbId;
+        }
+        // Bad parents and cycles are treated as roots
+        ui32 depth = 0;
+        if (cur && cur < listSize && depths[cur] != VISITING_DEPTH) depth = depths[cur] + 1;
+        for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+            depths[*it] = depth++;
+        }
+        if (depth > maxDepth) maxDepth = depth;
+        chain.clear();
+    }
+
+    // Counting sort by depth, stable on ID
+    m_levelStarts.assign(maxDepth + 1, 0);
+    for (vecs::ComponentID id = 1; id < listSize; id++) {
+        m_levelStarts[depths[id] + 1]++;
+    }
+    for (size_t d = 1; d < m_levelStarts.size(); d++) {
+        m_levelStarts[d] += m_levelStarts[d - 1];
+    }
+    std::vector<size_t> next(m_levelStarts.begin(), m_levelStarts.end() - 1);
+    m_ids.resize(numOrbits);
+    m_slots.assign(listSize, NO_PARENT);
+    for (vecs::ComponentID id = 1; id < listSize; id++) {
+        size_t s = next[depths[id]]++;
+        m_ids[s] = id;
+        m_slots[id] = (ui32)s;
+    }
+
+    m_npIDs.resize(numOrbits);
+    m_parentIds.resize(numOrbits);
+    m_parents.resize(numOrbits);
+    for (size_t s = 0; s < numOrbits; s++) {
+        vecs::ComponentID parentId = orbits.get(m_ids[s]).parentOrbId;
+        m_parentIds[s] = parentId;
+        if (parentId && parentId < listSize && depths[parentId] < depths[m_ids[s]]) {
+            m_parents[s] = m_slots[parentId];
+        } else {
+            m_parents[s] = NO_PARENT;
+        }
+    }
+
+    m_elements.resize(numOrbits);
+    m_meanAnomalies.resize(numOrbits);
+    m_relativeVelocities.resize(numOrbits);
+    m_positions.resize(numOrbits);
+    m_velocities.resize(numOrbits);
+}
+
+bool OrbitComponentUpdater::gatherElements(SpaceSystem* spaceSystem) {
+    OrbitElements& el = m_elements;
+    for (size_t s = 0; s < m_ids.size(); s++) {
+        const OrbitComponent& cmp = spaceSystem->orbit.get(m_ids[s]);
+        if (cmp.parentOrbId != m_parentIds[s]) return false;
+        m_npIDs[s] = cmp.npID;
+        el.a[s] = cmp.a;
+        el.e[s] = cmp.e;
+        el.o[s] = cmp.o;
+        el.p[s] = cmp.p;
+        el.i[s] = cmp.i;
+        el.parentMass[s] = cmp.parentMass;
+        el.startMeanAnomaly[s] = cmp.startMeanAnomaly;
+        if (cmp.a == 0.0) {
+            // Fixed bodies are not solved, their children orbit where they are
+            el.meanMotion[s] = 0.0;
+            m_positions[s] = spaceSystem->namePosition.get(cmp.npID).position;
+            m_velocities[s] = cmp.velocity;
+        } else {
+            el.meanMotion[s] = M_2_PI / cmp.t;
+        }
+    }
+    return true;
+}
+
+void OrbitComponentUpdater::solve(SpaceSystem* spaceSystem, f64 time, GameWorkerPool* workerPool) {
+    size_t listSize = spaceSystem->orbit.getComponentListSize();
+    if (m_slots.size() != listSize || !gatherElements(spaceSystem)) {
+        buildHierarchy(spaceSystem);
+        gatherElements(spaceSystem);
+    }
+
+    m_time = time;
+    // Each level only reads the levels above it
+    for (size_t d = 0; d + 1 < m_levelStarts.size(); d++) {
+        solveLevel(m_levelStarts[d], m_levelStarts[d + 1], workerPool);
+    }
+}
+
+void OrbitComponentUpdater::solveRange(size_t begin, size_t end) {
+    const OrbitElements& el = m_elements;
+    f64 M[SOLVE_BLOCK_SIZE];
+    f64 E[SOLVE_BLOCK_SIZE];
+
+    for (size_t b = begin; b < end; b += SOLVE_BLOCK_SIZE) {
+        size_t n = end - b < SOLVE_BLOCK_SIZE ? end - b : SOLVE_BLOCK_SIZE;
+        const f64* e = &el.e[b];
+        const f64* meanMotion = &el.meanMotion[b];
+        const f64* startMeanAnomaly = &el.startMeanAnomaly[b];
+
+        // Mean anomaly
+        for (size_t k = 0; k < n; k++) {
+            M[k] = meanMotion[k] * m_time + startMeanAnomaly[k];
+            E[k] = M[k];
+        }
+        // Newton iterations on the whole block, the inner loop vectorizes
+        for (int it = 0; it < KEPLER_ITERATIONS; it++) {
+            for (size_t k = 0; k < n; k++) {
+                f64 sinE, cosE;
+                sinCos(E[k], sinE, cosE);
+                E[k] -= (E[k] - e[k] * sinE - M[k]) / (1.0 - e[k] * cosE);
+            }
+        }
+
+        for (size_t k = 0; k < n; k++) {
+            size_t s = b + k;
+            if (el.a[s] == 0.0) continue;
+            m_meanAnomalies[s] = M[k];
+            f64v3 position;
+            toCartesian(el.a[s], el.e[s], el.o[s], el.p[s], el.i[s], el.parentMass[s], E[k],
+                        position, m_relativeVelocities[s]);
+            ui32 parent = m_parents[s];
+            if (parent != NO_PARENT) {
+                m_positions[s] = position + m_positions[parent];
+                m_velocities[s] = m_relativeVelocities[s] + m_velocities[parent];
+            } else {
+                m_positions[s] = position;
+                m_velocities[s] = m_relativeVelocities[s];
+            }
+        }
+    }
+}
+
+void OrbitComponentUpdater::solveLevel(size_t begin, size_t end, GameWorkerPool* workerPool) {
+    size_t count = end - begin;
+    size_t numJobs = count / MIN_ORBITS_PER_JOB;
+    if (numJobs < 2 || !workerPool) {
+        solveRange(begin, end);
+        return;
+    }
+
+    size_t numThreads = workerPool->getNumThreads();
+    if (numJobs > numThreads) numJobs = numThreads;
+    size_t jobSize = (count + numJobs - 1) / numJobs;
+    workerPool->run(numJobs, [&](size_t job) {
+        size_t jobBegin = begin + job * jobSize;
+        size_t jobEnd = jobBegin + jobSize < end ? jobBegin + jobSize : end;
+        solveRange(jobBegin, jobEnd);
+    });
+}
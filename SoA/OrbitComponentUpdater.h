@@ -16,15 +16,46 @@
 #define OrbitComponentUpdater_h__
 
 #include <Vorb/types.h>
+#include <Vorb/ecs/Entity.h>
 
+#include <vector>
+
+class GameWorkerPool;
 class SpaceSystem;
 struct NamePositionComponent;
 struct OrbitComponent;
 struct SphericalGravityComponent;
 
+/// Orbital elements of every orbit in hierarchy order, one array per element
+struct OrbitElements {
+    void resize(size_t size);
+
+    std::vector<f64> a; ///< Semi-major axis in KM, 0 for a fixed body
+    std::vector<f64> e;
+    std::vector<f64> o;
+    std::vector<f64> p;
+    std::vector<f64> i;
+    std::vector<f64> parentMass;
+    std::vector<f64> meanMotion; ///< Mean anomaly per second
+    std::vector<f64> startMeanAnomaly;
+};
+
 class OrbitComponentUpdater {
 public:
-    void update(SpaceSystem* spaceSystem, f64 time);
+    /// Moves every orbit to time. Parents are always solved before their children.
+    /// @param workerPool: Splits large levels of the hierarchy, null solves them serially
+    void update(SpaceSystem* spaceSystem, f64 time, OPT GameWorkerPool* workerPool = nullptr);
+
+    /// Space positions of every orbit at time, without touching the components.
+    /// Call from the same thread as update.
+    /// @param positions: Resized to the orbit table, indexed by orbit component ID
+    void getPositionsAt(SpaceSystem* spaceSystem, f64 time, OUT std::vector<f64v3>& positions,
+                        OPT GameWorkerPool* workerPool = nullptr);
+
+    /// Samples the space position of one orbit along its future path, for trajectory
+    /// previews. Uses the elements from the last update.
+    /// @param positions: Receives count positions, at startTime + n * timeStep
+    void getTrajectory(vecs::ComponentID orbitID, f64 startTime, f64 timeStep, size_t count, OUT f64v3* positions) const;
 
     /// Updates the position based on time and parent position
     /// @param cmp: The component to update
@@ -36,6 +67,34 @@ class OrbitComponentUpdater {
                            NamePositionComponent* parentNpComponent = nullptr);
 
     f64 calculateTrueAnomaly(f64 meanAnomaly, f64 e);
+private:
+    /// Sorts the orbits by depth in the hierarchy
+    void buildHierarchy(SpaceSystem* spaceSystem);
+    /// Copies the elements out of the components
+    /// @return false if a parent changed and the hierarchy must be rebuilt
+    bool gatherElements(SpaceSystem* spaceSystem);
+    /// Solves every level of the hierarchy at time
+    void solve(SpaceSystem* spaceSystem, f64 time, GameWorkerPool* workerPool);
+    /// Solves the slots [begin, end), their parents must already be solved
+    void solveRange(size_t begin, size_t end);
+    /// Splits one level of the hierarchy across the workers
+    void solveLevel(size_t begin, size_t end, GameWorkerPool* workerPool);
+
+    // Hierarchy, indexed by slot
+    std::vector<vecs::ComponentID> m_ids;
+    std::vector<vecs::ComponentID> m_npIDs;
+    std::vector<vecs::ComponentID> m_parentIds; ///< To notice reparenting
+    std::vector<ui32> m_parents; ///< Slot of the parent, or NO_PARENT
+    std::vector<ui32> m_slots; ///< Slot of each orbit component ID
+    std::vector<size_t> m_levelStarts; ///< First slot of each depth, plus the end
+    OrbitElements m_elements;
+
+    // Results, indexed by slot
+    std::vector<f64> m_meanAnomalies;
+    std::vector<f64v3> m_relativeVelocities;
+    std::vector<f64v3> m_positions;
+    std::vector<f64v3> m_velocities;
+    f64 m_time = 0.0;
 };
 
-#endif // OrbitComponentUpdater_h__
\ No newline at end of file
+#endif // OrbitComponentUpdater_h__
@@ -6,6 +6,7 @@
 #include "SpaceSystem.h"
 #include "TerrainPatch.h"
 #include "VoxelSpaceConversions.h"
+#include "VoxelBroadPhase.h"
 #include "VoxelSpaceUtils.h"
 #include "soaUtils.h"
 
@@ -18,13 +19,13 @@
 #define EXIT_RADIUS_MULT 1.0205
 
 // TODO(Ben): Timestep
-void PhysicsComponentUpdater::update(GameSystem* gameSystem, SpaceSystem* spaceSystem) {
+void PhysicsComponentUpdater::update(GameSystem* gameSystem, SpaceSystem* spaceSystem, const VoxelBroadPhase& broadPhase) {
   
     for (auto& it : gameSystem->physics) {
         auto& cmp = it.second;
         // Voxel position dictates space position
         if (cmp.voxelPosition) {
-            updateVoxelPhysics(gameSystem, spaceSystem, cmp, it.first);
+            updateVoxelPhysics(gameSystem, spaceSystem, broadPhase, cmp, it.first);
         } else {
             updateSpacePhysics(gameSystem, spaceSystem, cmp, it.first);
         } 
@@ -39,7 +40,7 @@ f64v3 PhysicsComponentUpdater::calculateGravityAcceleration(f64v3 relativePositi
 }
 
 // TODO(Ben): This is a clusterfuck
-void PhysicsComponentUpdater::updateVoxelPhysics(GameSystem* gameSystem, SpaceSystem* spaceSystem,
+void PhysicsComponentUpdater::updateVoxelPhysics(GameSystem* gameSystem, SpaceSystem* spaceSystem, const VoxelBroadPhase& broadPhase,
                                                  PhysicsComponent& pyCmp, vecs::EntityID entity) {
 
     // Get the position component
@@ -67,12 +68,10 @@ void PhysicsComponentUpdater::updateVoxelPhysics(GameSystem* gameSystem, SpaceSy
         f64 height = (vpcmp.gridPosition.pos.y + svcmp.voxelRadius) * M_PER_VOXEL;
         f64 fgrav = M_G * gravCmp.mass / (height * height);
         ChunkID id(VoxelSpaceConversions::voxelToChunk(vpcmp.gridPosition));
-        ChunkHandle chunk = svcmp.chunkGrids[vpcmp.gridPosition.face].accessor.acquire(id);
         // Don't apply gravity in non generated chunks.
-        if (chunk->genLevel == GEN_DONE) {
+        if (broadPhase.isChunkGenerated(svcmp.chunkGrids[vpcmp.gridPosition.face], id)) {
             pyCmp.velocity.y -= (fgrav * 0.1) / FPS;
         }
-        chunk.release();
     }
     // Update position
     vpcmp.gridPosition.pos += pyCmp.velocity;
@@ -17,6 +17,7 @@
 
 class GameSystem;
 class SpaceSystem;
+class VoxelBroadPhase;
 struct PhysicsComponent;
 struct VoxelPositionComponent;
 
@@ -28,7 +29,8 @@ class PhysicsComponentUpdater {
     /// Updates physics components
     /// @param gameSystem: Game ECS
     /// @param spaceSystem: Space ECS.
-    void update(GameSystem* gameSystem, SpaceSystem* spaceSystem);
+    /// @param broadPhase: Holds the chunks under AABB collidables, so gravity checks can skip the lookup
+    void update(GameSystem* gameSystem, SpaceSystem* spaceSystem, const VoxelBroadPhase& broadPhase);
 
     /// Calculates the acceleration vector due to gravity
     /// @relativePosition: Relative position of object to attractor
@@ -36,7 +38,7 @@ class PhysicsComponentUpdater {
     /// @return the acceleration vector
     static f64v3 calculateGravityAcceleration(f64v3 relativePosition, f64 mass);
 private:
-    void updateVoxelPhysics(GameSystem* gameSystem, SpaceSystem* spaceSystem,
+    void updateVoxelPhysics(GameSystem* gameSystem, SpaceSystem* spaceSystem, const VoxelBroadPhase& broadPhase,
                             PhysicsComponent& pyCmp, vecs::EntityID entity);
     void updateSpacePhysics(GameSystem* gameSystem, SpaceSystem* spaceSystem,
                             PhysicsComponent& pyCmp, vecs::EntityID entity);
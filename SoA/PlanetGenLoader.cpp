@@ -153,6 +153,9 @@ CALLER_DELETE PlanetGenData* PlanetGenLoader::getRandomGenData(f32 radius, vcore
     if (radius < 15.0) {
         genData->baseTerrainFuncs.funcs.setData();
     }
+    genData->baseTerrainFuncs.program.compile(genData->baseTerrainFuncs.funcs);
+    genData->tempTerrainFuncs.program.compile(genData->tempTerrainFuncs.funcs);
+    genData->humTerrainFuncs.program.compile(genData->humTerrainFuncs.funcs);
 
     // TODO: Reimplement these as suitable.
     // TODO(Matthew): Note in EVERY case of using RPC, it may be better if RPC owns the function, as otherwise we can't do non-blocking RPC.
@@ -322,6 +325,8 @@ void recursiveInitBiomes(Biome& biome,
     biome.noiseScale = kp.noiseScale;
     biome.terrainNoise = kp.terrainNoise;
     biome.childNoise = kp.childNoise;
+    biome.terrainNoise.program.compile(biome.terrainNoise.funcs);
+    biome.childNoise.program.compile(biome.childNoise.funcs);
 
     // Construct vectors in place for flora and trees
     auto& floraPropList = genData->blockInfo.biomeFlora.insert(
@@ -773,6 +778,7 @@ void PlanetGenLoader::parseTerrainFuncs(NoiseBase* terrainFuncs, keg::ReadContex
         fprintf(stderr, "Keg error %d in parseTerrainFuncs()\n", (int)error);
         return;
     }
+    terrainFuncs->program.compile(terrainFuncs->funcs);
 }
 
 void PlanetGenLoader::parseLiquidColor(keg::ReadContext& context, keg::Node node, PlanetGenData* genData) {
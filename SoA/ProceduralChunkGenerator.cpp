@@ -155,14 +155,7 @@ void ProceduralChunkGenerator::generateHeightmap(Chunk* chunk, PlanetHeightData*
     cornerPos2D.pos.y = cornerPos3D.pos.z;
     cornerPos2D.face = cornerPos3D.face;
 
-    for (int z = 0; z < CHUNK_WIDTH; z++) {
-        for (int x = 0; x < CHUNK_WIDTH; x++) {
-            VoxelPosition2D pos = cornerPos2D;
-            pos.pos.x += x;
-            pos.pos.y += z;
-            m_heightGenerator.generateHeightData(heightData[z * CHUNK_WIDTH + x], pos);
-        }
-    }
+    m_heightGenerator.generateHeightDataBatch(heightData, cornerPos2D, CHUNK_WIDTH);
 }
 
 // Gets layer in O(log(n)) where n is the number of layers
@@ -4,11 +4,16 @@
 #ifdef VORB_OS_WINDOWS
 #include <direct.h> //for mkdir windows
 #include <io.h>
+#else
+#include <unistd.h>
 #endif//VORB_OS_WINDOWS
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <algorithm>
+#include <cerrno>
 
+#include <Vorb/IO.h>
 #include <Vorb/utils.h>
 #include <zlib.h>
 
@@ -20,24 +25,23 @@
 // Section tags
 #define TAG_VOXELDATA 0x1
 
-// TODO: Reimplement missing parts and remove VORB_UNUSED tags.
+const char TAG_VOXELDATA_STR[4] = { TAG_VOXELDATA, 0, 0, 0 };
 
-// const char TAG_VOXELDATA_STR[4] = { TAG_VOXELDATA, 0, 0, 0 };
+// Worst case RLE size: a run per voxel for both arrays, plus the tag
+#define MAX_RLE_CHUNK_SIZE (CHUNK_SIZE * 8 + 4)
 
-inline i32 fileTruncate(i32 fd, i64 size)
-{
-#if defined(_WIN32) || defined(_WIN64) 
-    return _chsize(fd, (long)size);
-#else
-    return ftruncate(fd, size);
-    #define _fileno fileno
-    #define _off_t off_t
-#endif
+inline i32 sectorsFromBytes(ui64 bytes) {
+    return (i32)((bytes + SECTOR_SIZE - 1) / SECTOR_SIZE);
 }
 
-inline i32 sectorsFromBytes(ui32 bytes) {
-    // Adding 0.1f to be damn sure the cast is right
-    return (i32)(ceil(bytes / (float)SECTOR_SIZE) + 0.1f);
+// Shorts are stored little-endian
+inline void setShortLE(ui8* a, ui32 offset, ui16 data) {
+    a[offset] = (ui8)(data & 0xFF);
+    a[offset + 1] = (ui8)((data & 0xFF00) >> 8);
+}
+
+inline ui16 extractShortLE(const ui8* a, ui32 offset) {
+    return (ui16)(a[offset] | (a[offset + 1] << 8));
 }
 
 //returns true on error
@@ -74,11 +78,12 @@ bool checkZlibError(nString message, int zerror) {
 }
 
 RegionFileManager::RegionFileManager(const nString& saveDir) :
-_copySectorsBuffer(nullptr),
+_bufferSize(0),
 _maxCacheSize(8),
-m_saveDir(saveDir),
-_regionFile(nullptr) {
-    // Empty
+m_saveDir(saveDir) {
+    _chunkBuffer.resize(MAX_RLE_CHUNK_SIZE);
+    // Sector padded so whole chunks can be read straight into it
+    _compressedByteBuffer.resize(sectorsFromBytes(sizeof(ChunkHeader) + compressBound(MAX_RLE_CHUNK_SIZE)) * SECTOR_SIZE);
 }
 
 RegionFileManager::~RegionFileManager() {
@@ -90,308 +95,274 @@ void RegionFileManager::clear() {
         closeRegionFile(_regionFileCacheQueue[i]);
     }
 
-    if (_copySectorsBuffer) {
-        delete[] _copySectorsBuffer;
-        _copySectorsBuffer = nullptr;
-    }
-
     _regionFileCache.clear();
     _regionFileCacheQueue.clear();
-    _regionFile = nullptr;
 }
 
-// TODO: Investigate why gridPosition isn't used.
-bool RegionFileManager::openRegionFile(nString region, const ChunkPosition3D& gridPosition VORB_UNUSED, bool create) {
+RegionFile* RegionFileManager::openRegionFile(const nString& region, bool create) {
+
+    //Check if it is cached
+    auto rit = _regionFileCache.find(region);
+    if (rit != _regionFileCache.end()) {
+        RegionFile* rf = rit->second;
+        if (_regionFileCacheQueue.back() != rf) {
+            _regionFileCacheQueue.erase(std::find(_regionFileCacheQueue.begin(), _regionFileCacheQueue.end(), rf));
+            _regionFileCacheQueue.push_back(rf);
+        }
+        return rf;
+    }
+
+    nString filePath = m_saveDir + "/Region/" + region + ".soar";
+
+    if (create && !m_madeDirectories) {
+        vio::buildDirectoryTree(vio::Path(m_saveDir + "/Region"));
+        m_madeDirectories = true;
+    }
+
+    //open file if it exists, create it if we are allowed to
+#ifdef VORB_OS_WINDOWS
+    int fd = _open(filePath.c_str(), _O_RDWR | _O_BINARY | (create ? _O_CREAT : 0), _S_IREAD | _S_IWRITE);
+#else
+    int fd = open(filePath.c_str(), O_RDWR | (create ? O_CREAT : 0), 0644);
+#endif
+    if (fd < 0) {
+        if (create) {
+            perror(filePath.c_str());
+            pError("Failed to create region file ");
+        }
+        return nullptr;
+    }
 
-    nString filePath;
     struct stat statbuf;
-    RegionFile* rf;
+    if (fstat(fd, &statbuf) != 0) {
+        pError("Stat call failed for region file open"); //get the file stats
+#ifdef VORB_OS_WINDOWS
+        _close(fd);
+#else
+        close(fd);
+#endif
+        return nullptr;
+    }
 
-    if (_regionFile && _regionFile->file && region == _regionFile->region) {
-        return true;
+    RegionFile* rf = new RegionFile;
+    memset(&rf->header, 0, sizeof(RegionFileHeader));
+    rf->region = region;
+    rf->fileDescriptor = fd;
+    rf->totalSectors = 0;
+    rf->isHeaderDirty = false;
+
+    ui64 fileSize = (ui64)statbuf.st_size;
+
+    //If the file is new, write an empty header, otherwise load it
+    bool isHeaderValid = (fileSize == 0) ? saveRegionHeader(rf) : loadRegionHeader(rf);
+    if (!isHeaderValid) {
+        // Not cached, so the next call tries again
+        closeRegionFile(rf);
+        return nullptr;
+    }
+    if (fileSize != 0) {
+        if ((fileSize - sizeof(RegionFileHeader)) % SECTOR_SIZE) {
+            pError(filePath + ": Region file chunk storage must be multiple of " + std::to_string(SECTOR_SIZE) + ". Remainder = " + std::to_string((fileSize - sizeof(RegionFileHeader)) % SECTOR_SIZE));
+        }
+        rf->totalSectors = sectorsFromBytes(fileSize - sizeof(RegionFileHeader));
     }
 
-    flush();
+    // Rebuild the used sector map from the lookup table
+    rf->usedSectors.assign(rf->totalSectors, false);
+    for (ui32 i = 0; i < REGION_SIZE; i++) {
+        ui32 offset = BufferUtils::extractInt(rf->header.lookupTable, i * 4);
+        if (offset == 0) continue;
+        ui32 numSectors = extractShortLE(rf->header.sectorCounts, i * 2);
+        ui32 end = offset - 1 + numSectors;
+        if (end > rf->usedSectors.size()) rf->usedSectors.resize(end, false);
+        for (ui32 s = offset - 1; s < end; s++) rf->usedSectors[s] = true;
+    }
+    rf->totalSectors = (i32)rf->usedSectors.size();
 
+    // Only cache region files with a valid header
     if (_regionFileCache.size() == _maxCacheSize) {
         //Remove the oldest region file from the cache
-        rf = _regionFileCacheQueue.front();
+        RegionFile* oldest = _regionFileCacheQueue.front();
         _regionFileCacheQueue.pop_front();
-        _regionFileCache.erase(rf->region);
-        closeRegionFile(rf);
+        _regionFileCache.erase(oldest->region);
+        closeRegionFile(oldest);
     }
-    
-    //Check if it is cached
-    auto rit = _regionFileCache.find(region);
-    if (rit != _regionFileCache.end()) {
-        for (auto it = _regionFileCacheQueue.begin(); it != _regionFileCacheQueue.end(); it++) {
-            if ((*it)->region == region) {
-                RegionFile* rf = (*it);
-                _regionFileCacheQueue.erase(it);
-                _regionFileCacheQueue.push_back(rf);
-                break;
-            }
-        }
-        _regionFile = rit->second;
-        return true;
-    } 
+    _regionFileCache[region] = rf;
+    _regionFileCacheQueue.push_back(rf);
 
+    return rf;
+}
 
-    filePath = m_saveDir + "/Region/" + region + ".soar";
-   
-    //open file if it exists
-    FILE* file = fopen(filePath.c_str(), "rb+");
-
-    //If it doesn't exist
-    if (file == nullptr){
-        //Check if we should create a new region or return false
-        if (create){
-            file = fopen(filePath.c_str(), "wb+"); //create the file
-            if (file == nullptr){
-                perror(filePath.c_str());
-                pError("Failed to create region file ");
-                return false;
-            }
-        } else{
-            return false;
-        }
+void RegionFileManager::closeRegionFile(RegionFile* regionFile) {
+
+    if (regionFile->isHeaderDirty) {
+        saveRegionHeader(regionFile);
     }
 
-    _regionFile = new RegionFile;
-    memset(_regionFile, 0, sizeof(RegionFile));
+#ifdef VORB_OS_WINDOWS
+    _close(regionFile->fileDescriptor);
+#else
+    close(regionFile->fileDescriptor);
+#endif
+    delete regionFile;
+}
 
-    _regionFile->region = region;
-    _regionFile->file = file;
+//Attempt to load a chunk. Returns false on failure
+bool RegionFileManager::loadChunk(const ChunkPosition3D& position, OUT ChunkSaveData& data) {
 
-    _regionFileCache[region] = _regionFile;
-    _regionFileCacheQueue.push_back(_regionFile);
+    RegionFile* rf = openRegionFile(getRegionString(position), false);
+    if (!rf) return false;
 
-    _regionFile->fileDescriptor = _fileno(_regionFile->file); //get file descriptor for truncate if needed
+    ui32 tableIndex = getTableIndex(position);
+    ui32 sectorOffset = BufferUtils::extractInt(rf->header.lookupTable, tableIndex * 4);
+    //0 means it isn't saved
+    if (sectorOffset == 0) return false;
+    sectorOffset--;
+    ui32 numSectors = extractShortLE(rf->header.sectorCounts, tableIndex * 2);
 
-    if (fstat(_regionFile->fileDescriptor, &statbuf) != 0) {
-        pError("Stat call failed for region file open"); //get the file stats
+    size_t readSize = numSectors * SECTOR_SIZE;
+    if (numSectors == 0 || readSize > _compressedByteBuffer.size()) {
+        pError("Region voxel input buffer overflow");
         return false;
     }
-    
-    _off_t fileSize = statbuf.st_size;
 
-    //If the file is new, write an empty header
-    if (fileSize == 0){ 
-        //Save the empty header
-        if (saveRegionHeader() == false) return false;
+    if (!readAt(rf, _compressedByteBuffer.data(), readSize, sizeof(RegionFileHeader) + (ui64)sectorOffset * SECTOR_SIZE)) {
+        pError("Chunk Loading: Did not read enough bytes at " + std::to_string(sectorOffset) + " " + std::to_string(rf->totalSectors));
+        return false;
+    }
 
-        _regionFile->totalSectors = 0;
-        fflush(_regionFile->file);
-    } else{ //load header data into the header class 
+    ChunkHeader chunkHeader;
+    memcpy(&chunkHeader, _compressedByteBuffer.data(), sizeof(ChunkHeader));
+    ui32 dataLength = BufferUtils::extractInt(chunkHeader.dataLength);
+    if (dataLength + sizeof(ChunkHeader) > readSize) {
+        pError("Region voxel input buffer overflow");
+        return false;
+    }
 
-        if (loadRegionHeader() == false) return false;
+    uLongf chunkBufferSize = (uLongf)_chunkBuffer.size();
+    int zresult = uncompress(_chunkBuffer.data(), &chunkBufferSize, _compressedByteBuffer.data() + sizeof(ChunkHeader), dataLength);
+    if (checkZlibError("decompression", zresult)) return false;
+    _bufferSize = (ui32)chunkBufferSize;
 
-        if ((fileSize - sizeof(RegionFileHeader)) % SECTOR_SIZE){
-            pError(filePath + ": Region file chunk storage must be multiple of " + std::to_string(SECTOR_SIZE) + ". Remainder = " + std::to_string(sectorsFromBytes(fileSize - sizeof(RegionFileHeader))));
-            return false;
-        }
-
-        _regionFile->totalSectors = sectorsFromBytes(fileSize - sizeof(RegionFileHeader));
+    ui32 byteIndex = 0;
+    if (_bufferSize < 4 || memcmp(_chunkBuffer.data(), TAG_VOXELDATA_STR, 4) != 0) {
+        pError("Invalid chunk data tag in region " + rf->region);
+        return false;
     }
+    byteIndex += 4;
 
+    data.position = position;
+    if (!rleUncompressArray(data.blocks, byteIndex)) return false;
+    if (!rleUncompressArray(data.tertiary, byteIndex)) return false;
     return true;
 }
 
-void RegionFileManager::closeRegionFile(RegionFile* regionFile) {
-
-    if (regionFile->file == nullptr) return;
+void RegionFileManager::saveChunks(ChunkSaveData* const* chunks, size_t numChunks) {
+    if (numChunks == 0) return;
 
-    if (_regionFile->isHeaderDirty) {
-        saveRegionHeader();
+    // Sort by region, then by position in the region so neighbors are written together.
+    // Stable so a chunk queued twice keeps its copies in queue order.
+    std::vector<std::pair<nString, ChunkSaveData*> > sorted(numChunks);
+    for (size_t i = 0; i < numChunks; i++) {
+        sorted[i].first = getRegionString(chunks[i]->position);
+        sorted[i].second = chunks[i];
     }
+    std::stable_sort(sorted.begin(), sorted.end(), [](const std::pair<nString, ChunkSaveData*>& a,
+                                                      const std::pair<nString, ChunkSaveData*>& b) {
+        if (a.first != b.first) return a.first < b.first;
+        return getTableIndex(a.second->position) < getTableIndex(b.second->position);
+    });
+
+    struct SectorWrite {
+        ui32 sectorOffset;
+        std::vector<ui8> data;
+    };
+    std::vector<SectorWrite> writes;
+    std::vector<ui8> coalesced;
+
+    size_t i = 0;
+    while (i < sorted.size()) {
+        const nString& region = sorted[i].first;
+        RegionFile* rf = openRegionFile(region, true);
+        if (!rf) {
+            // Skip the whole region
+            while (i < sorted.size() && sorted[i].first == region) i++;
+            continue;
+        }
 
-    fclose(regionFile->file);
-    delete regionFile;
-}
+        writes.clear();
+        for (; i < sorted.size() && sorted[i].first == region; i++) {
+            const ChunkSaveData& chunk = *sorted[i].second;
+            // Same chunk may be in the batch twice, the later copy wins
+            if (i + 1 < sorted.size() && sorted[i + 1].first == region &&
+                sorted[i + 1].second->position.pos == chunk.position.pos) continue;
+
+            writes.emplace_back();
+            SectorWrite& write = writes.back();
+            if (!compressChunk(chunk, write.data)) {
+                writes.pop_back();
+                continue;
+            }
+            ui32 numSectors = (ui32)(write.data.size() / SECTOR_SIZE);
+
+            ui32 tableIndex = getTableIndex(chunk.position);
+            ui32 oldOffset = BufferUtils::extractInt(rf->header.lookupTable, tableIndex * 4);
+            ui32 oldSectors = extractShortLE(rf->header.sectorCounts, tableIndex * 2);
+
+            if (oldOffset != 0 && numSectors <= oldSectors) {
+                // Fits in place, give back the tail
+                write.sectorOffset = oldOffset - 1;
+                freeSectors(rf, write.sectorOffset + numSectors, oldSectors - numSectors);
+            } else {
+                if (oldOffset != 0) freeSectors(rf, oldOffset - 1, oldSectors);
+                write.sectorOffset = allocateSectors(rf, numSectors);
+            }
 
-//Attempt to load a chunk. Returns false on failure
-bool RegionFileManager::tryLoadChunk(Chunk* chunk VORB_UNUSED) {
-
-    //nString regionString = getRegionString(chunk);
-
-    ////Open the region file
-    //if (!openRegionFile(regionString, chunk->gridPosition, false)) return false;
-
-    ////Get the chunk sector offset
-    //ui32 chunkSectorOffset = getChunkSectorOffset(chunk);
-    ////If chunkOffset is zero, it hasnt been saved
-    //if (chunkSectorOffset == 0) {
-    //    return false;
-    //}
-
-    ////Location is not stored zero indexed, so that 0 indicates that it hasnt been saved
-    //chunkSectorOffset -= 1;
-
-    ////Seek to the chunk header
-    //if (!seekToChunk(chunkSectorOffset)){
-    //    pError("Region: Chunk data fseek C error! " + std::to_string(sizeof(RegionFileHeader)+chunkSectorOffset * SECTOR_SIZE) + " size: " + std::to_string(_regionFile->totalSectors));
-    //    return false;
-    //}
-
-    ////Get the chunk header
-    //if (!readChunkHeader()) return false;
-
-    //// Read all chunk data
-    //if (!readChunkData_v0()) return false;
-    //
-    //// Read all tags and process the data
-    //_chunkOffset = 0;
-    //while (_chunkOffset < _chunkBufferSize) {
-    //    // Read the tag
-    //    ui32 tag = BufferUtils::extractInt(_chunkBuffer, _chunkOffset);
-    //    _chunkOffset += sizeof(ui32);
-
-    //    switch (tag) {
-    //        case TAG_VOXELDATA:
-    //            //Fill the chunk with the aquired data
-    //            if (!fillChunkVoxelData(chunk)) return false;
-    //            break;
-    //        default:
-    //            std::cout << "INVALID TAG " << tag << std::endl;
-    //            return false;
-    //    }
-    //}
-    //return true;
-    return true;
-}
+            //we add 1 so that 0 can indicate not saved
+            BufferUtils::setInt(rf->header.lookupTable, tableIndex * 4, write.sectorOffset + 1);
+            setShortLE(rf->header.sectorCounts, tableIndex * 2, (ui16)numSectors);
+            rf->isHeaderDirty = true;
+        }
 
-//Saves a chunk to a region file
-bool RegionFileManager::saveChunk(Chunk* chunk VORB_UNUSED) {
-
-    ////Used for copying sectors if we need to resize the file
-    //if (_copySectorsBuffer) {
-    //    delete[] _copySectorsBuffer;
-    //    _copySectorsBuffer = nullptr;
-    //}
-
-    //nString regionString = getRegionString(chunk);
-
-    //if (!openRegionFile(regionString, chunk->gridPosition, true)) return false;
-
-    //ui32 tableOffset;
-    //ui32 chunkSectorOffset = getChunkSectorOffset(chunk, &tableOffset);
-
-    //i32 numOldSectors;
-
-    ////If chunkOffset is zero, then we need to add the entry
-    //if (chunkSectorOffset == 0) {
-
-    //    //Set the sector offset in the table
-    //    BufferUtils::setInt(_regionFile->header.lookupTable, tableOffset, _regionFile->totalSectors + 1); //we add 1 so that 0 can indicate not saved
-    //    _regionFile->isHeaderDirty = true;
-
-    //    chunkSectorOffset = _regionFile->totalSectors;
-
-    //    numOldSectors = 0;
-    //  
-    //} else {
-    //    //Convert sector offset from 1 indexed to 0 indexed
-    //    chunkSectorOffset--;
-    //    //seek to the chunk
-    //    if (!seekToChunk(chunkSectorOffset)){
-    //        pError("Region: Chunk data fseek save error BB! " + std::to_string(chunkSectorOffset));
-    //        return false;
-    //    }
-
-    //    //Get the chunk header
-    //    if (!readChunkHeader()) return false;
-    //    ui32 oldDataLength = BufferUtils::extractInt(_chunkHeader.dataLength);
-    //    numOldSectors = sectorsFromBytes(oldDataLength + sizeof(ChunkHeader));
-
-    //    if (numOldSectors > _regionFile->totalSectors) {
-    //        std::cout << (std::to_string(chunkSectorOffset) + " " + std::to_string(tableOffset) + "Chunk Header Corrupted\n");
-    //        return false;
-    //    }
-    //}
-
-    ////Compress the chunk data
-    //rleCompressChunk(chunk);
-    //zlibCompress();
-
-    //i32 numSectors = sectorsFromBytes(_compressedBufferSize);
-    //i32 sectorDiff = numSectors - numOldSectors;
-
-    ////If we need to resize the number of sectors in the file and this chunk is not at the end of file,
-    ////then we should copy all sectors at the end of the file so we can resize it. This operation should be
-    ////fairly rare.
-    //if ((sectorDiff != 0) && ((chunkSectorOffset + numOldSectors) != _regionFile->totalSectors)) {
-    //    if (!seekToChunk(chunkSectorOffset + numOldSectors)){
-    //        pError("Region: Failed to seek for sectorCopy " + std::to_string(chunkSectorOffset) + " " + std::to_string(numOldSectors) + " " + std::to_string(_regionFile->totalSectors));
-    //        return false;
-    //    }
-
-    //    _copySectorsBufferSize = (_regionFile->totalSectors - (chunkSectorOffset + numOldSectors)) * SECTOR_SIZE;
-    //    _copySectorsBuffer = new ui8[_copySectorsBufferSize]; //for storing all the data that will need to be copied in the end
-    //   
-    //    readSectors(_copySectorsBuffer, _copySectorsBufferSize);
-    //}
-
-    ////Set the header data
-    //BufferUtils::setInt(_chunkHeader.compression, COMPRESSION_RLE | COMPRESSION_ZLIB);
-    //BufferUtils::setInt(_chunkHeader.timeStamp, 0);
-    //BufferUtils::setInt(_chunkHeader.dataLength, _compressedBufferSize - sizeof(ChunkHeader));
-
-    ////Copy the header data to the write buffer
-    //memcpy(_compressedByteBuffer, &_chunkHeader, sizeof(ChunkHeader));
-
-    ////seek to the chunk
-    //if (!seekToChunk(chunkSectorOffset)){
-    //    pError("Region: Chunk data fseek save error GG! " + std::to_string(chunkSectorOffset));
-    //    return false;
-    //}
-
-    ////Write the header and data
-    //writeSectors(_compressedByteBuffer, (ui32)_compressedBufferSize);
-
-    ////Keep track of total sectors in file so we can infer filesize
-    //_regionFile->totalSectors += sectorDiff;
-
-    ////If we need to move some sectors around
-    //if (_copySectorsBuffer) {
-   
-    //    if (!seekToChunk(chunkSectorOffset + numSectors)){
-    //        pError("Region: Chunk data fseek save error GG! " + std::to_string(chunkSectorOffset));
-    //        return false;
-    //    }
-    //    //Write the buffer of sectors
-    //    writeSectors(_copySectorsBuffer, _copySectorsBufferSize);
-    //    delete[] _copySectorsBuffer;
-    //    _copySectorsBuffer = nullptr;
-
-    //    //if the file got smaller
-    //    if (sectorDiff < 0){
-    //        //truncate the file
-    //        if (fileTruncate(_regionFile->fileDescriptor, sizeof(RegionFileHeader)+_regionFile->totalSectors * SECTOR_SIZE) != 0) {
-    //            perror("Region file: Truncate error!\n");
-    //        }
-    //    }
-
-    //    //Update the table
-    //    ui32 nextChunkSectorOffset;
-    //    for (int i = 0; i < REGION_SIZE * 4; i += 4){
-    //        nextChunkSectorOffset = BufferUtils::extractInt(_regionFile->header.lookupTable, i);
-    //        //See if the 1 indexed nextChunkSectorOffset is > the 0 indexed chunkSectorOffset
-    //        if (nextChunkSectorOffset > (chunkSectorOffset + 1)){ 
-    //            BufferUtils::setInt(_regionFile->header.lookupTable, i, nextChunkSectorOffset + sectorDiff);
-    //        } 
-    //    }
-    //    _regionFile->isHeaderDirty = true;
-    //}
-    //fflush(_regionFile->file);
-    return true;
+        // Coalesce writes to contiguous sectors
+        std::sort(writes.begin(), writes.end(), [](const SectorWrite& a, const SectorWrite& b) {
+            return a.sectorOffset < b.sectorOffset;
+        });
+        size_t w = 0;
+        while (w < writes.size()) {
+            ui32 startSector = writes[w].sectorOffset;
+            ui32 endSector = startSector + (ui32)(writes[w].data.size() / SECTOR_SIZE);
+            size_t end = w + 1;
+            while (end < writes.size() && writes[end].sectorOffset == endSector) {
+                endSector += (ui32)(writes[end].data.size() / SECTOR_SIZE);
+                end++;
+            }
+
+            ui64 byteOffset = sizeof(RegionFileHeader) + (ui64)startSector * SECTOR_SIZE;
+            bool success;
+            if (end == w + 1) {
+                success = writeAt(rf, writes[w].data.data(), writes[w].data.size(), byteOffset);
+            } else {
+                coalesced.clear();
+                for (size_t j = w; j < end; j++) {
+                    coalesced.insert(coalesced.end(), writes[j].data.begin(), writes[j].data.end());
+                }
+                success = writeAt(rf, coalesced.data(), coalesced.size(), byteOffset);
+            }
+            if (!success) {
+                pError("Chunk Saving: Did not write enough bytes at " + std::to_string(startSector) + ". Save file may be corrupted!");
+            }
+            w = end;
+        }
+
+        // One header write per region per batch
+        saveRegionHeader(rf);
+    }
 }
 
 void RegionFileManager::flush() {
-    if (_regionFile && _regionFile->file) {
-        if (_regionFile->isHeaderDirty) {
-            saveRegionHeader();
-            fflush(_regionFile->file);
-        }  
+    for (auto& rf : _regionFileCacheQueue) {
+        if (rf->isHeaderDirty) saveRegionHeader(rf);
     }
 }
 
@@ -422,6 +393,7 @@ bool RegionFileManager::checkVersion() {
     SaveVersion version;
 
     fread(&version, 1, sizeof(SaveVersion), file);
+    fclose(file);
 
     ui32 regionVersion = BufferUtils::extractInt(version.regionVersion);
    
@@ -431,379 +403,118 @@ bool RegionFileManager::checkVersion() {
     return true;
 }
 
-bool RegionFileManager::readChunkHeader() {
-    if (fread(&(_chunkHeader), 1, sizeof(ChunkHeader), _regionFile->file) != sizeof(ChunkHeader)) {
+bool RegionFileManager::saveRegionHeader(RegionFile* regionFile) {
+    if (!writeAt(regionFile, &regionFile->header, sizeof(RegionFileHeader), 0)) {
+        pError("Region write error: could not write loc buffer. Save file is corrupted!\n");
         return false;
     }
-    return true;
-}
-
-bool RegionFileManager::readChunkData_v0() {
 
-    ui32 dataLength = BufferUtils::extractInt(_chunkHeader.dataLength);
+    regionFile->isHeaderDirty = false;
 
-    if (dataLength > sizeof(_compressedByteBuffer)) {
-        pError("Region voxel input buffer overflow");
-        return false;
-    }
+    return true;
+}
 
-    if (fread(_compressedByteBuffer, 1, dataLength, _regionFile->file) != dataLength) {
-        std::cout << "Did not read enough bytes at Z\n";
+//Loads the header for the region file and stores it in the region file class
+bool RegionFileManager::loadRegionHeader(RegionFile* regionFile) {
+    if (!readAt(regionFile, &regionFile->header, sizeof(RegionFileHeader), 0)) {
+        pError("Region read error: could not read region header\n");
         return false;
     }
-
-    _chunkBufferSize = CHUNK_DATA_SIZE + CHUNK_SIZE * 2;
-    int zresult = uncompress(_chunkBuffer, &_chunkBufferSize, _compressedByteBuffer, dataLength);
-
-    return (!checkZlibError("decompression", zresult));
- 
+    return true;
 }
 
-int RegionFileManager::rleUncompressArray(ui8* data, ui32& byteIndex, int jStart, int jMult, int jEnd, int jInc, int kStart, int kMult, int kEnd, int kInc) {
-
-    ui8 value;
-    ui16 runSize;
-    int index;
-
-    int i = 0; //y
-    int j = jStart; //z
-    int k = kStart; //x
-    int blockCounter = 0;
-
-    //Read block data
-    while (blockCounter < CHUNK_SIZE){
-        //Grab a run of RLE data
-        runSize = BufferUtils::extractShort(_chunkBuffer, byteIndex);
-        value = _chunkBuffer[byteIndex + 2];
-
-        for (int q = 0; q < runSize; q++){
-            index = i * CHUNK_LAYER + j * jMult + k * kMult;
-
-            if (index >= CHUNK_SIZE){
-                pError("Chunk File Corrupted! Index >= 32768. (" + std::to_string(index) + ") " + std::to_string(q) + " " + std::to_string(runSize) + " " + std::to_string(blockCounter));
-                return 1;
-            }
-
-            data[index] = value;
-
-            blockCounter++;
-            k += kInc;
-            if (k == kEnd){
-                k = kStart;
-                j += jInc;
-                if (j == jEnd){
-                    j = jStart;
-                    i++;
-                }
-            }
+ui32 RegionFileManager::allocateSectors(RegionFile* regionFile, ui32 numSectors) {
+    std::vector<bool>& used = regionFile->usedSectors;
+    // First fit
+    ui32 run = 0;
+    for (ui32 i = 0; i < used.size(); i++) {
+        if (used[i]) {
+            run = 0;
+        } else if (++run == numSectors) {
+            ui32 start = i + 1 - numSectors;
+            for (ui32 s = start; s <= i; s++) used[s] = true;
+            return start;
         }
-        byteIndex += 3;
     }
-    return 0;
+    // Grow the file, reusing any free sectors at the end
+    ui32 start = (ui32)used.size() - run;
+    used.resize(start + numSectors, false);
+    for (ui32 s = start; s < used.size(); s++) used[s] = true;
+    regionFile->totalSectors = (i32)used.size();
+    return start;
 }
 
-int RegionFileManager::rleUncompressArray(ui16* data, ui32& byteIndex, int jStart, int jMult, int jEnd, int jInc, int kStart, int kMult, int kEnd, int kInc) {
-    
-    ui16 value;
-    ui16 runSize;
-    int index;
-
-    int i = 0; //y
-    int j = jStart; //z
-    int k = kStart; //x
-    int blockCounter = 0;
-
-    //Read block data
-    while (blockCounter < CHUNK_SIZE){
-        //Grab a run of RLE data
-        runSize = BufferUtils::extractShort(_chunkBuffer, byteIndex);
-        value = BufferUtils::extractShort(_chunkBuffer, byteIndex + 2);
-
-        for (int q = 0; q < runSize; q++){
-            index = i * CHUNK_LAYER + j * jMult + k * kMult;
-
-            if (index >= CHUNK_SIZE){
-                pError("Chunk File Corrupted! Index >= 32768. (" + std::to_string(index) + ") " + std::to_string(q) + " " + std::to_string(runSize) + " " + std::to_string(blockCounter));
-                return 1;
-            }
-
-            data[index] = value;
+void RegionFileManager::freeSectors(RegionFile* regionFile, ui32 sectorOffset, ui32 numSectors) {
+    std::vector<bool>& used = regionFile->usedSectors;
+    ui32 end = std::min(sectorOffset + numSectors, (ui32)used.size());
+    for (ui32 s = sectorOffset; s < end; s++) used[s] = false;
+}
 
-            blockCounter++;
-            k += kInc;
-            if (k == kEnd){
-                k = kStart;
-                j += jInc;
-                if (j == jEnd){
-                    j = jStart;
-                    i++;
-                }
-            }
+// Runs are stored as [count, value] in linear voxel order
+bool RegionFileManager::rleUncompressArray(ui16* data, ui32& byteIndex) {
+    ui32 index = 0;
+    while (index < CHUNK_SIZE) {
+        if (byteIndex + 4 > _bufferSize) {
+            pError("Region RLE data is truncated");
+            return false;
         }
+        ui32 runSize = extractShortLE(_chunkBuffer.data(), byteIndex);
+        ui16 value = extractShortLE(_chunkBuffer.data(), byteIndex + 2);
         byteIndex += 4;
-    }
-    return 0;
-}
-
-bool RegionFileManager::fillChunkVoxelData(Chunk* chunk VORB_UNUSED) {
-
-    // TODO(Ben): Fix
-
-    //ui8 lightVal;
-
-    //int blockIndex;
-    //int jStart, jEnd, jInc;
-    //int kStart, kEnd, kInc;
-    //int jMult, kMult;
-
-    //chunk->voxelMapData->getIterationConstants(jStart, jMult, jEnd, jInc, kStart, kMult, kEnd, kInc);
-
-    //chunk->numBlocks = 0;
-
-    //if (rleUncompressArray(_blockIDBuffer, _chunkOffset, jStart, jMult, jEnd, jInc, kStart, kMult, kEnd, kInc)) return false;
-
-    //if (rleUncompressArray(_lampLightBuffer, _chunkOffset, jStart, jMult, jEnd, jInc, kStart, kMult, kEnd, kInc)) return false;
-
-    //if (rleUncompressArray(_sunlightBuffer, _chunkOffset, jStart, jMult, jEnd, jInc, kStart, kMult, kEnd, kInc)) return false;
-
-    //if (rleUncompressArray(_tertiaryDataBuffer, _chunkOffset, jStart, jMult, jEnd, jInc, kStart, kMult, kEnd, kInc)) return false;
-
-
-    ////Node buffers, reserving maximum memory so we don't ever need to reallocate. Static so that the memory persists.
-    //static std::vector<IntervalTree<ui16>::LNode> blockIDNodes(CHUNK_SIZE, IntervalTree<ui16>::LNode(0, 0, 0));
-    //static std::vector<IntervalTree<ui16>::LNode> lampLightNodes(CHUNK_SIZE, IntervalTree<ui16>::LNode(0, 0, 0));
-    //static std::vector<IntervalTree<ui8>::LNode> sunlightNodes(CHUNK_SIZE, IntervalTree<ui8>::LNode(0, 0, 0));
-    //static std::vector<IntervalTree<ui16>::LNode> tertiaryDataNodes(CHUNK_SIZE, IntervalTree<ui16>::LNode(0, 0, 0));
-
-    ////Make the size 0
-    //blockIDNodes.clear();
-    //lampLightNodes.clear();
-    //sunlightNodes.clear();
-    //tertiaryDataNodes.clear();
-    // //   chunk->_blockIDContainer.initFromSortedArray()
-
-    //ui16 blockID;
-    //ui16 lampLight;
-    //ui8 sunlight;
-    //ui16 tertiaryData;
-
-    ////Add first nodes
-    //blockIDNodes.push_back(IntervalTree<ui16>::LNode(0, 1, _blockIDBuffer[0]));
-    //lampLightNodes.push_back(IntervalTree<ui16>::LNode(0, 1, _lampLightBuffer[0]));
-    //sunlightNodes.push_back(IntervalTree<ui8>::LNode(0, 1, _sunlightBuffer[0]));
-    //tertiaryDataNodes.push_back(IntervalTree<ui16>::LNode(0, 1, _tertiaryDataBuffer[0]));
-
-    ////Construct the node vectors
-    //for (int i = 1; i < CHUNK_SIZE; i++) {
-    //    blockID = _blockIDBuffer[i];
-    //    lampLight = _lampLightBuffer[i];
-    //    sunlight = _sunlightBuffer[i];
-    //    tertiaryData = _tertiaryDataBuffer[i];
-
-    //    if (blockID != 0) chunk->numBlocks++;
-    //    
-    //    if (GETBLOCK(blockID).spawnerVal || GETBLOCK(blockID).sinkVal){
-    //        chunk->spawnerBlocks.push_back(i);
-    //    }
-
-    //    if (blockID == blockIDNodes.back().data) {
-    //        blockIDNodes.back().length++;
-    //    } else {
-    //        blockIDNodes.push_back(IntervalTree<ui16>::LNode(i, 1, blockID));
-    //    }
-    //    if (lampLight == lampLightNodes.back().data) {
-    //        lampLightNodes.back().length++;
-    //    } else {
-    //        lampLightNodes.push_back(IntervalTree<ui16>::LNode(i, 1, lampLight));
-    //    }
-    //    if (sunlight == sunlightNodes.back().data) {
-    //        sunlightNodes.back().length++;
-    //    } else {
-    //        sunlightNodes.push_back(IntervalTree<ui8>::LNode(i, 1, sunlight));
-    //    }
-    //    if (tertiaryData == tertiaryDataNodes.back().data) {
-    //        tertiaryDataNodes.back().length++;
-    //    } else {
-    //        tertiaryDataNodes.push_back(IntervalTree<ui16>::LNode(i, 1, tertiaryData));
-    //    }
-    //}
-  
-    //chunk->_blockIDContainer.initFromSortedArray(vvox::VoxelStorageState::INTERVAL_TREE, blockIDNodes);
-    //chunk->_lampLightContainer.initFromSortedArray(vvox::VoxelStorageState::INTERVAL_TREE, lampLightNodes);
-    //chunk->_sunlightContainer.initFromSortedArray(vvox::VoxelStorageState::INTERVAL_TREE, sunlightNodes);
-    //chunk->_tertiaryDataContainer.initFromSortedArray(vvox::VoxelStorageState::INTERVAL_TREE, tertiaryDataNodes);
-
-    return true;
-}
 
-//Saves the header for the region file
-bool RegionFileManager::saveRegionHeader() {
-    //Go back to beginning of file to save the header
-    if (!seek(0)) {
-        pError("Fseek error: could not seek to start. Save file is corrupted!\n");
-        return false;
-    }
-    //Save the header
-    if (fwrite(&(_regionFile->header), 1, sizeof(RegionFileHeader), _regionFile->file) != sizeof(RegionFileHeader)){
-        pError("Region write error: could not write loc buffer. Save file is corrupted!\n");
-        return false;
-    }
-
-    _regionFile->isHeaderDirty = false;
-
-    return true;
-}
-
-//Loads the header for the region file and stores it in the region file class
-bool RegionFileManager::loadRegionHeader() {
-
-    if (!seek(0)){
-        pError("Region fseek error F could not seek to start\n");
-        return false;
-    }
-    if (fread(&(_regionFile->header), 1, sizeof(RegionFileHeader), _regionFile->file) != sizeof(RegionFileHeader)){ //read the whole buffer in
-        pError("Region read error: could not read region header\n");
-        return false;
-    }
-
-    return true;
-}
-
-void RegionFileManager::rleCompressArray(ui8* data, int jStart, int jMult, int jEnd, int jInc, int kStart, int kMult, int kEnd, int kInc) {
-    int count = 1;
-    int tot = 0;
-    ui16 curr = data[jStart*jMult + kStart*kMult];
-    int index;
-    int z = 0;
-    bool first = true;
-    for (int i = 0; i < CHUNK_WIDTH; i++){ //y
-        for (int j = jStart; j != jEnd; j += jInc){ //z
-            for (int k = kStart; k != kEnd; k += kInc){ //x 
-                z++;
-                if (!first) {
-                    index = i*CHUNK_LAYER + j*jMult + k*kMult;
-                    if (data[index] != curr){
-                        _chunkBuffer[_bufferSize++] = (ui8)(count & 0xFF);
-                        _chunkBuffer[_bufferSize++] = (ui8)((count & 0xFF00) >> 8);
-                        _chunkBuffer[_bufferSize++] = (ui8)curr;
-                        tot += count;
-
-                        curr = data[index];
-                        count = 1;
-                    } else{
-                        count++;
-                    }
-                } else {
-                    first = false;
-                }
-            }
+        if (runSize == 0 || index + runSize > CHUNK_SIZE) {
+            pError("Region RLE run overflows the chunk");
+            return false;
         }
+        std::fill(data + index, data + index + runSize, value);
+        index += runSize;
     }
-    _chunkBuffer[_bufferSize++] = (ui8)(count & 0xFF);
-    _chunkBuffer[_bufferSize++] = (ui8)((count & 0xFF00) >> 8);
-    tot += count;
-    _chunkBuffer[_bufferSize++] = (ui8)curr;
+    return true;
 }
 
-void RegionFileManager::rleCompressArray(ui16* data, int jStart, int jMult, int jEnd, int jInc, int kStart, int kMult, int kEnd, int kInc) {
-    int count = 1;
-    ui16 curr = data[jStart*jMult + kStart*kMult];
-    int index;
-    int tot = 0;
-    bool first = true;
-    for (int i = 0; i < CHUNK_WIDTH; i++){ //y
-        for (int j = jStart; j != jEnd; j += jInc){ //z
-            for (int k = kStart; k != kEnd; k += kInc){ //x 
-                if (!first){
-                    index = i*CHUNK_LAYER + j*jMult + k*kMult;
-                    if (data[index] != curr){
-                        _chunkBuffer[_bufferSize++] = (ui8)(count & 0xFF);
-                        _chunkBuffer[_bufferSize++] = (ui8)((count & 0xFF00) >> 8);
-                        _chunkBuffer[_bufferSize++] = (ui8)(curr & 0xFF);
-                        _chunkBuffer[_bufferSize++] = (ui8)((curr & 0xFF00) >> 8);                   
-                        tot += count;
-                        curr = data[index];
-                        count = 1;
-                    } else{
-                        count++;
-                    }
-                } else{
-                    first = false;
-                }
-            }
+void RegionFileManager::rleCompressArray(const ui16* data) {
+    ui16 curr = data[0];
+    ui32 count = 1;
+    for (ui32 i = 1; i < CHUNK_SIZE; i++) {
+        // Runs are capped so the count fits in a short
+        if (data[i] != curr || count == 0xFFFF) {
+            setShortLE(_chunkBuffer.data(), _bufferSize, (ui16)count);
+            setShortLE(_chunkBuffer.data(), _bufferSize + 2, curr);
+            _bufferSize += 4;
+            curr = data[i];
+            count = 1;
+        } else {
+            count++;
         }
     }
-    _chunkBuffer[_bufferSize++] = (ui8)(count & 0xFF);
-    _chunkBuffer[_bufferSize++] = (ui8)((count & 0xFF00) >> 8);
-    _chunkBuffer[_bufferSize++] = (ui8)(curr & 0xFF);
-    _chunkBuffer[_bufferSize++] = (ui8)((curr & 0xFF00) >> 8);
-    tot += count;
+    setShortLE(_chunkBuffer.data(), _bufferSize, (ui16)count);
+    setShortLE(_chunkBuffer.data(), _bufferSize + 2, curr);
+    _bufferSize += 4;
 }
 
-bool RegionFileManager::rleCompressChunk(Chunk* chunk VORB_UNUSED) {
-
-    // TODO(Ben): Fix
-
-    //ui16* blockIDData;
-    //ui8* sunlightData;
-    //ui16* lampLightData;
-    //ui16* tertiaryData;
-
-    ////Need to lock so that nobody modifies the interval tree out from under us
-    //chunk->lock();
-    //if (chunk->_blockIDContainer.getState() == vvox::VoxelStorageState::INTERVAL_TREE) {
-    //    blockIDData = _blockIDBuffer;
-    //    chunk->_blockIDContainer.uncompressIntoBuffer(blockIDData);
-    //} else {
-    //    blockIDData = chunk->_blockIDContainer.getDataArray();
-    //}
-    //if (chunk->_lampLightContainer.getState() == vvox::VoxelStorageState::INTERVAL_TREE) {
-    //    lampLightData = _lampLightBuffer;
-    //    chunk->_lampLightContainer.uncompressIntoBuffer(lampLightData);
-    //} else {
-    //    lampLightData = chunk->_lampLightContainer.getDataArray();
-    //}
-    //if (chunk->_sunlightContainer.getState() == vvox::VoxelStorageState::INTERVAL_TREE) {
-    //    sunlightData = _sunlightBuffer;
-    //    chunk->_sunlightContainer.uncompressIntoBuffer(sunlightData);
-    //} else {
-    //    sunlightData = chunk->_sunlightContainer.getDataArray();
-    //}
-    //if (chunk->_tertiaryDataContainer.getState() == vvox::VoxelStorageState::INTERVAL_TREE) {
-    //    tertiaryData = _tertiaryDataBuffer;
-    //    chunk->_tertiaryDataContainer.uncompressIntoBuffer(tertiaryData);
-    //} else {
-    //    tertiaryData = chunk->_tertiaryDataContainer.getDataArray();
-    //}
-    //chunk->unlock();
-
-    //_bufferSize = 0;
-
-    //// Set the tag
-    //memcpy(_chunkBuffer, TAG_VOXELDATA_STR, 4);
-    //_bufferSize += 4;
-
-    //int jStart, jEnd, jInc;
-    //int kStart, kEnd, kInc;
-    //int jMult, kMult;
-
-    //chunk->voxelMapData->getIterationConstants(jStart, jMult, jEnd, jInc, kStart, kMult, kEnd, kInc);
-
-    //rleCompressArray(blockIDData, jStart, jMult, jEnd, jInc, kStart, kMult, kEnd, kInc);
-    //rleCompressArray(lampLightData, jStart, jMult, jEnd, jInc, kStart, kMult, kEnd, kInc);
-    //rleCompressArray(sunlightData, jStart, jMult, jEnd, jInc, kStart, kMult, kEnd, kInc);
-    //rleCompressArray(tertiaryData, jStart, jMult, jEnd, jInc, kStart, kMult, kEnd, kInc);
+bool RegionFileManager::compressChunk(const ChunkSaveData& data, OUT std::vector<ui8>& out) {
+    _bufferSize = 0;
+    memcpy(_chunkBuffer.data(), TAG_VOXELDATA_STR, 4);
+    _bufferSize += 4;
+    rleCompressArray(data.blocks);
+    rleCompressArray(data.tertiary);
 
-    return true;
-}
-
-bool RegionFileManager::zlibCompress() {
-    _compressedBufferSize = CHUNK_DATA_SIZE + CHUNK_SIZE * 2;
     //Compress the data, and leave space for the uncompressed chunk header
-    int zresult = compress2(_compressedByteBuffer + sizeof(ChunkHeader), &_compressedBufferSize, _chunkBuffer, _bufferSize, 6);
-    _compressedBufferSize += sizeof(ChunkHeader);
-
-    return (!checkZlibError("compression", zresult));
+    uLongf compressedSize = (uLongf)(_compressedByteBuffer.size() - sizeof(ChunkHeader));
+    int zresult = compress2(_compressedByteBuffer.data() + sizeof(ChunkHeader), &compressedSize, _chunkBuffer.data(), _bufferSize, 6);
+    if (checkZlibError("compression", zresult)) return false;
+
+    ChunkHeader chunkHeader;
+    BufferUtils::setInt(chunkHeader.compression, COMPRESSION_RLE | COMPRESSION_ZLIB);
+    BufferUtils::setInt(chunkHeader.timeStamp, 0);
+    BufferUtils::setInt(chunkHeader.dataLength, (ui32)compressedSize);
+    memcpy(_compressedByteBuffer.data(), &chunkHeader, sizeof(ChunkHeader));
+
+    // Pad to a whole number of sectors
+    size_t size = sizeof(ChunkHeader) + compressedSize;
+    out.assign(sectorsFromBytes(size) * SECTOR_SIZE, 0);
+    memcpy(out.data(), _compressedByteBuffer.data(), size);
+    return true;
 }
 
 // TODO: Implement this and remove VORB_UNUSED tags.
@@ -812,66 +523,67 @@ bool RegionFileManager::tryConvertSave(ui32 regionVersion VORB_UNUSED) {
     return false;
 }
 
-//Writes sector data, be sure to fseek to the correct position first
-bool RegionFileManager::writeSectors(ui8* srcBuffer, ui32 size) {
-
-    if (size % SECTOR_SIZE) {
-        ui32 padLength = SECTOR_SIZE - size % SECTOR_SIZE;
-        if (padLength == SECTOR_SIZE) padLength = 0;
-        size += padLength;
+bool RegionFileManager::readAt(RegionFile* regionFile, void* dstBuffer, size_t size, ui64 byteOffset) {
+    ui8* dst = (ui8*)dstBuffer;
+#ifdef VORB_OS_WINDOWS
+    if (_lseeki64(regionFile->fileDescriptor, (__int64)byteOffset, SEEK_SET) < 0) return false;
+    while (size) {
+        int bytes = _read(regionFile->fileDescriptor, dst, (unsigned)size);
+        if (bytes <= 0) return false;
+        dst += bytes;
+        size -= bytes;
     }
-
-    if (fwrite(srcBuffer, 1, size, _regionFile->file) != size) {
-        pError("Chunk Saving: Did not write enough bytes at A " + std::to_string(size));
-        return false;
+#else
+    while (size) {
+        ssize_t bytes = pread(regionFile->fileDescriptor, dst, size, (off_t)byteOffset);
+        if (bytes <= 0) {
+            if (bytes < 0 && errno == EINTR) continue;
+            return false;
+        }
+        dst += bytes;
+        size -= bytes;
+        byteOffset += bytes;
     }
+#endif
     return true;
 }
 
-//Read sector data, be sure to fseek to the correct position first
-bool RegionFileManager::readSectors(ui8* dstBuffer, ui32 size) {
-    if (fread(dstBuffer, 1, size, _regionFile->file) != size) {
-        pError("Chunk Loading: Did not read enough bytes at A " + std::to_string(size) + " " + std::to_string(_regionFile->totalSectors));
-        return false;
+bool RegionFileManager::writeAt(RegionFile* regionFile, const void* srcBuffer, size_t size, ui64 byteOffset) {
+    const ui8* src = (const ui8*)srcBuffer;
+#ifdef VORB_OS_WINDOWS
+    if (_lseeki64(regionFile->fileDescriptor, (__int64)byteOffset, SEEK_SET) < 0) return false;
+    while (size) {
+        int bytes = _write(regionFile->fileDescriptor, src, (unsigned)size);
+        if (bytes <= 0) return false;
+        src += bytes;
+        size -= bytes;
+    }
+#else
+    while (size) {
+        ssize_t bytes = pwrite(regionFile->fileDescriptor, src, size, (off_t)byteOffset);
+        if (bytes <= 0) {
+            if (bytes < 0 && errno == EINTR) continue;
+            return false;
+        }
+        src += bytes;
+        size -= bytes;
+        byteOffset += bytes;
     }
+#endif
     return true;
 }
 
-bool RegionFileManager::seek(ui32 byteOffset) {
-    return (fseek(_regionFile->file, byteOffset, SEEK_SET) == 0);
+ui32 RegionFileManager::getTableIndex(const ChunkPosition3D& position) {
+    //modulus is weird in c++ for negative numbers
+    ui32 x = (ui32)position.pos.x & (REGION_WIDTH - 1);
+    ui32 y = (ui32)position.pos.y & (REGION_WIDTH - 1);
+    ui32 z = (ui32)position.pos.z & (REGION_WIDTH - 1);
+    return x + z * REGION_WIDTH + y * REGION_LAYER;
 }
 
-bool RegionFileManager::seekToChunk(ui32 chunkSectorOffset) {
-    //seek to the chunk
-    return seek(sizeof(RegionFileHeader) + chunkSectorOffset * SECTOR_SIZE);
+nString RegionFileManager::getRegionString(const ChunkPosition3D& position) {
+    return "r." + std::to_string((int)position.face) + "."
+        + std::to_string(position.pos.x >> RSHIFT) + "."
+        + std::to_string(position.pos.y >> RSHIFT) + "."
+        + std::to_string(position.pos.z >> RSHIFT);
 }
-
-ui32 RegionFileManager::getChunkSectorOffset(Chunk* chunk VORB_UNUSED, ui32* retTableOffset VORB_UNUSED) {
-    
-    //const ChunkPosition3D& gridPos = chunk->gridPosition;
-
-    //int x = gridPos.pos.x % REGION_WIDTH;
-    //int y = gridPos.pos.y % REGION_WIDTH;
-    //int z = gridPos.pos.z % REGION_WIDTH;
-
-    ////modulus is weird in c++ for negative numbers
-    //if (x < 0) x += REGION_WIDTH;
-    //if (y < 0) y += REGION_WIDTH;
-    //if (z < 0) z += REGION_WIDTH;
-    //ui32 tableOffset = 4 * (x + z * REGION_WIDTH + y * REGION_LAYER);
-
-    ////If the caller asked for the table offset, return it
-    //if (retTableOffset) *retTableOffset = tableOffset;
-
-    //return BufferUtils::extractInt(_regionFile->header.lookupTable, tableOffset);
-    return 0;
-}
-
-nString RegionFileManager::getRegionString(Chunk *ch)
-{
-    const ChunkPosition3D& gridPos = ch->getChunkPosition();
-
-    return "r." + std::to_string(fastFloor((float)gridPos.pos.x / REGION_WIDTH)) + "."
-        + std::to_string(fastFloor((float)gridPos.pos.y / REGION_WIDTH)) + "."
-        + std::to_string(fastFloor((float)gridPos.pos.z / REGION_WIDTH));
-}
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 #include <deque>
 #include <map>
+#include <vector>
 
 #include <zconf.h>
 #include <Vorb/Vorb.h>
@@ -20,8 +21,9 @@
 #define REGION_SIZE 4096
 
 #define REGION_VER_0 1000
+#define REGION_VER_1 1001 ///< Sector counts in the header, chunks stored by linear voxel index
 
-#define CURRENT_REGION_VER REGION_VER_0
+#define CURRENT_REGION_VER REGION_VER_1
 
 #define CHUNK_DATA_SIZE (CHUNK_SIZE * 4) //right now a voxel is 4 bytes
 
@@ -38,16 +40,17 @@ class ChunkHeader {
 
 class RegionFileHeader {
 public:
-    ui8 lookupTable[REGION_SIZE * 4];
+    ui8 lookupTable[REGION_SIZE * 4]; ///< 1 indexed sector offset of each chunk, 0 if not saved
+    ui8 sectorCounts[REGION_SIZE * 2]; ///< Number of sectors each chunk occupies
 };
 
 class RegionFile {
 public:
     RegionFileHeader header;
     nString region;
-    FILE* file;
     int fileDescriptor;
     i32 totalSectors;
+    std::vector<bool> usedSectors; ///< Sectors that hold chunk data, for reuse of freed space
     bool isHeaderDirty;
 };
 
@@ -57,8 +60,15 @@ class SaveVersion {
     ui8 chunkVersion[4];
 };
 
-class Chunk;
+/// Flat voxel data of a single chunk, as read from or written to a region file
+struct ChunkSaveData {
+    ChunkPosition3D position;
+    ui16 blocks[CHUNK_SIZE];
+    ui16 tertiary[CHUNK_SIZE];
+};
 
+/// Reads and writes chunks in region files. Not thread safe, owned by the
+/// ChunkIOManager thread.
 class RegionFileManager {
 public:
     RegionFileManager(const nString& saveDir);
@@ -66,69 +76,50 @@ class RegionFileManager {
 
     void clear();
 
-    bool openRegionFile(nString region, const ChunkPosition3D& gridPosition, bool create);
-
-    bool tryLoadChunk(Chunk* chunk);
-    bool saveChunk(Chunk* chunk);
+    /// Reads a chunk into data. Returns false if it was never saved.
+    bool loadChunk(const ChunkPosition3D& position, OUT ChunkSaveData& data);
+    /// Writes a batch of chunks. Chunks are grouped by region so each region header
+    /// is written once, and chunks that land in adjacent sectors share one write.
+    void saveChunks(ChunkSaveData* const* chunks, size_t numChunks);
 
     void flush();
 
     bool saveVersionFile();
     bool checkVersion();
 private:
+    RegionFile* openRegionFile(const nString& region, bool create);
     void closeRegionFile(RegionFile* regionFile);
 
-    bool readChunkHeader();
-    bool readChunkData_v0();
-
-    int rleUncompressArray(ui8* data, ui32& byteIndex, int jStart, int jMult, int jEnd, int jInc, int kStart, int kMult, int kEnd, int kInc);
-    int rleUncompressArray(ui16* data, ui32& byteIndex, int jStart, int jMult, int jEnd, int jInc, int kStart, int kMult, int kEnd, int kInc);
-    bool fillChunkVoxelData(Chunk* chunk);
+    bool saveRegionHeader(RegionFile* regionFile);
+    bool loadRegionHeader(RegionFile* regionFile);
 
-    bool saveRegionHeader();
-    bool loadRegionHeader();
+    /// Finds numSectors free contiguous sectors, growing the file if needed
+    ui32 allocateSectors(RegionFile* regionFile, ui32 numSectors);
+    void freeSectors(RegionFile* regionFile, ui32 sectorOffset, ui32 numSectors);
 
-    void rleCompressArray(ui8* data, int jStart, int jMult, int jEnd, int jInc, int kStart, int kMult, int kEnd, int kInc);
-    void rleCompressArray(ui16* data, int jStart, int jMult, int jEnd, int jInc, int kStart, int kMult, int kEnd, int kInc);
-    bool rleCompressChunk(Chunk* chunk);
-    bool zlibCompress();
+    void rleCompressArray(const ui16* data);
+    bool rleUncompressArray(ui16* data, ui32& byteIndex);
+    /// RLE and zlib compresses a chunk into sector padded data in out
+    bool compressChunk(const ChunkSaveData& data, OUT std::vector<ui8>& out);
 
     bool tryConvertSave(ui32 regionVersion);
 
-    bool writeSectors(ui8* srcBuffer, ui32 size);
-    bool readSectors(ui8* dstBuffer, ui32 size);
+    bool readAt(RegionFile* regionFile, void* dstBuffer, size_t size, ui64 byteOffset);
+    bool writeAt(RegionFile* regionFile, const void* srcBuffer, size_t size, ui64 byteOffset);
 
-    bool seek(ui32 byteOffset);
-    bool seekToChunk(ui32 chunkSectorOffset);
+    static ui32 getTableIndex(const ChunkPosition3D& position);
+    static nString getRegionString(const ChunkPosition3D& position);
 
-    ui32 getChunkSectorOffset(Chunk* chunk, ui32* retTableOffset = nullptr);
-    nString getRegionString(Chunk* chunk);
-    
-    //Byte buffer for reading chunk data
+    //Byte buffer for RLE chunk data
     ui32 _bufferSize;
-    ui8 _chunkBuffer[CHUNK_DATA_SIZE];
-    //Byte buffer for compressed data. It is slightly larger because of worst case with RLE
-    uLongf _compressedBufferSize;
-    ui8 _compressedByteBuffer[CHUNK_DATA_SIZE + CHUNK_SIZE * 4 + sizeof(ChunkHeader)];
-    //Dynamic byte buffer used in copying contents of a file for resize
-//    ui32 _copySectorsBufferSize;
-    ui8* _copySectorsBuffer;
-
-//    ui16 _blockIDBuffer[CHUNK_SIZE];
-//    ui8 _sunlightBuffer[CHUNK_SIZE];
-//    ui16 _lampLightBuffer[CHUNK_SIZE];
-//    ui16 _tertiaryDataBuffer[CHUNK_SIZE];
-
-//    ui8 _chunkHeaderBuffer[sizeof(ChunkHeader)];
-//    ui8 _regionFileHeaderBuffer[sizeof(RegionFileHeader)];
-    
+    std::vector<ui8> _chunkBuffer;
+    //Byte buffer for zlib compressed data
+    std::vector<ui8> _compressedByteBuffer;
+
     ui32 _maxCacheSize;
-//    ui32 _chunkOffset; ///< Offset into the chunk data
-    uLongf _chunkBufferSize;
     std::map <nString, RegionFile*> _regionFileCache;
     std::deque <RegionFile*> _regionFileCacheQueue;
 
     nString m_saveDir;
-    RegionFile* _regionFile;
-    ChunkHeader _chunkHeader;
-};
\ No newline at end of file
+    bool m_madeDirectories = false;
+};
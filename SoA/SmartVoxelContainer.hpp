@@ -15,7 +15,10 @@
 #ifndef SmartVoxelContainer_h__
 #define SmartVoxelContainer_h__
 
+#include <algorithm>
+#include <atomic>
 #include <mutex>
+#include <shared_mutex>
 
 #include "Constants.h"
 
@@ -24,6 +27,7 @@
 
 #define QUIET_FRAMES_UNTIL_COMPRESS 60
 #define ACCESS_COUNT_UNTIL_DECOMPRESS 5
+#define MAX_PALETTE_BITS 8 ///< Past this a palette saves too little over a flat array
 
 // TODO(Cristian): We'll see how to fit it into Vorb
 namespace vorb {
@@ -68,7 +72,8 @@ namespace vorb {
 
         enum class VoxelStorageState {
             FLAT_ARRAY = 0,
-            INTERVAL_TREE = 1
+            INTERVAL_TREE = 1,
+            PALETTE = 2 ///< Distinct values plus bit packed indices into them
         };
 
         template <typename T, size_t SIZE = CHUNK_SIZE>
@@ -94,6 +99,13 @@ namespace vorb {
             void setArrayRecycler(vcore::FixedSizeArrayRecycler<SIZE, T>* arrayRecycler) {
                 _arrayRecycler = arrayRecycler;
             }
+            /*! @brief Set a counter of bytes held in flat arrays, for memory budgets.
+            *
+            * @param arrayBytes: Counter shared by many containers, or nullptr for none.
+            */
+            void setArrayByteCounter(std::atomic<size_t>* arrayBytes) {
+                _arrayBytes = arrayBytes;
+            }
 
             SmartHandle<T, SIZE> operator[] (size_t index) {
                 return std::move(SmartHandle<T, SIZE>(*this, index));
@@ -106,7 +118,8 @@ namespace vorb {
             inline void init(VoxelStorageState state) {
                 _state = state;
                 if (_state == VoxelStorageState::FLAT_ARRAY) {
-                    _dataArray = _arrayRecycler->create();
+                    _dataArray = createArray();
+                    countRuns();
                 }
             }
 
@@ -123,13 +136,18 @@ namespace vorb {
                     _dataTree.initFromSortedArray(data);
                     _dataTree.checkTreeValidity();
                 } else {
-                    _dataArray = _arrayRecycler->create();
+                    _dataArray = createArray();
                     int index = 0;
                     for (size_t i = 0; i < data.size(); i++) {
                         for (int j = 0; j < data[i].length; j++) {
                             _dataArray[index++] = data[i].data;
                         }
                     }
+                    countRuns();
+                    if (_state == VoxelStorageState::PALETTE) {
+                        _state = VoxelStorageState::FLAT_ARRAY;
+                        if (flatToPalette()) recycleArray();
+                    }
                 }
             }
             inline void initFromSortedArray(VoxelStorageState state,
@@ -141,30 +159,34 @@ namespace vorb {
                     _dataTree.initFromSortedArray(data, size);
                     _dataTree.checkTreeValidity();
                 } else {
-                    _dataArray = _arrayRecycler->create();
+                    _dataArray = createArray();
                     int index = 0;
                     for (size_t i = 0; i < size; i++) {
                         for (int j = 0; j < data[i].length; j++) {
                             _dataArray[index++] = data[i].data;
                         }
                     }
+                    countRuns();
+                    if (_state == VoxelStorageState::PALETTE) {
+                        _state = VoxelStorageState::FLAT_ARRAY;
+                        if (flatToPalette()) recycleArray();
+                    }
                 }
             }
 
-            inline void changeState(VoxelStorageState newState, std::mutex& dataLock) {
+            /// Converts to newState. PALETTE falls back to FLAT_ARRAY if there
+            /// are too many distinct values to pack.
+            inline void changeState(VoxelStorageState newState, std::shared_timed_mutex& dataLock) {
                 if (newState == _state) return;
-                if (newState == VoxelStorageState::INTERVAL_TREE) {
-                    compress(dataLock);
-                } else {
-                    uncompress(dataLock);
-                }
+                if (_state != VoxelStorageState::FLAT_ARRAY) uncompress(dataLock);
+                if (newState != VoxelStorageState::FLAT_ARRAY) compress(dataLock, newState);
                 _quietFrames = 0;
                 _accessCount = 0;
             }
 
             /// Updates the container. Call once per frame
             /// @param dataLock: The mutex that guards the data
-            inline void update(std::mutex& dataLock) {
+            inline void update(std::shared_timed_mutex& dataLock) {
                 // If access count is higher than the threshold, this is not a quiet frame
                 if (_accessCount >= ACCESS_COUNT_UNTIL_DECOMPRESS) {
                     _quietFrames = 0;
@@ -172,7 +194,7 @@ namespace vorb {
                     _quietFrames++;
                 }
 
-                if (_state == VoxelStorageState::INTERVAL_TREE) {
+                if (_state != VoxelStorageState::FLAT_ARRAY) {
                     // Check if we should uncompress the data
                     if (_quietFrames == 0) {
                         uncompress(dataLock);
@@ -180,7 +202,13 @@ namespace vorb {
                 } else {
                     // Check if we should compress the data
                     if (_quietFrames >= QUIET_FRAMES_UNTIL_COMPRESS && totalContainerCompressions <= MAX_COMPRESSIONS_PER_FRAME) {
-                        compress(dataLock);
+                        VoxelStorageState newState;
+                        {
+                            // Other threads write the array while we look at it
+                            std::shared_lock<std::shared_timed_mutex> l(dataLock);
+                            newState = getSmallestState();
+                        }
+                        compress(dataLock, newState);
                     }
                 }
                 _accessCount = 0;
@@ -192,9 +220,12 @@ namespace vorb {
                 _quietFrames = 0;
                 if (_state == VoxelStorageState::INTERVAL_TREE) {
                     _dataTree.clear();
+                } else if (_state == VoxelStorageState::PALETTE) {
+                    std::vector<T>().swap(_palette);
+                    std::vector<ui64>().swap(_paletteData);
+                    _paletteBits = 0;
                 } else if (_dataArray) {
-                    _arrayRecycler->recycle(_dataArray);
-                    _dataArray = nullptr;
+                    recycleArray();
                 }
             }
 
@@ -204,6 +235,65 @@ namespace vorb {
             /// @param buffer: Buffer of memory to store the result
             inline void uncompressIntoBuffer(T* buffer) { _dataTree.uncompressIntoBuffer(buffer); }
 
+            /// Copies the box [min, max) of voxels into a caller buffer. Voxel (x, y, z) of
+            /// the box is written to dst[y * dstLayer + z * dstWidth + x], relative to min.
+            /// The interval tree is walked once instead of being searched per voxel.
+            /// @param min: Inclusive corner of the box, in voxels
+            /// @param max: Exclusive corner of the box, in voxels
+            /// @param dst: Buffer to copy into
+            /// @param dstWidth: Stride between z rows of dst
+            /// @param dstLayer: Stride between y layers of dst
+            inline void copyRegion(const i32v3& min, const i32v3& max, T* dst, size_t dstWidth, size_t dstLayer) const {
+                const size_t rowLength = max.x - min.x;
+                if (_state == VoxelStorageState::FLAT_ARRAY) {
+                    for (int y = min.y; y < max.y; y++) {
+                        for (int z = min.z; z < max.z; z++) {
+                            memcpy(dst + (y - min.y) * dstLayer + (z - min.z) * dstWidth,
+                                   _dataArray + y * CHUNK_LAYER + z * CHUNK_WIDTH + min.x,
+                                   rowLength * sizeof(T));
+                        }
+                    }
+                    return;
+                } else if (_state == VoxelStorageState::PALETTE) {
+                    for (int y = min.y; y < max.y; y++) {
+                        for (int z = min.z; z < max.z; z++) {
+                            T* out = dst + (y - min.y) * dstLayer + (z - min.z) * dstWidth;
+                            size_t index = y * CHUNK_LAYER + z * CHUNK_WIDTH + min.x;
+                            for (size_t x = 0; x < rowLength; x++) {
+                                *out++ = _palette[getPaletteIndex(index++)];
+                            }
+                        }
+                    }
+                    return;
+                }
+
+                // Nodes aren't stored in order, so clip each one against the rows of the box
+                const size_t firstRow = min.y * CHUNK_WIDTH;
+                const size_t endRow = max.y * CHUNK_WIDTH;
+                for (size_t i = 0; i < _dataTree.size(); i++) {
+                    const auto& node = _dataTree[i];
+                    const size_t start = node.getStart();
+                    const size_t end = start + node.length;
+                    size_t row = start / CHUNK_WIDTH;
+                    size_t lastRow = (end - 1) / CHUNK_WIDTH + 1;
+                    if (row < firstRow) row = firstRow;
+                    if (lastRow > endRow) lastRow = endRow;
+                    for (; row < lastRow; row++) {
+                        const int z = (int)(row % CHUNK_WIDTH);
+                        if (z < min.z || z >= max.z) continue;
+                        const size_t rowStart = row * CHUNK_WIDTH;
+                        size_t a = rowStart + min.x;
+                        size_t b = rowStart + max.x;
+                        if (a < start) a = start;
+                        if (b > end) b = end;
+                        if (a >= b) continue;
+                        T* out = dst + ((int)(row / CHUNK_WIDTH) - min.y) * dstLayer + (z - min.z) * dstWidth
+                                     + (a - rowStart - min.x);
+                        for (size_t j = a; j < b; j++) *out++ = node.data;
+                    }
+                }
+            }
+
             /// Getters
             const VoxelStorageState& getState() const {
                 return _state;
@@ -214,6 +304,9 @@ namespace vorb {
             const T* getDataArray() const {
                 return _dataArray;
             }
+            const std::vector<T>& getPalette() const {
+                return _palette;
+            }
             IntervalTree<T>& getTree() {
                 return _dataTree;
             }
@@ -248,60 +341,228 @@ namespace vorb {
                 container->_dataTree.insert(index, data);
             }
             static void setFlat(SmartVoxelContainer* container, size_t index, T data) {
+                if (container->_dataArray[index] == data) return;
+                container->_numRuns -= container->getRunEdges(index);
                 container->_dataArray[index] = data;
+                container->_numRuns += container->getRunEdges(index);
+                container->_isSmallestStateKnown = false;
             }
+            static const T& getPaletted(const SmartVoxelContainer* container, size_t index) {
+                return container->_palette[container->getPaletteIndex(index)];
+            }
+            static void setPaletted(SmartVoxelContainer* container, size_t index, T data) {
+                auto& palette = container->_palette;
+                size_t p = 0;
+                while (p < palette.size() && palette[p] != data) p++;
+                if (p == palette.size()) {
+                    // Widen the indices when the palette is full
+                    if (palette.size() == ((size_t)1 << container->_paletteBits)) {
+                        if (container->_paletteBits == MAX_PALETTE_BITS) {
+                            // Writers hold the data lock, so this is safe without locking
+                            container->paletteToFlat();
+                            setFlat(container, index, data);
+                            return;
+                        }
+                        container->repackPalette(container->_paletteBits ? container->_paletteBits * 2 : 1);
+                    }
+                    palette.push_back(data);
+                }
+                container->setPaletteIndex(index, (ui32)p);
+            }
+
+            static Getter getters[3];
+            static Setter setters[3];
 
-            static Getter getters[2];
-            static Setter setters[2];
+            inline ui32 getPaletteIndex(size_t index) const {
+                if (_paletteBits == 0) return 0;
+                size_t bit = index * _paletteBits;
+                return (ui32)(_paletteData[bit >> 6] >> (bit & 63)) & ((1u << _paletteBits) - 1);
+            }
+            inline void setPaletteIndex(size_t index, ui32 p) {
+                if (_paletteBits == 0) return;
+                size_t bit = index * _paletteBits;
+                ui64 mask = (((ui64)1 << _paletteBits) - 1) << (bit & 63);
+                ui64& word = _paletteData[bit >> 6];
+                word = (word & ~mask) | ((ui64)p << (bit & 63));
+            }
+            /// Bits per index for a palette of size entries. Always a power of 2 so
+            /// indices never straddle words.
+            static ui32 getPaletteBits(size_t size) {
+                ui32 bits = 0;
+                while (((size_t)1 << bits) < size) bits = bits ? bits * 2 : 1;
+                return bits;
+            }
+            inline void repackPalette(ui32 bits) {
+                std::vector<ui64> data((SIZE * bits + 63) / 64, 0);
+                std::swap(data, _paletteData);
+                ui32 oldBits = _paletteBits;
+                _paletteBits = bits;
+                for (size_t i = 0; i < SIZE && oldBits; i++) {
+                    size_t bit = i * oldBits;
+                    setPaletteIndex(i, (ui32)(data[bit >> 6] >> (bit & 63)) & ((1u << oldBits) - 1));
+                }
+            }
+            /// Number of run boundaries touching index of the flat array
+            inline ui32 getRunEdges(size_t index) const {
+                ui32 edges = 0;
+                if (index > 0 && _dataArray[index] != _dataArray[index - 1]) edges++;
+                if (index + 1 < SIZE && _dataArray[index] != _dataArray[index + 1]) edges++;
+                return edges;
+            }
+            /// Counts the runs of a new flat array, setFlat keeps the count after that
+            inline void countRuns() {
+                _numRuns = 1;
+                for (size_t i = 1; i < SIZE; i++) {
+                    if (_dataArray[i] != _dataArray[i - 1]) _numRuns++;
+                }
+                _isSmallestStateKnown = false;
+            }
+            /// Gathers the distinct values of the flat array. Returns false if
+            /// there are too many to pack.
+            inline bool gatherPalette(OUT std::vector<T>& palette) const {
+                const size_t maxSize = (size_t)1 << MAX_PALETTE_BITS;
+                palette.clear();
+                palette.push_back(_dataArray[0]);
+                for (size_t i = 1; i < SIZE; i++) {
+                    // Neighbors are usually equal, skip the search for runs
+                    if (_dataArray[i] == _dataArray[i - 1]) continue;
+                    if (std::find(palette.begin(), palette.end(), _dataArray[i]) == palette.end()) {
+                        if (palette.size() == maxSize) return false;
+                        palette.push_back(_dataArray[i]);
+                    }
+                }
+                return true;
+            }
+            /// Packs the flat array. Does not lock or free the array.
+            inline bool flatToPalette() {
+                std::vector<T> palette;
+                if (!gatherPalette(palette)) return false;
+                _palette.swap(palette);
+                _paletteBits = getPaletteBits(_palette.size());
+                _paletteData.assign((SIZE * _paletteBits + 63) / 64, 0);
+                if (_paletteBits) {
+                    ui32 p = 0;
+                    for (size_t i = 0; i < SIZE; i++) {
+                        if (_palette[p] != _dataArray[i]) {
+                            p = (ui32)(std::find(_palette.begin(), _palette.end(), _dataArray[i]) - _palette.begin());
+                        }
+                        setPaletteIndex(i, p);
+                    }
+                }
+                _state = VoxelStorageState::PALETTE;
+                return true;
+            }
+            /// Unpacks into a new flat array. Does not lock.
+            inline void paletteToFlat() {
+                _dataArray = createArray();
+                for (size_t i = 0; i < SIZE; i++) {
+                    _dataArray[i] = _palette[getPaletteIndex(i)];
+                }
+                countRuns();
+                std::vector<T>().swap(_palette);
+                std::vector<ui64>().swap(_paletteData);
+                _paletteBits = 0;
+                _state = VoxelStorageState::FLAT_ARRAY;
+            }
+            inline T* createArray() {
+                if (_arrayBytes) *_arrayBytes += SIZE * sizeof(T);
+                return _arrayRecycler->create();
+            }
+            inline void recycleArray() {
+                if (_arrayBytes) *_arrayBytes -= SIZE * sizeof(T);
+                _arrayRecycler->recycle(_dataArray);
+                _dataArray = nullptr;
+            }
+            /// Picks the compressed state that uses the least memory for the flat array.
+            /// Palettes are favored on ties since their reads are O(1).
+            /// The answer is kept until the array changes. Needs at least a shared lock.
+            inline VoxelStorageState getSmallestState() {
+                if (_isSmallestStateKnown) return _smallestState;
+                size_t treeBytes = _numRuns * sizeof(typename IntervalTree<T>::LNode);
+                std::vector<T> palette;
+                if (_numRuns > 1 && treeBytes < SIZE / 8) {
+                    // Two or more values take a bit per voxel, no need to look at them
+                    _smallestState = VoxelStorageState::INTERVAL_TREE;
+                } else if (!gatherPalette(palette)) {
+                    _smallestState = VoxelStorageState::INTERVAL_TREE;
+                } else {
+                    size_t paletteBytes = (SIZE * getPaletteBits(palette.size())) / 8 + palette.size() * sizeof(T);
+                    _smallestState = paletteBytes <= treeBytes ? VoxelStorageState::PALETTE : VoxelStorageState::INTERVAL_TREE;
+                }
+                _isSmallestStateKnown = true;
+                return _smallestState;
+            }
 
-            inline void uncompress(std::mutex& dataLock) {
+            inline void uncompress(std::shared_timed_mutex& dataLock) {
                 dataLock.lock();
-                _dataArray = _arrayRecycler->create();
+                if (_state == VoxelStorageState::PALETTE) {
+                    paletteToFlat();
+                    dataLock.unlock();
+                    return;
+                }
+                _dataArray = createArray();
                 uncompressIntoBuffer(_dataArray);
+                countRuns();
                 // Free memory
                 _dataTree.clear();
                 // Set the new state
                 _state = VoxelStorageState::FLAT_ARRAY;
                 dataLock.unlock();
             }
-            inline void compress(std::mutex& dataLock) {
+            /// Compresses the flat array into newState
+            inline void compress(std::shared_timed_mutex& dataLock, VoxelStorageState newState) {
                 dataLock.lock();
-                // Sorted array for creating the interval tree
-                // Using stack array to avoid allocations, beware stack overflow
-                typename IntervalTree<T>::LNode data[CHUNK_SIZE];
-                int index = 0;
-                data[0].set(0, 1, _dataArray[0]);
-                // Set the data
-                for (int i = 1; i < CHUNK_SIZE; ++i) {
-                    if (_dataArray[i] == data[index].data) {
-                        ++(data[index].length);
-                    } else {
-                        data[++index].set(i, 1, _dataArray[i]);
+                if (newState == VoxelStorageState::PALETTE) {
+                    if (!flatToPalette()) {
+                        // Too many distinct values, stay flat
+                        dataLock.unlock();
+                        return;
                     }
+                } else {
+                    // Sorted array for creating the interval tree
+                    // Using stack array to avoid allocations, beware stack overflow
+                    typename IntervalTree<T>::LNode data[CHUNK_SIZE];
+                    int index = 0;
+                    data[0].set(0, 1, _dataArray[0]);
+                    // Set the data
+                    for (int i = 1; i < CHUNK_SIZE; ++i) {
+                        if (_dataArray[i] == data[index].data) {
+                            ++(data[index].length);
+                        } else {
+                            data[++index].set(i, 1, _dataArray[i]);
+                        }
+                    }
+                    // Set new state
+                    _state = VoxelStorageState::INTERVAL_TREE;
+                    // Create the tree
+                    _dataTree.initFromSortedArray(data, index + 1);
                 }
-                // Set new state
-                _state = VoxelStorageState::INTERVAL_TREE;
-                // Create the tree
-                _dataTree.initFromSortedArray(data, index + 1);
 
                 dataLock.unlock();
 
                 // Recycle memory
-                _arrayRecycler->recycle(_dataArray);
-                _dataArray = nullptr;
+                recycleArray();
 
                 totalContainerCompressions++;
             }
 
             IntervalTree<T> _dataTree; ///< Interval tree of voxel data
 
+            std::vector<T> _palette; ///< Distinct values for VoxelStorageState::PALETTE
+            std::vector<ui64> _paletteData; ///< Bit packed indices into _palette
+            ui32 _paletteBits = 0; ///< Bits per index, a power of 2. 0 when there is one value
+
             T* _dataArray = nullptr; ///< pointer to an array of voxel data
             int _accessCount = 0; ///< Number of times the container was accessed this frame
             int _quietFrames = 0; ///< Number of frames since we have had heavy updates
+            size_t _numRuns = 1; ///< Runs of equal values in the flat array
+            bool _isSmallestStateKnown = false;
+            VoxelStorageState _smallestState = VoxelStorageState::INTERVAL_TREE; ///< Cached getSmallestState
 
             VoxelStorageState _state = VoxelStorageState::FLAT_ARRAY; ///< Current data structure state
 
             vcore::FixedSizeArrayRecycler<CHUNK_SIZE, T>* _arrayRecycler = nullptr; ///< For recycling the voxel arrays
+            std::atomic<size_t>* _arrayBytes = nullptr; ///< Optional count of bytes in live flat arrays
         };
 
         /*template<typename T, size_t SIZE>
@@ -324,14 +585,16 @@ namespace vorb {
         }
 
         template<typename T, size_t SIZE>
-        typename SmartVoxelContainer<T, SIZE>::Getter SmartVoxelContainer<T, SIZE>::getters[2] = {
+        typename SmartVoxelContainer<T, SIZE>::Getter SmartVoxelContainer<T, SIZE>::getters[3] = {
             SmartVoxelContainer<T, SIZE>::getFlat,
-            SmartVoxelContainer<T, SIZE>::getInterval
+            SmartVoxelContainer<T, SIZE>::getInterval,
+            SmartVoxelContainer<T, SIZE>::getPaletted
         };
         template<typename T, size_t SIZE>
-        typename SmartVoxelContainer<T, SIZE>::Setter SmartVoxelContainer<T, SIZE>::setters[2] = {
+        typename SmartVoxelContainer<T, SIZE>::Setter SmartVoxelContainer<T, SIZE>::setters[3] = {
             SmartVoxelContainer<T, SIZE>::setFlat,
-            SmartVoxelContainer<T, SIZE>::setInterval
+            SmartVoxelContainer<T, SIZE>::setInterval,
+            SmartVoxelContainer<T, SIZE>::setPaletted
         };
 
     }
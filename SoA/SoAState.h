@@ -21,6 +21,7 @@
 #include "BlockPack.h"
 #include "ChunkAllocator.h"
 #include "ClientState.h"
+#include "GameWorkerPool.h"
 #include "Item.h"
 
 #include "ECSTemplates.h"
@@ -50,6 +51,7 @@ struct SoaState {
     vio::IOManager* systemIoManager = nullptr;
 
     vcore::ThreadPool<WorkerData>* threadPool = nullptr;
+    GameWorkerPool gameWorkerPool; ///< Helps the update thread, see GameWorkerPool
 
     SoaOptions* options = nullptr; // Lives in App
 
@@ -42,6 +42,9 @@ void SoaEngine::initOptions(SoaOptions& options) {
     options.addOption(OPT_BORDERLESS, "Borderless Window", OptionValue(false));
     options.addOption(OPT_SCREEN_WIDTH, "Screen Width", OptionValue(1280));
     options.addOption(OPT_SCREEN_HEIGHT, "Screen Height", OptionValue(720));
+    options.addOption(OPT_COMPACT_BLOCK_VERTICES, "Compact Block Vertices", OptionValue(false)); // Requires restart
+    options.addOption(OPT_CHUNK_MEMORY_BUDGET, "Chunk Memory Budget", OptionValue(0)); // In MB, 0 is unlimited
+    options.addOption(OPT_BATCHED_CHUNK_RENDERING, "Batched Chunk Rendering", OptionValue(false)); // Requires restart
     options.addStringOption("Texture Pack", "Default");
 
     SoaEngine::optionsController.setDefault();
@@ -68,6 +71,8 @@ void SoaEngine::initState(SoaState* state) {
         state->threadPool->init(hc);
     }
 
+    state->chunkAllocator.setMemoryBudget((size_t)soaOptions.get(OPT_CHUNK_MEMORY_BUDGET).value.i * 1024 * 1024);
+
     // Init ECS
     // TODO(Ben): Mod packs
     state->templateLib.registerFactory<AABBCollidableComponentBuilder>(GAME_SYSTEM_CT_AABBCOLLIDABLE_NAME);
@@ -242,7 +247,9 @@ void SoaEngine::initVoxelGen(PlanetGenData* genData, const BlockPack& blocks) {
         // Set liquid block
         if (blockInfo.liquidBlockName.length()) {
             if (blocks.hasBlock(blockInfo.liquidBlockName)) {
-                genData->liquidBlock = blocks[blockInfo.liquidBlockName].ID;
+                const Block& liquid = blocks[blockInfo.liquidBlockName];
+                // Oceans are full, not the lowest level
+                genData->liquidBlock = liquid.liquidLevels ? liquid.liquidStartID + liquid.liquidLevels : liquid.ID;
             }
         }
         // Set surface block
@@ -348,6 +355,7 @@ void SoaEngine::initVoxelGen(PlanetGenData* genData, const BlockPack& blocks) {
                         auto mit = genData->floraMap.find(kp.id);
                         if (mit != genData->floraMap.end()) {
                             biome.flora[i].chance = kp.chance;
+                            biome.flora[i].chance.program.compile(biome.flora[i].chance.funcs);
                             biome.flora[i].data = &genData->flora[mit->second];
                             biome.flora[i].id = i;
                         } else {
@@ -367,6 +375,7 @@ void SoaEngine::initVoxelGen(PlanetGenData* genData, const BlockPack& blocks) {
                         auto mit = genData->treeMap.find(kp.id);
                         if (mit != genData->treeMap.end()) {
                             biome.trees[i].chance = kp.chance;
+                            biome.trees[i].chance.program.compile(biome.trees[i].chance.funcs);
                             biome.trees[i].data = &genData->trees[mit->second];
                             // Trees and flora share IDs so we can use a single
                             // value in heightmap. Thus, add flora.size().
@@ -71,6 +71,9 @@ enum DefaultOptions : int {
     OPT_BORDERLESS,
     OPT_SCREEN_WIDTH,
     OPT_SCREEN_HEIGHT,
+    OPT_COMPACT_BLOCK_VERTICES,
+    OPT_CHUNK_MEMORY_BUDGET,
+    OPT_BATCHED_CHUNK_RENDERING,
     OPT_NUM_OPTIONS // This should be last
 };
 
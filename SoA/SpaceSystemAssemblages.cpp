@@ -270,6 +270,7 @@ vecs::ComponentID SpaceSystemAssemblages::addSphericalVoxelComponent(SpaceSystem
     for (int i = 0; i < 6; i++) {
         svcmp.chunkGrids[i].init(static_cast<WorldCubeFace>(i), svcmp.threadPool, 1, ftcmp.planetGenData, &soaState->chunkAllocator);
         svcmp.chunkGrids[i].blockPack = &soaState->blocks;
+        svcmp.chunkGrids[i].chunkIo = svcmp.chunkIo;
     }
 
     svcmp.planetGenData = ftcmp.planetGenData;
@@ -17,8 +17,18 @@ void SphericalVoxelComponentTable::disposeComponent(vecs::ComponentID cID, vecs:
     SphericalVoxelComponent& cmp = _components[cID].second;
     // Let the threadpool finish
     while (cmp.threadPool->getTasksSizeApprox() > 0);
+    if (cmp.chunkGrids) {
+        // Save modified chunks that are still loaded
+        for (int i = 0; i < 6 && cmp.chunkIo; i++) {
+            for (ChunkHandle chunk : cmp.chunkGrids[i].acquireActiveChunks()) {
+                if (chunk->genLevel == GEN_DONE && chunk->isDirty) cmp.chunkIo->addToSaveList(chunk);
+            }
+            cmp.chunkGrids[i].releaseActiveChunks();
+        }
+        delete[] cmp.chunkGrids;
+    }
+    // Finishes queued saves
     delete cmp.chunkIo;
-    delete[] cmp.chunkGrids;
     cmp = _components[0].second;
 }
 
@@ -32,7 +32,7 @@ void SpaceSystemUpdater::update(SoaState* soaState, const f64v3& spacePos, const
     m_sphericalVoxelComponentUpdater.update(soaState);
 
     // Update Orbits ( Do this last)
-    m_orbitComponentUpdater.update(spaceSystem, soaState->time);
+    m_orbitComponentUpdater.update(spaceSystem, soaState->time, &soaState->gameWorkerPool);
 }
 
 void SpaceSystemUpdater::glUpdate(const SoaState* soaState) {
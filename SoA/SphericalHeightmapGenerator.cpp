@@ -39,6 +39,45 @@ void SphericalHeightmapGenerator::generateHeightData(OUT PlanetHeightData& heigh
     generateHeightData(height, normal * m_genData->radius, normal);
 }
 
+void SphericalHeightmapGenerator::generateHeightDataBatch(OUT PlanetHeightData* heights, const VoxelPosition2D& cornerPosition, ui32 width) const {
+    // Need to convert to world-space
+    f32v2 coordMults = f32v2(VoxelSpaceConversions::FACE_TO_WORLD_MULTS[(int)cornerPosition.face]);
+    i32v3 coordMapping = VoxelSpaceConversions::VOXEL_TO_WORLD[(int)cornerPosition.face];
+
+    size_t count = width * width;
+    std::vector<f64v3> positions(count);
+    std::vector<f64v3> normals(count);
+    for (ui32 z = 0; z < width; z++) {
+        for (ui32 x = 0; x < width; x++) {
+            VoxelPosition2D facePosition = cornerPosition;
+            facePosition.pos.x += x;
+            facePosition.pos.y += z;
+            f64v3& pos = positions[z * width + x];
+            pos[coordMapping.x] = facePosition.pos.x * KM_PER_VOXEL * coordMults.x;
+            pos[coordMapping.y] = m_genData->radius * (f64)VoxelSpaceConversions::FACE_Y_MULTS[(int)facePosition.face];
+            pos[coordMapping.z] = facePosition.pos.y * KM_PER_VOXEL * coordMults.y;
+            normals[z * width + x] = glm::normalize(pos);
+        }
+    }
+
+    generateHeightDataBatch(heights, normals.data(), count);
+
+    // Flora depends on the biome so it is still done per position
+    for (ui32 z = 0; z < width; z++) {
+        for (ui32 x = 0; x < width; x++) {
+            VoxelPosition2D facePosition = cornerPosition;
+            facePosition.pos.x += x;
+            facePosition.pos.y += z;
+            PlanetHeightData& height = heights[z * width + x];
+            height.flora = getTreeID(height.biome, facePosition, positions[z * width + x]);
+            // If no tree, try flora
+            if (height.flora == FLORA_ID_NONE) {
+                height.flora = getFloraID(height.biome, facePosition, positions[z * width + x]);
+            }
+        }
+    }
+}
+
 FloraID SphericalHeightmapGenerator::getTreeID(const Biome* biome, const VoxelPosition2D& facePosition, const f64v3& worldPos) const {
     // TODO(Ben): Experiment with optimizations with large amounts of flora.
     f64 noTreeChance = 1.0;
@@ -49,7 +88,7 @@ FloraID SphericalHeightmapGenerator::getTreeID(const Biome* biome, const VoxelPo
     for (size_t i = 0; i < biome->trees.size(); i++) {
         auto& t = biome->trees[i];
         f64 c = t.chance.base;
-        getNoiseValue(worldPos, t.chance.funcs, nullptr, TerrainOp::ADD, c);
+        getNoiseValue(worldPos, t.chance, c);
         totalChance += c;
         chances[i] = totalChance;
         noTreeChance *= (1.0 - c);
@@ -82,7 +121,7 @@ FloraID SphericalHeightmapGenerator::getFloraID(const Biome* biome, const VoxelP
     for (size_t i = 0; i < biome->flora.size(); i++) {
         auto& t = biome->flora[i];
         f64 c = t.chance.base;
-        getNoiseValue(worldPos, t.chance.funcs, nullptr, TerrainOp::ADD, c);
+        getNoiseValue(worldPos, t.chance, c);
         totalChance += c;
         chances[i] = totalChance;
         noFloraChance *= (1.0 - c);
@@ -210,7 +249,7 @@ inline void SphericalHeightmapGenerator::generateHeightData(OUT PlanetHeightData
         f64 baseWeight = bb.first.weight * bb.second;
         // Get base biome terrain
         f64 newHeight = biome->terrainNoise.base + height.height;
-        getNoiseValue(pos, biome->terrainNoise.funcs, nullptr, TerrainOp::ADD, newHeight);
+        getNoiseValue(pos, biome->terrainNoise, newHeight);
         // Mix in height with squared interpolation
         height.height = (f32)((baseWeight * newHeight) + (1.0 - baseWeight) * (f64)height.height);
         // Sub biomes
@@ -220,10 +259,88 @@ inline void SphericalHeightmapGenerator::generateHeightData(OUT PlanetHeightData
     height.biome = bestBiome;
 }
 
+void SphericalHeightmapGenerator::generateHeightDataBatch(OUT PlanetHeightData* heights, const f64v3* normals, size_t count) const {
+    // NOTE: Make sure this implementation matches generateHeightData()
+    // Positions in SoA layout for the batched noise
+    std::vector<f64> px(count), py(count), pz(count);
+    for (size_t i = 0; i < count; i++) {
+        f64v3 pos = normals[i] * m_genData->radius;
+        px[i] = pos.x;
+        py[i] = pos.y;
+        pz[i] = pos.z;
+    }
+
+    std::vector<f64> baseHeight(count, m_genData->baseTerrainFuncs.base);
+    getNoiseValueBatch(px.data(), py.data(), pz.data(), count, m_genData->baseTerrainFuncs, baseHeight.data());
+    std::vector<f64> baseTemperature(count, m_genData->tempTerrainFuncs.base);
+    getNoiseValueBatch(px.data(), py.data(), pz.data(), count, m_genData->tempTerrainFuncs, baseTemperature.data());
+    std::vector<f64> baseHumidity(count, m_genData->humTerrainFuncs.base);
+    getNoiseValueBatch(px.data(), py.data(), pz.data(), count, m_genData->humTerrainFuncs, baseHumidity.data());
+
+    std::vector<std::map<BiomeInfluence, f64> > baseBiomes(count);
+    // Samples that each base biome influences. Ordered like BiomeInfluence so
+    // every sample sees its biomes in the same order as generateHeightData().
+    std::map<const Biome*, std::vector<ui32> > biomeSamples;
+    std::vector<f64> biggestWeight(count, 0.0);
+    std::vector<const Biome*> bestBiome(count);
+    for (size_t i = 0; i < count; i++) {
+        PlanetHeightData& height = heights[i];
+        f64 h = baseHeight[i];
+        height.height = (f32)(h * VOXELS_PER_M);
+        h *= KM_PER_M;
+        f64 angle = computeAngleFromNormal(normals[i]);
+        f64 temperature = calculateTemperature(m_genData->tempLatitudeFalloff, angle, baseTemperature[i] - glm::max(0.0, m_genData->tempHeightFalloff * h));
+        f64 humidity = calculateHumidity(m_genData->humLatitudeFalloff, angle, baseHumidity[i] - glm::max(0.0, m_genData->humHeightFalloff * h));
+        height.temperature = (ui8)temperature;
+        height.humidity = (ui8)humidity;
+        height.flora = FLORA_ID_NONE;
+
+        bestBiome[i] = m_genData->baseBiomeLookup[height.humidity][height.temperature];
+        getBaseBiomes(m_genData->baseBiomeInfluenceMap, temperature, humidity, baseBiomes[i]);
+        for (auto& bb : baseBiomes[i]) {
+            biomeSamples[bb.first.b].push_back((ui32)i);
+        }
+    }
+
+    // Base biome terrain, batched over every sample the biome influences
+    std::vector<f64> sx, sy, sz, newHeight;
+    for (auto& it : biomeSamples) {
+        const Biome* biome = it.first;
+        const std::vector<ui32>& samples = it.second;
+        size_t n = samples.size();
+        sx.resize(n);
+        sy.resize(n);
+        sz.resize(n);
+        newHeight.resize(n);
+        for (size_t k = 0; k < n; k++) {
+            ui32 i = samples[k];
+            sx[k] = px[i];
+            sy[k] = py[i];
+            sz[k] = pz[i];
+            newHeight[k] = biome->terrainNoise.base + heights[i].height;
+        }
+        getNoiseValueBatch(sx.data(), sy.data(), sz.data(), n, biome->terrainNoise, newHeight.data());
+        for (size_t k = 0; k < n; k++) {
+            ui32 i = samples[k];
+            auto bb = baseBiomes[i].find(BiomeInfluence(biome, 0.0f));
+            f64 baseWeight = bb->first.weight * bb->second;
+            // Mix in height with squared interpolation
+            heights[i].height = (f32)((baseWeight * newHeight[k]) + (1.0 - baseWeight) * (f64)heights[i].height);
+            // Sub biomes
+            recurseChildBiomes(biome, f64v3(px[i], py[i], pz[i]), heights[i].height, biggestWeight[i], bestBiome[i], baseWeight);
+        }
+    }
+
+    // Mark biome that is the best
+    for (size_t i = 0; i < count; i++) {
+        heights[i].biome = bestBiome[i];
+    }
+}
+
 void SphericalHeightmapGenerator::recurseChildBiomes(const Biome* biome, const f64v3& pos, f32& height, f64& biggestWeight, const Biome*& bestBiome, f64 baseWeight) const {
     // Get child noise value
     f64 noiseVal = biome->childNoise.base;
-    getNoiseValue(pos, biome->childNoise.funcs, nullptr, TerrainOp::ADD, noiseVal);
+    getNoiseValue(pos, biome->childNoise, noiseVal);
     // Sub biomes
     for (auto& child : biome->children) {
         f64 weight = 1.0;
@@ -282,7 +399,7 @@ void SphericalHeightmapGenerator::recurseChildBiomes(const Biome* biome, const f
         }
         // If we reach here, the biome exists.
         f64 newHeight = child->terrainNoise.base + height;
-        getNoiseValue(pos, child->terrainNoise.funcs, nullptr, TerrainOp::ADD, newHeight);
+        getNoiseValue(pos, child->terrainNoise, newHeight);
         // Biggest weight biome is the next biome
         if (weight >= biggestWeight) {
             biggestWeight = weight;
@@ -300,19 +417,19 @@ void SphericalHeightmapGenerator::recurseChildBiomes(const Biome* biome, const f
 
 f64 SphericalHeightmapGenerator::getBaseHeightValue(const f64v3& pos) const {
     f64 genHeight = m_genData->baseTerrainFuncs.base;
-    getNoiseValue(pos, m_genData->baseTerrainFuncs.funcs, nullptr, TerrainOp::ADD, genHeight);
+    getNoiseValue(pos, m_genData->baseTerrainFuncs, genHeight);
     return genHeight;
 }
 
 f64 SphericalHeightmapGenerator::getTemperatureValue(const f64v3& pos, const f64v3& normal, f64 height) const {
     f64 genHeight = m_genData->tempTerrainFuncs.base;
-    getNoiseValue(pos, m_genData->tempTerrainFuncs.funcs, nullptr, TerrainOp::ADD, genHeight);
+    getNoiseValue(pos, m_genData->tempTerrainFuncs, genHeight);
     return calculateTemperature(m_genData->tempLatitudeFalloff, computeAngleFromNormal(normal), genHeight - glm::max(0.0, m_genData->tempHeightFalloff * height));
 }
 
 f64 SphericalHeightmapGenerator::getHumidityValue(const f64v3& pos, const f64v3& normal, f64 height) const {
     f64 genHeight = m_genData->humTerrainFuncs.base;
-    getNoiseValue(pos, m_genData->humTerrainFuncs.funcs, nullptr, TerrainOp::ADD, genHeight);
+    getNoiseValue(pos, m_genData->humTerrainFuncs, genHeight);
     return SphericalHeightmapGenerator::calculateHumidity(m_genData->humLatitudeFalloff, computeAngleFromNormal(normal), genHeight - glm::max(0.0, m_genData->humHeightFalloff * height));
 }
 
@@ -356,6 +473,23 @@ f64 doOperation(const TerrainOp& op, f64 a, f64 b) {
     return 0.0;
 }
 
+void SphericalHeightmapGenerator::getNoiseValue(const f64v3& pos, const NoiseBase& noise, f64& height) const {
+    if (noise.program.isCompiled()) {
+        noise.program.execute(pos, height);
+    } else {
+        getNoiseValue(pos, noise.funcs, nullptr, TerrainOp::ADD, height);
+    }
+}
+
+void SphericalHeightmapGenerator::getNoiseValueBatch(const f64* x, const f64* y, const f64* z, size_t count,
+                                                     const NoiseBase& noise, f64* height) const {
+    if (noise.program.isCompiled()) {
+        noise.program.executeBatch(x, y, z, count, height);
+    } else {
+        getNoiseValueBatch(x, y, z, count, noise.funcs, nullptr, TerrainOp::ADD, nullptr, height);
+    }
+}
+
 void SphericalHeightmapGenerator::getNoiseValue(const f64v3& pos,
                                                 const Array<TerrainFuncProperties>& funcs,
                                                 f64* modifier,
@@ -497,3 +631,180 @@ void SphericalHeightmapGenerator::getNoiseValue(const f64v3& pos,
         }
     }
 }
+
+void SphericalHeightmapGenerator::getNoiseValueBatch(const f64* x, const f64* y, const f64* z, size_t count,
+                                                     const Array<TerrainFuncProperties>& funcs,
+                                                     f64* modifier,
+                                                     const TerrainOp& op,
+                                                     const ui8* active,
+                                                     f64* height) const {
+
+    // NOTE: Make sure this implementation matches getNoiseValue()
+    std::vector<f64> h;
+    std::vector<f64> total;
+    std::vector<f64> n1, n2;
+    std::vector<ui8> nextActive;
+    for (size_t f = 0; f < funcs.size(); ++f) {
+        auto& fn = funcs[f];
+        bool hasClamp = (fn.clamp[0] != 0.0 || fn.clamp[1] != 0.0);
+
+        h.assign(count, 0.0);
+        f64* nextMod;
+        TerrainOp nextOp;
+        // Check if its not a noise function
+        if (fn.func == TerrainStage::CONSTANT) {
+            nextMod = h.data();
+            for (size_t i = 0; i < count; i++) {
+                if (active && !active[i]) continue;
+                h[i] = fn.low;
+                // Apply parent before clamping
+                if (modifier) {
+                    h[i] = doOperation(op, h[i], modifier[i]);
+                }
+                // Optional clamp if both fields are not 0.0
+                if (hasClamp) {
+                    h[i] = glm::clamp(modifier ? modifier[i] : h[i], (f64)fn.clamp[0], (f64)fn.clamp[1]);
+                }
+            }
+            nextOp = fn.op;
+        } else if (fn.func == TerrainStage::PASS_THROUGH) {
+            nextMod = modifier;
+            // Apply parent before clamping
+            if (modifier) {
+                for (size_t i = 0; i < count; i++) {
+                    if (active && !active[i]) continue;
+                    h[i] = doOperation(op, modifier[i], fn.low);
+                    // Optional clamp if both fields are not 0.0
+                    if (hasClamp) {
+                        h[i] = glm::clamp(h[i], fn.clamp[0], fn.clamp[1]);
+                    }
+                }
+            }
+            nextOp = op;
+        } else if (fn.func == TerrainStage::SQUARED || fn.func == TerrainStage::CUBED) {
+            nextMod = modifier;
+            // Apply parent before clamping
+            if (modifier) {
+                for (size_t i = 0; i < count; i++) {
+                    if (active && !active[i]) continue;
+                    if (fn.func == TerrainStage::SQUARED) {
+                        modifier[i] = modifier[i] * modifier[i];
+                    } else {
+                        modifier[i] = modifier[i] * modifier[i] * modifier[i];
+                    }
+                    // Optional clamp if both fields are not 0.0
+                    if (hasClamp) {
+                        h[i] = glm::clamp(h[i], fn.clamp[0], fn.clamp[1]);
+                    }
+                }
+            }
+            nextOp = op;
+        } else { // It's a noise function
+            nextMod = h.data();
+            total.assign(count, 0.0);
+            n1.resize(count);
+            n2.resize(count);
+            f64 maxAmplitude = 0.0;
+            f64 amplitude = 1.0;
+            f64 frequency = fn.frequency;
+            for (int o = 0; o < fn.octaves; o++) {
+                switch (fn.func) {
+                    case TerrainStage::CUBED_NOISE:
+                    case TerrainStage::SQUARED_NOISE:
+                    case TerrainStage::NOISE:
+                        Noise::rawBatch(x, y, z, frequency, n1.data(), count);
+                        for (size_t i = 0; i < count; i++) {
+                            total[i] += n1[i] * amplitude;
+                        }
+                        break;
+                    case TerrainStage::RIDGED_NOISE:
+                        Noise::rawBatch(x, y, z, frequency, n1.data(), count);
+                        for (size_t i = 0; i < count; i++) {
+                            total[i] += ((1.0 - glm::abs(n1[i])) * 2.0 - 1.0) * amplitude;
+                        }
+                        break;
+                    case TerrainStage::ABS_NOISE:
+                        Noise::rawBatch(x, y, z, frequency, n1.data(), count);
+                        for (size_t i = 0; i < count; i++) {
+                            total[i] += glm::abs(n1[i]) * amplitude;
+                        }
+                        break;
+                    case TerrainStage::CELLULAR_NOISE:
+                        Noise::cellularBatch(x, y, z, frequency, n1.data(), n2.data(), count);
+                        for (size_t i = 0; i < count; i++) {
+                            total[i] += (n2[i] - n1[i]) * amplitude;
+                        }
+                        break;
+                    case TerrainStage::CELLULAR_SQUARED_NOISE:
+                        Noise::cellularBatch(x, y, z, frequency, n1.data(), n2.data(), count);
+                        for (size_t i = 0; i < count; i++) {
+                            f64 tmp = n2[i] - n1[i];
+                            total[i] += tmp * tmp * amplitude;
+                        }
+                        break;
+                    case TerrainStage::CELLULAR_CUBED_NOISE:
+                        Noise::cellularBatch(x, y, z, frequency, n1.data(), n2.data(), count);
+                        for (size_t i = 0; i < count; i++) {
+                            f64 tmp = n2[i] - n1[i];
+                            total[i] += tmp * tmp * tmp * amplitude;
+                        }
+                        break;
+                    default:
+                        break;
+                }
+                frequency *= 2.0;
+                maxAmplitude += amplitude;
+                amplitude *= fn.persistence;
+            }
+            bool scale = (fn.low != -1.0 || fn.high != 1.0);
+            for (size_t i = 0; i < count; i++) {
+                if (active && !active[i]) continue;
+                f64 t = (total[i] / maxAmplitude);
+                // Handle any post processes per noise
+                switch (fn.func) {
+                    case TerrainStage::CUBED_NOISE:
+                        t = t * t * t;
+                        break;
+                    case TerrainStage::SQUARED_NOISE:
+                        t = t * t;
+                        break;
+                    default:
+                        break;
+                }
+                // Conditional scaling.
+                if (scale) {
+                    h[i] = t * (fn.high - fn.low) * 0.5 + (fn.high + fn.low) * 0.5;
+                } else {
+                    h[i] = t;
+                }
+                // Optional clamp if both fields are not 0.0
+                if (hasClamp) {
+                    h[i] = glm::clamp(h[i], (f64)fn.clamp[0], (f64)fn.clamp[1]);
+                }
+                // Apply modifier from parent if needed
+                if (modifier) {
+                    h[i] = doOperation(op, h[i], modifier[i]);
+                }
+            }
+            nextOp = fn.op;
+        }
+
+        if (fn.children.size()) {
+            // Early exit for speed, per sample
+            nextActive.resize(count);
+            bool anyActive = false;
+            for (size_t i = 0; i < count; i++) {
+                nextActive[i] = (!active || active[i]) && !(nextOp == TerrainOp::MUL && nextMod && nextMod[i] == 0.0);
+                anyActive |= (nextActive[i] != 0);
+            }
+            if (anyActive) {
+                getNoiseValueBatch(x, y, z, count, fn.children, nextMod, nextOp, nextActive.data(), height);
+            }
+        } else {
+            for (size_t i = 0; i < count; i++) {
+                if (active && !active[i]) continue;
+                height[i] = doOperation(fn.op, height[i], h[i]);
+            }
+        }
+    }
+}
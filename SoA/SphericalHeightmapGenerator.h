@@ -36,6 +36,11 @@ class SphericalHeightmapGenerator {
     /// Gets the height at a specific face position.
     void generateHeightData(OUT PlanetHeightData& height, const VoxelPosition2D& facePosition) const;
     void generateHeightData(OUT PlanetHeightData& height, const f64v3& normal) const;
+    /// Gets the heights for a width * width grid of face positions, with heights[z * width + x]
+    /// at cornerPosition + (x, z). The noise stacks are evaluated for the whole grid at once.
+    void generateHeightDataBatch(OUT PlanetHeightData* heights, const VoxelPosition2D& cornerPosition, ui32 width) const;
+    /// Gets the heights for a batch of normalized positions.
+    void generateHeightDataBatch(OUT PlanetHeightData* heights, const f64v3* normals, size_t count) const;
 
     // Gets the tree id that should be at a specific worldspace position
     FloraID getTreeID(const Biome* biome, const VoxelPosition2D& facePosition, const f64v3& worldPos) const;
@@ -47,6 +52,12 @@ class SphericalHeightmapGenerator {
     void generateHeightData(OUT PlanetHeightData& height, const f64v3& pos, const f64v3& normal) const;
     void recurseChildBiomes(const Biome* biome, const f64v3& pos, f32& height, f64& biggestWeight, const Biome*& bestBiome, f64 baseWeight) const;
     
+    /// Gets noise value using the compiled program of noise, or its funcs
+    /// if it hasn't been compiled.
+    void getNoiseValue(const f64v3& pos, const NoiseBase& noise, f64& height) const;
+    /// Batched version of getNoiseValue(pos, noise, height)
+    void getNoiseValueBatch(const f64* x, const f64* y, const f64* z, size_t count,
+                            const NoiseBase& noise, f64* height) const;
     /// Gets noise value using terrainFuncs
     /// @return the noise value
     void getNoiseValue(const f64v3& pos,
@@ -54,6 +65,14 @@ class SphericalHeightmapGenerator {
                       f64* modifier,
                       const TerrainOp& op,
                       f64& height) const;
+    /// Batched version of getNoiseValue for count positions in SoA layout.
+    /// Samples with active[i] == 0 are left untouched. active may be nullptr.
+    void getNoiseValueBatch(const f64* x, const f64* y, const f64* z, size_t count,
+                            const Array<TerrainFuncProperties>& funcs,
+                            f64* modifier,
+                            const TerrainOp& op,
+                            const ui8* active,
+                            f64* height) const;
 
     f64 getBaseHeightValue(const f64v3& pos) const;
     f64 getTemperatureValue(const f64v3& pos, const f64v3& normal, f64 height) const;
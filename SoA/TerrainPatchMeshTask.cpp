@@ -22,6 +22,7 @@ void TerrainPatchMeshTask::execute(WorkerData* workerData) {
 
     PlanetHeightData heightData[PADDED_PATCH_WIDTH][PADDED_PATCH_WIDTH];
     f64v3 positionData[PADDED_PATCH_WIDTH][PADDED_PATCH_WIDTH];
+    f64v3 normalData[PADDED_PATCH_WIDTH][PADDED_PATCH_WIDTH];
     f64v3 pos;
     // f32v3 tmpPos;
 
@@ -43,11 +44,14 @@ void TerrainPatchMeshTask::execute(WorkerData* workerData) {
                 pos[coordMapping.x] = (m_startPos.x + (x - 1) * VERT_WIDTH) * coordMults.x;
                 pos[coordMapping.y] = m_startPos.y;
                 pos[coordMapping.z] = (m_startPos.z + (z - 1) * VERT_WIDTH) * coordMults.y;
-                f64v3 normal(glm::normalize(pos));
-                generator->generateHeightData(heightData[z][x], normal);
-                
+                normalData[z][x] = glm::normalize(pos);
+            }
+        }
+        generator->generateHeightDataBatch(&heightData[0][0], &normalData[0][0], PADDED_PATCH_WIDTH * PADDED_PATCH_WIDTH);
+        for (int z = 0; z < PADDED_PATCH_WIDTH; z++) {
+            for (int x = 0; x < PADDED_PATCH_WIDTH; x++) {
                 // offset position by height;
-                positionData[z][x] = normal * (m_patchData->radius + heightData[z][x].height * KM_PER_VOXEL);
+                positionData[z][x] = normalData[z][x] * (m_patchData->radius + heightData[z][x].height * KM_PER_VOXEL);
             }
         }
     } else { // Far terrain
@@ -55,17 +59,22 @@ void TerrainPatchMeshTask::execute(WorkerData* workerData) {
         const f32v2& coordMults = f32v2(VoxelSpaceConversions::FACE_TO_WORLD_MULTS[(int)m_cubeFace]);
 
         m_startPos.y *= (f32)VoxelSpaceConversions::FACE_Y_MULTS[(int)m_cubeFace];
+        f64v2 sposData[PADDED_PATCH_WIDTH][PADDED_PATCH_WIDTH];
         for (int z = 0; z < PADDED_PATCH_WIDTH; z++) {
             for (int x = 0; x < PADDED_PATCH_WIDTH; x++) {
-                f64v2 spos;
+                f64v2& spos = sposData[z][x];
                 spos.x = (m_startPos.x + (x - 1) * VERT_WIDTH);
                 spos.y = (m_startPos.z + (z - 1) * VERT_WIDTH);
                 pos[coordMapping.x] = spos.x * coordMults.x;
                 pos[coordMapping.y] = m_startPos.y;
                 pos[coordMapping.z] = spos.y * coordMults.y;
-                f64v3 normal(glm::normalize(pos));
-                generator->generateHeightData(heightData[z][x], normal);
-
+                normalData[z][x] = glm::normalize(pos);
+            }
+        }
+        generator->generateHeightDataBatch(&heightData[0][0], &normalData[0][0], PADDED_PATCH_WIDTH * PADDED_PATCH_WIDTH);
+        for (int z = 0; z < PADDED_PATCH_WIDTH; z++) {
+            for (int x = 0; x < PADDED_PATCH_WIDTH; x++) {
+                const f64v2& spos = sposData[z][x];
                 // offset position by height;
                 positionData[z][x] = f64v3(spos.x, heightData[z][x].height * KM_PER_VOXEL, spos.y);
             }
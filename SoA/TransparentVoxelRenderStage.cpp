@@ -5,10 +5,10 @@
 #include "BlockPack.h"
 #include "BlockTexturePack.h"
 #include "Camera.h"
+#include "ChunkCuller.h"
 #include "ChunkMeshManager.h"
 #include "ChunkRenderer.h"
 #include "GameRenderParams.h"
-#include "GeometrySorter.h"
 #include "Chunk.h"
 #include "RenderUtils.h"
 #include "ShaderLoader.h"
@@ -20,8 +20,11 @@ void TransparentVoxelRenderStage::hook(ChunkRenderer* renderer, const GameRender
 }
 
 void TransparentVoxelRenderStage::render(const Camera* camera VORB_MAYBE_UNUSED) {
+    const ChunkCuller* culler = m_gameRenderParams->chunkCuller;
+    const std::vector<ChunkMesh*>& drawList = culler->getDrawList();
+    if (drawList.empty()) return;
+
     glDepthMask(GL_FALSE);
-    ChunkMeshManager* cmm = m_gameRenderParams->chunkMeshmanager;
 
     const f64v3& position = m_gameRenderParams->chunkCamera->getPosition();
 
@@ -30,48 +33,27 @@ void TransparentVoxelRenderStage::render(const Camera* camera VORB_MAYBE_UNUSED)
 
     glDisable(GL_CULL_FACE);
 
-    // f64v3 cpos;
-
-    static i32v3 oldPos = i32v3(0);
-    bool sort = false;
-
+    // Meshes remember the voxel they were sorted from, so ones that were out
+    // of view get sorted when they come back.
     i32v3 intPosition(fastFloor(position.x), fastFloor(position.y), fastFloor(position.z));
 
-    if (oldPos != intPosition) {
-        //sort the geometry
-        sort = true;
-        oldPos = intPosition;
-    }
-    const std::vector <ChunkMesh *>& chunkMeshes = cmm->getChunkMeshes();
-    {
-        std::lock_guard<std::mutex> l(cmm->lckActiveChunkMeshes);
-        if (chunkMeshes.empty()) return;
-        for (size_t i = 0; i < chunkMeshes.size(); i++) {
-            ChunkMesh* cm = chunkMeshes[i];
-            if (sort) cm->needsSort = true;
-
-            if (cm->inFrustum) {
-                // TODO(Ben): We should probably do this outside of a lock
-                if (cm->needsSort) {
-                    cm->needsSort = false;
-                    if (cm->transQuadIndices.size() != 0) {
-                        GeometrySorter::sortTransparentBlocks(cm, intPosition);
-
-                        //update index data buffer
-                        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cm->transIndexID);
-                        glBufferData(GL_ELEMENT_ARRAY_BUFFER, cm->transQuadIndices.size() * sizeof(ui32), NULL, GL_STATIC_DRAW);
-                        void* v = glMapBufferRange(GL_ELEMENT_ARRAY_BUFFER, 0, cm->transQuadIndices.size() * sizeof(ui32), GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
-
-                        if (v == NULL) pError("Failed to map sorted transparency buffer.");
-                        memcpy(v, &(cm->transQuadIndices[0]), cm->transQuadIndices.size() * sizeof(ui32));
-                        glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER);
-                    }
-                }
-
-                m_renderer->drawTransparent(cm, position,
-                                            m_gameRenderParams->chunkCamera->getViewProjectionMatrix());
-            }
+    const f32m4& VP = m_gameRenderParams->chunkCamera->getViewProjectionMatrix();
+    // Back to front for blending
+    for (auto it = drawList.rbegin(); it != drawList.rend(); ++it) {
+        ChunkMesh* cm = *it;
+        // Only upload when the order actually changed
+        if (cm->transQuadIndices.size() != 0 && m_geometrySorter.sortTransparentBlocks(cm, intPosition)) {
+            //update index data buffer
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cm->transIndexID);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, cm->transQuadIndices.size() * sizeof(ui32), NULL, GL_STATIC_DRAW);
+            void* v = glMapBufferRange(GL_ELEMENT_ARRAY_BUFFER, 0, cm->transQuadIndices.size() * sizeof(ui32), GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+
+            if (v == NULL) pError("Failed to map sorted transparency buffer.");
+            memcpy(v, &(cm->transQuadIndices[0]), cm->transQuadIndices.size() * sizeof(ui32));
+            glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER);
         }
+
+        m_renderer->drawTransparent(cm, position, VP);
     }
     glEnable(GL_CULL_FACE);
 
@@ -16,6 +16,7 @@
 #ifndef TransparentVoxelRenderStage_h__
 #define TransparentVoxelRenderStage_h__
 
+#include "GeometrySorter.h"
 #include "IRenderStage.h"
 
 #include <Vorb/graphics/GLProgram.h>
@@ -34,6 +35,7 @@ class TransparentVoxelRenderStage : public IRenderStage {
 private:
     ChunkRenderer* m_renderer;
     const GameRenderParams* m_gameRenderParams = nullptr; ///< Handle to some shared parameters
+    GeometrySorter m_geometrySorter;
 };
 
 #endif // TransparentVoxelRenderStage_h__
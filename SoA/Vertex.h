@@ -87,6 +87,45 @@ struct BlockVertex {
 };
 static_assert(sizeof(BlockVertex) == 32, "Size of BlockVertex is not 32");
 
+// Compact alternative to BlockVertex for opaque meshes. Everything that isn't
+// position or UV is looked up by material in the mesh's BlockMaterial table.
+// Size: 8 Bytes
+struct CompactBlockVertex {
+    ui8v3 position;
+    ui8 face;
+    ui8v2 tex;
+    ui16 material; ///< Index into ChunkMeshData::opaqueMaterials
+};
+static_assert(sizeof(CompactBlockVertex) == 8, "Size of CompactBlockVertex is not 8");
+
+// The BlockVertex attributes shared by many vertices of a mesh.
+// Uploaded as 6 RGBA8 texels per material to a texture buffer.
+// Size: 24 Bytes
+struct BlockMaterial {
+    AtlasTexturePosition texturePosition;
+    AtlasTexturePosition normTexturePosition;
+    AtlasTexturePosition dispTexturePosition;
+    ui8v2 textureDims;
+    ui8v2 overlayTextureDims;
+    color3 color;
+    ui8 blendMode;
+    color3 overlayColor;
+    ui8 animationLength;
+
+    bool operator==(const BlockMaterial& rhs) const {
+        return memcmp(this, &rhs, sizeof(BlockMaterial)) == 0;
+    }
+
+    struct Hash {
+        size_t operator()(const BlockMaterial& m) const {
+            ui64 words[3];
+            memcpy(words, &m, sizeof(words));
+            return std::hash<ui64>()(words[0] ^ (words[1] * 31) ^ (words[2] * 961));
+        }
+    };
+};
+static_assert(sizeof(BlockMaterial) == 24, "Size of BlockMaterial is not 24");
+
 class LiquidVertex {
 public:
     // TODO: x and z can be bytes?
@@ -0,0 +1,257 @@
+#include "stdafx.h"
+#include "VoxelBroadPhase.h"
+
+#include "BlockPack.h"
+#include "ChunkAccessor.h"
+#include "ChunkGrid.h"
+#include "GameSystem.h"
+#include "SpaceSystem.h"
+#include "VoxelSpaceConversions.h"
+
+namespace {
+    inline bool isEmptyBox(const i32v3& min, const i32v3& max) {
+        return max.x <= min.x || max.y <= min.y || max.z <= min.z;
+    }
+}
+
+void VoxelBroadPhase::update(GameSystem* gameSystem, SpaceSystem* spaceSystem) {
+    m_frame++;
+    dropDisposedGrids(spaceSystem);
+
+    // Move collidables between buckets
+    m_entities.resize(gameSystem->aabbCollidable.getComponentListSize());
+    vecs::ComponentID cID = 0;
+    for (auto& it : gameSystem->aabbCollidable) {
+        // Iteration follows component IDs, 0 is the null component
+        if (cID) updateRange(cID, it.second, gameSystem, spaceSystem);
+        cID++;
+    }
+    // Collidables that weren't visited were removed
+    for (cID = 0; cID < m_entities.size(); cID++) {
+        EntityRange& range = m_entities[cID];
+        if (range.grid && range.frame != m_frame) {
+            removeFromBuckets(cID, range);
+            range.grid = nullptr;
+        }
+    }
+
+    // Copy all voxels first, so neighbor flags can look into adjacent chunks
+    for (auto& git : m_grids) {
+        for (auto& bit : git.second.buckets) {
+            takeSnapshot(*git.first, bit.second, bit.first);
+        }
+    }
+    for (auto& git : m_grids) {
+        for (auto& bit : git.second.buckets) {
+            collide(git.second, bit.second, bit.first, gameSystem);
+        }
+    }
+}
+
+bool VoxelBroadPhase::isChunkGenerated(ChunkGrid& grid, const ChunkID& id) const {
+    auto git = m_grids.find(&grid);
+    if (git != m_grids.end()) {
+        auto bit = git->second.buckets.find(id);
+        if (bit != git->second.buckets.end() && bit->second.chunk.isAquired()) {
+            return bit->second.chunk->genLevel == GEN_DONE;
+        }
+    }
+    // Nothing overlaps it, look it up without adding it
+    ChunkHandle chunk = grid.accessor.tryAcquire(id);
+    if (!chunk.isAquired()) return false;
+    bool isGenerated = chunk->genLevel == GEN_DONE;
+    chunk.release();
+    return isGenerated;
+}
+
+void VoxelBroadPhase::dropDisposedGrids(SpaceSystem* spaceSystem) {
+    for (auto it = m_grids.begin(); it != m_grids.end();) {
+        const SphericalVoxelComponent& svCmp = spaceSystem->sphericalVoxel.get(it->second.sphericalVoxel);
+        if (svCmp.chunkGrids == it->second.chunkGrids) {
+            ++it;
+            continue;
+        }
+        // The chunks were freed with the grid, so the handles are dropped without a release
+        for (auto& range : m_entities) {
+            if (range.grid == it->first) range.grid = nullptr;
+        }
+        it = m_grids.erase(it);
+    }
+}
+
+void VoxelBroadPhase::updateRange(vecs::ComponentID cID, AabbCollidableComponent& cmp, GameSystem* gameSystem, SpaceSystem* spaceSystem) {
+    // Clear old data
+    cmp.voxelCollisions.clear();
+
+    EntityRange& range = m_entities[cID];
+    auto& physics = gameSystem->physics.get(cmp.physics);
+    auto& position = gameSystem->voxelPosition.get(physics.voxelPosition);
+    SphericalVoxelComponent* svCmp = nullptr;
+    if (position.parentVoxel) svCmp = &spaceSystem->sphericalVoxel.get(position.parentVoxel);
+    if (!svCmp || !svCmp->chunkGrids) {
+        // Not on a voxel planet
+        if (range.grid) removeFromBuckets(cID, range);
+        range.grid = nullptr;
+        return;
+    }
+
+    EntityRange newRange;
+    newRange.grid = &svCmp->chunkGrids[position.gridPosition.face];
+    f64v3 vpos = position.gridPosition.pos + f64v3(cmp.offset - cmp.box * 0.5f);
+    newRange.minVoxel = i32v3(glm::floor(vpos));
+    newRange.maxVoxel = newRange.minVoxel + i32v3(glm::ceil(f64v3(cmp.box) + glm::fract(vpos)));
+    // Grown by one voxel for the neighbor flags
+    newRange.minChunk = VoxelSpaceConversions::voxelToChunk(newRange.minVoxel - 1);
+    newRange.maxChunk = VoxelSpaceConversions::voxelToChunk(newRange.maxVoxel);
+    newRange.frame = m_frame;
+
+    // Only touch the buckets when it crosses a chunk border
+    if (newRange.grid != range.grid || newRange.minChunk != range.minChunk || newRange.maxChunk != range.maxChunk) {
+        if (range.grid) removeFromBuckets(cID, range);
+        if (m_grids.find(newRange.grid) == m_grids.end()) {
+            GridBuckets& grid = m_grids[newRange.grid];
+            grid.sphericalVoxel = position.parentVoxel;
+            grid.chunkGrids = svCmp->chunkGrids;
+            grid.blockPack = svCmp->blockPack;
+        }
+        addToBuckets(cID, newRange);
+    }
+    range = newRange;
+}
+
+void VoxelBroadPhase::addToBuckets(vecs::ComponentID cID, const EntityRange& range) {
+    GridBuckets& grid = m_grids[range.grid];
+    for (int y = range.minChunk.y; y <= range.maxChunk.y; y++) {
+        for (int z = range.minChunk.z; z <= range.maxChunk.z; z++) {
+            for (int x = range.minChunk.x; x <= range.maxChunk.x; x++) {
+                ChunkID id(x, y, z);
+                Bucket& bucket = grid.buckets[id];
+                // Don't add chunks for empty space, takeSnapshot retries
+                if (!bucket.chunk.isAquired()) bucket.chunk = range.grid->accessor.tryAcquire(id);
+                bucket.entities.push_back(cID);
+            }
+        }
+    }
+}
+
+void VoxelBroadPhase::removeFromBuckets(vecs::ComponentID cID, const EntityRange& range) {
+    auto git = m_grids.find(range.grid);
+    if (git == m_grids.end()) return;
+    auto& buckets = git->second.buckets;
+    for (int y = range.minChunk.y; y <= range.maxChunk.y; y++) {
+        for (int z = range.minChunk.z; z <= range.maxChunk.z; z++) {
+            for (int x = range.minChunk.x; x <= range.maxChunk.x; x++) {
+                auto bit = buckets.find(ChunkID(x, y, z));
+                if (bit == buckets.end()) continue;
+                Bucket& bucket = bit->second;
+                for (size_t i = 0; i < bucket.entities.size(); i++) {
+                    if (bucket.entities[i] == cID) {
+                        bucket.entities[i] = bucket.entities.back();
+                        bucket.entities.pop_back();
+                        break;
+                    }
+                }
+                if (bucket.entities.empty()) {
+                    if (bucket.chunk.isAquired()) bucket.chunk.release();
+                    buckets.erase(bit);
+                }
+            }
+        }
+    }
+    if (buckets.empty()) m_grids.erase(git);
+}
+
+void VoxelBroadPhase::takeSnapshot(ChunkGrid& grid, Bucket& bucket, const ChunkID& id) {
+    bucket.min = i32v3(0);
+    bucket.max = i32v3(0);
+    if (!bucket.chunk.isAquired()) {
+        bucket.chunk = grid.accessor.tryAcquire(id);
+        if (!bucket.chunk.isAquired()) return;
+    }
+    Chunk* chunk = bucket.chunk;
+    if (chunk->genLevel != GEN_DONE) return;
+
+    // Union of the grown boxes, in chunk space
+    i32v3 origin = i32v3(id.x, id.y, id.z) * CHUNK_WIDTH;
+    i32v3 min(CHUNK_WIDTH);
+    i32v3 max(0);
+    for (auto& cID : bucket.entities) {
+        const EntityRange& range = m_entities[cID];
+        min = glm::min(min, range.minVoxel - 1 - origin);
+        max = glm::max(max, range.maxVoxel + 1 - origin);
+    }
+    min = glm::clamp(min, 0, CHUNK_WIDTH);
+    max = glm::clamp(max, 0, CHUNK_WIDTH);
+    if (isEmptyBox(min, max)) return;
+
+    i32v3 size = max - min;
+    bucket.blocks.resize(size.x * size.y * size.z);
+    {
+        std::shared_lock<std::shared_timed_mutex> l(chunk->dataMutex);
+        chunk->blocks.copyRegion(min, max, bucket.blocks.data(), size.x, size.x * size.z);
+    }
+    bucket.min = min;
+    bucket.max = max;
+}
+
+void VoxelBroadPhase::collide(GridBuckets& grid, Bucket& bucket, const ChunkID& id, GameSystem* gameSystem) {
+    if (isEmptyBox(bucket.min, bucket.max)) return;
+    const BlockPack* bp = grid.blockPack;
+    i32v3 origin = i32v3(id.x, id.y, id.z) * CHUNK_WIDTH;
+    i32v3 size = bucket.max - bucket.min;
+
+    for (auto& cID : bucket.entities) {
+        const EntityRange& range = m_entities[cID];
+        // Part of the box inside this chunk, may be empty when only the grown box is
+        i32v3 min = glm::max(range.minVoxel - origin, i32v3(0));
+        i32v3 max = glm::min(range.maxVoxel - origin, i32v3(CHUNK_WIDTH));
+        if (isEmptyBox(min, max)) continue;
+
+        std::vector<BlockCollisionData>* collisions = nullptr;
+        for (int y = min.y; y < max.y; y++) {
+            for (int z = min.z; z < max.z; z++) {
+                for (int x = min.x; x < max.x; x++) {
+                    i32v3 p = i32v3(x, y, z) - bucket.min;
+                    BlockID blockID = bucket.blocks[(p.y * size.z + p.z) * size.x + p.x];
+                    if (!bp->operator[](blockID).collide) continue;
+
+                    if (!collisions) collisions = &gameSystem->aabbCollidable.get(cID).voxelCollisions[id];
+                    collisions->emplace_back(blockID, (ui16)(y * CHUNK_LAYER + z * CHUNK_WIDTH + x));
+                    BlockCollisionData& cd = collisions->back();
+                    // Set neighbor collide flags
+                    cd.left = isCollidable(grid, bucket, id, i32v3(x - 1, y, z));
+                    cd.right = isCollidable(grid, bucket, id, i32v3(x + 1, y, z));
+                    cd.bottom = isCollidable(grid, bucket, id, i32v3(x, y - 1, z));
+                    cd.top = isCollidable(grid, bucket, id, i32v3(x, y + 1, z));
+                    cd.back = isCollidable(grid, bucket, id, i32v3(x, y, z - 1));
+                    cd.front = isCollidable(grid, bucket, id, i32v3(x, y, z + 1));
+                }
+            }
+        }
+    }
+}
+
+bool VoxelBroadPhase::isCollidable(const GridBuckets& grid, const Bucket& bucket, const ChunkID& id, i32v3 pos) const {
+    const Bucket* b = &bucket;
+    // Step into the neighbor, its bucket has the same collidables since their boxes were grown
+    i32v3 offset(0);
+    for (int i = 0; i < 3; i++) {
+        if (pos[i] < 0) {
+            offset[i] = -1;
+        } else if (pos[i] >= CHUNK_WIDTH) {
+            offset[i] = 1;
+        }
+    }
+    if (offset != i32v3(0)) {
+        auto it = grid.buckets.find(ChunkID(id.x + offset.x, id.y + offset.y, id.z + offset.z));
+        if (it == grid.buckets.end()) return false;
+        b = &it->second;
+        pos -= offset * CHUNK_WIDTH;
+    }
+
+    if (pos.x < b->min.x || pos.y < b->min.y || pos.z < b->min.z ||
+        pos.x >= b->max.x || pos.y >= b->max.y || pos.z >= b->max.z) return false;
+    i32v3 size = b->max - b->min;
+    i32v3 p = pos - b->min;
+    return grid.blockPack->operator[](b->blocks[(p.y * size.z + p.z) * size.x + p.x]).collide;
+}
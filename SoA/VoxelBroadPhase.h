@@ -0,0 +1,83 @@
+///
+/// VoxelBroadPhase.h
+/// Seed of Andromeda
+///
+/// Copyright 2014 Regrowth Studios
+/// MIT License
+///
+/// Summary:
+/// Buckets AABB collidables by the chunks they overlap, so voxel collision
+/// touches each chunk once per update instead of once per entity.
+///
+
+#pragma once
+
+#ifndef VoxelBroadPhase_h__
+#define VoxelBroadPhase_h__
+
+#include <Vorb/ecs/Entity.h>
+
+#include "BlockData.h"
+#include "ChunkHandle.h"
+#include "ChunkID.h"
+
+#include <unordered_map>
+#include <vector>
+
+class BlockPack;
+class ChunkGrid;
+class GameSystem;
+class SpaceSystem;
+struct AabbCollidableComponent;
+
+class VoxelBroadPhase {
+public:
+    /// Moves the collidables between chunk lists and fills their voxelCollisions.
+    /// Each chunk with collidables in it is locked once, to copy the voxels they can touch.
+    void update(GameSystem* gameSystem, SpaceSystem* spaceSystem);
+
+    /// Checks if a chunk is done generating, without a lookup when a collidable overlaps it
+    bool isChunkGenerated(ChunkGrid& grid, const ChunkID& id) const;
+private:
+    /// Voxels a collidable can touch, its box grown by one for the neighbor flags
+    struct EntityRange {
+        ChunkGrid* grid = nullptr;
+        i32v3 minChunk;
+        i32v3 maxChunk; ///< Inclusive
+        i32v3 minVoxel; ///< Box of the collidable
+        i32v3 maxVoxel; ///< Exclusive
+        ui32 frame = 0;
+    };
+
+    struct Bucket {
+        ChunkHandle chunk; ///< Held while the bucket has collidables
+        std::vector<vecs::ComponentID> entities;
+        // Copy of the blocks in [min, max) of the chunk, empty if it isn't generated
+        i32v3 min = i32v3(0);
+        i32v3 max = i32v3(0);
+        std::vector<BlockID> blocks;
+    };
+
+    struct GridBuckets {
+        vecs::ComponentID sphericalVoxel = 0;
+        ChunkGrid* chunkGrids = nullptr; ///< To notice that the voxel component was disposed
+        const BlockPack* blockPack = nullptr;
+        std::unordered_map<ChunkID, Bucket> buckets;
+    };
+
+    /// Drops the buckets of voxel components that were disposed, their chunks are gone
+    void dropDisposedGrids(SpaceSystem* spaceSystem);
+    void updateRange(vecs::ComponentID cID, AabbCollidableComponent& cmp, GameSystem* gameSystem, SpaceSystem* spaceSystem);
+    void addToBuckets(vecs::ComponentID cID, const EntityRange& range);
+    void removeFromBuckets(vecs::ComponentID cID, const EntityRange& range);
+    void takeSnapshot(ChunkGrid& grid, Bucket& bucket, const ChunkID& id);
+    void collide(GridBuckets& grid, Bucket& bucket, const ChunkID& id, GameSystem* gameSystem);
+    /// Checks a voxel against the copy of the chunk that holds it
+    bool isCollidable(const GridBuckets& grid, const Bucket& bucket, const ChunkID& id, i32v3 pos) const;
+
+    std::vector<EntityRange> m_entities; ///< Indexed by AABB component ID
+    std::unordered_map<ChunkGrid*, GridBuckets> m_grids;
+    ui32 m_frame = 0;
+};
+
+#endif // VoxelBroadPhase_h__
@@ -1,635 +1,403 @@
 #include "stdafx.h"
 #include "VoxelLightEngine.h"
 
-#include "Errors.h"
-#include "VoxelNavigation.inl"
-
-// TODO: Do we still want this system as is? If so reimplement and remove VORB_UNUSED tags.
-
-void VoxelLightEngine::calculateLight(Chunk* chunk VORB_UNUSED)
-{
-    ////Flush all edge queues
-    //_lockedChunk = nullptr;
-
-    ////Sunlight Calculation
-    //if (chunk->sunlightRemovalQueue.size()) {
-    //    vvox::swapLockedChunk(chunk, _lockedChunk);
-    //    //Removal
-    //    while (chunk->sunlightRemovalQueue.size()){
-    //        auto& node = chunk->sunlightRemovalQueue.front();
-    //        removeSunlightBFS(chunk, (int)node.blockIndex, node.oldLightVal);
-    //        chunk->sunlightRemovalQueue.pop();
-    //    }
-    //    std::queue<SunlightRemovalNode>().swap(chunk->sunlightRemovalQueue); //forces memory to be freed
-    //}
-
-    //if (chunk->sunlightUpdateQueue.size()) {
-    //    vvox::swapLockedChunk(chunk, _lockedChunk);
-    //    //Addition
-    //    while (chunk->sunlightUpdateQueue.size()){
-    //        auto& node = chunk->sunlightUpdateQueue.front();
-    //        placeSunlightBFS(chunk, (int)node.blockIndex, (int)node.lightVal);
-    //        chunk->sunlightUpdateQueue.pop();
-    //    }
-    //    std::queue<SunlightUpdateNode>().swap(chunk->sunlightUpdateQueue); //forces memory to be freed
-    //}
-
-    ////Voxel Light Calculation
-    //if (chunk->lampLightRemovalQueue.size()) {
-    //    vvox::swapLockedChunk(chunk, _lockedChunk);
-    //    //Removal
-    //    while (chunk->lampLightRemovalQueue.size()){
-    //        auto& node = chunk->lampLightRemovalQueue.front();
-    //        removeLampLightBFS(chunk, (int)node.blockIndex, node.oldLightColor);
-    //        chunk->lampLightRemovalQueue.pop();
-    //    }
-    //    std::queue<LampLightRemovalNode>().swap(chunk->lampLightRemovalQueue); //forces memory to be freed
-    //}
-
-    //if (chunk->lampLightUpdateQueue.size()) {
-    //    vvox::swapLockedChunk(chunk, _lockedChunk);
-    //    //Addition
-    //    while (chunk->lampLightUpdateQueue.size()) {
-    //        auto& node = chunk->lampLightUpdateQueue.front();
-    //        placeLampLightBFS(chunk, (int)node.blockIndex, node.lightColor);
-    //        chunk->lampLightUpdateQueue.pop();
-    //    }
-    //    std::queue<LampLightUpdateNode>().swap(chunk->lampLightUpdateQueue); //forces memory to be freed
-    //}
-    //if (_lockedChunk) {
-    //    _lockedChunk->unlock();
-    //    _lockedChunk = nullptr;
-    //}
-}
+#include "BlockPack.h"
+#include "Chunk.h"
+#include "VoxelBits.h"
+
+// Directions in Chunk::neighbors order
+#define LIGHT_DIR_BOTTOM 2
+#define LIGHT_DIR_TOP 3
 
-void VoxelLightEngine::calculateSunlightExtend(Chunk* chunk VORB_UNUSED)
-{
-    //int blockIndex;
-    //int y;
-
-    //_lockedChunk = nullptr;
-    //vvox::swapLockedChunk(chunk, _lockedChunk);
-
-    //for (ui32 i = 0; i < chunk->sunExtendList.size(); i++){
-    //    blockIndex = chunk->sunExtendList[i];
-    //    if (chunk->getSunlight(blockIndex) == MAXLIGHT){
-    //        y = blockIndex / CHUNK_LAYER;
-    //        extendSunRay(chunk, blockIndex - y * CHUNK_LAYER, y);
-    //    }
-    //}
-    //std::vector<GLushort>().swap(chunk->sunExtendList); //forces memory to be freed
-    //if (_lockedChunk) {
-    //    _lockedChunk->unlock();
-    //    _lockedChunk = nullptr;
-    //}
+#define RED1 0x400
+#define GREEN1 0x20
+#define BLUE1 1
+
+bool ChunkLightQueues::empty() const {
+    return changedVoxels.empty() && sunlightUpdates.empty() && sunlightRemovals.empty() &&
+        lampLightUpdates.empty() && lampLightRemovals.empty();
 }
 
-void VoxelLightEngine::calculateSunlightRemoval(Chunk* chunk VORB_UNUSED)
-{
-    //int blockIndex;
-    //int y;
-
-    //_lockedChunk = nullptr;
-    //vvox::swapLockedChunk(chunk, _lockedChunk);
-
-    //for (ui32 i = 0; i < chunk->sunRemovalList.size(); i++){
-    //    blockIndex = chunk->sunRemovalList[i];
-    //    if (chunk->getSunlight(blockIndex) == 0){
-    //        y = blockIndex / CHUNK_LAYER;
-    //        blockSunRay(chunk, blockIndex - y * CHUNK_LAYER, y - 1);
-    //    }
-    //}
-    //std::vector<GLushort>().swap(chunk->sunRemovalList); //forces memory to be freed
-    //if (_lockedChunk) {
-    //    _lockedChunk->unlock();
-    //    _lockedChunk = nullptr;
-    //}
+void ChunkLightQueues::clear() {
+    changedVoxels.clear();
+    sunlightUpdates.clear();
+    sunlightRemovals.clear();
+    lampLightUpdates.clear();
+    lampLightRemovals.clear();
 }
 
-//Check for sun rays from the top chunk
-void VoxelLightEngine::checkTopForSunlight(Chunk* chunk VORB_UNUSED)
-{
-    //int blockIndex;
-    //ui16 topLight;
-
-    //static ui16 topSunlight[CHUNK_LAYER];
-
-    //if (chunk->top && chunk->top->isAccessible) {
-    //    // First grab the sunlight from the top
-    //    chunk->top->lock();
-    //    for (int i = 0; i < CHUNK_LAYER; i++) {
-    //        topSunlight[i] = chunk->top->getSunlight(i);
-    //    }
-    //    chunk->top->unlock();
-    //    // Now check for sun extend
-    //    chunk->lock();
-    //    for (int i = 0; i < CHUNK_LAYER; i++) {
-    //        blockIndex = i + 31 * CHUNK_LAYER;
-    //        topLight = topSunlight[i];
-
-    //        if ((chunk->getBlock(blockIndex).blockLight == 0) && topLight == MAXLIGHT) {
-    //            chunk->setSunlight(blockIndex, MAXLIGHT);
-    //            chunk->sunExtendList.push_back(blockIndex);
-    //        } else if (topLight == 0) { //if the top is blocking sunlight
-    //            if (chunk->getSunlight(blockIndex) == MAXLIGHT) {
-    //                chunk->setSunlight(blockIndex, 0);
-    //                chunk->sunRemovalList.push_back(blockIndex);
-    //            }
-    //        }
-    //    }
-    //    chunk->unlock();
-    //}
+void ChunkLightQueues::swap(ChunkLightQueues& other) {
+    changedVoxels.swap(other.changedVoxels);
+    sunlightUpdates.swap(other.sunlightUpdates);
+    sunlightRemovals.swap(other.sunlightRemovals);
+    lampLightUpdates.swap(other.lampLightUpdates);
+    lampLightRemovals.swap(other.lampLightRemovals);
 }
 
-void VoxelLightEngine::blockSunRay(Chunk* chunk VORB_UNUSED, int xz VORB_UNUSED, int y VORB_UNUSED)
-{
-    //int i = y; //start at the current block
-    //chunk->changeState(ChunkStates::MESH);
-   
-    //while (true){ //do the light removal iteration
-    //    if (i == -1){ //bottom chunk
-    //        if (chunk->bottom && chunk->bottom->isAccessible){
-    //            vvox::swapLockedChunk(chunk->bottom, _lockedChunk);
-    //            VoxelLightEngine::blockSunRay(chunk->bottom, xz, 31); //continue the algorithm
-    //            vvox::swapLockedChunk(chunk, _lockedChunk);
-    //        }
-    //        return;
-    //    } else{
-    //        if (chunk->getSunlight(xz + i*CHUNK_LAYER) == MAXLIGHT){
-    //            chunk->setSunlight(xz + i*CHUNK_LAYER, 0);
-    //            VoxelLightEngine::removeSunlightBFS(chunk, xz + i*CHUNK_LAYER, MAXLIGHT);
-    //        } else{
-    //            return;
-    //        }
-    //        i--;
-    //    }
-    //}
+void ChunkLightQueues::append(const ChunkLightQueues& other) {
+    changedVoxels.insert(changedVoxels.end(), other.changedVoxels.begin(), other.changedVoxels.end());
+    sunlightUpdates.insert(sunlightUpdates.end(), other.sunlightUpdates.begin(), other.sunlightUpdates.end());
+    sunlightRemovals.insert(sunlightRemovals.end(), other.sunlightRemovals.begin(), other.sunlightRemovals.end());
+    lampLightUpdates.insert(lampLightUpdates.end(), other.lampLightUpdates.begin(), other.lampLightUpdates.end());
+    lampLightRemovals.insert(lampLightRemovals.end(), other.lampLightRemovals.begin(), other.lampLightRemovals.end());
+}
 
+// Gets the voxel next to blockIndex in direction dir. Returns false if it is in
+// the neighbor chunk, neighborIndex is then the index in that chunk.
+inline bool getNeighborVoxel(int blockIndex, int dir, OUT int& neighborIndex) {
+    int x = blockIndex & CHUNK_WIDTH_M1;
+    int y = blockIndex / CHUNK_LAYER;
+    int z = (blockIndex / CHUNK_WIDTH) & CHUNK_WIDTH_M1;
+    switch (dir) {
+        case 0: // left
+            neighborIndex = x > 0 ? blockIndex - 1 : blockIndex + CHUNK_WIDTH_M1;
+            return x > 0;
+        case 1: // right
+            neighborIndex = x < CHUNK_WIDTH_M1 ? blockIndex + 1 : blockIndex - CHUNK_WIDTH_M1;
+            return x < CHUNK_WIDTH_M1;
+        case 2: // bottom
+            neighborIndex = y > 0 ? blockIndex - CHUNK_LAYER : blockIndex + CHUNK_SIZE - CHUNK_LAYER;
+            return y > 0;
+        case 3: // top
+            neighborIndex = y < CHUNK_WIDTH_M1 ? blockIndex + CHUNK_LAYER : blockIndex - CHUNK_SIZE + CHUNK_LAYER;
+            return y < CHUNK_WIDTH_M1;
+        case 4: // back
+            neighborIndex = z > 0 ? blockIndex - CHUNK_WIDTH : blockIndex + CHUNK_LAYER - CHUNK_WIDTH;
+            return z > 0;
+        default: // front
+            neighborIndex = z < CHUNK_WIDTH_M1 ? blockIndex + CHUNK_WIDTH : blockIndex - CHUNK_LAYER + CHUNK_WIDTH;
+            return z < CHUNK_WIDTH_M1;
+    }
 }
 
-void VoxelLightEngine::extendSunRay(Chunk* chunk VORB_UNUSED, int xz VORB_UNUSED, int y VORB_UNUSED)
-{
-    //int i = y; //start at the current block, for extension to other chunks
-    //int blockIndex;
-    //chunk->changeState(ChunkStates::MESH);
-    //while (true){
-    //    if (i == -1){
-    //        if (chunk->bottom && chunk->bottom->isAccessible){
-    //            vvox::swapLockedChunk(chunk->bottom, _lockedChunk);
-    //            extendSunRay(chunk->bottom, xz, 31); //continue the algorithm
-    //            vvox::swapLockedChunk(chunk, _lockedChunk);
-    //        }
-    //        return;
-    //    } else{
-    //        blockIndex = xz + i*CHUNK_LAYER;
-    //        if (chunk->getBlock(blockIndex).blockLight == 0){
-
-    //            if (chunk->getSunlight(blockIndex) != MAXLIGHT){
-    //                chunk->sunlightUpdateQueue.emplace(blockIndex, MAXLIGHT);
-    //            }
-    //        
-    //        } else{
-    //            return;
-    //        }
-    //    }
-    //    i--;
-    //}
+// Voxel k of the chunk side facing dir, k runs over the two other axes
+inline int getFaceVoxel(int dir, int k) {
+    int a = k & CHUNK_WIDTH_M1;
+    int b = k / CHUNK_WIDTH;
+    int side = (dir & 1) ? CHUNK_WIDTH_M1 : 0;
+    switch (dir >> 1) {
+        case 0: return side + a * CHUNK_WIDTH + b * CHUNK_LAYER;
+        case 1: return a + side * CHUNK_LAYER + b * CHUNK_WIDTH;
+        default: return a + b * CHUNK_LAYER + side * CHUNK_WIDTH;
+    }
 }
 
-inline void removeSunlightNeighborUpdate(Chunk* chunk VORB_UNUSED, int blockIndex VORB_UNUSED, ui16 light VORB_UNUSED) {
-   /* ui8 lightVal = chunk->getSunlight(blockIndex);
-    if (lightVal > 0){
-        if (lightVal <= light){
-            chunk->setSunlight(blockIndex, 0);
-            chunk->sunlightRemovalQueue.emplace(blockIndex, light);
-        } else {
-            chunk->sunlightUpdateQueue.emplace(blockIndex, 0);
-        }
-    }*/
+// Light that moves one voxel, each color loses one
+inline ui16 dimLampLight(ui16 light) {
+    if (light & LAMP_RED_MASK) light -= RED1;
+    if (light & LAMP_GREEN_MASK) light -= GREEN1;
+    if (light & LAMP_BLUE_MASK) light -= BLUE1;
+    return light;
 }
 
-void VoxelLightEngine::removeSunlightBFS(Chunk* chunk VORB_UNUSED, int blockIndex VORB_UNUSED, ui8 oldLightVal VORB_UNUSED)
-{
-    //ui8 nextIntensity;
-    //if (oldLightVal > 0) {
-    //    nextIntensity = oldLightVal - 1;
-    //} else {
-    //    nextIntensity = 0;
-    //}
-
-    //int x = blockIndex % CHUNK_WIDTH;
-    //int y = blockIndex / CHUNK_LAYER;
-    //int z = (blockIndex % CHUNK_LAYER) / CHUNK_WIDTH;
-
-    //Chunk*& left = chunk->left;
-    //Chunk*& right = chunk->right;
-    //Chunk*& back = chunk->back;
-    //Chunk*& front = chunk->front;
-    //Chunk*& top = chunk->top;
-    //Chunk*& bottom = chunk->bottom;
-
-    //if (x > 0){ //left
-    //    removeSunlightNeighborUpdate(chunk, blockIndex - 1, nextIntensity);
-    //} else if (left && left->isAccessible){
-    //    vvox::swapLockedChunk(left, _lockedChunk);
-    //    removeSunlightNeighborUpdate(left, blockIndex + CHUNK_WIDTH - 1, nextIntensity);
-    //    left->changeState(ChunkStates::MESH);
-    //    vvox::swapLockedChunk(chunk, _lockedChunk);
-    //}
-
-    //if (x < CHUNK_WIDTH - 1){ //right
-    //    removeSunlightNeighborUpdate(chunk, blockIndex + 1, nextIntensity);
-    //} else if (right && right->isAccessible){
-    //    vvox::swapLockedChunk(right, _lockedChunk);
-    //    removeSunlightNeighborUpdate(right, blockIndex - CHUNK_WIDTH + 1, nextIntensity);
-    //    right->changeState(ChunkStates::MESH);
-    //    vvox::swapLockedChunk(chunk, _lockedChunk);
-    //}
-
-    //if (z > 0){ //back
-    //    removeSunlightNeighborUpdate(chunk, blockIndex - CHUNK_WIDTH, nextIntensity);
-    //} else if (back && back->isAccessible){
-    //    vvox::swapLockedChunk(back, _lockedChunk);
-    //    removeSunlightNeighborUpdate(back, blockIndex + CHUNK_LAYER - CHUNK_WIDTH, nextIntensity);
-    //    back->changeState(ChunkStates::MESH);
-    //    vvox::swapLockedChunk(chunk, _lockedChunk);
-    //}
-
-    //if (z < CHUNK_WIDTH - 1){ //front
-    //    removeSunlightNeighborUpdate(chunk, blockIndex + CHUNK_WIDTH, nextIntensity);
-    //} else if (front && front->isAccessible){
-    //    vvox::swapLockedChunk(front, _lockedChunk);
-    //    removeSunlightNeighborUpdate(front, blockIndex - CHUNK_LAYER + CHUNK_WIDTH, nextIntensity);
-    //    front->changeState(ChunkStates::MESH);
-    //    vvox::swapLockedChunk(chunk, _lockedChunk);
-    //}
-
-    //if (y > 0){ //bottom
-    //    removeSunlightNeighborUpdate(chunk, blockIndex - CHUNK_LAYER, nextIntensity);
-    //} else if (bottom && bottom->isAccessible){
-    //    vvox::swapLockedChunk(bottom, _lockedChunk);
-    //    removeSunlightNeighborUpdate(bottom, CHUNK_SIZE - CHUNK_LAYER + blockIndex, nextIntensity);
-    //    bottom->changeState(ChunkStates::MESH);
-    //    vvox::swapLockedChunk(chunk, _lockedChunk);
-    //}
-
-    //if (y < CHUNK_WIDTH - 1){ //top
-    //    removeSunlightNeighborUpdate(chunk, blockIndex + CHUNK_LAYER, nextIntensity);
-    //} else if (top && top->isAccessible){
-    //    vvox::swapLockedChunk(top, _lockedChunk);
-    //    removeSunlightNeighborUpdate(top, blockIndex - CHUNK_SIZE + CHUNK_LAYER, nextIntensity);
-    //    top->changeState(ChunkStates::MESH);
-    //    vvox::swapLockedChunk(chunk, _lockedChunk);
-    //}
-    //chunk->changeState(ChunkStates::MESH);
+inline ui16 getMaxLampColors(ui16 a, ui16 b) {
+    return glm::max(a & LAMP_RED_MASK, b & LAMP_RED_MASK) |
+        glm::max(a & LAMP_GREEN_MASK, b & LAMP_GREEN_MASK) |
+        glm::max(a & LAMP_BLUE_MASK, b & LAMP_BLUE_MASK);
+}
 
+// Sunlight that leaves a voxel with light in direction dir
+inline ui8 getSunlightOut(ui16 light, int dir) {
+    if (dir == LIGHT_DIR_BOTTOM && light == MAXLIGHT) return SUN_RAY;
+    return light ? (ui8)(light - 1) : 0;
 }
 
-inline void placeSunlightNeighborUpdate(Chunk* chunk VORB_UNUSED, int blockIndex VORB_UNUSED, ui16 light VORB_UNUSED) {
-    //if (chunk->getSunlight(blockIndex) < light){
-    //    if (chunk->getBlock(blockIndex).allowLight){
-    //        chunk->setSunlight(blockIndex, (ui8)light); // TODO(Ben) Wrong type?
-    //        chunk->sunlightUpdateQueue.emplace(blockIndex, light);
-    //    }
-    //}
+void VoxelLightEngine::update(Chunk* chunk, ChunkHandle neighbors[6], const BlockPack* blocks) {
+    m_blockPack = blocks;
+    m_hasChanged = false;
+
+    { // Take the work
+        std::lock_guard<std::mutex> l(chunk->lckLightQueues);
+        m_work.clear();
+        m_work.swap(chunk->lightQueues);
+        chunk->hasLightUpdates = false;
+    }
+
+    { // Copy the data, we are the only writer of this chunk's light
+        std::shared_lock<std::shared_timed_mutex> l(chunk->dataMutex);
+        chunk->blocks.copyRegion(i32v3(0), i32v3(CHUNK_WIDTH), m_blocks, CHUNK_WIDTH, CHUNK_LAYER);
+        chunk->sunlight.copyRegion(i32v3(0), i32v3(CHUNK_WIDTH), m_sunlight, CHUNK_WIDTH, CHUNK_LAYER);
+        chunk->lampLight.copyRegion(i32v3(0), i32v3(CHUNK_WIDTH), m_lampLight, CHUNK_WIDTH, CHUNK_LAYER);
+    }
+
+    // Remove first, light placed before would be removed with it
+    for (auto& i : m_work.changedVoxels) addChangedVoxel(i);
+    for (auto& n : m_work.sunlightRemovals) checkSunlightRemoval(n.blockIndex, n.oldLightVal);
+    for (auto& n : m_work.lampLightRemovals) checkLampLightRemoval(n.blockIndex, n.oldLightColor);
+    removeSunlightBFS();
+    removeLampLightBFS();
+
+    for (auto& n : m_lampSources) {
+        ui16 light = getMaxLampColors(m_lampLight[n.blockIndex], n.lightColor);
+        if (light != m_lampLight[n.blockIndex]) {
+            m_lampLight[n.blockIndex] = light;
+            m_hasChanged = true;
+        }
+        m_lampLightSpread.push_back(n.blockIndex);
+    }
+    m_lampSources.clear();
+    for (auto& n : m_work.sunlightUpdates) {
+        if (n.lightVal) {
+            offerSunlight(n.blockIndex, n.lightVal);
+        } else {
+            m_sunlightSpread.push_back(n.blockIndex);
+        }
+    }
+    for (auto& n : m_work.lampLightUpdates) {
+        if (n.lightColor) {
+            offerLampLight(n.blockIndex, n.lightColor);
+        } else {
+            m_lampLightSpread.push_back(n.blockIndex);
+        }
+    }
+    if (!chunk->isLit) seedLight(chunk, neighbors);
+
+    placeSunlightBFS();
+    placeLampLightBFS();
+
+    if (m_hasChanged || !chunk->isLit) {
+        std::lock_guard<std::shared_timed_mutex> l(chunk->dataMutex);
+        writeLight(chunk);
+    }
+    chunk->isLit = true;
+
+    // Hand light that left us to the neighbors
+    for (int dir = 0; dir < 6; dir++) {
+        ChunkLightQueues& border = m_border[dir];
+        if (border.empty()) continue;
+        // Neighbors that aren't lit yet pull our light in when they are seeded,
+        // so only lit ones get it. Otherwise chunks that never finish loading,
+        // like the ones just outside the load range, would collect it forever.
+        if (neighbors[dir].isAquired() && neighbors[dir]->isLit) {
+            Chunk* neighbor = neighbors[dir];
+            std::lock_guard<std::mutex> l(neighbor->lckLightQueues);
+            neighbor->lightQueues.append(border);
+            neighbor->hasLightUpdates = true;
+        }
+        border.clear();
+    }
 }
 
-void VoxelLightEngine::placeSunlightBFS(Chunk* chunk VORB_UNUSED, int blockIndex VORB_UNUSED, ui8 intensity VORB_UNUSED)
-{
-    //if (intensity > chunk->getSunlight(blockIndex)) {
-    //    //Set the light value
-    //    chunk->setSunlight(blockIndex, intensity);
-    //} else {
-    //    //If intensity is less that the actual light value, use the actual
-    //    intensity = chunk->getSunlight(blockIndex);
-    //}
-
-    //if (intensity <= 1) return;
-    ////Reduce by 1 to prevent a bunch of -1
-    //ui8 newIntensity = (intensity - 1);
-
-    //chunk->dirty = 1;
-
-    //int x = blockIndex % CHUNK_WIDTH;
-    //int y = blockIndex / CHUNK_LAYER;
-    //int z = (blockIndex % CHUNK_LAYER) / CHUNK_WIDTH;
-
-    //Chunk*& left = chunk->left;
-    //Chunk*& right = chunk->right;
-    //Chunk*& back = chunk->back;
-    //Chunk*& front = chunk->front;
-    //Chunk*& top = chunk->top;
-    //Chunk*& bottom = chunk->bottom;
-
-    //if (x > 0){ //left
-    //    placeSunlightNeighborUpdate(chunk, blockIndex - 1, newIntensity);
-    //} else if (left && left->isAccessible){
-    //    vvox::swapLockedChunk(left, _lockedChunk);
-    //    placeSunlightNeighborUpdate(left, blockIndex + CHUNK_WIDTH - 1, newIntensity);
-    //    left->changeState(ChunkStates::MESH);
-    //    vvox::swapLockedChunk(chunk, _lockedChunk);
-    //}
-
-    //if (x < CHUNK_WIDTH - 1){ //right
-    //    placeSunlightNeighborUpdate(chunk, blockIndex + 1, newIntensity);
-    //} else if (right && right->isAccessible){
-    //    vvox::swapLockedChunk(right, _lockedChunk);
-    //    placeSunlightNeighborUpdate(right, blockIndex - CHUNK_WIDTH + 1, newIntensity);
-    //    right->changeState(ChunkStates::MESH); 
-    //    vvox::swapLockedChunk(chunk, _lockedChunk);
-    //}
-
-    //if (z > 0){ //back
-    //    placeSunlightNeighborUpdate(chunk, blockIndex - CHUNK_WIDTH, newIntensity);
-    //} else if (back && back->isAccessible){
-    //    vvox::swapLockedChunk(back, _lockedChunk);
-    //    placeSunlightNeighborUpdate(back, blockIndex + CHUNK_LAYER - CHUNK_WIDTH, newIntensity);
-    //    back->changeState(ChunkStates::MESH);
-    //    vvox::swapLockedChunk(chunk, _lockedChunk);
-    //}
-
-    //if (z < CHUNK_WIDTH - 1){ //front
-    //    placeSunlightNeighborUpdate(chunk, blockIndex + CHUNK_WIDTH, newIntensity);
-    //} else if (front && front->isAccessible){
-    //    vvox::swapLockedChunk(front, _lockedChunk);
-    //    placeSunlightNeighborUpdate(front, blockIndex - CHUNK_LAYER + CHUNK_WIDTH, newIntensity);
-    //    front->changeState(ChunkStates::MESH);
-    //    vvox::swapLockedChunk(chunk, _lockedChunk);
-    //}
-
-    //if (y > 0){ //bottom
-    //    placeSunlightNeighborUpdate(chunk, blockIndex - CHUNK_LAYER, newIntensity);
-    //} else if (bottom && bottom->isAccessible){
-    //    vvox::swapLockedChunk(bottom, _lockedChunk);
-    //    placeSunlightNeighborUpdate(bottom, CHUNK_SIZE - CHUNK_LAYER + blockIndex, newIntensity);
-    //    bottom->changeState(ChunkStates::MESH);
-    //    vvox::swapLockedChunk(chunk, _lockedChunk);
-    //}
-
-    //if (y < CHUNK_WIDTH - 1){ //top
-    //    placeSunlightNeighborUpdate(chunk, blockIndex + CHUNK_LAYER, newIntensity);
-    //} else if (top && top->isAccessible){
-    //    vvox::swapLockedChunk(top, _lockedChunk);
-    //    placeSunlightNeighborUpdate(top, blockIndex - CHUNK_SIZE + CHUNK_LAYER, newIntensity);
-    //    top->changeState(ChunkStates::MESH);
-    //    vvox::swapLockedChunk(chunk, _lockedChunk);
-    //}
-
-    //chunk->changeState(ChunkStates::MESH);
+void VoxelLightEngine::seedLight(Chunk* chunk, ChunkHandle neighbors[6]) {
+    // Neighbors aren't updating, so their light can be read
+    bool isNeighborLit[6];
+    for (int dir = 0; dir < 6; dir++) {
+        isNeighborLit[dir] = neighbors[dir].isAquired() && neighbors[dir]->isLit;
+    }
+
+    // Sun rays come from the chunk above, or from the sky if the column is above the terrain
+    int topY = chunk->getVoxelPosition().pos.y + CHUNK_WIDTH;
+    for (int k = 0; k < CHUNK_LAYER; k++) {
+        if (isNeighborLit[LIGHT_DIR_TOP]) break;
+        const PlanetHeightData& height = chunk->gridData->heightData[k];
+        if ((f32)topY > height.height) offerSunlight(getFaceVoxel(LIGHT_DIR_TOP, k), SUN_RAY);
+    }
+
+    // Pull in the light of lit neighbors
+    for (int dir = 0; dir < 6; dir++) {
+        if (!isNeighborLit[dir]) continue;
+        Chunk* neighbor = neighbors[dir];
+        int opposite = dir ^ 1;
+        std::shared_lock<std::shared_timed_mutex> l(neighbor->dataMutex);
+        for (int k = 0; k < CHUNK_LAYER; k++) {
+            int blockIndex = getFaceVoxel(dir, k);
+            int neighborIndex = getFaceVoxel(opposite, k);
+            ui8 sunlight = getSunlightOut(neighbor->sunlight.get(neighborIndex), opposite);
+            if (sunlight) offerSunlight(blockIndex, sunlight);
+            ui16 lampLight = dimLampLight(neighbor->lampLight.get(neighborIndex));
+            if (lampLight) offerLampLight(blockIndex, lampLight);
+        }
+    }
+
+    // Emitters
+    for (int i = 0; i < CHUNK_SIZE; i++) {
+        ui16 color = (*m_blockPack)[m_blocks[i]].lightColorPacked;
+        if (color) {
+            m_lampLight[i] = getMaxLampColors(m_lampLight[i], color);
+            m_lampLightSpread.push_back((ui16)i);
+        }
+    }
 }
 
-inline ui16 getMaxLampColors(const ui16 redA VORB_UNUSED, const ui16 greenA VORB_UNUSED, const ui16 blueA VORB_UNUSED, const ui16 b VORB_UNUSED) {
-    /*   ui16 redB = b & LAMP_RED_MASK;
-       ui16 greenB = b & LAMP_GREEN_MASK;
-       ui16 blueB = b & LAMP_BLUE_MASK;
-       return MAX(redA, redB) | MAX(greenA, greenB) | MAX(blueA, blueB);*/
-       return 0;
+void VoxelLightEngine::addChangedVoxel(int blockIndex) {
+    if (m_sunlight[blockIndex]) {
+        m_sunlightRemovals.emplace_back((ui16)blockIndex, (ui8)m_sunlight[blockIndex]);
+        m_sunlight[blockIndex] = 0;
+        m_hasChanged = true;
+    }
+    if (m_lampLight[blockIndex]) {
+        m_lampLightRemovals.emplace_back((ui16)blockIndex, m_lampLight[blockIndex]);
+        m_lampLight[blockIndex] = 0;
+        m_hasChanged = true;
+    }
+    // Let the neighbors light it again
+    for (int dir = 0; dir < 6; dir++) {
+        int neighborIndex;
+        if (getNeighborVoxel(blockIndex, dir, neighborIndex)) {
+            m_sunlightSpread.push_back((ui16)neighborIndex);
+            m_lampLightSpread.push_back((ui16)neighborIndex);
+        } else {
+            m_border[dir].sunlightUpdates.emplace_back((ui16)neighborIndex, 0);
+            m_border[dir].lampLightUpdates.emplace_back((ui16)neighborIndex, 0);
+        }
+    }
+    ui16 color = (*m_blockPack)[m_blocks[blockIndex]].lightColorPacked;
+    if (color) m_lampSources.emplace_back((ui16)blockIndex, color);
 }
 
-inline void getLampColors(const ui16 l VORB_UNUSED, ui16 &r VORB_UNUSED, ui16 &g VORB_UNUSED, ui16 &b VORB_UNUSED) {
-    /*  r = l & LAMP_RED_MASK;
-      g = l & LAMP_GREEN_MASK;
-      b = l & LAMP_BLUE_MASK;*/
+void VoxelLightEngine::checkSunlightRemoval(int blockIndex, ui8 oldLightVal) {
+    ui16 light = m_sunlight[blockIndex];
+    if (light == 0) return;
+    if (light < oldLightVal) {
+        // Could have come from the removed light
+        m_sunlight[blockIndex] = 0;
+        m_sunlightRemovals.emplace_back((ui16)blockIndex, (ui8)light);
+        m_hasChanged = true;
+    } else {
+        // Has its own source, relight what was removed
+        m_sunlightSpread.push_back((ui16)blockIndex);
+    }
 }
 
-inline void removeLampNeighborUpdate(Chunk* chunk VORB_UNUSED, int blockIndex VORB_UNUSED, ui16 intensityRed VORB_UNUSED, ui16 intensityGreen VORB_UNUSED, ui16 intensityBlue VORB_UNUSED, ui16 light VORB_UNUSED) {
-   /* ui16 nextRed, nextGreen, nextBlue;
-    ui16 nextLight = chunk->getLampLight(blockIndex);
-    getLampColors(nextLight, nextRed, nextGreen, nextBlue);
+void VoxelLightEngine::removeSunlightBFS() {
+    for (size_t i = 0; i < m_sunlightRemovals.size(); i++) {
+        SunlightRemovalNode node = m_sunlightRemovals[i];
+        for (int dir = 0; dir < 6; dir++) {
+            // Full light below came from the same ray
+            ui8 oldLightVal = (dir == LIGHT_DIR_BOTTOM && node.oldLightVal == MAXLIGHT) ? SUN_RAY : node.oldLightVal;
+            int neighborIndex;
+            if (getNeighborVoxel(node.blockIndex, dir, neighborIndex)) {
+                checkSunlightRemoval(neighborIndex, oldLightVal);
+            } else {
+                m_border[dir].sunlightRemovals.emplace_back((ui16)neighborIndex, oldLightVal);
+            }
+        }
+    }
+    m_sunlightRemovals.clear();
+}
 
-    if ((nextRed && nextRed <= intensityRed) || (nextGreen && nextGreen <= intensityGreen) || (nextBlue && nextBlue <= intensityBlue)){
-        chunk->setLampLight(blockIndex, 0);
-        chunk->lampLightRemovalQueue.emplace(blockIndex, light);
+void VoxelLightEngine::offerSunlight(int blockIndex, ui8 light) {
+    const Block& block = (*m_blockPack)[m_blocks[blockIndex]];
+    if (!block.allowLight) return;
+    if (light == SUN_RAY) light = block.blockLight ? MAXLIGHT - 1 : MAXLIGHT;
+    if (light > m_sunlight[blockIndex]) {
+        m_sunlight[blockIndex] = light;
+        m_sunlightSpread.push_back((ui16)blockIndex);
+        m_hasChanged = true;
+    }
+}
 
-        if (nextRed > intensityRed || nextGreen > intensityGreen || nextBlue > intensityBlue){
-            chunk->lampLightUpdateQueue.emplace(blockIndex, 0);
+void VoxelLightEngine::placeSunlightBFS() {
+    for (size_t i = 0; i < m_sunlightSpread.size(); i++) {
+        int blockIndex = m_sunlightSpread[i];
+        ui16 light = m_sunlight[blockIndex];
+        if (light <= 1) continue;
+        for (int dir = 0; dir < 6; dir++) {
+            ui8 nextLight = getSunlightOut(light, dir);
+            int neighborIndex;
+            if (getNeighborVoxel(blockIndex, dir, neighborIndex)) {
+                offerSunlight(neighborIndex, nextLight);
+            } else {
+                m_border[dir].sunlightUpdates.emplace_back((ui16)neighborIndex, nextLight);
+            }
         }
-    } else if (nextLight > 0) {
-        chunk->lampLightUpdateQueue.emplace(blockIndex, 0);
-    }*/
+    }
+    m_sunlightSpread.clear();
 }
 
-void VoxelLightEngine::removeLampLightBFS(Chunk* chunk VORB_UNUSED, int blockIndex VORB_UNUSED, ui16 light VORB_UNUSED)
-{
-//#define RED1 0x400
-//#define GREEN1 0x20
-//#define BLUE1 1
-//
-//    ui16 intensityRed = light & LAMP_RED_MASK;
-//    ui16 intensityGreen = light & LAMP_GREEN_MASK;
-//    ui16 intensityBlue = light & LAMP_BLUE_MASK;
-//
-//    //Reduce by 1
-//    if (intensityRed != 0) {
-//        intensityRed -= RED1;
-//        light -= RED1;
-//    }
-//    if (intensityGreen != 0) {
-//        intensityGreen -= GREEN1;
-//        light -= GREEN1;
-//    }
-//    if (intensityBlue != 0) {
-//        intensityBlue -= BLUE1;
-//        light -= BLUE1;
-//    }
-//
-//    int x = blockIndex % CHUNK_WIDTH;
-//    int y = blockIndex / CHUNK_LAYER;
-//    int z = (blockIndex % CHUNK_LAYER) / CHUNK_WIDTH;
-//
-//    Chunk*& left = chunk->left;
-//    Chunk*& right = chunk->right;
-//    Chunk*& back = chunk->back;
-//    Chunk*& front = chunk->front;
-//    Chunk*& top = chunk->top;
-//    Chunk*& bottom = chunk->bottom;
-//
-//    if (x > 0){ //left
-//        removeLampNeighborUpdate(chunk, blockIndex - 1, intensityRed, intensityGreen, intensityBlue, light);    
-//    } else if (left && left->isAccessible){
-//        vvox::swapLockedChunk(left, _lockedChunk);
-//        removeLampNeighborUpdate(left, blockIndex + CHUNK_WIDTH - 1, intensityRed, intensityGreen, intensityBlue, light);
-//        left->changeState(ChunkStates::MESH);
-//        vvox::swapLockedChunk(chunk, _lockedChunk);
-//    }
-//
-//    if (x < CHUNK_WIDTH - 1){ //right
-//        removeLampNeighborUpdate(chunk, blockIndex + 1, intensityRed, intensityGreen, intensityBlue, light);
-//    } else if (right && right->isAccessible){
-//        vvox::swapLockedChunk(right, _lockedChunk);
-//        removeLampNeighborUpdate(right, blockIndex - CHUNK_WIDTH + 1, intensityRed, intensityGreen, intensityBlue, light);
-//        right->changeState(ChunkStates::MESH);
-//        vvox::swapLockedChunk(chunk, _lockedChunk);
-//    }
-//
-//    if (z > 0){ //back
-//        removeLampNeighborUpdate(chunk, blockIndex - CHUNK_WIDTH, intensityRed, intensityGreen, intensityBlue, light);
-//    } else if (back && back->isAccessible){
-//        vvox::swapLockedChunk(back, _lockedChunk);
-//        removeLampNeighborUpdate(back, blockIndex + CHUNK_LAYER - CHUNK_WIDTH, intensityRed, intensityGreen, intensityBlue, light);
-//        back->changeState(ChunkStates::MESH);
-//        vvox::swapLockedChunk(chunk, _lockedChunk);
-//    }
-//
-//    if (z < CHUNK_WIDTH - 1){ //front
-//        removeLampNeighborUpdate(chunk, blockIndex + CHUNK_WIDTH, intensityRed, intensityGreen, intensityBlue, light);
-//    } else if (front && front->isAccessible){
-//        vvox::swapLockedChunk(front, _lockedChunk);
-//        removeLampNeighborUpdate(front, blockIndex - CHUNK_LAYER + CHUNK_WIDTH, intensityRed, intensityGreen, intensityBlue, light);
-//        front->changeState(ChunkStates::MESH);
-//        vvox::swapLockedChunk(chunk, _lockedChunk);
-//    }
-//
-//    if (y > 0){ //bottom
-//        removeLampNeighborUpdate(chunk, blockIndex - CHUNK_LAYER, intensityRed, intensityGreen, intensityBlue, light);
-//    } else if (bottom && bottom->isAccessible){
-//        vvox::swapLockedChunk(bottom, _lockedChunk);
-//        removeLampNeighborUpdate(bottom, CHUNK_SIZE - CHUNK_LAYER + blockIndex, intensityRed, intensityGreen, intensityBlue, light);
-//        bottom->changeState(ChunkStates::MESH);
-//        vvox::swapLockedChunk(chunk, _lockedChunk);
-//    }
-//
-//    if (y < CHUNK_WIDTH - 1){ //top
-//        removeLampNeighborUpdate(chunk, blockIndex + CHUNK_LAYER, intensityRed, intensityGreen, intensityBlue, light);
-//    } else if (top && top->isAccessible){
-//        vvox::swapLockedChunk(top, _lockedChunk);
-//        removeLampNeighborUpdate(top, blockIndex - CHUNK_SIZE + CHUNK_LAYER, intensityRed, intensityGreen, intensityBlue, light);
-//        top->changeState(ChunkStates::MESH);
-//        vvox::swapLockedChunk(chunk, _lockedChunk);
-//    }
-//    chunk->changeState(ChunkStates::MESH);
+void VoxelLightEngine::checkLampLightRemoval(int blockIndex, ui16 oldLightColor) {
+    ui16 light = m_lampLight[blockIndex];
+    if (light == 0) return;
+    // Colors are removed separately
+    static const ui16 MASKS[3] = { LAMP_RED_MASK, LAMP_GREEN_MASK, LAMP_BLUE_MASK };
+    ui16 removed = 0;
+    bool isSource = false;
+    for (int c = 0; c < 3; c++) {
+        ui16 color = light & MASKS[c];
+        ui16 oldColor = oldLightColor & MASKS[c];
+        if (color == 0 || oldColor == 0) continue;
+        if (color < oldColor) {
+            removed |= color;
+        } else {
+            isSource = true;
+        }
+    }
+    if (removed) {
+        m_lampLight[blockIndex] = light & ~removed;
+        m_lampLightRemovals.emplace_back((ui16)blockIndex, removed);
+        m_hasChanged = true;
+    }
+    if (isSource) m_lampLightSpread.push_back((ui16)blockIndex);
+}
 
+void VoxelLightEngine::removeLampLightBFS() {
+    for (size_t i = 0; i < m_lampLightRemovals.size(); i++) {
+        LampLightRemovalNode node = m_lampLightRemovals[i];
+        for (int dir = 0; dir < 6; dir++) {
+            int neighborIndex;
+            if (getNeighborVoxel(node.blockIndex, dir, neighborIndex)) {
+                checkLampLightRemoval(neighborIndex, node.oldLightColor);
+            } else {
+                m_border[dir].lampLightRemovals.emplace_back((ui16)neighborIndex, node.oldLightColor);
+            }
+        }
+    }
+    m_lampLightRemovals.clear();
 }
 
-inline void placeLampNeighborUpdate(Chunk* chunk VORB_UNUSED, int blockIndex VORB_UNUSED, ui16 intensityRed VORB_UNUSED, ui16 intensityGreen VORB_UNUSED, ui16 intensityBlue VORB_UNUSED) {
-  /*  ui16 currentLight = chunk->getLampLight(blockIndex);
-    const Block& block = chunk->getBlock(blockIndex);
+void VoxelLightEngine::offerLampLight(int blockIndex, ui16 light) {
+    const Block& block = (*m_blockPack)[m_blocks[blockIndex]];
+    if (!block.allowLight) return;
+    // Tinted blocks filter the light entering them
+    ui16 red = (ui16)((light >> LAMP_RED_SHIFT) * block.colorFilter.r) << LAMP_RED_SHIFT;
+    ui16 green = (ui16)(((light & LAMP_GREEN_MASK) >> LAMP_GREEN_SHIFT) * block.colorFilter.g) << LAMP_GREEN_SHIFT;
+    ui16 blue = (ui16)((light & LAMP_BLUE_MASK) * block.colorFilter.b);
+    ui16 current = m_lampLight[blockIndex];
+    ui16 next = getMaxLampColors(current, red | green | blue);
+    if (next != current) {
+        m_lampLight[blockIndex] = next;
+        m_lampLightSpread.push_back((ui16)blockIndex);
+        m_hasChanged = true;
+    }
+}
 
-    intensityRed = (ui16)((intensityRed >> LAMP_RED_SHIFT) * block.colorFilter.r) << LAMP_RED_SHIFT;
-    intensityGreen = (ui16)((intensityGreen >> LAMP_GREEN_SHIFT) * block.colorFilter.g) << LAMP_GREEN_SHIFT;
-    intensityBlue = (ui16)(intensityBlue * block.colorFilter.b);
+void VoxelLightEngine::placeLampLightBFS() {
+    for (size_t i = 0; i < m_lampLightSpread.size(); i++) {
+        int blockIndex = m_lampLightSpread[i];
+        ui16 nextLight = dimLampLight(m_lampLight[blockIndex]);
+        if (nextLight == 0) continue;
+        for (int dir = 0; dir < 6; dir++) {
+            int neighborIndex;
+            if (getNeighborVoxel(blockIndex, dir, neighborIndex)) {
+                offerLampLight(neighborIndex, nextLight);
+            } else {
+                m_border[dir].lampLightUpdates.emplace_back((ui16)neighborIndex, nextLight);
+            }
+        }
+    }
+    m_lampLightSpread.clear();
+}
 
-    ui16 nextLight = getMaxLampColors(intensityRed, intensityGreen, intensityBlue, currentLight);
-    if (nextLight != currentLight){
-        if (chunk->getBlock(blockIndex).allowLight){
-            chunk->setLampLight(blockIndex, nextLight);
-            chunk->lampLightUpdateQueue.emplace(blockIndex, nextLight);
+// Run length encodes flat data for an interval tree
+inline void buildLightNodes(const ui16* data, OUT std::vector<IntervalTree<ui16>::LNode>& nodes) {
+    nodes.clear();
+    int start = 0;
+    for (int i = 1; i <= CHUNK_SIZE; i++) {
+        if (i == CHUNK_SIZE || data[i] != data[start]) {
+            nodes.emplace_back();
+            nodes.back().set(start, i - start, data[start]);
+            start = i;
         }
-    }*/
+    }
 }
 
-void VoxelLightEngine::placeLampLightBFS(Chunk* chunk VORB_UNUSED, int blockIndex VORB_UNUSED, ui16 intensity VORB_UNUSED)
-{
-//#define RED1 0x400
-//#define GREEN1 0x20
-//#define BLUE1 1
-//
-//    ui16 currentLight = chunk->getLampLight(blockIndex);
-//
-//    ui16 currentRed = currentLight & LAMP_RED_MASK;
-//    ui16 currentGreen = currentLight & LAMP_GREEN_MASK;
-//    ui16 currentBlue = currentLight & LAMP_BLUE_MASK;
-//
-//    ui16 intensityRed = intensity & LAMP_RED_MASK;
-//    ui16 intensityGreen = intensity & LAMP_GREEN_MASK;
-//    ui16 intensityBlue = intensity & LAMP_BLUE_MASK;
-//
-//    intensityRed = MAX(currentRed, intensityRed);
-//    intensityGreen = MAX(currentGreen, intensityGreen);
-//    intensityBlue = MAX(currentBlue, intensityBlue);
-//
-//    const Block& currentBlock = chunk->getBlock(blockIndex);
-//
-//    intensityRed = (ui16)((intensityRed >> LAMP_RED_SHIFT) * currentBlock.colorFilter.r) << LAMP_RED_SHIFT;
-//    intensityGreen = (ui16)((intensityGreen >> LAMP_GREEN_SHIFT) * currentBlock.colorFilter.g) << LAMP_GREEN_SHIFT;
-//    intensityBlue = (ui16)(intensityBlue * currentBlock.colorFilter.b);
-//    intensity = intensityRed | intensityGreen | intensityBlue;
-//
-//    if (intensity != currentLight) { 
-//        //Set the light value
-//        chunk->setLampLight(blockIndex, intensity);
-//    }
-//
-//    if (intensityRed <= RED1 && intensityGreen <= GREEN1 && intensityBlue <= BLUE1) return;
-//    //Reduce by 1
-//    if (intensityRed != 0) {
-//        intensityRed -= RED1;
-//        intensity -= RED1;
-//    }
-//    if (intensityGreen != 0) {
-//        intensityGreen -= GREEN1;
-//        intensity -= GREEN1;
-//    }
-//    if (intensityBlue != 0) {
-//        intensityBlue -= BLUE1;
-//        intensity -= BLUE1;
-//    }
-//
-//    chunk->dirty = 1;
-//
-//    int x = blockIndex % CHUNK_WIDTH;
-//    int y = blockIndex / CHUNK_LAYER;
-//    int z = (blockIndex % CHUNK_LAYER) / CHUNK_WIDTH;
-//
-//    Chunk*& left = chunk->left;
-//    Chunk*& right = chunk->right;
-//    Chunk*& back = chunk->back;
-//    Chunk*& front = chunk->front;
-//    Chunk*& top = chunk->top;
-//    Chunk*& bottom = chunk->bottom;
-//
-//    if (x > 0){ //left
-//        placeLampNeighborUpdate(chunk, blockIndex - 1, intensityRed, intensityGreen, intensityBlue);
-//    } else if (left && left->isAccessible){
-//        vvox::swapLockedChunk(left, _lockedChunk);
-//        placeLampNeighborUpdate(left, blockIndex + CHUNK_WIDTH - 1, intensityRed, intensityGreen, intensityBlue);
-//        left->changeState(ChunkStates::MESH);
-//        vvox::swapLockedChunk(chunk, _lockedChunk);
-//    }
-//
-//    if (x < CHUNK_WIDTH - 1){ //right
-//        placeLampNeighborUpdate(chunk, blockIndex + 1, intensityRed, intensityGreen, intensityBlue);
-//    } else if (right && right->isAccessible){
-//        vvox::swapLockedChunk(right, _lockedChunk);
-//        placeLampNeighborUpdate(right, blockIndex - CHUNK_WIDTH + 1, intensityRed, intensityGreen, intensityBlue);
-//        right->changeState(ChunkStates::MESH);
-//        vvox::swapLockedChunk(chunk, _lockedChunk);
-//    }
-//
-//    if (z > 0){ //back
-//        placeLampNeighborUpdate(chunk, blockIndex - CHUNK_WIDTH, intensityRed, intensityGreen, intensityBlue);
-//    } else if (back && back->isAccessible){
-//        vvox::swapLockedChunk(back, _lockedChunk);
-//        placeLampNeighborUpdate(back, blockIndex + CHUNK_LAYER - CHUNK_WIDTH, intensityRed, intensityGreen, intensityBlue);
-//        back->changeState(ChunkStates::MESH);
-//        vvox::swapLockedChunk(chunk, _lockedChunk);
-//    }
-//
-//    if (z < CHUNK_WIDTH - 1){ //front
-//        placeLampNeighborUpdate(chunk, blockIndex + CHUNK_WIDTH, intensityRed, intensityGreen, intensityBlue);
-//    } else if (front && front->isAccessible){
-//        vvox::swapLockedChunk(front, _lockedChunk);
-//        placeLampNeighborUpdate(front, blockIndex - CHUNK_LAYER + CHUNK_WIDTH, intensityRed, intensityGreen, intensityBlue);
-//        front->changeState(ChunkStates::MESH);
-//        vvox::swapLockedChunk(chunk, _lockedChunk);
-//    }
-//
-//    if (y > 0){ //bottom
-//        placeLampNeighborUpdate(chunk, blockIndex - CHUNK_LAYER, intensityRed, intensityGreen, intensityBlue);
-//    } else if (bottom && bottom->isAccessible){
-//        vvox::swapLockedChunk(bottom, _lockedChunk);
-//        placeLampNeighborUpdate(bottom, CHUNK_SIZE - CHUNK_LAYER + blockIndex, intensityRed, intensityGreen, intensityBlue);
-//        bottom->changeState(ChunkStates::MESH);
-//        vvox::swapLockedChunk(chunk, _lockedChunk);
-//    }
-//    if (y < CHUNK_WIDTH - 1){ //top
-//        placeLampNeighborUpdate(chunk, blockIndex + CHUNK_LAYER, intensityRed, intensityGreen, intensityBlue);
-//    } else if (top && top->isAccessible){
-//        vvox::swapLockedChunk(top, _lockedChunk);
-//        placeLampNeighborUpdate(top, blockIndex - CHUNK_SIZE + CHUNK_LAYER, intensityRed, intensityGreen, intensityBlue);
-//        top->changeState(ChunkStates::MESH);
-//        vvox::swapLockedChunk(chunk, _lockedChunk);
-//    }
-//
-//    chunk->changeState(ChunkStates::MESH);
-}
\ No newline at end of file
+void VoxelLightEngine::writeLight(Chunk* chunk) {
+    // Light is mostly uniform, so it goes back into a tree
+    static thread_local std::vector<IntervalTree<ui16>::LNode> nodes;
+    buildLightNodes(m_sunlight, nodes);
+    chunk->sunlight.clear();
+    chunk->sunlight.initFromSortedArray(vvox::VoxelStorageState::INTERVAL_TREE, nodes);
+    buildLightNodes(m_lampLight, nodes);
+    chunk->lampLight.clear();
+    chunk->lampLight.initFromSortedArray(vvox::VoxelStorageState::INTERVAL_TREE, nodes);
+}
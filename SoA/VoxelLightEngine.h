@@ -1,6 +1,18 @@
 #pragma once
 
 #include <Vorb/types.h>
+#include <vector>
+
+#include "ChunkHandle.h"
+#include "Constants.h"
+
+class BlockPack;
+class Chunk;
+
+const ui8 MAXLIGHT = 31;
+// Offered by a full strength sun ray coming from above. It stays at MAXLIGHT
+// through voxels that don't scatter sun rays.
+const ui8 SUN_RAY = MAXLIGHT + 1;
 
 //Used to tell neighbors to update light
 //class LightMessage {
@@ -24,7 +36,7 @@ class SunlightUpdateNode
 public:
     SunlightUpdateNode(ui16 BlockIndex, ui8 LightVal) : blockIndex(BlockIndex), lightVal(LightVal){}
     ui16 blockIndex;
-    ui8 lightVal;
+    ui8 lightVal; ///< 0 spreads the light already there
 };
 
 class LampLightRemovalNode
@@ -40,26 +52,67 @@ class LampLightUpdateNode
 public:
     LampLightUpdateNode(ui16 BlockIndex, ui16 LightColor) : blockIndex(BlockIndex), lightColor(LightColor){}
     ui16 blockIndex;
-    ui16 lightColor;
+    ui16 lightColor; ///< 0 spreads the light already there
 };
 
-class Chunk;
+/// Light work waiting for a chunk. Edits and light crossing in from neighbors
+/// add to it, the light task of the chunk takes all of it.
+class ChunkLightQueues {
+public:
+    bool empty() const;
+    void clear();
+    void swap(ChunkLightQueues& other);
+    /// Appends all of other
+    void append(const ChunkLightQueues& other);
+
+    std::vector<ui16> changedVoxels; ///< Voxels whose block changed
+    std::vector<SunlightUpdateNode> sunlightUpdates;
+    std::vector<SunlightRemovalNode> sunlightRemovals;
+    std::vector<LampLightUpdateNode> lampLightUpdates;
+    std::vector<LampLightRemovalNode> lampLightRemovals;
+};
 
+// Each worker thread gets one of these
 class VoxelLightEngine {
 public:
-    void calculateLight(Chunk* chunk);
-    void calculateSunlightExtend(Chunk* chunk);
-    void calculateSunlightRemoval(Chunk* chunk);
-
-    void checkTopForSunlight(Chunk* chunk);
+    /// Runs the queued light work of chunk, seeding its sunlight first if needed.
+    /// Only the light of chunk is written, light that leaves it is queued on the
+    /// neighbor if it is lit. Neighbors that aren't read it from chunk when they
+    /// are seeded. The neighbors must not be updating at the same time.
+    /// @param neighbors: Handles in Chunk::neighbors order, may be unacquired
+    void update(Chunk* chunk, ChunkHandle neighbors[6], const BlockPack* blocks);
 private:
-   
-    void blockSunRay(Chunk* chunk, int xz, int y);
-    void extendSunRay(Chunk* chunk, int xz, int y);
-    void removeSunlightBFS(Chunk* chunk, int blockIndex, ui8 oldLightVal);
-    void placeSunlightBFS(Chunk* chunk, int blockIndex, ui8 intensity);
-    void removeLampLightBFS(Chunk* chunk, int blockIndex, ui16 light);
-    void placeLampLightBFS(Chunk* chunk, int blockIndex, ui16 intensity);
-
-//    Chunk* _lockedChunk = nullptr;
-};
\ No newline at end of file
+    void seedLight(Chunk* chunk, ChunkHandle neighbors[6]);
+    void addChangedVoxel(int blockIndex);
+
+    void removeSunlightBFS();
+    void placeSunlightBFS();
+    void removeLampLightBFS();
+    void placeLampLightBFS();
+
+    // Seeds for the BFS, they compare against the light already in the voxel
+    void checkSunlightRemoval(int blockIndex, ui8 oldLightVal);
+    void checkLampLightRemoval(int blockIndex, ui16 oldLightColor);
+    void offerSunlight(int blockIndex, ui8 light);
+    void offerLampLight(int blockIndex, ui16 light);
+
+    void writeLight(Chunk* chunk);
+
+    const BlockPack* m_blockPack = nullptr;
+    bool m_hasChanged;
+
+    // Flat copies of the chunk
+    ui16 m_blocks[CHUNK_SIZE];
+    ui16 m_sunlight[CHUNK_SIZE];
+    ui16 m_lampLight[CHUNK_SIZE];
+
+    ChunkLightQueues m_work; ///< Taken from the chunk
+    ChunkLightQueues m_border[6]; ///< Leaving the chunk, in Chunk::neighbors order
+
+    // BFS queues
+    std::vector<SunlightRemovalNode> m_sunlightRemovals;
+    std::vector<LampLightRemovalNode> m_lampLightRemovals;
+    std::vector<ui16> m_sunlightSpread;
+    std::vector<ui16> m_lampLightSpread;
+    std::vector<LampLightUpdateNode> m_lampSources; ///< Emitters, placed after removal
+};
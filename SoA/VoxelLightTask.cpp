@@ -0,0 +1,24 @@
+#include "stdafx.h"
+#include "VoxelLightTask.h"
+
+#include "Chunk.h"
+#include "VoxelLightEngine.h"
+
+void VoxelLightTask::execute(WorkerData* workerData) {
+    // Lazily allocate the light engine
+    if (workerData->voxelLightEngine == nullptr) {
+        workerData->voxelLightEngine = new VoxelLightEngine;
+    }
+    workerData->voxelLightEngine->update(chunk, neighborHandles, blockPack);
+
+    chunk.release();
+    for (int i = 0; i < 6; i++) {
+        if (neighborHandles[i].isAquired()) neighborHandles[i].release();
+    }
+    // Last so the updater can't start the next batch while we hold handles
+    (*runningTasks)--;
+}
+
+void VoxelLightTask::cleanup() {
+    recycler->recycle(this);
+}
@@ -0,0 +1,44 @@
+///
+/// VoxelLightTask.h
+/// Seed of Andromeda
+///
+/// Copyright 2014 Regrowth Studios
+/// MIT License
+///
+/// Summary:
+/// Runs the light updates of one chunk on the thread pool.
+///
+
+#pragma once
+
+#ifndef VoxelLightTask_h__
+#define VoxelLightTask_h__
+
+#include <Vorb/IThreadPoolTask.h>
+#include <atomic>
+
+#include "ChunkHandle.h"
+#include "ConcurrentRecycler.h"
+#include "VoxPool.h"
+
+class BlockPack;
+
+#define VOXEL_LIGHT_TASK_ID 4
+
+class VoxelLightTask : public vcore::IThreadPoolTask<WorkerData> {
+public:
+    VoxelLightTask() : vcore::IThreadPoolTask<WorkerData>(VOXEL_LIGHT_TASK_ID) {}
+
+    // Executes the task
+    void execute(WorkerData* workerData) override;
+
+    void cleanup() override;
+
+    ChunkHandle chunk;
+    ChunkHandle neighborHandles[6]; ///< In Chunk::neighbors order
+    const BlockPack* blockPack = nullptr;
+    std::atomic<ui32>* runningTasks = nullptr; ///< Decremented when the task is done
+    ConcurrentRecycler<VoxelLightTask>* recycler = nullptr; ///< Where the task came from
+};
+
+#endif // VoxelLightTask_h__
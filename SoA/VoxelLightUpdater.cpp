@@ -0,0 +1,20 @@
+#include "stdafx.h"
+#include "VoxelLightUpdater.h"
+
+#include "ChunkGrid.h"
+
+void VoxelLightUpdater::init(ChunkGrid* grid, OPT vcore::ThreadPool<WorkerData>* threadPool) {
+    m_grid = grid;
+    m_checkerboard.init(threadPool);
+}
+
+void VoxelLightUpdater::update() {
+    if (m_checkerboard.isBusy()) return;
+
+    const BlockPack* blockPack = m_grid->blockPack;
+    m_checkerboard.sendBatch(m_grid->acquireActiveChunks(),
+                             [](const Chunk& chunk) { return !chunk.isLit || chunk.hasLightUpdates; },
+                             [&](VoxelLightTask& task) { task.blockPack = blockPack; });
+    m_grid->releaseActiveChunks();
+    m_checkerboard.runInlineTasks();
+}
@@ -0,0 +1,37 @@
+///
+/// VoxelLightUpdater.h
+/// Seed of Andromeda
+///
+/// Copyright 2014 Regrowth Studios
+/// MIT License
+///
+/// Summary:
+/// Schedules chunk light tasks in a checkerboard pattern so that
+/// neighboring chunks never update their light at the same time.
+///
+
+#pragma once
+
+#ifndef VoxelLightUpdater_h__
+#define VoxelLightUpdater_h__
+
+#include "ChunkCheckerboard.h"
+#include "VoxelLightTask.h"
+
+class ChunkGrid;
+
+class VoxelLightUpdater {
+public:
+    void init(ChunkGrid* grid, OPT vcore::ThreadPool<WorkerData>* threadPool);
+
+    /// Sends light tasks for chunks of one color once the last batch has finished.
+    /// Chunks of one color share no faces, so the batch runs fully in parallel and
+    /// each task can read the light of its neighbors without locking.
+    /// Without a thread pool the batch runs on the calling thread.
+    void update();
+private:
+    ChunkGrid* m_grid = nullptr;
+    ChunkCheckerboard<VoxelLightTask> m_checkerboard;
+};
+
+#endif // VoxelLightUpdater_h__
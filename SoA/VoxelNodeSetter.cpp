@@ -3,73 +3,126 @@
 
 #include "ChunkGrid.h"
 
-void VoxelNodeSetter::setNodes(ChunkHandle& h, ChunkGenLevel requiredGenLevel, std::vector<VoxelToPlace>& forcedNodes, std::vector<VoxelToPlace>& condNodes) {
-    {
-        std::lock_guard<std::mutex> l(m_lckVoxelsToAdd);
-        auto it = m_handleLookup.find(h);
-        if (it != m_handleLookup.end()) {
-            VoxelNodeSetterLookupData& ld = it->second;
-            // Copy new voxels to add
-            size_t oldSize = ld.forcedNodes.size();
-            ld.forcedNodes.resize(oldSize + forcedNodes.size());
-            memcpy(&ld.forcedNodes[oldSize], forcedNodes.data(), forcedNodes.size() * sizeof(VoxelToPlace));
-            oldSize = ld.condNodes.size();
-            ld.condNodes.resize(oldSize + condNodes.size());
-            memcpy(&ld.condNodes[oldSize], condNodes.data(), condNodes.size() * sizeof(VoxelToPlace));
-            // Update required gen level if needed
-            if (m_waitingChunks[ld.waitingChunksIndex].requiredGenLevel < requiredGenLevel) {
-                m_waitingChunks[ld.waitingChunksIndex].requiredGenLevel = requiredGenLevel;
-            }
+namespace {
+    const ui32 FORCED_PRIORITY_BIT = 0x80000000u;
+    const size_t MAX_SEQUENCE = 0xFFFF;
+    const size_t MIN_OWNER_SLOTS = 64;
+
+    // Owner slots hold (blockIndex + 1) << 48 | priority << 16 | blockID, 0 is empty.
+    // The low 48 bits compare like the priority with the block ID breaking ties.
+    const ui64 OWNER_RANK_MASK = 0xFFFFFFFFFFFFull;
+
+    inline ui64 getRank(const VoxelToPlace& node) {
+        return ((ui64)node.priority << 16) | node.blockID;
+    }
+
+    /// Finds the owner slot of a voxel, or the empty slot it goes in
+    ui64& findOwner(std::vector<ui64>& owners, ui16 blockIndex) {
+        ui64 key = (ui64)(blockIndex + 1) << 48;
+        size_t mask = owners.size() - 1;
+        size_t i = (blockIndex * 2654435761u) & mask;
+        while (owners[i] && (owners[i] & ~OWNER_RANK_MASK) != key) {
+            i = (i + 1) & mask;
+        }
+        return owners[i];
+    }
+
+    void growOwners(std::vector<ui64>& owners) {
+        std::vector<ui64> old;
+        old.swap(owners);
+        owners.resize(old.empty() ? MIN_OWNER_SLOTS : old.size() * 2, 0);
+        for (auto& slot : old) {
+            if (slot) findOwner(owners, (ui16)((slot >> 48) - 1)) = slot;
+        }
+    }
+
+    /// Sets the voxel if the node outranks whatever flora is already there.
+    /// Must hold the data lock of the chunk.
+    void placeNode(Chunk& chunk, const VoxelToPlace& node) {
+        // Keep the table at most half full
+        if ((chunk.numFloraOwners + 1) * 2 > chunk.floraOwners.size()) growOwners(chunk.floraOwners);
+        ui64& owner = findOwner(chunk.floraOwners, node.blockIndex);
+        ui64 rank = getRank(node);
+        if (owner) {
+            if ((owner & OWNER_RANK_MASK) >= rank) return;
         } else {
-            VoxelNodeSetterLookupData& ld = m_handleLookup[h];
-            ld.forcedNodes.swap(forcedNodes);
-            ld.condNodes.swap(condNodes);
-            ld.h = h.acquire();
-            ld.waitingChunksIndex = m_waitingChunks.size();
-
-            VoxelNodeSetterWaitingChunk wc;
-            wc.ch = h;
-            wc.requiredGenLevel = requiredGenLevel;
-            m_waitingChunks.push_back(std::move(wc));
+            // TODO(Ben): Custom condition
+            if (!(node.priority & FORCED_PRIORITY_BIT) && chunk.blocks.get(node.blockIndex) != 0) return;
+            chunk.numFloraOwners++;
         }
+        owner = ((ui64)(node.blockIndex + 1) << 48) | rank;
+        chunk.blocks.set(node.blockIndex, node.blockID);
+    }
+}
+
+void VoxelNodeSetter::setNodes(ChunkHandle& h, VoxelNodeBatch* batch) {
+    batch->next = h->pendingNodes.load(std::memory_order_relaxed);
+    while (!h->pendingNodes.compare_exchange_weak(batch->next, batch));
+
+    // Pairs with the fence in flushNodes. Either we see the terrain, or the
+    // generator sees the batch when it flushes after setting it.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (h->genLevel >= GEN_TERRAIN) {
+        flushNodes(h);
+    } else {
+        // TODO(Ben): Faster overload?
+        grid->submitQuery(h->getChunkPosition(), GEN_TERRAIN, true);
     }
-    // TODO(Ben): Faster overload?
-    grid->submitQuery(h->getChunkPosition(), requiredGenLevel, true);
 }
 
-void VoxelNodeSetter::update() {
-    if (m_waitingChunks.size()) {
-        std::cout << m_waitingChunks.size() << std::endl;
+void VoxelNodeSetter::flushNodes(ChunkHandle& h) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    VoxelNodeBatch* batches = h->pendingNodes.exchange(nullptr);
+    if (!batches) return;
+
+    {
+        std::lock_guard<std::shared_timed_mutex> l(h->dataMutex);
+        for (VoxelNodeBatch* b = batches; b; b = b->next) {
+            for (auto& node : b->nodes) placeNode(*h, node);
+        }
     }
-    std::lock_guard<std::mutex> l(m_lckVoxelsToAdd);
-    for (int i = (int)m_waitingChunks.size() - 1; i >= 0; i--) {
-        VoxelNodeSetterWaitingChunk& v = m_waitingChunks[i];
-
-        if (v.ch->genLevel >= v.requiredGenLevel) {
-            auto it = m_handleLookup.find(v.ch);
-
-            {
-                // Send task
-                // TODO(Ben): MEMORY MANAGEMENT PROBLEM
-                VoxelNodeSetterTask* newTask = new VoxelNodeSetterTask;
-                newTask->h = it->second.h.acquire();
-                newTask->forcedNodes.swap(it->second.forcedNodes);
-                newTask->condNodes.swap(it->second.condNodes);
-                threadPool->addTask(newTask);
+    // Saved chunks don't generate flora again when loaded, so whatever reached
+    // this chunk from its neighbors has to be saved with it
+    h->flagDirty();
+
+    if (h->genLevel >= GEN_DONE) {
+        // Nodes can land anywhere in the chunk
+        h->meshSlabs |= ALL_MESH_SLABS;
+        h->isOccupancyStale = true;
+        {
+            std::lock_guard<std::mutex> l(h->lckLightQueues);
+            for (VoxelNodeBatch* b = batches; b; b = b->next) {
+                for (auto& node : b->nodes) h->lightQueues.changedVoxels.push_back(node.blockIndex);
             }
-           
-            it->second.h.release();
-            m_handleLookup.erase(it);
-            
-            // Copy back node for fast removal from vector
-            VoxelNodeSetterWaitingChunk& bn = m_waitingChunks.back();
-            v.ch = bn.ch;
-            v.requiredGenLevel = bn.requiredGenLevel;
-
-            // Update lookup index
-            m_handleLookup[v.ch].waitingChunksIndex = i;
-
-            m_waitingChunks.pop_back();
+            h->hasLightUpdates = true;
         }
+        h->DataChange(h);
+    }
+
+    recycleBatches(batches);
+}
+
+void VoxelNodeSetter::dropNodes(Chunk& chunk) {
+    recycleBatches(chunk.pendingNodes.exchange(nullptr));
+}
+
+void VoxelNodeSetter::recycleBatches(VoxelNodeBatch* batches) {
+    while (batches) {
+        VoxelNodeBatch* next = batches->next;
+        // Keep the capacity for the next use
+        batches->nodes.clear();
+        m_batchRecycler.recycle(batches);
+        batches = next;
     }
 }
+
+ui32 VoxelNodeSetter::getPriority(const ChunkID& source, size_t sequence, bool isForced) {
+    // Mix the ID so neighboring chunks don't always outrank each other the same way
+    ui64 h = source.id * 0x9E3779B97F4A7C15ull;
+    h ^= h >> 29;
+    h *= 0xBF58476D1CE4E5B9ull;
+    h ^= h >> 32;
+    if (sequence > MAX_SEQUENCE) sequence = MAX_SEQUENCE;
+    if (!isForced) sequence = MAX_SEQUENCE - sequence;
+    return (isForced ? FORCED_PRIORITY_BIT : 0) | (((ui32)h & 0x7FFF) << 16) | (ui32)sequence;
+}
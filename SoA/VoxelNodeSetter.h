@@ -7,7 +7,8 @@
 // MIT License
 //
 // Summary:
-// Waits on chunk generation queries and then sets voxels.
+// Queues voxels for chunks that don't have terrain yet and sets them
+// once they do.
 //
 
 #pragma once
@@ -16,40 +17,60 @@
 #define VoxelNodeSetter_h__
 
 #include <vector>
+#include "ChunkID.h"
 #include "ChunkQuery.h"
-#include "VoxelNodeSetterTask.h"
+#include "ConcurrentRecycler.h"
 
+class Chunk;
 class ChunkHandle;
 class ChunkGrid;
 
-struct VoxelNodeSetterWaitingChunk {
-    Chunk* ch;
-    ChunkGenLevel requiredGenLevel;
+struct VoxelToPlace {
+    VoxelToPlace() {};
+    VoxelToPlace(ui16 blockID, ui16 blockIndex, ui32 priority) : blockID(blockID), blockIndex(blockIndex), priority(priority) {};
+    ui16 blockID;
+    ui16 blockIndex;
+    ui32 priority; ///< See VoxelNodeSetter::getPriority
 };
 
-struct VoxelNodeSetterLookupData {
-    ui32 waitingChunksIndex;
-    ChunkHandle h;
-    std::vector<VoxelToPlace> forcedNodes; ///< Always added
-    std::vector<VoxelToPlace> condNodes; ///< Conditionally added
+/// Nodes one chunk generated for another, linked into the pending list of the target
+struct VoxelNodeBatch {
+    std::vector<VoxelToPlace> nodes;
+    VoxelNodeBatch* next = nullptr;
 };
 
+/// Nodes from different chunks arrive in any order, so a voxel goes to the node
+/// with the highest priority instead of the last one placed. Chunks remember who
+/// owns their flora voxels, which makes the result the same for any thread count.
 class VoxelNodeSetter {
 public:
-    // Contents of vectors may be cleared
-    void setNodes(ChunkHandle& h,
-                  ChunkGenLevel requiredGenLevel,
-                  std::vector<VoxelToPlace>& forcedNodes,
-                  std::vector<VoxelToPlace>& condNodes);
+    /// Gets an empty batch, recycled ones keep their capacity. Thread safe.
+    VoxelNodeBatch* createBatch() { return m_batchRecycler.create(); }
 
-    void update();
+    /// Adds the batch to the pending list of the chunk without locking. The nodes are
+    /// placed right away if the chunk has terrain, otherwise when it gets it.
+    /// Takes the batch. Thread safe.
+    void setNodes(ChunkHandle& h, VoxelNodeBatch* batch);
+
+    /// Places the pending nodes of a chunk that has terrain. Thread safe.
+    void flushNodes(ChunkHandle& h);
+
+    /// Recycles the pending nodes of a chunk that is being freed. Thread safe.
+    void dropNodes(Chunk& chunk);
+
+    /// Forced nodes beat conditional ones, then the source chunk decides and then
+    /// the order the source generated them in. Later forced nodes win, like a
+    /// plain overwrite, and earlier conditional ones win, like an empty check.
+    /// @param source: Chunk that generated the node
+    /// @param sequence: Index of the node in the output of the source
+    /// @param isForced: Set even if the voxel isn't empty
+    static ui32 getPriority(const ChunkID& source, size_t sequence, bool isForced);
 
     ChunkGrid* grid = nullptr;
-    vcore::ThreadPool<WorkerData>* threadPool;
 private:
-    std::mutex m_lckVoxelsToAdd;
-    std::vector<VoxelNodeSetterWaitingChunk> m_waitingChunks;
-    std::map<Chunk*, VoxelNodeSetterLookupData> m_handleLookup; ///< Stores handles since they fk up in vector.
+    void recycleBatches(VoxelNodeBatch* batches);
+
+    ConcurrentRecycler<VoxelNodeBatch> m_batchRecycler;
 };
 
 #endif // VoxelNodeSetter_h__
@@ -0,0 +1,195 @@
+#include "stdafx.h"
+#include "VoxelRaycaster.h"
+
+#include <float.h>
+
+#include <Vorb/utils.h>
+
+#include "BlockPack.h"
+#include "ChunkGrid.h"
+#include "VoxelSpaceConversions.h"
+
+#define OCCUPANCY_CELL_WIDTH 8
+#define OCCUPANCY_CELL_SHIFT 3
+#define OCCUPANCY_CELLS_PER_ROW (CHUNK_WIDTH / OCCUPANCY_CELL_WIDTH)
+
+inline ui64 getOccupancyBit(int x, int y, int z) {
+    return (ui64)1 << ((x >> OCCUPANCY_CELL_SHIFT) +
+                       (z >> OCCUPANCY_CELL_SHIFT) * OCCUPANCY_CELLS_PER_ROW +
+                       (y >> OCCUPANCY_CELL_SHIFT) * OCCUPANCY_CELLS_PER_ROW * OCCUPANCY_CELLS_PER_ROW);
+}
+
+void VoxelRaycaster::castRays(ChunkGrid& grid, const VoxelRayRequest* rays, size_t numRays,
+                              OUT VoxelRayFullQuery* results, PredBlock f) {
+    for (size_t i = 0; i < numRays; i++) {
+        castRay(grid, rays[i], results[i], f);
+    }
+    // Rays of a batch are usually close, so chunks are only released at the end
+    for (auto& c : m_chunks) {
+        if (c.handle.isAquired()) c.handle.release();
+    }
+    m_chunks.clear();
+    m_chunkLookup.clear();
+}
+
+void VoxelRaycaster::castRay(ChunkGrid& grid, const VoxelRayRequest& ray, OUT VoxelRayFullQuery& result, PredBlock f) {
+    const f64v3 dir(ray.direction);
+
+    // Set up the DDA
+    m_voxel = i32v3(fastFloor(ray.position.x), fastFloor(ray.position.y), fastFloor(ray.position.z));
+    m_distance = 0.0;
+    for (int a = 0; a < 3; a++) {
+        if (dir[a] > 0.0) {
+            m_step[a] = 1;
+            m_crossingDelta[a] = 1.0 / dir[a];
+            m_nextCrossing[a] = (m_voxel[a] + 1 - ray.position[a]) * m_crossingDelta[a];
+        } else if (dir[a] < 0.0) {
+            m_step[a] = -1;
+            m_crossingDelta[a] = -1.0 / dir[a];
+            m_nextCrossing[a] = (ray.position[a] - m_voxel[a]) * m_crossingDelta[a];
+        } else {
+            m_step[a] = 0;
+            m_crossingDelta[a] = DBL_MAX;
+            m_nextCrossing[a] = DBL_MAX;
+        }
+    }
+    result = {};
+    visit(result.outer, 0);
+    // The start voxel is not tested
+    step();
+
+    while (m_distance < ray.maxDistance) {
+        i32v3 chunkPos = VoxelSpaceConversions::voxelToChunk(m_voxel);
+        i32v3 chunkMin = chunkPos * CHUNK_WIDTH;
+        i32v3 chunkMax = chunkMin + CHUNK_WIDTH_M1;
+        CachedChunk& c = getChunk(grid, ChunkID(chunkPos));
+        if (!c.chunk || c.occupancy == 0) {
+            // Nothing to hit
+            skipBox(chunkMin, chunkMax, result.outer);
+            continue;
+        }
+
+        // Walk through the chunk under one lock
+        std::shared_lock<std::shared_timed_mutex> l(c.chunk->dataMutex);
+        while (m_distance < ray.maxDistance) {
+            i32v3 pos = m_voxel - chunkMin;
+            if (pos.x < 0 || pos.y < 0 || pos.z < 0 ||
+                pos.x > CHUNK_WIDTH_M1 || pos.y > CHUNK_WIDTH_M1 || pos.z > CHUNK_WIDTH_M1) break;
+
+            if (!(c.occupancy & getOccupancyBit(pos.x, pos.y, pos.z))) {
+                i32v3 cellMin = chunkMin + ((pos >> OCCUPANCY_CELL_SHIFT) << OCCUPANCY_CELL_SHIFT);
+                skipBox(cellMin, cellMin + (OCCUPANCY_CELL_WIDTH - 1), result.outer);
+                continue;
+            }
+
+            ui16 blockID = c.chunk->blocks.get(pos.x + pos.y * CHUNK_LAYER + pos.z * CHUNK_WIDTH);
+            if (f((*grid.blockPack)[blockID])) {
+                visit(result.inner, blockID);
+                return;
+            }
+            visit(result.outer, blockID);
+            step();
+        }
+    }
+    // Missed
+    visit(result.inner, 0);
+}
+
+VoxelRaycaster::CachedChunk& VoxelRaycaster::getChunk(ChunkGrid& grid, const ChunkID& id) {
+    auto it = m_chunkLookup.find(id);
+    if (it != m_chunkLookup.end()) return m_chunks[it->second];
+
+    m_chunkLookup[id] = m_chunks.size();
+    m_chunks.emplace_back();
+    CachedChunk& c = m_chunks.back();
+    // Don't add chunks for empty space
+    c.handle = grid.accessor.tryAcquire(id);
+    c.chunk = nullptr;
+    c.occupancy = 0;
+    if (c.handle.isAquired() && c.handle->genLevel == GEN_DONE) {
+        c.chunk = c.handle;
+        c.occupancy = getOccupancy(c.chunk);
+    }
+    return c;
+}
+
+ui64 VoxelRaycaster::getOccupancy(Chunk* chunk) {
+    if (!chunk->isOccupancyStale) return chunk->occupancy;
+
+    // Writers set the flag after changing blocks, and can't change them while we
+    // hold the lock. So the flag is only cleared once the new mask is stored, and
+    // other casters rebuild it too until then instead of using the old one.
+    std::shared_lock<std::shared_timed_mutex> l(chunk->dataMutex);
+    chunk->blocks.copyRegion(i32v3(0), i32v3(CHUNK_WIDTH), m_blocks, CHUNK_WIDTH, CHUNK_LAYER);
+    ui64 occupancy = 0;
+    int i = 0;
+    for (int y = 0; y < CHUNK_WIDTH; y++) {
+        for (int z = 0; z < CHUNK_WIDTH; z++) {
+            for (int x = 0; x < CHUNK_WIDTH; x++, i++) {
+                if (m_blocks[i]) occupancy |= getOccupancyBit(x, y, z);
+            }
+        }
+    }
+    chunk->occupancy = occupancy;
+    chunk->isOccupancyStale = false;
+    return occupancy;
+}
+
+void VoxelRaycaster::step() {
+    int a = 0;
+    if (m_nextCrossing[1] < m_nextCrossing[a]) a = 1;
+    if (m_nextCrossing[2] < m_nextCrossing[a]) a = 2;
+    m_distance = m_nextCrossing[a];
+    m_voxel[a] += m_step[a];
+    m_nextCrossing[a] += m_crossingDelta[a];
+}
+
+void VoxelRaycaster::skipBox(const i32v3& min, const i32v3& max, OUT VoxelRayQuery& outer) {
+    // Crossings until the ray leaves the box on each axis, the first axis to leave wins
+    i32v3 crossings;
+    int exitAxis = -1;
+    f64 exitDistance = DBL_MAX;
+    for (int a = 0; a < 3; a++) {
+        if (m_step[a] == 0) continue;
+        crossings[a] = (m_step[a] > 0) ? max[a] - m_voxel[a] + 1 : m_voxel[a] - min[a] + 1;
+        f64 d = m_nextCrossing[a] + (crossings[a] - 1) * m_crossingDelta[a];
+        if (d < exitDistance) {
+            exitDistance = d;
+            exitAxis = a;
+        }
+    }
+    if (exitAxis == -1) {
+        // Not moving
+        m_distance = DBL_MAX;
+        return;
+    }
+
+    // Jump to the last voxel in the box, then step out of it
+    for (int a = 0; a < 3; a++) {
+        if (m_step[a] == 0) continue;
+        i32 n;
+        if (a == exitAxis) {
+            n = crossings[a] - 1;
+        } else if (exitDistance > m_nextCrossing[a]) {
+            n = glm::min((i32)ceil((exitDistance - m_nextCrossing[a]) / m_crossingDelta[a]), crossings[a] - 1);
+        } else {
+            n = 0;
+        }
+        if (n == 0) continue;
+        m_distance = glm::max(m_distance, m_nextCrossing[a] + (n - 1) * m_crossingDelta[a]);
+        m_voxel[a] += m_step[a] * n;
+        m_nextCrossing[a] += n * m_crossingDelta[a];
+    }
+    visit(outer, 0);
+    step();
+}
+
+void VoxelRaycaster::visit(OUT VoxelRayQuery& query, ui16 blockID) const {
+    query.id = blockID;
+    query.location = m_voxel;
+    query.distance = m_distance;
+    query.chunkID = ChunkID(VoxelSpaceConversions::voxelToChunk(m_voxel));
+    query.voxelIndex = (ui16)((m_voxel.x & CHUNK_WIDTH_M1) +
+                              (m_voxel.y & CHUNK_WIDTH_M1) * CHUNK_LAYER +
+                              (m_voxel.z & CHUNK_WIDTH_M1) * CHUNK_WIDTH);
+}
@@ -0,0 +1,71 @@
+///
+/// VoxelRaycaster.h
+/// Seed of Andromeda
+///
+/// Copyright 2014 Regrowth Studios
+/// MIT License
+///
+/// Summary:
+/// Casts batches of voxel rays, skipping empty chunks and empty
+/// 8x8x8 cells without reading their voxels.
+///
+
+#pragma once
+
+#ifndef VoxelRaycaster_h__
+#define VoxelRaycaster_h__
+
+#include <unordered_map>
+#include <vector>
+
+#include "ChunkHandle.h"
+#include "Constants.h"
+#include "VRayHelper.h"
+
+class ChunkGrid;
+
+struct VoxelRayRequest {
+    f64v3 position; ///< Voxel space start
+    f32v3 direction; ///< Normalized
+    f64 maxDistance;
+};
+
+/// Not thread safe, but any number of raycasters can cast on the same grid at once.
+/// Each chunk is acquired once per batch and only read under its shared lock.
+class VoxelRaycaster {
+public:
+    /// Casts the rays until they hit a block that passes f. The voxel a ray starts in is
+    /// not tested. A ray missed if inner.distance >= maxDistance.
+    /// @param results: Array of numRays results
+    void castRays(ChunkGrid& grid, const VoxelRayRequest* rays, size_t numRays,
+                  OUT VoxelRayFullQuery* results, PredBlock f = &solidVoxelPredBlock);
+private:
+    struct CachedChunk {
+        ChunkHandle handle;
+        Chunk* chunk; ///< Null if not loaded
+        ui64 occupancy;
+    };
+
+    void castRay(ChunkGrid& grid, const VoxelRayRequest& ray, OUT VoxelRayFullQuery& result, PredBlock f);
+    CachedChunk& getChunk(ChunkGrid& grid, const ChunkID& id);
+    ui64 getOccupancy(Chunk* chunk);
+
+    // DDA
+    void step();
+    /// Steps out of the box of voxels [min, max] without testing them
+    /// @param outer: Set to the last voxel in the box
+    void skipBox(const i32v3& min, const i32v3& max, OUT VoxelRayQuery& outer);
+    void visit(OUT VoxelRayQuery& query, ui16 blockID) const;
+
+    i32v3 m_voxel;
+    f64 m_distance; ///< Where the ray entered m_voxel
+    i32v3 m_step;
+    f64v3 m_nextCrossing; ///< Distance of the next voxel boundary per axis
+    f64v3 m_crossingDelta;
+
+    std::vector<CachedChunk> m_chunks;
+    std::unordered_map<ChunkID, size_t> m_chunkLookup; ///< Index into m_chunks
+    ui16 m_blocks[CHUNK_SIZE]; ///< Scratch for building occupancy
+};
+
+#endif // VoxelRaycaster_h__